@@ -82,7 +82,9 @@ public:
         NameRole,
         PrefixRole,
         ModeRole,
-        TitleRole
+        TitleRole,
+        MessageRole,
+        TimeStampRole
     };
 
     enum SortMethod {
@@ -49,7 +49,8 @@ class IRC_CORE_EXPORT IrcCommand : public QObject
     Q_PROPERTY(QStringList parameters READ parameters WRITE setParameters)
     Q_PROPERTY(QByteArray encoding READ encoding WRITE setEncoding)
     Q_PROPERTY(Type type READ type WRITE setType)
-    Q_ENUMS(Type)
+    Q_PROPERTY(Priority priority READ priority WRITE setPriority)
+    Q_ENUMS(Type Priority)
 
 public:
     enum Type {
@@ -89,6 +90,13 @@ public:
         Monitor
     };
 
+    enum Priority {
+        DefaultPriority,
+        HighPriority,
+        NormalPriority,
+        LowPriority
+    };
+
     explicit IrcCommand(QObject* parent = nullptr);
     ~IrcCommand() override;
 
@@ -98,6 +106,9 @@ public:
     Type type() const;
     void setType(Type type);
 
+    Priority priority() const;
+    void setPriority(Priority priority);
+
     QStringList parameters() const;
     void setParameters(const QStringList& parameters);
 
@@ -163,5 +174,6 @@ IRC_END_NAMESPACE
 
 Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcCommand*))
 Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcCommand::Type))
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcCommand::Priority))
 
 #endif // IRCCOMMAND_H
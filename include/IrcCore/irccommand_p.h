@@ -30,11 +30,22 @@
 #define IRCCOMMAND_P_H
 
 #include "irccommand.h"
+#include "ircnetwork.h"
 
 #include <QPointer>
+#include <QStringList>
 
 IRC_BEGIN_NAMESPACE
 
+class IrcReply;
+
+struct IrcModeChange
+{
+    QChar sign;
+    QChar mode;
+    QString arg;
+};
+
 class IrcCommandPrivate
 {
 public:
@@ -43,9 +54,13 @@ public:
     QString params(int index) const;
 
     IrcCommand::Type type = IrcCommand::Custom;
+    IrcCommand::Priority priority = IrcCommand::DefaultPriority;
     QStringList parameters;
     QByteArray encoding;
     QPointer<IrcConnection> connection;
+    QPointer<IrcReply> reply;
+    QString label;
+    QString target;
 
     static IrcCommandPrivate* get(const IrcCommand* command)
     {
@@ -53,6 +68,18 @@ public:
     }
 
     static IrcCommand* createCommand(IrcCommand::Type type, const QStringList& parameters);
+    static QList<QStringList> split(const IrcCommand* command, const IrcNetwork* network);
+
+    // the amount of modes with parameters per line, as per ISUPPORT MODES
+    static int modeLimit(const IrcNetwork* network)
+    {
+        const int limit = network->numericLimit(IrcNetwork::ModeCount);
+        return limit > 0 ? limit : 3;
+    }
+
+    // exported for the command queue of the util module, which merges modes
+    static IRC_CORE_EXPORT bool parseModes(const IrcNetwork* network, const QStringList& params, QList<IrcModeChange>* changes);
+    static IRC_CORE_EXPORT QStringList modeParameters(const QString& target, const QList<IrcModeChange>& changes);
 };
 
 IRC_END_NAMESPACE
@@ -41,6 +41,7 @@
 
 IRC_BEGIN_NAMESPACE
 
+class IrcReply;
 class IrcCommand;
 class IrcProtocol;
 class IrcConnectionPrivate;
@@ -174,6 +175,7 @@ public Q_SLOTS:
     void setDisabled(bool disabled = true);
 
     bool sendCommand(IrcCommand* command);
+    IrcReply* sendRequest(IrcCommand* command);
     bool sendData(const QByteArray& data);
     bool sendRaw(const QString& message);
 
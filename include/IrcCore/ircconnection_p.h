@@ -30,12 +30,15 @@
 #define IRCCONNECTION_P_H
 
 #include "ircconnection.h"
+#include "ircreply_p.h"
 
 #include <QSet>
 #include <QList>
 #include <QHash>
 #include <QStack>
+#include <QPointer>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QString>
 #include <QByteArray>
 #include <QAbstractSocket>
@@ -45,6 +48,17 @@ IRC_BEGIN_NAMESPACE
 class IrcMessageFilter;
 class IrcCommandFilter;
 
+// an own message presented locally that the server is going to echo back
+class IrcLocalEcho
+{
+public:
+    QString label;
+    QString target;
+    QStringList lines;
+    QElapsedTimer created;
+    QPointer<IrcMessage> message;
+};
+
 class IrcConnectionPrivate
 {
     Q_DECLARE_PUBLIC(IrcConnection)
@@ -72,7 +86,18 @@ public:
     void setInfo(const QHash<QString, QString>& info);
 
     bool receiveMessage(IrcMessage* msg);
+    void updateHostMask(IrcMessage* msg);
     IrcCommand* createCtcpReply(IrcPrivateMessage* request);
+    QList<IrcCommand*> splitMessage(IrcCommand* command);
+    int prefixLength() const;
+    QString prepareRequest(IrcCommand* command, const QString& line);
+    void handleReply(IrcMessage* msg);
+    void abortRequests();
+    void expireRequests();
+    QString echoLabel(const IrcCommand* command);
+    void addLocalEcho(IrcMessage* message, const IrcCommand* command);
+    void reconcileEcho(IrcMessage* msg);
+    void expireEchoes();
 
     static IrcConnectionPrivate* get(const IrcConnection* connection)
     {
@@ -94,6 +119,12 @@ public:
     QString password;
     QStringList nickNames;
     QString displayName;
+    QString ownUser;
+    QString ownHost;
+    int batchCount = 0;
+    int labelCount = 0;
+    QList<IrcReplyRequest> requests;
+    QList<IrcLocalEcho> localEchoes;
     QVariantMap userData;
     QTimer reconnecter;
     int connectionCount = 0;
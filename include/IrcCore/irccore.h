@@ -37,6 +37,7 @@
 #include "ircfilter.h"
 #include "ircnetwork.h"
 #include "ircprotocol.h"
+#include "ircreply.h"
 
 IRC_BEGIN_NAMESPACE
 
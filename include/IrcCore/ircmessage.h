@@ -101,7 +101,8 @@ public:
         Identified = 0x02,
         Unidentified = 0x04,
         Playback = 0x08,
-        Implicit = 0x10
+        Implicit = 0x10,
+        Echo = 0x20
     };
     Q_DECLARE_FLAGS(Flags, Flag)
 
@@ -114,6 +114,8 @@ public:
     QDateTime timeStamp;
     QByteArray encoding;
     mutable int flags = -1;
+    // microseconds since the labeled request this responds to was written
+    qint64 roundTrip = -1;
     IrcMessageData data;
     QList<IrcMessage*> batch;
 
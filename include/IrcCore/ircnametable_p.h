@@ -0,0 +1,136 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCNAMETABLE_P_H
+#define IRCNAMETABLE_P_H
+
+#include "ircglobal.h"
+
+#include <QChar>
+#include <QString>
+#include <QStringList>
+
+IRC_BEGIN_NAMESPACE
+
+// Folds nick and channel names according to the server's CASEMAPPING,
+// so that different spellings of the same name ("Nick[away]" vs.
+// "nick{away}" under rfc1459) map to the same key. Keys are folded
+// strings rather than interned ids: folding is a single pass that
+// shares names that are folded already, so a lookup hashes the name
+// only once, in the map that holds it. Keys stay valid until the case
+// mapping changes, which bumps the generation so that holders know to
+// re-key their maps.
+class IrcNameTable
+{
+public:
+    enum CaseMapping { Ascii, Rfc1459, StrictRfc1459 };
+
+    static CaseMapping caseMappingFromString(const QString& str)
+    {
+        if (str == QLatin1String("ascii"))
+            return Ascii;
+        if (str == QLatin1String("strict-rfc1459"))
+            return StrictRfc1459;
+        return Rfc1459;
+    }
+
+    CaseMapping caseMapping() const
+    {
+        return mapping;
+    }
+
+    void setCaseMapping(CaseMapping value)
+    {
+        if (mapping != value) {
+            mapping = value;
+            ++gen;
+        }
+    }
+
+    int generation() const
+    {
+        return gen;
+    }
+
+    QChar fold(QChar ch) const
+    {
+        const ushort c = ch.unicode();
+        if (c >= 'A' && c <= 'Z')
+            return QChar(ushort(c + 32));
+        // rfc1459: []\^ are the upper case forms of {}|~
+        if (mapping != Ascii && c >= '[' && c <= (mapping == StrictRfc1459 ? ']' : '^'))
+            return QChar(ushort(c + 32));
+        if (c >= 128)
+            return ch.toLower();
+        return ch;
+    }
+
+    QString fold(const QString& name) const
+    {
+        // most names are folded already, and are shared as they are
+        const QChar* src = name.constData();
+        const int len = name.length();
+        int i = 0;
+        while (i < len && fold(src[i]) == src[i])
+            ++i;
+        if (i == len)
+            return name;
+
+        QString str = name;
+        QChar* data = str.data();
+        for (; i < len; ++i)
+            data[i] = fold(data[i]);
+        return str;
+    }
+
+    QString key(const QString& name) const
+    {
+        return fold(name);
+    }
+
+    bool equals(const QString& one, const QString& another) const
+    {
+        const int len = one.length();
+        if (len != another.length())
+            return false;
+        for (int i = 0; i < len; ++i) {
+            if (fold(one.at(i)) != fold(another.at(i)))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    CaseMapping mapping = Rfc1459;
+    int gen = 0;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCNAMETABLE_P_H
@@ -30,14 +30,77 @@
 #define IRCNETWORK_P_H
 
 #include "ircnetwork.h"
+#include "ircnametable_p.h"
 
 #include <QSet>
 #include <QHash>
 #include <QString>
 #include <QPointer>
+#include <QStringList>
+#include <QSharedPointer>
 
 IRC_BEGIN_NAMESPACE
 
+class IrcNetworkInfo
+{
+public:
+    // Returns a compiled snapshot of the ISUPPORT parameters. Snapshots are
+    // immutable and shared by all connections that received identical
+    // parameters, ie. hundreds of connections to the same network share one.
+    static QSharedPointer<const IrcNetworkInfo> create(const QHash<QString, QString>& info);
+
+    int modeIndex(QChar mode) const
+    {
+        const ushort c = mode.unicode();
+        return c < 128 ? modeIndices[c] : -1;
+    }
+
+    int prefixIndex(QChar prefix) const
+    {
+        const ushort c = prefix.unicode();
+        return c < 128 ? prefixIndices[c] : -1;
+    }
+
+    int channelTypeIndex(QChar type) const
+    {
+        const ushort c = type.unicode();
+        return c < 128 ? channelTypeIndices[c] : -1;
+    }
+
+    bool isStatusPrefix(QChar prefix) const
+    {
+        const ushort c = prefix.unicode();
+        return c < 128 && statusPrefixTable[c];
+    }
+
+    IrcNetwork::ModeTypes channelModeType(QChar mode) const
+    {
+        const ushort c = mode.unicode();
+        return IrcNetwork::ModeTypes(c < 128 ? channelModeTypes[c] : 0);
+    }
+
+    QHash<QString, QString> info;
+    QStringList modes, prefixes, channelTypes, channelModes, statusPrefixes;
+    QStringList typeModes[4];
+    QHash<QString, int> modeLimits, channelLimits, targetLimits;
+    int numericLimits[IrcNetwork::MonitorCount + 1];
+    IrcNameTable::CaseMapping caseMapping;
+
+    // PREFIX, CHANMODES, CHANTYPES and STATUSMSG compiled into ASCII lookup
+    // tables. Channel user modes are represented as bits, where the bit index
+    // is the rank of the mode in PREFIX, ie. the lowest set bit is the highest
+    // ranked mode.
+    qint8 modeIndices[128];
+    qint8 prefixIndices[128];
+    qint8 channelTypeIndices[128];
+    bool statusPrefixTable[128];
+    quint8 channelModeTypes[128];
+
+private:
+    explicit IrcNetworkInfo(const QHash<QString, QString>& info);
+    Q_DISABLE_COPY(IrcNetworkInfo)
+};
+
 class IrcNetworkPrivate
 {
     Q_DECLARE_PUBLIC(IrcNetwork)
@@ -50,13 +113,50 @@ public:
     void setActiveCapabilities(const QSet<QString>& capabilities);
 
     void setName(const QString& name);
-    void setModes(const QStringList& modes);
-    void setPrefixes(const QStringList& prefixes);
-    void setChannelTypes(const QStringList& types);
-    void setStatusPrefixes(const QStringList& prefixes);
 
-    static QString getPrefix(const QString& str, const QStringList& prefixes);
-    static QString removePrefix(const QString& str, const QStringList& prefixes);
+    int modeIndex(QChar mode) const { return info->modeIndex(mode); }
+    int prefixIndex(QChar prefix) const { return info->prefixIndex(prefix); }
+    int channelTypeIndex(QChar type) const { return info->channelTypeIndex(type); }
+    bool isStatusPrefix(QChar prefix) const { return info->isStatusPrefix(prefix); }
+    IrcNetwork::ModeTypes channelModeType(QChar mode) const { return info->channelModeType(mode); }
+
+    int statusPrefixLength(const QString& target) const
+    {
+        int i = 0;
+        while (i < target.length() && info->isStatusPrefix(target.at(i)))
+            ++i;
+        return i;
+    }
+
+    int channelPrefixLength(const QString& title) const
+    {
+        int i = 0;
+        while (i < title.length() && info->channelTypeIndex(title.at(i)) != -1)
+            ++i;
+        return i;
+    }
+
+    QString modesFromBits(uint bits) const
+    {
+        QString str;
+        const QStringList& modes = info->modes;
+        for (int i = 0; bits && i < modes.count(); ++i, bits >>= 1) {
+            if (bits & 1)
+                str += modes.at(i);
+        }
+        return str;
+    }
+
+    QString prefixesFromBits(uint bits) const
+    {
+        QString str;
+        const QStringList& prefixes = info->prefixes;
+        for (int i = 0; bits && i < prefixes.count(); ++i, bits >>= 1) {
+            if (bits & 1)
+                str += prefixes.at(i);
+        }
+        return str;
+    }
 
     static IrcNetwork* create(IrcConnection* connection)
     {
@@ -72,8 +172,8 @@ public:
     QPointer<IrcConnection> connection;
     bool initialized = false;
     QString name;
-    QStringList modes, prefixes, channelTypes, channelModes, statusPrefixes;
-    QHash<QString, int> numericLimits, modeLimits, channelLimits, targetLimits;
+    QSharedPointer<const IrcNetworkInfo> info;
+    IrcNameTable nameTable;
     QSet<QString> availableCaps, requestedCaps, activeCaps;
 };
 
@@ -0,0 +1,81 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCREPLY_H
+#define IRCREPLY_H
+
+#include <IrcGlobal>
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qscopedpointer.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcMessage;
+class IrcConnection;
+class IrcReplyPrivate;
+
+class IRC_CORE_EXPORT IrcReply : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(IrcConnection* connection READ connection CONSTANT)
+    Q_PROPERTY(bool aborted READ isAborted NOTIFY finished)
+    Q_PROPERTY(QList<IrcMessage*> messages READ messages NOTIFY finished)
+
+public:
+    ~IrcReply() override;
+
+    IrcConnection* connection() const;
+
+    bool isFinished() const;
+    bool isAborted() const;
+
+    QList<IrcMessage*> messages() const;
+
+public Q_SLOTS:
+    void abort();
+
+Q_SIGNALS:
+    void finished();
+
+private:
+    explicit IrcReply(IrcConnection* connection);
+
+    QScopedPointer<IrcReplyPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcReply)
+    Q_DISABLE_COPY(IrcReply)
+    friend class IrcConnection;
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcReply*))
+
+#endif // IRCREPLY_H
@@ -33,6 +33,7 @@
 #include <IrcGlobal>
 #include <QtCore/qobject.h>
 #include <QtCore/qvariant.h>
+#include <QtCore/qdatetime.h>
 #include <QtCore/qmetatype.h>
 #include <QtCore/qscopedpointer.h>
 
@@ -97,6 +98,8 @@ public:
 
     Q_INVOKABLE bool sendCommand(IrcCommand* command);
 
+    QList<IrcMessage*> loadMessages(int count, const QDateTime& before = QDateTime());
+
     virtual IrcBuffer *clone(QObject* parent = nullptr);
 
 public Q_SLOTS:
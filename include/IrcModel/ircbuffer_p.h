@@ -31,6 +31,7 @@
 
 #include "ircbuffer.h"
 #include "ircmessage.h"
+#include "ircnametable_p.h"
 #include <qstringlist.h>
 #include <qdatetime.h>
 #include <qlist.h>
@@ -39,6 +40,8 @@
 IRC_BEGIN_NAMESPACE
 
 class IrcUser;
+class IrcMessageStore;
+class IrcMessageArchive;
 class IrcUserModel;
 
 class IrcBufferPrivate
@@ -57,6 +60,12 @@ public:
     void setPrefix(const QString& prefix);
     void setModel(IrcBufferModel* model);
 
+    const IrcNameTable& nameTable() const;
+    IrcMessageStore* messageStore();
+    IrcMessageArchive* messageArchive();
+    void closeArchive();
+    void recordMessage(IrcMessage* message);
+
     enum MonitorStatus { MonitorUnknown, MonitorOffline, MonitorOnline };
     void setMonitorStatus(MonitorStatus status);
     bool isMonitorable() const;
@@ -92,6 +101,10 @@ public:
     QDateTime activity;
     MonitorStatus monitorStatus = MonitorUnknown;
     IrcBuffer::Type type = IrcBuffer::Basic;
+    IrcNameTable localNames;
+    IrcMessageStore* store = nullptr;
+    IrcMessageArchive* archive = nullptr;
+    qint64 archiveOffset = -1;
 };
 
 IRC_END_NAMESPACE
@@ -61,6 +61,7 @@ class IRC_MODEL_EXPORT IrcBufferModel : public QAbstractListModel
     Q_PROPERTY(IrcChannel* channelPrototype READ channelPrototype WRITE setChannelPrototype NOTIFY channelPrototypeChanged)
     Q_PROPERTY(int joinDelay READ joinDelay WRITE setJoinDelay NOTIFY joinDelayChanged)
     Q_PROPERTY(bool monitorEnabled READ isMonitorEnabled WRITE setMonitorEnabled NOTIFY monitorEnabledChanged)
+    Q_PROPERTY(QString archiveDirectory READ archiveDirectory WRITE setArchiveDirectory NOTIFY archiveDirectoryChanged)
 
 public:
     explicit IrcBufferModel(QObject* parent = nullptr);
@@ -119,6 +120,9 @@ public:
     bool isMonitorEnabled() const;
     void setMonitorEnabled(bool enabled);
 
+    QString archiveDirectory() const;
+    void setArchiveDirectory(const QString& directory);
+
     Q_INVOKABLE QByteArray saveState(int version = 0) const;
     Q_INVOKABLE bool restoreState(const QByteArray& state, int version = 0);
 
@@ -146,6 +150,7 @@ Q_SIGNALS:
     void destroyed(IrcBufferModel* model);
     void joinDelayChanged(int delay);
     void monitorEnabledChanged(bool enabled);
+    void archiveDirectoryChanged(const QString& directory);
 
 protected Q_SLOTS:
     virtual IrcBuffer* createBuffer(const QString& title);
@@ -167,6 +172,7 @@ private:
     Q_PRIVATE_SLOT(d_func(), void _irc_bufferDestroyed(IrcBuffer*))
     Q_PRIVATE_SLOT(d_func(), void _irc_restoreBuffers())
     Q_PRIVATE_SLOT(d_func(), void _irc_monitorStatus())
+    Q_PRIVATE_SLOT(d_func(), void _irc_flushArchives())
 };
 
 IRC_END_NAMESPACE
@@ -32,6 +32,11 @@
 #include "ircbuffer.h"
 #include "ircfilter.h"
 #include "ircbuffermodel.h"
+#include "ircuserstore_p.h"
+#include "ircnametable_p.h"
+#include "ircnetwork_p.h"
+#include "ircconnection.h"
+#include "ircnameindex_p.h"
 #include <qpointer.h>
 
 IRC_BEGIN_NAMESPACE
@@ -65,6 +70,15 @@ public:
 
     bool processMessage(const QString& title, IrcMessage* message, bool create = false);
 
+    const IrcNameTable& nameTable() const
+    {
+        if (connection)
+            return IrcNetworkPrivate::get(connection->network())->nameTable;
+        return localNames;
+    }
+
+    QString nameKey(const QString& name) const;
+
     void _irc_connected();
     void _irc_initialized();
     void _irc_disconnected();
@@ -72,6 +86,9 @@ public:
 
     void _irc_restoreBuffers();
     void _irc_monitorStatus();
+    void _irc_flushArchives();
+
+    void scheduleArchiveFlush();
 
     static IrcBufferModelPrivate* get(IrcBufferModel* model)
     {
@@ -82,9 +99,13 @@ public:
     Irc::DataRole role = Irc::TitleRole;
     QPointer<IrcConnection> connection;
     QList<IrcBuffer*> bufferList;
-    QMap<QString, IrcBuffer*> bufferMap;
+    mutable QHash<QString, IrcBuffer*> bufferMap;
+    mutable const IrcNameTable* keyTable = nullptr;
+    mutable int keyGeneration = 0;
+    mutable IrcNameIndex<IrcBuffer> channelIndex;
+    IrcNameTable localNames;
     QHash<QString, QString> keys;
-    QVariantMap bufferStates;
+    mutable QVariantMap bufferStates;
     QStringList channels;
     Irc::SortMethod sortMethod = Irc::SortByHand;
     Qt::SortOrder sortOrder = Qt::AscendingOrder;
@@ -94,6 +115,9 @@ public:
     int joinDelay = 0;
     bool monitorEnabled = false;
     bool monitorPending = false;
+    QString archiveDirectory;
+    bool archiveFlushPending = false;
+    IrcUserStore userStore;
 };
 
 IRC_END_NAMESPACE
@@ -32,8 +32,10 @@
 #include "ircchannel.h"
 #include "ircnetwork.h"
 #include "ircbuffer_p.h"
+#include "ircnameindex_p.h"
 #include <qstringlist.h>
 #include <qlist.h>
+#include <qhash.h>
 #include <qmap.h>
 
 IRC_BEGIN_NAMESPACE
@@ -54,14 +56,25 @@ public:
 
     void changeModes(const QString& value, const QStringList& arguments);
     void setModes(const QString& value, const QStringList& arguments);
+    void applyModes(const QString& value, const QStringList& arguments, quint64 bits, QMap<QChar, QString> args);
+    void insertMode(QChar mode, const QString& argument);
+    QStringList modeLetters() const;
+    QStringList modeArguments() const;
     void setTopic(const QString& value);
     void setKey(const QString& value);
 
+    QString nameKey(const QString& name) const;
+    IrcUser* findUser(const QString& name) const;
+    void indexUser(IrcUser* user);
+    void unindexUser(IrcUser* user, const QString& name);
+
+    IrcUser* createUser(const QString& name, uint modes);
     void addUser(const QString& user);
     bool removeUser(const QString& user);
     void setUsers(const QStringList& users);
     bool renameUser(const QString& from, const QString& to);
-    void setUserMode(const QString& user, const QString& mode);
+    void changeUserModes(const QString& value, const QStringList& arguments);
+    void setUserModes(IrcUser* user, uint modes);
     void promoteUser(const QString& user);
     bool setUserAway(const QString &name, bool away);
     void setUserServOp(const QString &name, bool servOp);
@@ -85,15 +98,21 @@ public:
         return channel->d_func();
     }
 
-    QMap<QString, QString> modes;
+    quint64 modeBits = 0;
+    QMap<QChar, QString> modeArgs;
     QString topic;
     bool active = false;
     bool enabled = true;
     QStringList names;
     QList<IrcUser*> userList;
     QList<IrcUser*> activeUsers;
-    QMap<QString, IrcUser*> userMap;
+    mutable QHash<QString, IrcUser*> userMap;
+    mutable const IrcNameTable* keyTable = nullptr;
+    mutable int keyGeneration = 0;
+    mutable IrcNameIndex<IrcUser> userIndex;
     QList<IrcUserModel*> userModels;
+    qint64 mostActive = 0;
+    qint64 leastActive = 0;
 };
 
 IRC_END_NAMESPACE
@@ -0,0 +1,137 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCMESSAGEARCHIVE_P_H
+#define IRCMESSAGEARCHIVE_P_H
+
+#include <IrcGlobal>
+#include <qbytearray.h>
+#include <qvector.h>
+#include <qqueue.h>
+#include <qhash.h>
+#include <qstring.h>
+#include <qfile.h>
+#include <qurl.h>
+#include <qdir.h>
+#include <qlist.h>
+
+IRC_BEGIN_NAMESPACE
+
+// An append-only file of raw message lines. Every record is stored as
+// a little-endian (timestamp, flags, size) header followed by the line.
+// A sparse index of every CheckpointInterval'th record is kept next to
+// it, so that paging reads only map the segments they need, and so is
+// an index of (msgid hash, offset) pairs of the records with a msgid.
+// The most recent RecentIds of those are kept in memory for lookups.
+// Appends are buffered and written in batches by flush(), or as soon as
+// WriteBufferSize bytes are pending or the archive is read.
+class IrcMessageArchive
+{
+public:
+    explicit IrcMessageArchive(const QString& fileName);
+    ~IrcMessageArchive();
+
+    enum { HeaderSize = 8, RecordHeaderSize = 16, CheckpointSize = 16, CheckpointInterval = 256,
+           IdHeaderSize = 8, IdSize = 16, RecentIds = 65536, WriteBufferSize = 65536 };
+
+    struct Record
+    {
+        qint64 offset;
+        qint64 timeStamp;
+        int flags;
+        QByteArray data;
+    };
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    QString fileName() const
+    {
+        return file.fileName();
+    }
+
+    // one file per buffer in the directory, named after its case folded title
+    static QString filePath(const QString& directory, const QString& name)
+    {
+        const QByteArray encoded = QUrl::toPercentEncoding(name);
+        return QDir(directory).filePath(QString::fromLatin1(encoded) + QLatin1String(".log"));
+    }
+
+    qint64 count() const;
+    qint64 size() const;
+
+    qint64 append(qint64 timeStamp, int flags, const QByteArray& data);
+    QList<Record> read(qint64 before, int count);
+    qint64 find(qint64 timeStamp);
+    qint64 findId(const QByteArray& id);
+
+    bool hasPending() const;
+    bool flush();
+
+    static QByteArray messageId(const char* data, int size);
+
+private:
+    struct Checkpoint
+    {
+        qint64 offset;
+        qint64 timeStamp;
+    };
+
+    struct RecentId
+    {
+        quint64 hash;
+        qint64 offset;
+    };
+
+    bool recover();
+    bool recoverIds();
+    int checkpointBefore(qint64 offset) const;
+    void addCheckpoint(qint64 offset, qint64 timeStamp);
+    void addId(qint64 offset, const char* data, int size);
+    void addRecentId(quint64 hash, qint64 offset);
+    void loadRecentIds();
+
+    QFile file;
+    QFile indexFile;
+    QFile idFile;
+    QByteArray pending;
+    QByteArray pendingIndex;
+    QByteArray pendingIds;
+    QVector<Checkpoint> checkpoints;
+    QQueue<RecentId> recentOrder;
+    QHash<quint64, qint64> recentIds;
+    bool recentLoaded = false;
+    qint64 records = 0;
+    qint64 end = 0;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCMESSAGEARCHIVE_P_H
@@ -0,0 +1,112 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCMESSAGEMODEL_H
+#define IRCMESSAGEMODEL_H
+
+#include <Irc>
+#include <IrcGlobal>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qabstractitemmodel.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcBuffer;
+class IrcMessage;
+class IrcMessageModelPrivate;
+
+class IRC_MODEL_EXPORT IrcMessageModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(bool empty READ isEmpty NOTIFY emptyChanged)
+    Q_PROPERTY(IrcBuffer* buffer READ buffer WRITE setBuffer NOTIFY bufferChanged)
+    Q_PROPERTY(int lineLimit READ lineLimit WRITE setLineLimit NOTIFY lineLimitChanged)
+    Q_PROPERTY(int byteLimit READ byteLimit WRITE setByteLimit NOTIFY byteLimitChanged)
+    Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize)
+    Q_PROPERTY(int fetchSize READ fetchSize WRITE setFetchSize)
+
+public:
+    explicit IrcMessageModel(QObject* parent = nullptr);
+    ~IrcMessageModel() override;
+
+    IrcBuffer* buffer() const;
+    void setBuffer(IrcBuffer* buffer);
+
+    int count() const;
+    bool isEmpty() const;
+    Q_INVOKABLE IrcMessage* get(int index) const;
+
+    int lineLimit() const;
+    void setLineLimit(int limit);
+
+    int byteLimit() const;
+    void setByteLimit(int limit);
+
+    int cacheSize() const;
+    void setCacheSize(int size);
+
+    int fetchSize() const;
+    void setFetchSize(int size);
+
+    IrcMessage* message(const QModelIndex& index) const;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QHash<int, QByteArray> roleNames() const override;
+#endif
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+public Q_SLOTS:
+    void clear();
+
+Q_SIGNALS:
+    void countChanged(int count);
+    void emptyChanged(bool empty);
+    void bufferChanged(IrcBuffer* buffer);
+    void lineLimitChanged(int limit);
+    void byteLimitChanged(int limit);
+
+protected:
+    virtual QString formatMessage(IrcMessage* message) const;
+
+private:
+    QScopedPointer<IrcMessageModelPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcMessageModel)
+    Q_DISABLE_COPY(IrcMessageModel)
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcMessageModel*))
+
+#endif // IRCMESSAGEMODEL_H
@@ -0,0 +1,85 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCMESSAGEMODEL_P_H
+#define IRCMESSAGEMODEL_P_H
+
+#include "ircmessagemodel.h"
+#include "ircmessagestore_p.h"
+#include <qpointer.h>
+#include <qcache.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcMessageModelRow
+{
+public:
+    ~IrcMessageModelRow();
+
+    IrcMessage* message = nullptr;
+    QString text;
+    bool formatted = false;
+};
+
+class IrcMessageModelPrivate
+{
+    Q_DECLARE_PUBLIC(IrcMessageModel)
+
+public:
+    IrcMessageModelPrivate();
+
+    IrcMessageModelRow* row(int index) const;
+    IrcMessageArchive* archive() const;
+
+    void beginInsert(int first, int last);
+    void endInsert();
+    void beginRemove(int first, int last);
+    void endRemove();
+    void beginReset();
+    void endReset();
+    void detach();
+
+    static IrcMessageModelPrivate* get(IrcMessageModel* model)
+    {
+        return model->d_func();
+    }
+
+    IrcMessageModel* q_ptr = nullptr;
+    QPointer<IrcBuffer> buffer;
+    IrcMessageStore* store = nullptr;
+    int lineLimit = IrcMessageStore::DefaultLineLimit;
+    int byteLimit = -1;
+    int fetchSize = 100;
+    int previousCount = 0;
+    mutable QCache<quint64, IrcMessageModelRow> cache;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCMESSAGEMODEL_P_H
@@ -0,0 +1,99 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCMESSAGESTORE_P_H
+#define IRCMESSAGESTORE_P_H
+
+#include "ircmessagearchive_p.h"
+#include <IrcGlobal>
+#include <qbytearray.h>
+#include <qlist.h>
+#include <qvector.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcMessageModel;
+
+// A bounded scrollback of raw message lines. Messages are kept in their
+// wire format together with a timestamp and flags, and re-parsed only when
+// a view asks for them.
+class IrcMessageStore
+{
+public:
+    ~IrcMessageStore();
+
+    enum { DefaultLineLimit = 1000 };
+
+    struct Entry
+    {
+        quint64 id;
+        qint64 offset;
+        qint64 timeStamp;
+        int flags;
+        QByteArray data;
+    };
+
+    void append(qint64 timeStamp, int flags, const QByteArray& data, qint64 offset = -1);
+    void prepend(const QList<IrcMessageArchive::Record>& records);
+    void clear();
+
+    void addModel(IrcMessageModel* model);
+    void removeModel(IrcMessageModel* model);
+    void updateLimits();
+
+    int count() const
+    {
+        return entries.count();
+    }
+
+    bool isEmpty() const
+    {
+        return entries.isEmpty();
+    }
+
+    const Entry& at(int index) const
+    {
+        return entries.at(index);
+    }
+
+    QVector<Entry> entries;
+    QList<IrcMessageModel*> models;
+    quint64 nextId = 0;
+    qint64 bytes = 0;
+    int lineLimit = DefaultLineLimit;
+    int byteLimit = -1;
+
+private:
+    void trim(int lines, qint64 size);
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_TYPEINFO(IRC_PREPEND_NAMESPACE(IrcMessageStore::Entry), Q_MOVABLE_TYPE);
+
+#endif // IRCMESSAGESTORE_P_H
@@ -32,6 +32,7 @@
 #include "ircbuffer.h"
 #include "ircbuffermodel.h"
 #include "ircchannel.h"
+#include "ircmessagemodel.h"
 #include "ircuser.h"
 #include "ircusermodel.h"
 
@@ -0,0 +1,123 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCNAMEINDEX_P_H
+#define IRCNAMEINDEX_P_H
+
+#include <IrcGlobal>
+#include <qstring.h>
+#include <qvector.h>
+#include <qlist.h>
+#include <algorithm>
+
+IRC_BEGIN_NAMESPACE
+
+// A completion index of items sorted by their case folded names. Prefix
+// lookups are a binary search followed by a walk over the matching range,
+// so completing in a large channel does not have to visit every user.
+template <typename T>
+class IrcNameIndex
+{
+public:
+    struct Entry
+    {
+        QString name;
+        T* item;
+        bool operator<(const Entry& other) const
+        {
+            return name < other.name || (name == other.name && item < other.item);
+        }
+    };
+
+    bool isEmpty() const
+    {
+        return entries.isEmpty();
+    }
+
+    void clear()
+    {
+        entries.clear();
+    }
+
+    void insert(const QString& name, T* item)
+    {
+        const Entry entry = { name, item };
+        typename QVector<Entry>::iterator it = std::lower_bound(entries.begin(), entries.end(), entry);
+        if (it == entries.end() || it->item != item || it->name != name)
+            entries.insert(it, entry);
+    }
+
+    void remove(const QString& name, T* item)
+    {
+        const Entry entry = { name, item };
+        typename QVector<Entry>::iterator it = std::lower_bound(entries.begin(), entries.end(), entry);
+        if (it != entries.end() && it->item == item && it->name == name)
+            entries.erase(it);
+    }
+
+    // replaces the whole index at once, eg. after a NAMES reply
+    void assign(const QVector<Entry>& values)
+    {
+        entries = values;
+        std::sort(entries.begin(), entries.end());
+    }
+
+    // returns the items whose name starts with the case folded prefix,
+    // the first limit of them ordered by lessThan (all when limit < 0)
+    template <typename LessThan>
+    QList<T*> find(const QString& prefix, int limit, LessThan lessThan) const
+    {
+        const Entry entry = { prefix, nullptr };
+        typename QVector<Entry>::const_iterator it = std::lower_bound(entries.constBegin(), entries.constEnd(), entry);
+
+        QVector<T*> items;
+        for (; it != entries.constEnd() && it->name.startsWith(prefix); ++it)
+            items += it->item;
+
+        if (limit >= 0 && limit < items.count()) {
+            std::partial_sort(items.begin(), items.begin() + limit, items.end(), lessThan);
+            items.resize(limit);
+        } else {
+            std::sort(items.begin(), items.end(), lessThan);
+        }
+
+        QList<T*> result;
+        result.reserve(items.count());
+        foreach (T* item, items)
+            result += item;
+        return result;
+    }
+
+private:
+    QVector<Entry> entries;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCNAMEINDEX_P_H
@@ -30,6 +30,7 @@
 #define IRCUSER_P_H
 
 #include "ircuser.h"
+#include "ircuserstore_p.h"
 
 IRC_BEGIN_NAMESPACE
 
@@ -38,9 +39,12 @@ class IrcUserPrivate
     Q_DECLARE_PUBLIC(IrcUser)
 
 public:
+    IrcUserIdentity* ensureIdentity();
+    void setIdentity(IrcUserIdentity* i);
+
     void setName(const QString& n);
-    void setPrefix(const QString& p);
-    void setMode(const QString& m);
+    void setModes(uint m);
+    const IrcNetwork* network() const;
     void setServOp(const bool& o);
     void setAway(const bool& a);
 
@@ -51,11 +55,9 @@ public:
 
     IrcUser* q_ptr;
     IrcChannel* channel;
-    QString name;
-    QString prefix;
-    QString mode;
-    bool servOp;
-    bool away;
+    IrcUserIdentity* identity;
+    uint modes;
+    qint64 activity;
 };
 
 IRC_END_NAMESPACE
@@ -47,11 +47,13 @@ public:
     void insertUser(int index, IrcUser* user, bool notify = true);
     void removeUser(IrcUser* user, bool notify = true);
     void setUsers(const QList<IrcUser*>& users, bool reset = true);
+    void syncUsers(const QList<IrcUser*>& removed, const QList<IrcUser*>& added, const QList<IrcUser*>& changed);
     void renameUser(IrcUser* user);
     void setUserMode(IrcUser* user);
     void promoteUser(IrcUser* user);
     bool updateUser(IrcUser* user);
     bool updateTitles();
+    int insertIndex(int index, IrcUser* user) const;
 
     static IrcUserModelPrivate* get(IrcUserModel* model)
     {
@@ -0,0 +1,82 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCUSERSTORE_P_H
+#define IRCUSERSTORE_P_H
+
+#include <IrcGlobal>
+#include "ircnametable_p.h"
+#include <qstring.h>
+#include <qhash.h>
+#include <qlist.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcUser;
+class IrcMessage;
+class IrcUserStore;
+
+class IrcUserIdentity
+{
+public:
+    IrcUserStore* store = nullptr;
+    QString name;
+    QString ident;
+    QString host;
+    QString account;
+    bool away = false;
+    bool servOp = false;
+    QList<IrcUser*> users;
+};
+
+class IrcUserStore
+{
+public:
+    ~IrcUserStore();
+
+    void setNameTable(const IrcNameTable* table);
+
+    IrcUserIdentity* find(const QString& name) const;
+    IrcUserIdentity* identity(const QString& name);
+    void rename(IrcUserIdentity* identity, const QString& name);
+    void remove(IrcUserIdentity* identity);
+    void update(IrcMessage* message);
+
+private:
+    QString key(const QString& name) const;
+
+    const IrcNameTable* nameTable = nullptr;
+    IrcNameTable localNames;
+    mutable int keyGeneration = 0;
+    mutable QHash<QString, IrcUserIdentity*> identities;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCUSERSTORE_P_H
@@ -31,11 +31,13 @@
 
 #include <IrcGlobal>
 #include <QtCore/qobject.h>
+#include <QtCore/qstringlist.h>
 #include <QtCore/qmetatype.h>
 #include <QtCore/qscopedpointer.h>
 
 IRC_BEGIN_NAMESPACE
 
+class IrcLagTimer;
 class IrcConnection;
 class IrcCommandQueuePrivate;
 
@@ -44,8 +46,11 @@ class IRC_UTIL_EXPORT IrcCommandQueue : public QObject
     Q_OBJECT
     Q_PROPERTY(int batch READ batch WRITE setBatch)
     Q_PROPERTY(int interval READ interval WRITE setInterval)
+    Q_PROPERTY(bool coalescing READ isCoalescing WRITE setCoalescing)
     Q_PROPERTY(int size READ size NOTIFY sizeChanged)
+    Q_PROPERTY(QStringList targets READ targets NOTIFY sizeChanged)
     Q_PROPERTY(IrcConnection* connection READ connection WRITE setConnection)
+    Q_PROPERTY(IrcLagTimer* lagTimer READ lagTimer WRITE setLagTimer)
 
 public:
     explicit IrcCommandQueue(QObject* parent = nullptr);
@@ -57,11 +62,21 @@ public:
     int interval() const;
     void setInterval(int seconds);
 
+    bool isCoalescing() const;
+    void setCoalescing(bool coalescing);
+
     int size() const;
 
+    QStringList targets() const;
+    Q_INVOKABLE int depth(const QString& target) const;
+    Q_INVOKABLE qint64 waitTime(const QString& target) const;
+
     IrcConnection* connection() const;
     void setConnection(IrcConnection* connection);
 
+    IrcLagTimer* lagTimer() const;
+    void setLagTimer(IrcLagTimer* timer);
+
 public Q_SLOTS:
     void clear();
     void flush();
@@ -76,6 +91,7 @@ private:
 
     Q_PRIVATE_SLOT(d_func(), void _irc_updateTimer())
     Q_PRIVATE_SLOT(d_func(), void _irc_sendBatch())
+    Q_PRIVATE_SLOT(d_func(), void _irc_updateLag(qint64))
 };
 
 IRC_END_NAMESPACE
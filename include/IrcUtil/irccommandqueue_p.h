@@ -31,32 +31,109 @@
 
 #include "irccommandqueue.h"
 #include "ircfilter.h"
+#include "irclagtimer.h"
+#include "ircnametable_p.h"
+#include <QElapsedTimer>
 #include <QPointer>
 #include <QQueue>
+#include <QHash>
+#include <QStringList>
 #include <QTimer>
 
 IRC_BEGIN_NAMESPACE
 
-class IrcCommandQueuePrivate : public QObject,  public IrcCommandFilter
+class IrcCommandQueueItem
+{
+public:
+    QPointer<IrcCommand> command;
+    int cost;
+    qint64 time;
+};
+
+class IrcCommandQueueFlow
+{
+public:
+    QQueue<IrcCommandQueueItem> items;
+    int deficit = 0;
+};
+
+class IrcCommandQueueLane
+{
+public:
+    bool isEmpty() const { return !size; }
+    void enqueue(const QString& target, const IrcCommandQueueItem& item);
+    const IrcCommandQueueItem& head();
+    IrcCommandQueueItem dequeue();
+    IrcCommandQueueItem remove(const QString& target, int index);
+    IrcCommandQueueFlow* flow(const QString& target);
+    void clear();
+
+    int size = 0;
+    QQueue<QString> active;
+    QHash<QString, IrcCommandQueueFlow> flows;
+};
+
+enum IrcCommandLane {
+    IrcControlLane = -1,
+    IrcInteractiveLane,
+    IrcBulkLane,
+    IrcLaneCount
+};
+
+class IrcCommandQueuePrivate : public QObject,  public IrcMessageFilter, public IrcCommandFilter
 {
     Q_OBJECT
-    Q_INTERFACES(IrcCommandFilter)
+    Q_INTERFACES(IrcMessageFilter IrcCommandFilter)
     Q_DECLARE_PUBLIC(IrcCommandQueue)
 
 public:
     IrcCommandQueuePrivate();
 
+    bool messageFilter(IrcMessage* msg) override;
     bool commandFilter(IrcCommand* cmd) override;
 
     void _irc_updateTimer();
     void _irc_sendBatch(bool force = false);
+    void _irc_updateLag(qint64 lag);
+
+    static int cost(IrcCommand* cmd);
+    static int lane(IrcCommand* cmd);
+    QString target(IrcCommand* cmd) const;
+    const IrcNameTable* nameTable() const;
+    QString key(const QString& name) const;
+    bool equals(const QString& one, const QString& another) const;
+    int indexOf(const QStringList& names, const QString& name) const;
+    void rekey(bool force = false);
+    bool coalesce(IrcCommand* cmd, int lane);
+    bool findDuplicate(IrcCommand* cmd, int lane);
+    bool mergeMode(IrcCommand* cmd, int lane);
+    bool mergeMonitor(IrcCommand* cmd, int lane);
+    bool cancelJoin(IrcCommand* part);
+    bool fits(const QString& command) const;
+    int count() const;
+    int nextLane() const;
+    IrcCommandQueueItem take();
+    bool isQueueing() const;
+    qreal capacity() const;
+    qreal rate() const;
+    void refill();
 
     IrcCommandQueue* q_ptr = nullptr;
     IrcConnection* connection = nullptr;
+    QPointer<IrcLagTimer> lagTimer;
     QTimer timer;
+    QElapsedTimer clock;
+    QElapsedTimer uptime;
     int batch;
     int interval;
-    QQueue<QPointer<IrcCommand> > commands;
+    qreal tokens;
+    qreal factor = 1.0;
+    qint64 baseLag = -1;
+    int credit;
+    bool coalescing = true;
+    int generation = -1;
+    QHash<QString, QString> joined;
+    IrcCommandQueueLane lanes[IrcLaneCount];
 };
 
 IRC_END_NAMESPACE
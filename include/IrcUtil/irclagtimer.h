@@ -43,6 +43,10 @@ class IRC_UTIL_EXPORT IrcLagTimer : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(qint64 lag READ lag NOTIFY lagChanged)
+    Q_PROPERTY(qint64 minimumLag READ minimumLag NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 medianLag READ medianLag NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 maximumLag READ maximumLag NOTIFY statisticsChanged)
+    Q_PROPERTY(int windowSize READ windowSize WRITE setWindowSize)
     Q_PROPERTY(int interval READ interval WRITE setInterval)
     Q_PROPERTY(IrcConnection* connection READ connection WRITE setConnection)
 
@@ -55,11 +59,20 @@ public:
 
     qint64 lag() const;
 
+    qint64 minimumLag() const;
+    qint64 medianLag() const;
+    qint64 maximumLag() const;
+    Q_INVOKABLE qint64 percentile(int percent) const;
+
+    int windowSize() const;
+    void setWindowSize(int size);
+
     int interval() const;
     void setInterval(int seconds);
 
 Q_SIGNALS:
     void lagChanged(qint64 lag);
+    void statisticsChanged();
 
 private:
     QScopedPointer<IrcLagTimerPrivate> d_ptr;
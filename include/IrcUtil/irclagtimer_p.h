@@ -31,23 +31,33 @@
 
 #include "irclagtimer.h"
 #include "ircfilter.h"
+#include <QQueue>
 #include <QTimer>
 
 IRC_BEGIN_NAMESPACE
 
 class IrcPongMessage;
 
-class IrcLagTimerPrivate : public QObject,  public IrcMessageFilter
+class IrcLagTimerEcho
+{
+public:
+    QString key;
+    qint64 time;
+};
+
+class IrcLagTimerPrivate : public QObject,  public IrcMessageFilter, public IrcCommandFilter
 {
     Q_OBJECT
-    Q_INTERFACES(IrcMessageFilter)
+    Q_INTERFACES(IrcMessageFilter IrcCommandFilter)
     Q_DECLARE_PUBLIC(IrcLagTimer)
 
 public:
     IrcLagTimerPrivate();
 
     bool messageFilter(IrcMessage* msg) override;
+    bool commandFilter(IrcCommand* cmd) override;
     bool processPongReply(IrcPongMessage* msg);
+    void processEcho(const QString& target, const QString& content);
 
     void _irc_connected();
     void _irc_pingServer();
@@ -55,6 +65,10 @@ public:
 
     void updateTimer();
     void updateLag(qint64 value);
+    void addSample(qint64 usecs);
+    void clearSamples();
+
+    static qint64 now();
 
     IrcLagTimer* q_ptr = nullptr;
     IrcConnection* connection = nullptr;
@@ -62,6 +76,10 @@ public:
     int interval;
     int pendingPings = 0;
     qint64 lag = -1;
+    int windowSize;
+    QList<qint64> samples;
+    qint64 lastPassive = -1;
+    QQueue<IrcLagTimerEcho> echoes;
 };
 
 IRC_END_NAMESPACE
@@ -0,0 +1,92 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCLOGWRITER_H
+#define IRCLOGWRITER_H
+
+#include <IrcGlobal>
+#include <QtCore/qobject.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qscopedpointer.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcConnection;
+class IrcLogWriterPrivate;
+
+class IRC_UTIL_EXPORT IrcLogWriter : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(IrcConnection* connection READ connection WRITE setConnection)
+    Q_PROPERTY(QString directory READ directory WRITE setDirectory)
+    Q_PROPERTY(int queueSize READ queueSize WRITE setQueueSize)
+    Q_PROPERTY(int flushInterval READ flushInterval WRITE setFlushInterval)
+    Q_PROPERTY(bool syncEnabled READ isSyncEnabled WRITE setSyncEnabled)
+    Q_PROPERTY(qint64 rotationSize READ rotationSize WRITE setRotationSize)
+    Q_PROPERTY(int dropped READ dropped)
+
+public:
+    explicit IrcLogWriter(QObject* parent = nullptr);
+    ~IrcLogWriter() override;
+
+    IrcConnection* connection() const;
+    void setConnection(IrcConnection* connection);
+
+    QString directory() const;
+    void setDirectory(const QString& directory);
+
+    int queueSize() const;
+    void setQueueSize(int size);
+
+    int flushInterval() const;
+    void setFlushInterval(int msecs);
+
+    bool isSyncEnabled() const;
+    void setSyncEnabled(bool enabled);
+
+    qint64 rotationSize() const;
+    void setRotationSize(qint64 size);
+
+    int dropped() const;
+
+public Q_SLOTS:
+    void flush();
+
+private:
+    QScopedPointer<IrcLogWriterPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcLogWriter)
+    Q_DISABLE_COPY(IrcLogWriter)
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcLogWriter*))
+
+#endif // IRCLOGWRITER_H
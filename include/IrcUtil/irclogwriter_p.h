@@ -0,0 +1,115 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCLOGWRITER_P_H
+#define IRCLOGWRITER_P_H
+
+#include "irclogwriter.h"
+#include "ircfilter.h"
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QPointer>
+#include <QFile>
+#include <QThread>
+#include <QMutex>
+#include <QHash>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcLogWriterPrivate;
+
+struct IrcLogRecord
+{
+    qint64 timeStamp;
+    QString target;
+    QByteArray data;
+};
+
+class IrcLogWriterThread : public QThread
+{
+public:
+    explicit IrcLogWriterThread(IrcLogWriterPrivate* writer) : writer(writer) { }
+
+protected:
+    void run() override;
+
+private:
+    IrcLogWriterPrivate* writer;
+};
+
+class IrcLogWriterPrivate : public QObject, public IrcMessageFilter
+{
+    Q_OBJECT
+    Q_INTERFACES(IrcMessageFilter)
+    Q_DECLARE_PUBLIC(IrcLogWriter)
+
+public:
+    IrcLogWriterPrivate();
+    ~IrcLogWriterPrivate() override;
+
+    bool messageFilter(IrcMessage* message) override;
+
+    // called on the thread of the connection
+    bool enqueue(const IrcLogRecord& record);
+    void start();
+    void stop();
+
+    // called on the writer thread
+    void drain();
+    void write(const QString& target, const QByteArray& lines);
+    void closeFiles();
+
+    IrcLogWriter* q_ptr = nullptr;
+    QPointer<IrcConnection> connection;
+
+    // settings are changed only while the writer thread is stopped
+    QString directory;
+    int queueSize = 4096;
+    int flushInterval = 1000;
+    bool syncEnabled = false;
+    qint64 rotationSize = 0;
+
+    // single producer, single consumer ring buffer
+    IrcLogRecord* ring = nullptr;
+    int capacity = 0;
+    QAtomicInt head;
+    QAtomicInt tail;
+    QAtomicInt dropped;
+
+    QMutex mutex;
+    QWaitCondition condition;
+    bool stopped = false;
+    IrcLogWriterThread thread;
+
+    QHash<QString, QFile*> files;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCLOGWRITER_P_H
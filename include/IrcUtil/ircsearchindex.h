@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCSEARCHINDEX_H
+#define IRCSEARCHINDEX_H
+
+#include <IrcGlobal>
+#include <QtCore/qobject.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qmetatype.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcBuffer;
+class IrcMessage;
+class IrcBufferModel;
+class IrcSearchIndexPrivate;
+
+class IRC_UTIL_EXPORT IrcSearchIndex : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(IrcBufferModel* model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(int count READ count)
+
+public:
+    explicit IrcSearchIndex(QObject* parent = nullptr);
+    ~IrcSearchIndex() override;
+
+    IrcBufferModel* model() const;
+    void setModel(IrcBufferModel* model);
+
+    int count() const;
+
+    QList<IrcMessage*> search(const QString& text,
+                              const QString& buffer = QString(),
+                              const QString& nick = QString(),
+                              const QDateTime& from = QDateTime(),
+                              const QDateTime& to = QDateTime(),
+                              int limit = 100) const;
+
+public Q_SLOTS:
+    void clear();
+    void rebuild(int count = -1);
+
+Q_SIGNALS:
+    void modelChanged(IrcBufferModel* model);
+
+private:
+    QScopedPointer<IrcSearchIndexPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcSearchIndex)
+    Q_DISABLE_COPY(IrcSearchIndex)
+
+    Q_PRIVATE_SLOT(d_func(), void _irc_bufferAdded(IrcBuffer*))
+    Q_PRIVATE_SLOT(d_func(), void _irc_bufferRemoved(IrcBuffer*))
+    Q_PRIVATE_SLOT(d_func(), void _irc_messageReceived(IrcMessage*))
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcSearchIndex*))
+
+#endif // IRCSEARCHINDEX_H
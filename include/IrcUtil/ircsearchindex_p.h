@@ -0,0 +1,151 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IRCSEARCHINDEX_P_H
+#define IRCSEARCHINDEX_P_H
+
+#include "ircsearchindex.h"
+#include <QReadWriteLock>
+#include <QWaitCondition>
+#include <QPointer>
+#include <QThread>
+#include <QVector>
+#include <QMutex>
+#include <QFile>
+#include <QHash>
+#include <QList>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcBuffer;
+
+// a delivered message, or an archived one by its file and offset
+struct IrcSearchEntry
+{
+    qint64 timeStamp;
+    int flags;
+    QString buffer;
+    QString source;
+    qint64 offset;
+    QByteArray data;
+};
+
+// the archive of a buffer, indexed up to the end it had when queued
+struct IrcSearchArchive
+{
+    QString buffer;
+    QString fileName;
+    qint64 end;
+};
+
+struct IrcSearchHit
+{
+    qint64 timeStamp;
+    int flags;
+    QString source;
+    qint64 offset;
+    QByteArray data;
+};
+
+// Tokenizes queued entries and pages through queued archives, and merges
+// them into an inverted index on a background thread. Archived messages
+// are referred to by their offset, and read again only for search hits.
+// Lookups take a read lock and may run on any thread.
+class IrcSearchWorker : public QThread
+{
+public:
+    IrcSearchWorker();
+    ~IrcSearchWorker() override;
+
+    enum { PageSize = 256 };
+
+    void enqueue(const QList<IrcSearchEntry>& entries);
+    void enqueue(const QList<IrcSearchArchive>& archives, int count);
+    void clear();
+    int count() const;
+
+    QList<IrcSearchHit> search(const QStringList& keys, qint64 from, qint64 to, int limit) const;
+
+    static QStringList terms(const QString& text);
+    static QString bufferKey(const QString& buffer);
+    static QString nickKey(const QString& nick);
+    static bool parse(const QByteArray& data, QString* nick, QString* text);
+    static bool readRecord(QFile* file, qint64 offset, qint64 timeStamp, QByteArray* data);
+
+protected:
+    void run() override;
+
+private:
+    struct Document
+    {
+        qint64 timeStamp;
+        int flags;
+        int source;
+        qint64 offset;
+        QByteArray data;
+    };
+
+    bool isCurrent(int batchGeneration);
+    void index(const QList<IrcSearchEntry>& batch, int batchGeneration);
+    void index(const IrcSearchArchive& archive, int count, int batchGeneration);
+    void release();
+
+    QMutex mutex;
+    QWaitCondition condition;
+    QList<IrcSearchEntry> pending;
+    QList<IrcSearchArchive> archives;
+    int archiveCount = -1;
+    bool stopped = false;
+    int generation = 0;
+
+    mutable QReadWriteLock lock;
+    QVector<Document> documents;
+    QHash<QString, QVector<int> > postings;
+    QStringList sources;
+    QHash<QString, int> sourceIds;
+    QVector<int> unflushed;
+};
+
+class IrcSearchIndexPrivate
+{
+    Q_DECLARE_PUBLIC(IrcSearchIndex)
+
+public:
+    void _irc_bufferAdded(IrcBuffer* buffer);
+    void _irc_bufferRemoved(IrcBuffer* buffer);
+    void _irc_messageReceived(IrcMessage* message);
+
+    IrcSearchIndex* q_ptr = nullptr;
+    QPointer<IrcBufferModel> model;
+    IrcSearchWorker worker;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCSEARCHINDEX_P_H
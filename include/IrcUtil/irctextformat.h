@@ -34,12 +34,17 @@
 #include <QtCore/qlist.h>
 #include <QtCore/qobject.h>
 #include <QtCore/qstring.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qshareddata.h>
 #include <QtCore/qmetatype.h>
 #include <QtCore/qscopedpointer.h>
 
 IRC_BEGIN_NAMESPACE
 
 class IrcPalette;
+class IrcTextFormatConfig;
 class IrcTextFormatPrivate;
 
 class IRC_UTIL_EXPORT IrcTextFormat : public QObject
@@ -50,6 +55,9 @@ class IRC_UTIL_EXPORT IrcTextFormat : public QObject
     Q_PROPERTY(QString plainText READ plainText)
     Q_PROPERTY(QString html READ html)
     Q_PROPERTY(QList<QUrl> urls READ urls)
+    Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize)
+    Q_PROPERTY(int cacheHits READ cacheHits)
+    Q_PROPERTY(int cacheMisses READ cacheMisses)
     Q_ENUMS(SpanFormat)
 
 public:
@@ -69,12 +77,65 @@ public:
     Q_INVOKABLE QString toHtml(const QString& text) const;
     Q_INVOKABLE QString toPlainText(const QString& text) const;
 
+    enum Style {
+        NoStyle = 0x0,
+        Bold = 0x1,
+        Italic = 0x2,
+        Underline = 0x4,
+        StrikeOut = 0x8,
+        Inverse = 0x10
+    };
+    Q_DECLARE_FLAGS(Styles, Style)
+
+    struct Run {
+        int start;
+        int length;
+        Styles styles;
+        int foreground;
+        int background;
+        int url;
+    };
+
+    QVector<Run> toRuns(const QString& text, QString* plainText, QList<QUrl>* urls = nullptr) const;
+
+    class IRC_UTIL_EXPORT Snapshot
+    {
+    public:
+        Snapshot();
+        Snapshot(const Snapshot& other);
+        Snapshot& operator=(const Snapshot& other);
+        ~Snapshot();
+
+        bool isNull() const;
+
+        QString toHtml(const QString& text) const;
+        QString toPlainText(const QString& text) const;
+        QVector<Run> toRuns(const QString& text, QString* plainText, QList<QUrl>* urls = nullptr) const;
+        void parse(const QString& text, QString* plainText, QString* html, QList<QUrl>* urls) const;
+
+        QStringList toHtml(const QStringList& texts, QThreadPool* pool = nullptr) const;
+        QStringList toPlainText(const QStringList& texts, QThreadPool* pool = nullptr) const;
+
+    private:
+        friend class IrcTextFormat;
+        QSharedDataPointer<IrcTextFormatConfig> d;
+    };
+
+    Snapshot snapshot() const;
+
     QString plainText() const;
     QString html() const;
     QList<QUrl> urls() const;
 
+    int cacheSize() const;
+    void setCacheSize(int size);
+
+    int cacheHits() const;
+    int cacheMisses() const;
+
 public Q_SLOTS:
     void parse(const QString& text);
+    void clearCache();
 
 private:
     QScopedPointer<IrcTextFormatPrivate> d_ptr;
@@ -82,9 +143,12 @@ private:
     Q_DISABLE_COPY(IrcTextFormat)
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(IrcTextFormat::Styles)
+
 IRC_END_NAMESPACE
 
 Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcTextFormat*))
 Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcTextFormat::SpanFormat))
+Q_DECLARE_TYPEINFO(IRC_PREPEND_NAMESPACE(IrcTextFormat::Run), Q_MOVABLE_TYPE);
 
 #endif // IRCTEXTFORMAT_H
@@ -33,7 +33,9 @@
 #include "irccommandqueue.h"
 #include "irccompleter.h"
 #include "irclagtimer.h"
+#include "irclogwriter.h"
 #include "ircpalette.h"
+#include "ircsearchindex.h"
 #include "irctextformat.h"
 
 IRC_BEGIN_NAMESPACE
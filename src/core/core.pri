@@ -19,6 +19,7 @@ CONV_HEADERS += $$INCDIR/IrcMessage
 CONV_HEADERS += $$INCDIR/IrcMessageFilter
 CONV_HEADERS += $$INCDIR/IrcNetwork
 CONV_HEADERS += $$INCDIR/IrcProtocol
+CONV_HEADERS += $$INCDIR/IrcReply
 
 PUB_HEADERS  = $$INCDIR/irc.h
 PUB_HEADERS += $$INCDIR/irccommand.h
@@ -29,6 +30,7 @@ PUB_HEADERS += $$INCDIR/ircglobal.h
 PUB_HEADERS += $$INCDIR/ircmessage.h
 PUB_HEADERS += $$INCDIR/ircnetwork.h
 PUB_HEADERS += $$INCDIR/ircprotocol.h
+PUB_HEADERS += $$INCDIR/ircreply.h
 
 PRIV_HEADERS  = $$INCDIR/irccommand_p.h
 PRIV_HEADERS += $$INCDIR/ircconnection_p.h
@@ -37,7 +39,9 @@ PRIV_HEADERS += $$INCDIR/ircdebug_p.h
 PRIV_HEADERS += $$INCDIR/ircmessage_p.h
 PRIV_HEADERS += $$INCDIR/ircmessagecomposer_p.h
 PRIV_HEADERS += $$INCDIR/ircmessagedecoder_p.h
+PRIV_HEADERS += $$INCDIR/ircnametable_p.h
 PRIV_HEADERS += $$INCDIR/ircnetwork_p.h
+PRIV_HEADERS += $$INCDIR/ircreply_p.h
 
 HEADERS += $$PUB_HEADERS
 HEADERS += $$PRIV_HEADERS
@@ -53,6 +57,7 @@ SOURCES += $$PWD/ircmessagecomposer.cpp
 SOURCES += $$PWD/ircmessagedecoder.cpp
 SOURCES += $$PWD/ircnetwork.cpp
 SOURCES += $$PWD/ircprotocol.cpp
+SOURCES += $$PWD/ircreply.cpp
 
 include(pkg.pri)
 
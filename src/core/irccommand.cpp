@@ -29,8 +29,11 @@
 #include "irccommand.h"
 #include "irccommand_p.h"
 #include "ircconnection.h"
+#include "ircnetwork.h"
 #include "ircmessage.h"
 #include "irccore_p.h"
+#include "ircreply_p.h"
+#include "ircconnection_p.h"
 #include <QMetaEnum>
 #include <QDebug>
 
@@ -266,6 +269,36 @@ IRC_BEGIN_NAMESPACE
     \brief A whowas command (WHOWAS) is used to query information about a user that no longer exists.
  */
 
+/*!
+    \since 3.7
+    \enum IrcCommand::Priority
+    This enum describes the sending priorities of commands.
+
+    The priority is a hint for flood protection queues such as IrcCommandQueue,
+    which send high priority commands first and keep bulk commands from delaying
+    interactive ones.
+ */
+
+/*!
+    \var IrcCommand::DefaultPriority
+    \brief The priority is determined from the command type.
+ */
+
+/*!
+    \var IrcCommand::HighPriority
+    \brief Protocol control commands, such as PONG, CAP and AUTHENTICATE.
+ */
+
+/*!
+    \var IrcCommand::NormalPriority
+    \brief Interactive commands, such as messages typed by the user.
+ */
+
+/*!
+    \var IrcCommand::LowPriority
+    \brief Bulk commands, such as automated rejoins and WHO synchronization.
+ */
+
 extern bool irc_is_supported_encoding(const QByteArray& encoding); // ircmessagedecoder.cpp
 
 #ifndef IRC_DOXYGEN
@@ -285,6 +318,224 @@ IrcCommand* IrcCommandPrivate::createCommand(IrcCommand::Type type, const QStrin
     command->setParameters(parameters);
     return command;
 }
+
+static bool fitsLine(IrcCommand* line, const IrcNetwork* network)
+{
+    const int max = network ? network->numericLimit(IrcNetwork::MessageLength) : 512;
+    return line->toString().toUtf8().size() + 2 <= max; // CRLF
+}
+
+static QList<QStringList> splitTargets(const IrcCommand* command, int index, const QString& verb, const IrcNetwork* network)
+{
+    QStringList params = command->parameters();
+    if (!params.value(index).contains(QLatin1Char(',')))
+        return QList<QStringList>();
+
+    QList<QStringList> lines;
+    const QStringList targets = params.value(index).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    const int limit = network ? network->targetLimit(verb) : 0;
+
+    IrcCommand line;
+    line.setType(command->type());
+    QStringList current;
+    foreach (const QString& target, targets) {
+        const QStringList candidate = current + QStringList(target);
+        params[index] = candidate.join(QLatin1String(","));
+        line.setParameters(params);
+        if (!current.isEmpty() && ((limit > 0 && candidate.count() > limit) || !fitsLine(&line, network))) {
+            params[index] = current.join(QLatin1String(","));
+            lines += params;
+            current = QStringList(target);
+        } else {
+            current = candidate;
+        }
+    }
+    if (!current.isEmpty() || lines.isEmpty()) {
+        params[index] = current.join(QLatin1String(","));
+        lines += params;
+    }
+    return lines;
+}
+
+static QStringList joinParameters(const QStringList& channels, const QStringList& keys)
+{
+    QStringList params = QStringList() << channels.join(QLatin1String(","));
+    if (!keys.isEmpty())
+        params += keys.join(QLatin1String(","));
+    return params;
+}
+
+static QList<QStringList> splitJoin(const IrcCommand* command, const IrcNetwork* network)
+{
+    const QStringList params = command->parameters();
+    if (!params.value(0).contains(QLatin1Char(',')))
+        return QList<QStringList>();
+
+    const QStringList channels = params.value(0).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    const QStringList keys = params.value(1).split(QLatin1Char(','));
+
+    // channels with keys must precede channels without keys, because
+    // keys are matched by position: "JOIN #a,#b ,key" does not work
+    QStringList keyed, unkeyed, ordered;
+    for (int i = 0; i < channels.count(); ++i) {
+        const QString key = keys.value(i);
+        if (key.isEmpty()) {
+            unkeyed += channels.at(i);
+        } else {
+            keyed += channels.at(i);
+            ordered += key;
+        }
+    }
+    const QStringList targets = keyed + unkeyed;
+    const int limit = network ? network->targetLimit(QLatin1String("JOIN")) : 0;
+
+    QList<QStringList> lines;
+    IrcCommand line;
+    line.setType(IrcCommand::Join);
+    QStringList current, currentKeys;
+    for (int i = 0; i < targets.count(); ++i) {
+        const QStringList candidate = current + QStringList(targets.at(i));
+        QStringList candidateKeys = currentKeys;
+        if (i < ordered.count())
+            candidateKeys += ordered.at(i);
+        line.setParameters(joinParameters(candidate, candidateKeys));
+        if (!current.isEmpty() && ((limit > 0 && candidate.count() > limit) || !fitsLine(&line, network))) {
+            lines += joinParameters(current, currentKeys);
+            current = QStringList(targets.at(i));
+            currentKeys = candidateKeys.mid(currentKeys.count());
+        } else {
+            current = candidate;
+            currentKeys = candidateKeys;
+        }
+    }
+    if (!current.isEmpty() || lines.isEmpty())
+        lines += joinParameters(current, currentKeys);
+    return lines;
+}
+
+// the individual changes of channel MODE parameters, or false if
+// the changes cannot be taken apart: a list query, a missing argument,
+// or an unknown mode for which the amount of arguments is not known
+bool IrcCommandPrivate::parseModes(const IrcNetwork* network, const QStringList& params, QList<IrcModeChange>* changes)
+{
+    const QString modes = params.value(1);
+    if (modes.isEmpty() || (modes.at(0) != QLatin1Char('+') && modes.at(0) != QLatin1Char('-')))
+        return false;
+
+    const QStringList listModes = network->channelModes(IrcNetwork::TypeA);
+    const QStringList paramModes = network->channelModes(IrcNetwork::TypeB) + network->modes();
+    const QStringList setModes = network->channelModes(IrcNetwork::TypeC);
+    const QStringList flagModes = network->channelModes(IrcNetwork::TypeD);
+
+    QStringList args = params.mid(2).join(QLatin1String(" ")).split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    QChar sign;
+    foreach (const QChar& c, modes) {
+        if (c == QLatin1Char('+') || c == QLatin1Char('-')) {
+            sign = c;
+            continue;
+        }
+        IrcModeChange change;
+        change.sign = sign;
+        change.mode = c;
+        const QString m(c);
+        if (listModes.contains(m) || paramModes.contains(m) || (sign == QLatin1Char('+') && setModes.contains(m))) {
+            if (args.isEmpty())
+                return false;
+            change.arg = args.takeFirst();
+        } else if (!flagModes.contains(m) && !setModes.contains(m)) {
+            return false;
+        }
+        changes->append(change);
+    }
+    return args.isEmpty();
+}
+
+// the MODE parameters that apply the changes to target
+QStringList IrcCommandPrivate::modeParameters(const QString& target, const QList<IrcModeChange>& changes)
+{
+    QChar sign;
+    QString modes;
+    QStringList args;
+    foreach (const IrcModeChange& change, changes) {
+        if (change.sign != sign) {
+            sign = change.sign;
+            modes += sign;
+        }
+        modes += change.mode;
+        if (!change.arg.isEmpty())
+            args += change.arg;
+    }
+    QStringList params = QStringList() << target << modes;
+    if (!args.isEmpty())
+        params += args.join(QLatin1String(" "));
+    return params;
+}
+
+static QList<QStringList> splitModes(const IrcCommand* command, const IrcNetwork* network)
+{
+    // without the channel modes of the network it is not known which modes have arguments
+    QList<IrcModeChange> changes;
+    const QString target = command->parameters().value(0);
+    if (!network || !network->isChannel(target) || !IrcCommandPrivate::parseModes(network, command->parameters(), &changes))
+        return QList<QStringList>();
+
+    const int limit = IrcCommandPrivate::modeLimit(network);
+
+    QList<QStringList> lines;
+    IrcCommand line;
+    line.setType(IrcCommand::Mode);
+    QList<IrcModeChange> current;
+    int count = 0;
+    foreach (const IrcModeChange& change, changes) {
+        const int arg = change.arg.isEmpty() ? 0 : 1;
+        line.setParameters(IrcCommandPrivate::modeParameters(target, current + (QList<IrcModeChange>() << change)));
+        if (!current.isEmpty() && (count + arg > limit || !fitsLine(&line, network))) {
+            lines += IrcCommandPrivate::modeParameters(target, current);
+            current.clear();
+            count = 0;
+        }
+        current += change;
+        count += arg;
+    }
+    if (!current.isEmpty())
+        lines += IrcCommandPrivate::modeParameters(target, current);
+    return lines;
+}
+
+/*
+    Splits a multi-target command to lines that fit the TARGMAX and MODES
+    limits and the maximum line length of the network. Returns the
+    parameters of each line, or an empty list if the command has a single
+    target or cannot be split.
+ */
+QList<QStringList> IrcCommandPrivate::split(const IrcCommand* command, const IrcNetwork* network)
+{
+    switch (command->type()) {
+    case IrcCommand::Join:
+        return splitJoin(command, network);
+    case IrcCommand::Mode:
+        return splitModes(command, network);
+    case IrcCommand::Monitor: {
+        const QString sign = command->parameters().value(0);
+        if (sign == QLatin1String("+") || sign == QLatin1String("-"))
+            return splitTargets(command, 1, QLatin1String("MONITOR"), network);
+        break;
+    }
+    case IrcCommand::Message:
+        return splitTargets(command, 0, QLatin1String("PRIVMSG"), network);
+    case IrcCommand::Names:
+        return splitTargets(command, 0, QLatin1String("NAMES"), network);
+    case IrcCommand::Notice:
+        return splitTargets(command, 0, QLatin1String("NOTICE"), network);
+    case IrcCommand::Part:
+        return splitTargets(command, 0, QLatin1String("PART"), network);
+    case IrcCommand::Whois:
+        return splitTargets(command, 0, QLatin1String("WHOIS"), network);
+    default:
+        break;
+    }
+    return QList<QStringList>();
+}
 #endif // IRC_DOXYGEN
 
 /*!
@@ -299,6 +550,10 @@ IrcCommand::IrcCommand(QObject* parent) : QObject(parent), d_ptr(new IrcCommandP
  */
 IrcCommand::~IrcCommand()
 {
+    Q_D(IrcCommand);
+    // a request that is discarded before it is sent
+    if (d->reply)
+        IrcReplyPrivate::get(d->reply)->detach(this);
 }
 
 /*!
@@ -353,6 +608,31 @@ void IrcCommand::setType(Type type)
     d->type = type;
 }
 
+/*!
+    \since 3.7
+
+    This property holds the command priority.
+
+    The default value is \ref DefaultPriority.
+
+    \par Access functions:
+    \li IrcCommand::Priority <b>priority</b>() const
+    \li void <b>setPriority</b>(IrcCommand::Priority priority)
+
+    \sa IrcCommandQueue
+ */
+IrcCommand::Priority IrcCommand::priority() const
+{
+    Q_D(const IrcCommand);
+    return d->priority;
+}
+
+void IrcCommand::setPriority(Priority priority)
+{
+    Q_D(IrcCommand);
+    d->priority = priority;
+}
+
 /*!
     This property holds the command parameters.
 
@@ -469,10 +749,49 @@ QString IrcCommand::toString() const
         message->deleteLater();
     }
     \endcode
+
+    \note Since 3.7, the message is built directly from the parameters of
+    the command, without formatting and parsing the command line, unless
+    the command is a custom command.
+
+    \note Since 3.7, when the \c echo-message capability is active, the
+    connection remembers own messages created with this function. When the
+    server echoes such a message back, the echo gets the IrcMessage::Echo flag,
+    and the local message receives the \c msgid tag and the time stamp of
+    the echo.
  */
 IrcMessage* IrcCommand::toMessage(const QString& prefix, IrcConnection* connection) const
 {
-    return IrcMessage::fromData(":" + prefix.toUtf8() + " " + toString().toUtf8(), connection);
+    Q_D(const IrcCommand);
+    const QString p0 = d->parameters.value(0);
+    const QString p1 = d->parameters.value(1);
+    const QString p2 = d->parameters.value(2);
+
+    QString command;
+    QStringList params;
+    switch (d->type) {
+        case CtcpAction:    command = QLatin1String("PRIVMSG"); params << p0 << "\1ACTION " + d->params(1) + "\1"; break;
+        case CtcpRequest:   command = QLatin1String("PRIVMSG"); params << p0 << "\1" + d->params(1) + "\1"; break;
+        case CtcpReply:     command = QLatin1String("NOTICE"); params << p0 << "\1" + d->params(1) + "\1"; break;
+        case Join:          command = QLatin1String("JOIN"); params << p0; if (!p1.isNull()) params << p1; break;
+        case Kick:          command = QLatin1String("KICK"); params << p0 << p1; if (!p2.isNull()) params << d->params(2); break;
+        case Message:       command = QLatin1String("PRIVMSG"); params << p0 << d->params(1); break;
+        case Nick:          command = QLatin1String("NICK"); params << p0; break;
+        case Notice:        command = QLatin1String("NOTICE"); params << p0 << d->params(1); break;
+        case Part:          command = QLatin1String("PART"); params << p0; if (!p1.isNull()) params << d->params(1); break;
+        case Quit:          command = QLatin1String("QUIT"); params << d->params(0); break;
+        case Topic:         command = QLatin1String("TOPIC"); params << p0; if (!p1.isNull()) params << d->params(1); break;
+        default:            break;
+    }
+
+    // custom commands may reimplement toString()
+    if (command.isEmpty() || metaObject() != &IrcCommand::staticMetaObject)
+        return IrcMessage::fromData(":" + prefix.toUtf8() + " " + toString().toUtf8(), connection);
+
+    IrcMessage* message = IrcMessage::fromParameters(prefix, command, params, connection);
+    if (connection && (message->type() == IrcMessage::Private || message->type() == IrcMessage::Notice) && message->isOwn())
+        IrcConnectionPrivate::get(connection)->addLocalEcho(message, this);
+    return message;
 }
 
 /*!
@@ -34,9 +34,11 @@
 #include "ircnetwork.h"
 #include "irccommand.h"
 #include "ircmessage.h"
+#include "ircmessage_p.h"
 #include "ircdebug_p.h"
 #include "ircfilter.h"
 #include "irccore_p.h"
+#include "ircreply_p.h"
 #include "irc.h"
 #include <QLocale>
 #include <QDateTime>
@@ -58,9 +60,23 @@
 #include <QSslSocket>
 #include <QSslError>
 #endif // QT_NO_SSL
+
 #include <QDataStream>
 #include <QVariantMap>
 
+// the length of a user name and a host name when not yet known
+static const int DEFAULT_USERLEN = 11; // "~" + USERLEN=10
+static const int DEFAULT_HOSTLEN = 63;
+
+// the amount of locally presented messages remembered while waiting for their echo
+static const int MAX_LOCAL_ECHOES = 64;
+
+// the time in milliseconds after which a locally presented message is no longer expected to echo back
+static const int LOCAL_ECHO_TIMEOUT = 30000;
+
+// the time in milliseconds after which a request that is still waiting for its response is aborted
+static const int REQUEST_TIMEOUT = 120000;
+
 IRC_BEGIN_NAMESPACE
 
 /*!
@@ -285,6 +301,8 @@ void IrcConnectionPrivate::_irc_connected()
     Q_Q(IrcConnection);
     closed = false;
     pendingOpen = false;
+    ownUser.clear();
+    ownHost.clear();
     emit q->connecting();
     if (q->isSecure())
         QMetaObject::invokeMethod(socket, "startClientEncryption");
@@ -295,6 +313,7 @@ void IrcConnectionPrivate::_irc_disconnected()
 {
     Q_Q(IrcConnection);
     protocol->close();
+    abortRequests();
     emit q->disconnected();
     reconnect();
 }
@@ -472,6 +491,9 @@ void IrcConnectionPrivate::setInfo(const QHash<QString, QString>& info)
 bool IrcConnectionPrivate::receiveMessage(IrcMessage* msg)
 {
     Q_Q(IrcConnection);
+    updateHostMask(msg);
+    handleReply(msg);
+    reconcileEcho(msg);
     if (msg->type() == IrcMessage::Join && msg->isOwn()) {
         replies.clear();
     } else if (msg->type() == IrcMessage::Numeric) {
@@ -581,6 +603,438 @@ bool IrcConnectionPrivate::receiveMessage(IrcMessage* msg)
     return !filtered;
 }
 
+static QString irc_label_line(const QString& line, const QString& label)
+{
+    // merge with the tags of a line that already has some
+    QString data = line;
+    if (data.startsWith(QLatin1Char('@')))
+        data.insert(1, QString("label=%1;").arg(label));
+    else
+        data.prepend(QString("@label=%1 ").arg(label));
+    return data;
+}
+
+QString IrcConnectionPrivate::prepareRequest(IrcCommand* command, const QString& line)
+{
+    IrcReplyPrivate* reply = IrcReplyPrivate::get(IrcCommandPrivate::get(command)->reply);
+    if (!reply || reply->finished) {
+        if (reply)
+            reply->detach(command);
+        const QString label = echoLabel(command);
+        return label.isEmpty() ? line : irc_label_line(line, label);
+    }
+
+    QString data = line;
+    IrcReplyRequest request;
+    request.reply = reply->q_ptr;
+    if (network->isCapable(QLatin1String("labeled-response"))) {
+        // an own message that was presented locally already has its label
+        QString& label = IrcCommandPrivate::get(command)->label;
+        if (label.isEmpty())
+            label = QString::number(++labelCount, 36);
+        request.label = label;
+        data = irc_label_line(data, label);
+        request.written.start();
+        requests += request;
+        ++reply->requests;
+    } else if (request.correlate(command, network)) {
+        request.written.start();
+        requests += request;
+        ++reply->requests;
+    }
+    reply->written = true;
+    reply->detach(command);
+    return data;
+}
+
+void IrcConnectionPrivate::handleReply(IrcMessage* msg)
+{
+    if (requests.isEmpty())
+        return;
+
+    expireRequests();
+
+    const QString label = msg->tags().value(QLatin1String("label")).toString();
+    if (!label.isEmpty()) {
+        for (int i = 0; i < requests.count(); ++i) {
+            if (requests.at(i).label == label) {
+                const IrcReplyRequest request = requests.takeAt(i);
+                IrcMessagePrivate::get(msg)->roundTrip = request.written.nsecsElapsed() / 1000;
+                IrcReplyPrivate* reply = IrcReplyPrivate::get(request.reply);
+                if (reply) {
+                    reply->receive(msg);
+                    reply->complete();
+                }
+                return;
+            }
+        }
+    } else if (msg->type() == IrcMessage::Numeric) {
+        // servers respond in order, so the response belongs to the oldest matching request
+        IrcNumericMessage* numeric = static_cast<IrcNumericMessage*>(msg);
+        for (int i = 0; i < requests.count(); ++i) {
+            IrcReplyRequest& request = requests[i];
+            if (!request.label.isEmpty())
+                continue;
+            if (!request.reply || request.reply->isFinished()) {
+                requests.removeAt(i--);
+                continue;
+            }
+            const IrcReplyRequest::Match match = request.match(numeric);
+            if (match != IrcReplyRequest::NoMatch) {
+                IrcReplyPrivate* reply = IrcReplyPrivate::get(request.reply);
+                reply->receive(msg);
+                if (match == IrcReplyRequest::EndMatch) {
+                    requests.removeAt(i);
+                    reply->complete();
+                }
+                return;
+            }
+        }
+    }
+}
+
+void IrcConnectionPrivate::abortRequests()
+{
+    const QList<IrcReplyRequest> aborted = requests;
+    requests.clear();
+    foreach (const IrcReplyRequest& request, aborted) {
+        if (request.reply)
+            request.reply->abort();
+    }
+}
+
+void IrcConnectionPrivate::expireRequests()
+{
+    // requests are written in order, so the oldest ones are first
+    QList<IrcReplyRequest> expired;
+    while (!requests.isEmpty() && requests.first().written.hasExpired(REQUEST_TIMEOUT))
+        expired += requests.takeFirst();
+    foreach (const IrcReplyRequest& request, expired) {
+        if (request.reply)
+            request.reply->abort();
+    }
+}
+
+void IrcConnectionPrivate::updateHostMask(IrcMessage* msg)
+{
+    if (msg->type() == IrcMessage::HostChange) {
+        if (msg->isOwn()) {
+            IrcHostChangeMessage* hostChange = static_cast<IrcHostChangeMessage*>(msg);
+            ownUser = hostChange->user();
+            ownHost = hostChange->host();
+        }
+    } else if (msg->type() == IrcMessage::Numeric) {
+        const QStringList params = msg->parameters();
+        switch (static_cast<IrcNumericMessage*>(msg)->code()) {
+        case Irc::RPL_WELCOME: {
+            // "Welcome to the Internet Relay Network <nick>!<user>@<host>"
+            const QString mask = params.value(1).section(QLatin1Char(' '), -1);
+            const int ex = mask.indexOf(QLatin1Char('!'));
+            const int at = mask.indexOf(QLatin1Char('@'), ex + 1);
+            if (ex > 0 && at > ex + 1 && at < mask.length() - 1) {
+                ownUser = mask.mid(ex + 1, at - ex - 1);
+                ownHost = mask.mid(at + 1);
+            }
+            break;
+        }
+        case Irc::RPL_WHOREPLY: // <me> <channel> <user> <host> <server> <nick> ...
+            if (!params.value(5).compare(nickName, Qt::CaseInsensitive)) {
+                ownUser = params.value(2);
+                ownHost = params.value(3);
+            }
+            break;
+        case Irc::RPL_HOSTHIDDEN: // <me> <host> :is now your displayed host
+            ownHost = params.value(1);
+            break;
+        default:
+            break;
+        }
+    } else if (msg->isOwn() && !msg->ident().isEmpty() && !msg->host().isEmpty()) {
+        ownUser = msg->ident();
+        ownHost = msg->host();
+    }
+}
+
+int IrcConnectionPrivate::prefixLength() const
+{
+    // ":<nick>!<user>@<host> " as relayed by the server
+    const int user = ownUser.isEmpty() ? DEFAULT_USERLEN : ownUser.toUtf8().size();
+    const int host = ownHost.isEmpty() ? DEFAULT_HOSTLEN : ownHost.toUtf8().size();
+    return nickName.toUtf8().size() + user + host + 4;
+}
+
+static int utf8Length(const QChar* data, int length)
+{
+    int bytes = 0;
+    for (int i = 0; i < length; ++i) {
+        const ushort c = data[i].unicode();
+        if (c < 0x80)
+            bytes += 1;
+        else if (c < 0x800)
+            bytes += 2;
+        else if (QChar::isHighSurrogate(c) && i + 1 < length && QChar::isLowSurrogate(data[i + 1].unicode())) {
+            bytes += 4;
+            ++i;
+        } else {
+            bytes += 3;
+        }
+    }
+    return bytes;
+}
+
+struct IrcMessagePart
+{
+    QString text;
+    bool concat;
+};
+
+// splits text to lines of at most budget bytes in UTF-8, preferably after whitespace
+static QList<IrcMessagePart> splitText(const QString& text, int budget)
+{
+    QList<IrcMessagePart> parts;
+    QString str = text;
+    str.remove(QLatin1Char('\r'));
+    foreach (const QString& line, str.split(QLatin1Char('\n'), Qt::SkipEmptyParts)) {
+        const QChar* data = line.constData();
+        const int length = line.length();
+        int start = 0;
+        while (start < length) {
+            int end = start;
+            int bytes = 0;
+            while (end < length) {
+                const bool pair = data[end].isHighSurrogate() && end + 1 < length && data[end + 1].isLowSurrogate();
+                const int n = utf8Length(data + end, pair ? 2 : 1);
+                if (bytes + n > budget && end > start)
+                    break;
+                bytes += n;
+                end += pair ? 2 : 1;
+            }
+            if (end < length) {
+                int space = end - 1;
+                while (space > start && !data[space].isSpace())
+                    --space;
+                if (space > start)
+                    end = space + 1;
+            }
+            IrcMessagePart part;
+            part.text = line.mid(start, end - start);
+            part.concat = start > 0;
+            parts += part;
+            start = end;
+        }
+    }
+    return parts;
+}
+
+static void multilineLimits(IrcNetwork* network, int* maxBytes, int* maxLines)
+{
+    *maxBytes = -1;
+    *maxLines = -1;
+    // draft/multiline=max-bytes=4096,max-lines=24
+    foreach (const QString& cap, network->availableCapabilities()) {
+        if (cap.startsWith(QLatin1String("draft/multiline="))) {
+            foreach (const QString& limit, cap.mid(16).split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+                if (limit.startsWith(QLatin1String("max-bytes=")))
+                    *maxBytes = limit.mid(10).toInt();
+                else if (limit.startsWith(QLatin1String("max-lines=")))
+                    *maxLines = limit.mid(10).toInt();
+            }
+        }
+    }
+}
+
+// splits the text of a PRIVMSG or NOTICE command to the lines it is sent as,
+// or returns an empty list if the text fits on a single line
+static QList<IrcMessagePart> splitCommand(const IrcCommand* command, const IrcNetwork* network, int prefix)
+{
+    const QString verb = command->type() == IrcCommand::Message ? QLatin1String("PRIVMSG") : QLatin1String("NOTICE");
+    const QString target = command->parameters().value(0);
+    const QString text = QStringList(command->parameters().mid(1)).join(QLatin1String(" "));
+
+    // ":<prefix> PRIVMSG <target> :<text>\r\n"
+    const int max = network->numericLimit(IrcNetwork::MessageLength);
+    const int budget = max - prefix - verb.length() - target.toUtf8().size() - 5;
+    const bool newlines = text.contains(QLatin1Char('\n')) || text.contains(QLatin1Char('\r'));
+    if (!newlines && (text.length() * 3 <= budget || utf8Length(text.constData(), text.length()) <= budget))
+        return QList<IrcMessagePart>();
+
+    QList<IrcMessagePart> parts = splitText(text, qMax(budget, 4));
+    if (parts.isEmpty()) {
+        // nothing but line breaks
+        IrcMessagePart part;
+        part.concat = false;
+        parts += part;
+    }
+    return parts;
+}
+
+/*
+    Splits a long or multi-line PRIVMSG or NOTICE to as few lines as
+    possible, taking into account the prefix the server adds when relaying
+    it. Wraps the lines into draft/multiline batches when the capability is
+    enabled. Each batch is a single raw command of several lines, so that it
+    is queued, charged and written in one go. Returns an empty list if the
+    command fits in one line.
+ */
+QList<IrcCommand*> IrcConnectionPrivate::splitMessage(IrcCommand* command)
+{
+    const IrcCommand::Type type = command->type();
+    const QString verb = type == IrcCommand::Message ? QLatin1String("PRIVMSG") : QLatin1String("NOTICE");
+    const QString target = command->parameters().value(0);
+
+    const QList<IrcMessagePart> parts = splitCommand(command, network, prefixLength());
+    if (parts.isEmpty())
+        return QList<IrcCommand*>();
+
+    QList<IrcCommand*> commands;
+    if (parts.count() > 1 && network->isCapable(QLatin1String("draft/multiline"))) {
+        int maxBytes, maxLines;
+        multilineLimits(network, &maxBytes, &maxLines);
+
+        int i = 0;
+        while (i < parts.count()) {
+            // collect as many parts as the batch limits allow
+            int j = i;
+            int bytes = 0;
+            while (j < parts.count()) {
+                const int n = parts.at(j).text.toUtf8().size() + (j > i && !parts.at(j).concat ? 1 : 0);
+                if (j > i && ((maxLines > 0 && j - i >= maxLines) || (maxBytes > 0 && bytes + n > maxBytes)))
+                    break;
+                bytes += n;
+                ++j;
+            }
+            if (j - i == 1) {
+                commands += IrcCommandPrivate::createCommand(type, QStringList() << target << parts.at(i).text);
+            } else {
+                const QString ref = QString::number(++batchCount, 36);
+                QStringList lines;
+                lines += QString("BATCH +%1 draft/multiline %2").arg(ref, target);
+                for (int k = i; k < j; ++k) {
+                    const QString tags = k > i && parts.at(k).concat ? QString("@batch=%1;draft/multiline-concat").arg(ref) : QString("@batch=%1").arg(ref);
+                    lines += QString("%1 %2 %3 :%4").arg(tags, verb, target, parts.at(k).text);
+                }
+                lines += QString("BATCH -%1").arg(ref);
+                commands += IrcCommand::createQuote(lines.join(QLatin1String("\r\n")));
+            }
+            i = j;
+        }
+    } else {
+        foreach (const IrcMessagePart& part, parts)
+            commands += IrcCommandPrivate::createCommand(type, QStringList() << target << part.text);
+    }
+
+    foreach (IrcCommand* cmd, commands) {
+        cmd->setPriority(command->priority());
+        cmd->setEncoding(command->encoding());
+        // keeps the raw batch in order with the rest of the target
+        IrcCommandPrivate::get(cmd)->target = target;
+    }
+    return commands;
+}
+
+// single line own messages are labeled, so that their echoes are told
+// apart from the same text sent by another client of the same account
+QString IrcConnectionPrivate::echoLabel(const IrcCommand* command)
+{
+    QString& label = IrcCommandPrivate::get(command)->label;
+    if (label.isEmpty() && network->isCapable(QLatin1String("echo-message")) && network->isCapable(QLatin1String("labeled-response"))) {
+        const IrcCommand::Type type = command->type();
+        if ((type == IrcCommand::Message || type == IrcCommand::Notice || type == IrcCommand::CtcpAction) &&
+                splitCommand(command, network, prefixLength()).isEmpty())
+            label = QString::number(++labelCount, 36);
+    }
+    return label;
+}
+
+void IrcConnectionPrivate::addLocalEcho(IrcMessage* message, const IrcCommand* command)
+{
+    if (!network->isCapable(QLatin1String("echo-message")))
+        return;
+
+    expireEchoes();
+
+    IrcLocalEcho echo;
+    echo.message = message;
+    echo.target = message->parameters().value(0);
+    echo.created.start();
+    // long messages are echoed line by line, the way they were sent
+    if (command->type() == IrcCommand::Message || command->type() == IrcCommand::Notice) {
+        foreach (const IrcMessagePart& part, splitCommand(command, network, prefixLength()))
+            echo.lines += part.text;
+    }
+    if (echo.lines.isEmpty()) {
+        echo.label = echoLabel(command);
+        echo.lines += message->parameters().value(1);
+    }
+    localEchoes += echo;
+    if (localEchoes.count() > MAX_LOCAL_ECHOES)
+        localEchoes.removeFirst();
+}
+
+void IrcConnectionPrivate::reconcileEcho(IrcMessage* msg)
+{
+    if (localEchoes.isEmpty())
+        return;
+
+    expireEchoes();
+
+    const IrcNameTable& names = IrcNetworkPrivate::get(network)->nameTable;
+    const QString label = msg->tags().value(QLatin1String("label")).toString();
+
+    // a message that the server refused is not going to echo back
+    if (msg->type() == IrcMessage::Numeric) {
+        switch (static_cast<IrcNumericMessage*>(msg)->code()) {
+        case Irc::ERR_NOSUCHNICK:
+        case Irc::ERR_NOSUCHCHANNEL:
+        case Irc::ERR_CANNOTSENDTOCHAN:
+        case Irc::ERR_TOOMANYTARGETS:
+        case Irc::ERR_NORECIPIENT:
+        case Irc::ERR_NOTEXTTOSEND:
+            break;
+        default:
+            return;
+        }
+        const QString target = msg->parameters().value(1);
+        for (int i = 0; i < localEchoes.count(); ++i) {
+            const IrcLocalEcho& echo = localEchoes.at(i);
+            if (label.isEmpty() ? names.equals(echo.target, target) : echo.label == label) {
+                localEchoes.removeAt(i);
+                return;
+            }
+        }
+        return;
+    }
+
+    if ((msg->type() != IrcMessage::Private && msg->type() != IrcMessage::Notice) || !msg->isOwn())
+        return;
+
+    // labeled messages are matched by their label only, the others by their target and text
+    const QString target = msg->parameters().value(0);
+    const QString text = msg->parameters().value(1);
+    for (int i = 0; i < localEchoes.count(); ++i) {
+        IrcLocalEcho& echo = localEchoes[i];
+        const bool match = echo.label.isEmpty() ? names.equals(echo.target, target) && echo.lines.removeOne(text)
+                                                : !label.isEmpty() && echo.label == label;
+        if (match) {
+            msg->setFlag(IrcMessage::Echo);
+            // the local message takes the msgid and time of the first echoed line
+            if (echo.message && !echo.message->tags().contains(QLatin1String("msgid"))) {
+                echo.message->setTags(msg->tags());
+                echo.message->setTimeStamp(msg->timeStamp());
+            }
+            if (echo.lines.isEmpty() || !echo.label.isEmpty())
+                localEchoes.removeAt(i);
+            return;
+        }
+    }
+}
+
+void IrcConnectionPrivate::expireEchoes()
+{
+    while (!localEchoes.isEmpty() && localEchoes.first().created.hasExpired(LOCAL_ECHO_TIMEOUT))
+        localEchoes.removeFirst();
+}
+
 IrcCommand* IrcConnectionPrivate::createCtcpReply(IrcPrivateMessage* request)
 {
     Q_Q(IrcConnection);
@@ -1458,6 +1912,18 @@ void IrcConnection::quit(const QString& reason)
     sent. Thus, the command must have been allocated on the heap and
     it is not safe to access the command after it has been sent.
 
+    \note Since 3.7, commands with multiple targets, such as JOIN, PART,
+    NAMES, WHOIS, MONITOR, PRIVMSG and NOTICE, and MODE commands with
+    multiple mode changes, are split to as few lines as possible within
+    the TARGMAX and MODES limits of the \ref network and the maximum line
+    length. Each line is sent as a separate command.
+
+    \note Since 3.7, long and multi-line PRIVMSG and NOTICE commands are
+    split to as few lines as possible, taking into account the prefix that
+    the server adds when relaying them. Lines are split on whitespace where
+    possible, and never within a UTF-8 sequence. When the \c draft/multiline
+    capability is active, the lines are sent in a multiline batch.
+
     \sa sendData()
  */
 bool IrcConnection::sendCommand(IrcCommand* command)
@@ -1467,6 +1933,41 @@ bool IrcConnection::sendCommand(IrcCommand* command)
     if (command) {
         bool filtered = false;
         IrcCommandPrivate::get(command)->connection = this;
+        IrcReplyPrivate* reply = IrcReplyPrivate::get(IrcCommandPrivate::get(command)->reply);
+        const QList<QStringList> lines = IrcCommandPrivate::split(command, d->network);
+        if (lines.count() > 1) {
+            foreach (const QStringList& params, lines) {
+                IrcCommand* line = IrcCommandPrivate::createCommand(command->type(), params);
+                line->setPriority(command->priority());
+                line->setEncoding(command->encoding());
+                if (reply)
+                    reply->attach(line);
+                res |= sendCommand(line);
+            }
+            if (reply)
+                reply->detach(command);
+            if (!command->parent())
+                command->deleteLater();
+            return res;
+        } else if (lines.count() == 1 && lines.first() != command->parameters()) {
+            command->setParameters(lines.first());
+        }
+        if (command->type() == IrcCommand::Message || command->type() == IrcCommand::Notice) {
+            const QList<IrcCommand*> parts = d->splitMessage(command);
+            if (!parts.isEmpty()) {
+                foreach (IrcCommand* part, parts) {
+                    // a multiline batch is labeled by its opening line
+                    if (reply)
+                        reply->attach(part);
+                    res |= sendCommand(part);
+                }
+                if (reply)
+                    reply->detach(command);
+                if (!command->parent())
+                    command->deleteLater();
+                return res;
+            }
+        }
         for (int i = d->commandFilters.count() - 1; !filtered && i >= 0; --i) {
             QObject* filter = d->commandFilters.at(i);
             IrcCommandFilter* commandFilter = qobject_cast<IrcCommandFilter*>(filter);
@@ -1479,17 +1980,18 @@ bool IrcConnection::sendCommand(IrcCommand* command)
         if (filtered) {
             res = false;
         } else {
+            const QString data = d->prepareRequest(command, command->toString());
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     QTextCodec* codec = QTextCodec::codecForName(command->encoding());
     Q_ASSERT(codec);
-    res = sendData(codec->fromUnicode(command->toString()));
+    res = sendData(codec->fromUnicode(data));
 #else
     std::optional<QStringConverter::Encoding> codec = QStringConverter::encodingForName(command->encoding());
     Q_ASSERT(codec.has_value());
 
     auto toCodec = QStringDecoder(codec.value());
-    QByteArray encodedCommand = command->toString().toLatin1();
+    QByteArray encodedCommand = data.toLatin1();
     QString decodedCommand = toCodec(encodedCommand);
     res = sendData(decodedCommand.toLatin1());
 
@@ -1502,6 +2004,36 @@ bool IrcConnection::sendCommand(IrcCommand* command)
     return res;
 }
 
+/*!
+    \since 3.7
+
+    Sends a \a command to the server and returns a reply that collects
+    the response of the server.
+
+    The command is sent as if by sendCommand(). The reply is owned by the
+    connection, and should be deleted using deleteLater() once it has
+    \ref IrcReply::finished "finished". Requests do not have to wait for
+    the previous ones to finish, so many queries can be in flight at once.
+
+    \note Responses are matched reliably only when the \c labeled-response
+    capability is active. Add it to the \ref IrcNetwork::requestedCapabilities
+    "requested capabilities", together with \c batch, to enable it.
+
+    \sa IrcReply, sendCommand()
+ */
+IrcReply* IrcConnection::sendRequest(IrcCommand* command)
+{
+    if (!command)
+        return nullptr;
+    IrcReply* reply = new IrcReply(this);
+    IrcReplyPrivate* priv = IrcReplyPrivate::get(reply);
+    priv->deferred = true;
+    priv->attach(command);
+    sendCommand(command);
+    priv->deferred = false;
+    return reply;
+}
+
 /*!
     Sends raw \a data to the server.
 
@@ -60,8 +60,11 @@ namespace IrcCore {
 
         qRegisterMetaType<IrcNetwork*>("IrcNetwork*");
 
+        qRegisterMetaType<IrcReply*>("IrcReply*");
+
         qRegisterMetaType<IrcCommand*>("IrcCommand*");
         qRegisterMetaType<IrcCommand::Type>("IrcCommand::Type");
+        qRegisterMetaType<IrcCommand::Priority>("IrcCommand::Priority");
 
         qRegisterMetaType<IrcMessage*>("IrcMessage*");
         qRegisterMetaType<IrcMessage::Type>("IrcMessage::Type");
@@ -242,6 +242,13 @@ IRC_BEGIN_NAMESPACE
     \brief The message is an implicit "reply" after joining a channel.
  */
 
+/*!
+    \since 3.7
+    \var IrcMessage::Echo
+    \brief The message is the server's echo of a message that was already
+    presented locally using IrcCommand::toMessage().
+ */
+
 extern bool irc_is_supported_encoding(const QByteArray& encoding); // ircmessagedecoder.cpp
 
 static IrcMessage* irc_create_message(const QString& command, IrcConnection* connection)
@@ -382,8 +389,11 @@ IrcMessage::Flags IrcMessage::flags() const
     Q_D(const IrcMessage);
     if (d->flags == -1) {
         d->flags = IrcMessage::None;
-        if (d->connection && !d->prefix().isEmpty() && d->nick() == d->connection->nickName())
-            d->flags |= IrcMessage::Own;
+        if (d->connection && !d->prefix().isEmpty()) {
+            const IrcNameTable& names = IrcNetworkPrivate::get(d->connection->network())->nameTable;
+            if (names.equals(d->nick(), d->connection->nickName()))
+                d->flags |= IrcMessage::Own;
+        }
     }
     return IrcMessage::Flags(d->flags);
 }
@@ -1374,17 +1384,16 @@ bool IrcModeMessage::isReply() const
  */
 IrcModeMessage::Kind IrcModeMessage::kind() const
 {
-    const QString m = mode().remove(QLatin1Char('+')).remove(QLatin1Char('-'));
-    if (!m.isEmpty()) {
-        QStringList channelModes;
-        if (const IrcNetwork* net = network())
-            channelModes = net->channelModes(IrcNetwork::AllTypes);
-        if (!channelModes.isEmpty()) {
-            for (int i = 0; i < m.length(); ++i) {
-                if (!channelModes.contains(m.at(i)))
-                    return User;
-            }
-        }
+    const IrcNetwork* net = network();
+    if (!net || IrcNetworkPrivate::get(net)->info->channelModes.isEmpty())
+        return Channel;
+
+    const IrcNetworkPrivate* priv = IrcNetworkPrivate::get(net);
+    const QString m = mode();
+    for (int i = 0; i < m.length(); ++i) {
+        const QChar c = m.at(i);
+        if (c != QLatin1Char('+') && c != QLatin1Char('-') && !priv->channelModeType(c))
+            return User;
     }
     return Channel;
 }
@@ -1546,8 +1555,9 @@ QString IrcNoticeMessage::target() const
 {
     Q_D(const IrcMessage);
     if (d->connection) {
-        const IrcNetwork* network = d->connection->network();
-        return IrcNetworkPrivate::removePrefix(d->param(0), network->statusPrefixes());
+        const IrcNetworkPrivate* network = IrcNetworkPrivate::get(d->connection->network());
+        const QString target = d->param(0);
+        return target.mid(network->statusPrefixLength(target));
     }
     return d->param(0);
 }
@@ -1581,8 +1591,9 @@ QString IrcNoticeMessage::statusPrefix() const
 {
     Q_D(const IrcMessage);
     if (d->connection) {
-        const IrcNetwork* network = d->connection->network();
-        return IrcNetworkPrivate::getPrefix(d->param(0), network->statusPrefixes());
+        const IrcNetworkPrivate* network = IrcNetworkPrivate::get(d->connection->network());
+        const QString target = d->param(0);
+        return target.left(network->statusPrefixLength(target));
     }
     return QString();
 }
@@ -1599,7 +1610,7 @@ bool IrcNoticeMessage::isPrivate() const
 {
     Q_D(const IrcMessage);
     if (d->connection)
-        return !target().compare(d->connection->nickName(), Qt::CaseInsensitive);
+        return IrcNetworkPrivate::get(d->connection->network())->nameTable.equals(target(), d->connection->nickName());
     return false;
 }
 
@@ -1812,8 +1823,9 @@ QString IrcPrivateMessage::target() const
 {
     Q_D(const IrcMessage);
     if (d->connection) {
-        const IrcNetwork* network = d->connection->network();
-        return IrcNetworkPrivate::removePrefix(d->param(0), network->statusPrefixes());
+        const IrcNetworkPrivate* network = IrcNetworkPrivate::get(d->connection->network());
+        const QString target = d->param(0);
+        return target.mid(network->statusPrefixLength(target));
     }
     return d->param(0);
 }
@@ -1848,8 +1860,9 @@ QString IrcPrivateMessage::statusPrefix() const
 {
     Q_D(const IrcMessage);
     if (d->connection) {
-        const IrcNetwork* network = d->connection->network();
-        return IrcNetworkPrivate::getPrefix(d->param(0), network->statusPrefixes());
+        const IrcNetworkPrivate* network = IrcNetworkPrivate::get(d->connection->network());
+        const QString target = d->param(0);
+        return target.left(network->statusPrefixLength(target));
     }
     return QString();
 }
@@ -1866,7 +1879,7 @@ bool IrcPrivateMessage::isPrivate() const
 {
     Q_D(const IrcMessage);
     if (d->connection)
-        return !target().compare(d->connection->nickName(), Qt::CaseInsensitive);
+        return IrcNetworkPrivate::get(d->connection->network())->nameTable.equals(target(), d->connection->nickName());
     return false;
 }
 
@@ -2332,6 +2345,8 @@ QDebug operator<<(QDebug debug, IrcMessage::Flags flags)
         lst << "Playback";
     if (flags & IrcMessage::Implicit)
         lst << "Implicit";
+    if (flags & IrcMessage::Echo)
+        lst << "Echo";
     debug.nospace() << '(' << qPrintable(lst.join("|")) << ')';
     return debug;
 }
@@ -35,6 +35,9 @@
 #include "irccore_p.h"
 #include <QMetaEnum>
 #include <QPointer>
+#include <QMutex>
+#include <cstring>
+#include <algorithm>
 
 IRC_BEGIN_NAMESPACE
 
@@ -183,11 +186,6 @@ IRC_BEGIN_NAMESPACE
  */
 
 #ifndef IRC_DOXYGEN
-IrcNetworkPrivate::IrcNetworkPrivate() :
-    modes(QStringList() << "o" << "v"), prefixes(QStringList() << "@" << "+"), channelTypes("#")
-{
-}
-
 static QHash<QString, int> numericValues(const QString& parameter)
 {
     QHash<QString, int> values;
@@ -197,36 +195,32 @@ static QHash<QString, int> numericValues(const QString& parameter)
     return values;
 }
 
-void IrcNetworkPrivate::setInfo(const QHash<QString, QString>& info)
+static void compileIndices(qint8* table, const QStringList& chars, int count)
 {
-    Q_Q(IrcNetwork);
-    if (info.contains("NETWORK"))
-        setName(info.value("NETWORK"));
+    memset(table, -1, 128 * sizeof(qint8));
+    for (int i = 0; i < count; ++i) {
+        const QString& str = chars.at(i);
+        const ushort c = str.isEmpty() ? 128 : str.at(0).unicode();
+        if (c < 128 && table[c] == -1)
+            table[c] = i;
+    }
+}
+
+IrcNetworkInfo::IrcNetworkInfo(const QHash<QString, QString>& parameters) : info(parameters)
+{
+    modes = QStringList() << "o" << "v";
+    prefixes = QStringList() << "@" << "+";
+    channelTypes = QStringList() << "#";
+
     if (info.contains("PREFIX")) {
         const QString pfx = info.value("PREFIX");
-        setModes(pfx.mid(1, pfx.indexOf(')') - 1).split("", Qt::SkipEmptyParts));
-        setPrefixes(pfx.mid(pfx.indexOf(')') + 1).split("", Qt::SkipEmptyParts));
+        modes = pfx.mid(1, pfx.indexOf(')') - 1).split("", Qt::SkipEmptyParts);
+        prefixes = pfx.mid(pfx.indexOf(')') + 1).split("", Qt::SkipEmptyParts);
     }
     if (info.contains("CHANTYPES"))
-        setChannelTypes(info.value("CHANTYPES").split("", Qt::SkipEmptyParts));
+        channelTypes = info.value("CHANTYPES").split("", Qt::SkipEmptyParts);
     if (info.contains("STATUSMSG"))
-        setStatusPrefixes(info.value("STATUSMSG").split("", Qt::SkipEmptyParts));
-
-    // TODO:
-    if (info.contains("NICKLEN"))
-        numericLimits.insert("NICKLEN", info.value("NICKLEN").toInt());
-    if (info.contains("CHANNELLEN"))
-        numericLimits.insert("CHANNELLEN", info.value("CHANNELLEN").toInt());
-    if (info.contains("TOPICLEN"))
-        numericLimits.insert("TOPICLEN", info.value("TOPICLEN").toInt());
-    if (info.contains("KICKLEN"))
-        numericLimits.insert("KICKLEN", info.value("KICKLEN").toInt());
-    if (info.contains("AWAYLEN"))
-        numericLimits.insert("AWAYLEN", info.value("AWAYLEN").toInt());
-    if (info.contains("MODES"))
-        numericLimits.insert("MODES", info.value("MODES").toInt());
-    if (info.contains("MONITOR"))
-        numericLimits.insert("MONITOR", info.value("MONITOR").toInt());
+        statusPrefixes = info.value("STATUSMSG").split("", Qt::SkipEmptyParts);
     if (info.contains("CHANMODES"))
         channelModes = info.value("CHANMODES").split(",", Qt::SkipEmptyParts);
     if (info.contains("MAXLIST"))
@@ -236,6 +230,97 @@ void IrcNetworkPrivate::setInfo(const QHash<QString, QString>& info)
     if (info.contains("TARGMAX"))
         targetLimits = numericValues(info.value("TARGMAX"));
 
+    static const char* const limitKeys[] = { "NICKLEN", "CHANNELLEN", "TOPICLEN", nullptr, "KICKLEN", "AWAYLEN", "MODES", "MONITOR" };
+    for (int i = 0; i <= IrcNetwork::MonitorCount; ++i) {
+        numericLimits[i] = -1;
+        if (limitKeys[i] && info.contains(QLatin1String(limitKeys[i])))
+            numericLimits[i] = info.value(QLatin1String(limitKeys[i])).toInt();
+    }
+    numericLimits[IrcNetwork::MessageLength] = 512; // RFC 1459
+    caseMapping = IrcNameTable::caseMappingFromString(info.value("CASEMAPPING"));
+
+    // user modes are stored as bits in an uint
+    const int count = qMin(modes.count(), 32);
+    compileIndices(modeIndices, modes, count);
+    compileIndices(prefixIndices, prefixes, qMin(prefixes.count(), count));
+    compileIndices(channelTypeIndices, channelTypes, channelTypes.count());
+
+    memset(statusPrefixTable, 0, sizeof(statusPrefixTable));
+    foreach (const QString& prefix, statusPrefixes) {
+        const ushort c = prefix.at(0).unicode();
+        if (c < 128)
+            statusPrefixTable[c] = true;
+    }
+
+    memset(channelModeTypes, 0, sizeof(channelModeTypes));
+    static const IrcNetwork::ModeType types[] = { IrcNetwork::TypeA, IrcNetwork::TypeB, IrcNetwork::TypeC, IrcNetwork::TypeD };
+    for (int t = 0; t < qMin(channelModes.count(), 4); ++t) {
+        const QString& letters = channelModes.at(t);
+        typeModes[t] = letters.split("", Qt::SkipEmptyParts);
+        for (int i = 0; i < letters.length(); ++i) {
+            const ushort c = letters.at(i).unicode();
+            if (c < 128)
+                channelModeTypes[c] |= types[t];
+        }
+    }
+}
+
+QSharedPointer<const IrcNetworkInfo> IrcNetworkInfo::create(const QHash<QString, QString>& info)
+{
+    // connections may live in different threads
+    static QMutex mutex;
+    static QHash<QString, QWeakPointer<const IrcNetworkInfo> > snapshots;
+
+    QStringList keys = info.keys();
+    std::sort(keys.begin(), keys.end());
+    QString key;
+    foreach (const QString& k, keys)
+        key += k + QLatin1Char('=') + info.value(k) + QLatin1Char('\n');
+
+    QMutexLocker locker(&mutex);
+    QSharedPointer<const IrcNetworkInfo> snapshot = snapshots.value(key).toStrongRef();
+    if (!snapshot) {
+        QHash<QString, QWeakPointer<const IrcNetworkInfo> >::iterator it = snapshots.begin();
+        while (it != snapshots.end()) {
+            if (it.value().isNull())
+                it = snapshots.erase(it);
+            else
+                ++it;
+        }
+        snapshot = QSharedPointer<const IrcNetworkInfo>(new IrcNetworkInfo(info));
+        snapshots.insert(key, snapshot);
+    }
+    return snapshot;
+}
+
+IrcNetworkPrivate::IrcNetworkPrivate() : info(IrcNetworkInfo::create(QHash<QString, QString>()))
+{
+}
+
+void IrcNetworkPrivate::setInfo(const QHash<QString, QString>& parameters)
+{
+    Q_Q(IrcNetwork);
+    QHash<QString, QString> merged = info->info;
+    for (QHash<QString, QString>::const_iterator it = parameters.constBegin(); it != parameters.constEnd(); ++it)
+        merged.insert(it.key(), it.value());
+
+    const QSharedPointer<const IrcNetworkInfo> previous = info;
+    if (merged != previous->info)
+        info = IrcNetworkInfo::create(merged);
+
+    nameTable.setCaseMapping(info->caseMapping);
+
+    if (parameters.contains("NETWORK"))
+        setName(parameters.value("NETWORK"));
+    if (info->modes != previous->modes)
+        emit q->modesChanged(info->modes);
+    if (info->prefixes != previous->prefixes)
+        emit q->prefixesChanged(info->prefixes);
+    if (info->channelTypes != previous->channelTypes)
+        emit q->channelTypesChanged(info->channelTypes);
+    if (info->statusPrefixes != previous->statusPrefixes)
+        emit q->statusPrefixesChanged(info->statusPrefixes);
+
     if (!initialized) {
         initialized = true;
         emit q->initialized();
@@ -268,58 +353,6 @@ void IrcNetworkPrivate::setName(const QString& value)
         emit q->nameChanged(value);
     }
 }
-
-void IrcNetworkPrivate::setModes(const QStringList& value)
-{
-    Q_Q(IrcNetwork);
-    if (modes != value) {
-        modes = value;
-        emit q->modesChanged(value);
-    }
-}
-
-void IrcNetworkPrivate::setPrefixes(const QStringList& value)
-{
-    Q_Q(IrcNetwork);
-    if (prefixes != value) {
-        prefixes = value;
-        emit q->prefixesChanged(value);
-    }
-}
-
-void IrcNetworkPrivate::setChannelTypes(const QStringList& value)
-{
-    Q_Q(IrcNetwork);
-    if (channelTypes != value) {
-        channelTypes = value;
-        emit q->channelTypesChanged(value);
-    }
-}
-
-void IrcNetworkPrivate::setStatusPrefixes(const QStringList& value)
-{
-    Q_Q(IrcNetwork);
-    if (statusPrefixes != value) {
-        statusPrefixes = value;
-        emit q->statusPrefixesChanged(value);
-    }
-}
-
-QString IrcNetworkPrivate::getPrefix(const QString& str, const QStringList& prefixes)
-{
-    int i = 0;
-    while (i < str.length() && prefixes.contains(str.at(i)))
-        ++i;
-    return str.left(i);
-}
-
-QString IrcNetworkPrivate::removePrefix(const QString& str, const QStringList& prefixes)
-{
-    int i = 0;
-    while (i < str.length() && prefixes.contains(str.at(i)))
-        ++i;
-    return str.mid(i);
-}
 #endif // IRC_DOXYGEN
 
 /*!
@@ -395,7 +428,7 @@ QString IrcNetwork::name() const
 QStringList IrcNetwork::modes() const
 {
     Q_D(const IrcNetwork);
-    return d->modes;
+    return d->info->modes;
 }
 
 /*!
@@ -418,7 +451,7 @@ QStringList IrcNetwork::modes() const
 QStringList IrcNetwork::prefixes() const
 {
     Q_D(const IrcNetwork);
-    return d->prefixes;
+    return d->info->prefixes;
 }
 
 /*!
@@ -429,7 +462,9 @@ QStringList IrcNetwork::prefixes() const
 QString IrcNetwork::modeToPrefix(const QString& mode) const
 {
     Q_D(const IrcNetwork);
-    return d->prefixes.value(d->modes.indexOf(mode));
+    if (mode.length() == 1)
+        return d->info->prefixes.value(d->modeIndex(mode.at(0)));
+    return d->info->prefixes.value(d->info->modes.indexOf(mode));
 }
 
 /*!
@@ -440,7 +475,9 @@ QString IrcNetwork::modeToPrefix(const QString& mode) const
 QString IrcNetwork::prefixToMode(const QString& prefix) const
 {
     Q_D(const IrcNetwork);
-    return d->modes.value(d->prefixes.indexOf(prefix));
+    if (prefix.length() == 1)
+        return d->info->modes.value(d->prefixIndex(prefix.at(0)));
+    return d->info->modes.value(d->info->prefixes.indexOf(prefix));
 }
 
 /*!
@@ -461,7 +498,7 @@ QString IrcNetwork::prefixToMode(const QString& prefix) const
 QStringList IrcNetwork::channelTypes() const
 {
     Q_D(const IrcNetwork);
-    return d->channelTypes;
+    return d->info->channelTypes;
 }
 
 /*!
@@ -482,7 +519,7 @@ QStringList IrcNetwork::channelTypes() const
 QStringList IrcNetwork::statusPrefixes() const
 {
     Q_D(const IrcNetwork);
-    return d->statusPrefixes;
+    return d->info->statusPrefixes;
 }
 
 /*!
@@ -499,8 +536,8 @@ QStringList IrcNetwork::statusPrefixes() const
 bool IrcNetwork::isChannel(const QString& name) const
 {
     Q_D(const IrcNetwork);
-    QString unprefixed = d->removePrefix(name, d->statusPrefixes);
-    return !unprefixed.isEmpty() && d->channelTypes.contains(unprefixed.at(0));
+    const int i = d->statusPrefixLength(name);
+    return i < name.length() && d->channelTypeIndex(name.at(i)) != -1;
 }
 
 /*!
@@ -513,13 +550,13 @@ QStringList IrcNetwork::channelModes(IrcNetwork::ModeTypes types) const
     Q_D(const IrcNetwork);
     QStringList modes;
     if (types & TypeA)
-        modes += d->channelModes.value(0).split("", Qt::SkipEmptyParts);
+        modes += d->info->typeModes[0];
     if (types & TypeB)
-        modes += d->channelModes.value(1).split("", Qt::SkipEmptyParts);
+        modes += d->info->typeModes[1];
     if (types & TypeC)
-        modes += d->channelModes.value(2).split("", Qt::SkipEmptyParts);
+        modes += d->info->typeModes[2];
     if (types & TypeD)
-        modes += d->channelModes.value(3).split("", Qt::SkipEmptyParts);
+        modes += d->info->typeModes[3];
     return modes;
 }
 
@@ -531,18 +568,9 @@ QStringList IrcNetwork::channelModes(IrcNetwork::ModeTypes types) const
 int IrcNetwork::numericLimit(Limit limit) const
 {
     Q_D(const IrcNetwork);
-    QString key;
-    switch (limit) {
-        case NickLength:        key = QLatin1String("NICKLEN"); break;
-        case ChannelLength:     key = QLatin1String("CHANNELLEN"); break;
-        case TopicLength:       key = QLatin1String("TOPICLEN"); break;
-        case MessageLength:     return 512; // RFC 1459
-        case KickReasonLength:  key = QLatin1String("KICKLEN"); break;
-        case AwayReasonLength:  key = QLatin1String("AWAYLEN"); break;
-        case ModeCount:         key = QLatin1String("MODES"); break;
-        case MonitorCount:      key = QLatin1String("MONITOR"); break;
-    }
-    return d->numericLimits.value(key, -1);
+    if (limit < NickLength || limit > MonitorCount)
+        return -1;
+    return d->info->numericLimits[limit];
 }
 
 /*!
@@ -553,7 +581,7 @@ int IrcNetwork::numericLimit(Limit limit) const
 int IrcNetwork::modeLimit(const QString& mode) const
 {
     Q_D(const IrcNetwork);
-    return d->modeLimits.value(mode);
+    return d->info->modeLimits.value(mode);
 }
 
 /*!
@@ -564,7 +592,7 @@ int IrcNetwork::modeLimit(const QString& mode) const
 int IrcNetwork::channelLimit(const QString& type) const
 {
     Q_D(const IrcNetwork);
-    return d->channelLimits.value(type);
+    return d->info->channelLimits.value(type);
 }
 
 /*!
@@ -573,7 +601,7 @@ int IrcNetwork::channelLimit(const QString& type) const
 int IrcNetwork::targetLimit(const QString& command) const
 {
     Q_D(const IrcNetwork);
-    return d->targetLimits.value(command);
+    return d->info->targetLimits.value(command);
 }
 
 /*!
@@ -107,15 +107,55 @@ void IrcProtocolPrivate::authenticate(bool secure)
     }
 }
 
+// checks whether the line is a PING without parsing the whole message
+static bool irc_ping_argument(const QByteArray& line, QByteArray* argument)
+{
+    const int size = line.size();
+    int pos = 0;
+    // skip "@<tags> " and ":<prefix> "
+    const char skip[] = { '@', ':' };
+    for (int i = 0; i < 2; ++i) {
+        if (pos < size && line.at(pos) == skip[i]) {
+            pos = line.indexOf(' ', pos) + 1;
+            if (pos == 0)
+                return false;
+            while (pos < size && line.at(pos) == ' ')
+                ++pos;
+        }
+    }
+    if (size - pos < 4 || qstrnicmp(line.constData() + pos, "PING", 4) || (size > pos + 4 && line.at(pos + 4) != ' '))
+        return false;
+    pos += 4;
+    while (pos < size && line.at(pos) == ' ')
+        ++pos;
+    if (pos < size && line.at(pos) == ':')
+        *argument = line.mid(pos + 1);
+    else
+        *argument = line.mid(pos, line.indexOf(' ', pos) - pos);
+    return true;
+}
+
 void IrcProtocolPrivate::readLines(const QByteArray& delimiter)
 {
+    // frame all complete lines first, and answer server pings right away,
+    // ahead of a backlog that may take a while to process
+    QList<QByteArray> lines;
+    int pos = 0;
     int i = -1;
-    while ((i = buffer.indexOf(delimiter)) != -1) {
-        QByteArray line = buffer.left(i).trimmed();
-        buffer = buffer.mid(i + delimiter.length());
-        if (!line.isEmpty())
-            processLine(line);
+    while ((i = buffer.indexOf(delimiter, pos)) != -1) {
+        QByteArray line = buffer.mid(pos, i - pos).trimmed();
+        pos = i + delimiter.length();
+        if (!line.isEmpty()) {
+            QByteArray argument;
+            if (irc_ping_argument(line, &argument))
+                connection->sendData("PONG " + argument);
+            lines += line;
+        }
     }
+    buffer.remove(0, pos);
+
+    foreach (const QByteArray& line, lines)
+        processLine(line);
 }
 
 void IrcProtocolPrivate::processLine(const QByteArray& line)
@@ -154,9 +194,6 @@ void IrcProtocolPrivate::processLine(const QByteArray& line)
         case IrcMessage::Numeric:
             handleNumericMessage(static_cast<IrcNumericMessage*>(msg));
             break;
-        case IrcMessage::Ping:
-            connection->sendRaw("PONG " + static_cast<IrcPingMessage*>(msg)->argument());
-            break;
         case IrcMessage::Private:
             handlePrivateMessage(static_cast<IrcPrivateMessage*>(msg));
             break;
@@ -300,8 +337,15 @@ void IrcProtocolPrivate::handleCapabilityMessage(IrcCapabilityMessage* msg)
             QMetaObject::invokeMethod(connection->network(), "requestingCapabilities");
             QSet<QString> requestedCaps;
             QSet<QString> activeCaps = IrcPrivate::listToSet(connection->network()->activeCapabilities());
+            // capabilities with values, such as draft/multiline=max-bytes=4096, are requested
+            // by name, except for SASL mechanism lists that are checked separately below
+            QSet<QString> availableNames;
+            foreach (const QString& cap, availableCaps) {
+                if (!cap.startsWith(QLatin1String("sasl="), Qt::CaseInsensitive))
+                    availableNames += cap.section(QLatin1Char('='), 0, 0);
+            }
             foreach (const QString& cap, connection->network()->requestedCapabilities()) {
-                if (availableCaps.contains(cap) && !activeCaps.contains(cap))
+                if (availableNames.contains(cap) && !activeCaps.contains(cap))
                     requestedCaps += cap;
             }
             const QStringList params = msg->parameters();
@@ -347,8 +391,9 @@ void IrcProtocolPrivate::handleCapabilityMessage(IrcCapabilityMessage* msg)
         QStringList requestedCaps;
         QSet<QString> availableCaps = IrcPrivate::listToSet(connection->network()->availableCapabilities());
         foreach (const QString& cap, msg->capabilities()) {
-            if (connection->network()->requestedCapabilities().contains(cap))
-                requestedCaps += cap;
+            const QString name = cap.section(QLatin1Char('='), 0, 0);
+            if (!cap.startsWith(QLatin1String("sasl="), Qt::CaseInsensitive) && connection->network()->requestedCapabilities().contains(name))
+                requestedCaps += name;
             availableCaps.insert(cap);
         }
         q->setAvailableCapabilities(availableCaps);
@@ -475,6 +520,11 @@ void IrcProtocol::close()
     The default implementation reads lines as specified in
     <a href="http://tools.ietf.org/html/rfc1459">RFC 1459</a>.
 
+    \note Since 3.7, the default implementation answers server pings as soon
+    as the received lines have been framed, before processing the lines that
+    precede the ping. The ping messages are still delivered to the connection
+    and its message filters as usual.
+
     \sa socket
  */
 void IrcProtocol::read()
@@ -0,0 +1,350 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ircreply.h"
+#include "ircreply_p.h"
+#include "irccommand_p.h"
+#include "ircconnection.h"
+#include "ircnetwork.h"
+#include "ircnetwork_p.h"
+#include "ircmessage.h"
+#include "irc.h"
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file ircreply.h
+    \brief \#include &lt;IrcReply&gt;
+ */
+
+/*!
+    \since 3.7
+    \class IrcReply ircreply.h IrcReply
+    \ingroup core
+    \brief Collects the response of the server to a request.
+
+    IrcReply is returned by IrcConnection::sendRequest(). It collects the
+    messages the server sends in response to the request, and emits
+    finished() when the response is complete. This allows sending many
+    requests, such as \c WHOIS or \c WHO queries, without waiting for the
+    response to the previous one.
+
+    When the \c labeled-response capability is \ref IrcNetwork::activeCapabilities
+    "active", the request is labeled and the response is matched by its label.
+    Otherwise, the response to the following requests is matched by the
+    numeric replies the server sends, in the order the requests were sent:
+    \li \c WHOIS and \c WHOWAS
+    \li \c WHO
+    \li \c NAMES for one or more channels
+    \li \c MODE queries for channel and user modes, and ban, exception and
+    invitation lists
+
+    Other requests are finished as soon as they have been sent.
+
+    \note The connection is the parent of the reply. Use deleteLater()
+    to delete the reply after it has finished.
+
+    \code
+    IrcReply* reply = connection->sendRequest(IrcCommand::createWhois("jpnurmi"));
+    connect(reply, &IrcReply::finished, [=]() {
+        foreach (IrcMessage* message, reply->messages())
+            qDebug() << message;
+        reply->deleteLater();
+    });
+    \endcode
+
+    \sa IrcConnection::sendRequest(), \ref ircv3
+ */
+
+/*!
+    \fn void IrcReply::finished()
+
+    This signal is emitted when the response is complete or the reply is aborted.
+
+    \sa isFinished(), isAborted()
+ */
+
+#ifndef IRC_DOXYGEN
+IrcReplyPrivate::IrcReplyPrivate()
+{
+}
+
+void IrcReplyPrivate::attach(IrcCommand* command)
+{
+    Q_Q(IrcReply);
+    IrcCommandPrivate::get(command)->reply = q;
+    ++commands;
+}
+
+void IrcReplyPrivate::detach(IrcCommand* command)
+{
+    IrcCommandPrivate::get(command)->reply = nullptr;
+    if (--commands == 0 && requests == 0)
+        finish(!written);
+}
+
+void IrcReplyPrivate::receive(IrcMessage* message)
+{
+    Q_Q(IrcReply);
+    if (finished)
+        return;
+    if (message->type() == IrcMessage::Batch) {
+        foreach (IrcMessage* msg, static_cast<IrcBatchMessage*>(message)->messages())
+            messages += msg->clone(q);
+    } else if (message->command() != QLatin1String("ACK")) {
+        messages += message->clone(q);
+    }
+}
+
+void IrcReplyPrivate::complete()
+{
+    if (--requests == 0 && commands == 0)
+        finish(false);
+}
+
+void IrcReplyPrivate::finish(bool abort)
+{
+    Q_Q(IrcReply);
+    if (finished)
+        return;
+    finished = true;
+    aborted = abort;
+    if (deferred)
+        QMetaObject::invokeMethod(q, "finished", Qt::QueuedConnection);
+    else
+        emit q->finished();
+}
+
+// returns the parameter the numeric reply refers to, or a null string if it
+// cannot be told apart from the replies to other requests of the same kind
+static QString irc_reply_key(IrcNumericMessage* message)
+{
+    const QStringList params = message->parameters();
+    switch (message->code()) {
+    case Irc::RPL_NAMREPLY: // <me> <type> <channel> :<names>
+        return params.value(2);
+    case Irc::RPL_WHOREPLY:
+    case Irc::RPL_WHOSPCRPL:
+    case Irc::RPL_UMODEIS:
+    case Irc::ERR_USERSDONTMATCH:
+        return QString();
+    default:
+        return params.value(1);
+    }
+}
+
+// folds a name as per the server's CASEMAPPING
+QString IrcReplyRequest::fold(const QString& name) const
+{
+    if (names)
+        return names->fold(name);
+    return name.toLower();
+}
+
+bool IrcReplyRequest::correlate(const IrcCommand* command, const IrcNetwork* network)
+{
+    if (network)
+        names = &IrcNetworkPrivate::get(network)->nameTable;
+    const QStringList params = command->parameters();
+    switch (command->type()) {
+    case IrcCommand::Whois:
+        // WHOIS [<server>] <nick>
+        keys = fold(params.value(params.count() - 1)).split(QLatin1Char(','), Qt::SkipEmptyParts);
+        ends << Irc::RPL_ENDOFWHOIS;
+        keyed = true;
+        break;
+    case IrcCommand::Whowas:
+        keys = fold(params.value(0)).split(QLatin1Char(','), Qt::SkipEmptyParts);
+        ends << Irc::RPL_ENDOFWHOWAS;
+        keyed = true;
+        break;
+    case IrcCommand::Who:
+        if (!params.value(0).isEmpty())
+            keys << fold(params.value(0));
+        replies << Irc::RPL_WHOREPLY << Irc::RPL_WHOSPCRPL;
+        ends << Irc::RPL_ENDOFWHO;
+        break;
+    case IrcCommand::Names:
+        keys = fold(params.value(0)).split(QLatin1Char(','), Qt::SkipEmptyParts);
+        replies << Irc::RPL_NAMREPLY;
+        ends << Irc::RPL_ENDOFNAMES;
+        break;
+    case IrcCommand::Mode: {
+        // MODE <target> [b|e|I]
+        const QString target = params.value(0);
+        QString mode = params.value(1);
+        if (mode.startsWith(QLatin1Char('+')))
+            mode.remove(0, 1);
+        if (target.isEmpty() || !params.value(2).isEmpty() || mode.length() > 1)
+            return false;
+        keys << fold(target);
+        if (!network || !network->isChannel(target)) {
+            if (!mode.isEmpty())
+                return false;
+            ends << Irc::RPL_UMODEIS << Irc::ERR_USERSDONTMATCH;
+        } else if (mode.isEmpty()) {
+            ends << Irc::RPL_CHANNELMODEIS;
+        } else if (mode == QLatin1String("b")) {
+            replies << Irc::RPL_BANLIST;
+            ends << Irc::RPL_ENDOFBANLIST;
+        } else if (mode == QLatin1String("e")) {
+            replies << Irc::RPL_EXCEPTLIST;
+            ends << Irc::RPL_ENDOFEXCEPTLIST;
+        } else if (mode == QLatin1String("I")) {
+            replies << Irc::RPL_INVITELIST;
+            ends << Irc::RPL_ENDOFINVITELIST;
+        } else {
+            return false;
+        }
+        ends << Irc::ERR_NOSUCHNICK << Irc::ERR_NOSUCHCHANNEL << Irc::ERR_NOTONCHANNEL << Irc::ERR_CHANOPRIVSNEEDED;
+        break;
+    }
+    default:
+        return false;
+    }
+    return !keys.isEmpty();
+}
+
+IrcReplyRequest::Match IrcReplyRequest::match(IrcNumericMessage* message)
+{
+    const int code = message->code();
+    const bool end = ends.contains(code);
+    if (!end && !replies.contains(code) && !keyed)
+        return NoMatch;
+
+    const QString key = irc_reply_key(message);
+    if (key.isNull())
+        return end ? EndMatch : (keyed ? NoMatch : ReplyMatch);
+
+    // some servers end a multi-target query once, others once per target
+    bool matched = false;
+    foreach (const QString& k, fold(key).split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        if (keys.contains(k)) {
+            matched = true;
+            if (end)
+                keys.removeAll(k);
+        }
+    }
+    if (!matched)
+        return NoMatch;
+    return end && keys.isEmpty() ? EndMatch : ReplyMatch;
+}
+#endif // IRC_DOXYGEN
+
+/*!
+    \internal
+ */
+IrcReply::IrcReply(IrcConnection* connection) : QObject(connection), d_ptr(new IrcReplyPrivate)
+{
+    Q_D(IrcReply);
+    d->q_ptr = this;
+    d->connection = connection;
+}
+
+/*!
+    Destructs the reply.
+ */
+IrcReply::~IrcReply()
+{
+}
+
+/*!
+    \property IrcConnection* IrcReply::connection
+    This property holds the connection the request was sent to.
+
+    \par Access function:
+    \li \ref IrcConnection* <b>connection</b>() const
+ */
+IrcConnection* IrcReply::connection() const
+{
+    Q_D(const IrcReply);
+    return d->connection;
+}
+
+/*!
+    Returns \c true if the reply has finished or was aborted.
+
+    \sa finished(), isAborted()
+ */
+bool IrcReply::isFinished() const
+{
+    Q_D(const IrcReply);
+    return d->finished;
+}
+
+/*!
+    \property bool IrcReply::aborted
+    This property holds whether the reply was aborted.
+
+    A reply is aborted when abort() is called, when the connection
+    is lost before the response is complete, when the request is
+    discarded before it has been sent, or when the server has not
+    responded within two minutes.
+
+    \par Access function:
+    \li bool <b>isAborted</b>() const
+
+    \par Notifier signal:
+    \li void <b>finished</b>()
+ */
+bool IrcReply::isAborted() const
+{
+    Q_D(const IrcReply);
+    return d->aborted;
+}
+
+/*!
+    \property QList<IrcMessage*> IrcReply::messages
+    This property holds the messages received in response to the request.
+
+    The messages are copies owned by the reply. The original messages are
+    delivered to the connection and its message filters as usual.
+
+    \par Access function:
+    \li QList<\ref IrcMessage*> <b>messages</b>() const
+
+    \par Notifier signal:
+    \li void <b>finished</b>()
+ */
+QList<IrcMessage*> IrcReply::messages() const
+{
+    Q_D(const IrcReply);
+    return d->messages;
+}
+
+/*!
+    Aborts the reply. Any further response to the request is ignored.
+ */
+void IrcReply::abort()
+{
+    Q_D(IrcReply);
+    d->finish(true);
+}
+
+IRC_END_NAMESPACE
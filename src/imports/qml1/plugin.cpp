@@ -122,12 +122,14 @@ public:
         qmlRegisterType<IrcBuffer>(uri, 3, 0, "IrcBuffer");
         qmlRegisterType<IrcBufferModel>(uri, 3, 0, "IrcBufferModel");
         qmlRegisterType<IrcChannel>(uri, 3, 0, "IrcChannel");
+        qmlRegisterType<IrcMessageModel>(uri, 3, 7, "IrcMessageModel");
         qmlRegisterType<IrcUser>(uri, 3, 0, "IrcUser");
         qmlRegisterType<IrcUserModel>(uri, 3, 0, "IrcUserModel");
 
         // IrcUtil
         qmlRegisterType<IrcCommandParser>(uri, 3, 0, "IrcCommandParser");
         qmlRegisterType<IrcLagTimer>(uri, 3, 0, "IrcLagTimer");
+        qmlRegisterType<IrcLogWriter>(uri, 3, 7, "IrcLogWriter");
         qmlRegisterType<IrcTextFormat>(uri, 3, 0, "IrcTextFormat");
         qmlRegisterUncreatableType<IrcPalette>(uri, 3, 0, "IrcPalette", "Cannot create an instance of IrcPalette. Use IrcTextFormat::palette property instead.");
         qmlRegisterType<IrcCompleter>(uri, 3, 1, "IrcCompleter");
@@ -30,9 +30,12 @@
 #include "ircbuffer_p.h"
 #include "ircbuffermodel.h"
 #include "ircbuffermodel_p.h"
+#include "ircmessagestore_p.h"
+#include "ircmessagearchive_p.h"
 #include "ircconnection.h"
 #include "ircnetwork.h"
 #include "ircchannel.h"
+#include <qdatetime.h>
 
 IRC_BEGIN_NAMESPACE
 
@@ -80,6 +83,8 @@ IrcBufferPrivate::IrcBufferPrivate()
 
 IrcBufferPrivate::~IrcBufferPrivate()
 {
+    delete store;
+    delete archive;
 }
 
 void IrcBufferPrivate::init(const QString& title, IrcBufferModel* m)
@@ -106,6 +111,7 @@ void IrcBufferPrivate::setName(const QString& value)
     if (name != value) {
         const QString oldTitle = q->title();
         name = value;
+        closeArchive();
         emit q->nameChanged(name);
         emit q->titleChanged(q->title());
         if (model)
@@ -119,6 +125,7 @@ void IrcBufferPrivate::setPrefix(const QString& value)
     if (prefix != value) {
         const QString oldTitle = q->title();
         prefix = value;
+        closeArchive();
         emit q->prefixChanged(prefix);
         emit q->titleChanged(q->title());
         if (model)
@@ -128,6 +135,8 @@ void IrcBufferPrivate::setPrefix(const QString& value)
 
 void IrcBufferPrivate::setModel(IrcBufferModel* value)
 {
+    if (model != value)
+        closeArchive();
     model = value;
 }
 
@@ -153,6 +162,70 @@ bool IrcBufferPrivate::isMonitorable() const
     return false;
 }
 
+const IrcNameTable& IrcBufferPrivate::nameTable() const
+{
+    if (model)
+        return IrcBufferModelPrivate::get(model)->nameTable();
+    return localNames;
+}
+
+IrcMessageStore* IrcBufferPrivate::messageStore()
+{
+    // created on demand: buffers without a message model keep no history
+    if (!store)
+        store = new IrcMessageStore;
+    return store;
+}
+
+IrcMessageArchive* IrcBufferPrivate::messageArchive()
+{
+    Q_Q(IrcBuffer);
+    if (!archive) {
+        const QString dir = model ? IrcBufferModelPrivate::get(model)->archiveDirectory : QString();
+        if (dir.isEmpty() || q->title().isEmpty())
+            return nullptr;
+
+        archive = new IrcMessageArchive(IrcMessageArchive::filePath(dir, nameTable().fold(q->title())));
+        archive->open();
+    }
+    // a failed archive is kept around to avoid retrying on every message
+    return archive->isOpen() ? archive : nullptr;
+}
+
+void IrcBufferPrivate::closeArchive()
+{
+    delete archive;
+    archive = nullptr;
+}
+
+void IrcBufferPrivate::recordMessage(IrcMessage* message)
+{
+    IrcMessageArchive* log = messageArchive();
+    archiveOffset = -1;
+    if (!store && !log)
+        return;
+
+    const qint64 timeStamp = message->timeStamp().toMSecsSinceEpoch();
+    const int flags = message->flags();
+    const QByteArray data = message->toData();
+    qint64 offset = -1;
+    if (log) {
+        // history playback repeats messages that may have been archived already
+        if (message->testFlag(IrcMessage::Playback)) {
+            const QByteArray id = IrcMessageArchive::messageId(data.constData(), data.size());
+            if (!id.isEmpty())
+                offset = log->findId(id);
+        }
+        if (offset == -1)
+            offset = log->append(timeStamp, flags, data);
+        if (log->hasPending())
+            IrcBufferModelPrivate::get(model)->scheduleArchiveFlush();
+    }
+    if (store)
+        store->append(timeStamp, flags, data, offset);
+    archiveOffset = offset;
+}
+
 bool IrcBufferPrivate::processMessage(IrcMessage* message)
 {
     Q_Q(IrcBuffer);
@@ -204,14 +277,16 @@ bool IrcBufferPrivate::processMessage(IrcMessage* message)
     default:
         break;
     }
-    if (processed)
+    if (processed) {
+        recordMessage(message);
         emit q->messageReceived(message);
+    }
     return processed;
 }
 
 bool IrcBufferPrivate::processAwayMessage(IrcAwayMessage* message)
 {
-    return !message->nick().compare(name, Qt::CaseInsensitive);
+    return nameTable().equals(message->nick(), name);
 }
 
 bool IrcBufferPrivate::processJoinMessage(IrcJoinMessage* message)
@@ -240,11 +315,12 @@ bool IrcBufferPrivate::processNamesMessage(IrcNamesMessage* message)
 
 bool IrcBufferPrivate::processNickMessage(IrcNickMessage* message)
 {
-    if (!message->testFlag(IrcMessage::Playback) && !message->nick().compare(name, Qt::CaseInsensitive)) {
+    const IrcNameTable& names = nameTable();
+    if (!message->testFlag(IrcMessage::Playback) && names.equals(message->nick(), name)) {
         setName(message->newNick());
         return true;
     }
-    return !message->newNick().compare(name, Qt::CaseInsensitive);
+    return names.equals(message->newNick(), name);
 }
 
 bool IrcBufferPrivate::processNoticeMessage(IrcNoticeMessage* message)
@@ -276,7 +352,7 @@ bool IrcBufferPrivate::processPrivateMessage(IrcPrivateMessage* message)
 
 bool IrcBufferPrivate::processQuitMessage(IrcQuitMessage* message)
 {
-    return !message->nick().compare(name, Qt::CaseInsensitive);
+    return nameTable().equals(message->nick(), name);
 }
 
 bool IrcBufferPrivate::processTopicMessage(IrcTopicMessage* message)
@@ -582,6 +658,36 @@ bool IrcBuffer::sendCommand(IrcCommand* command)
     return false;
 }
 
+/*!
+    \since 3.7
+
+    Loads up to \a count archived messages that are older than \a before,
+    or the most recent ones if \a before is not valid. The messages are
+    returned in chronological order, and the caller takes ownership.
+
+    Only the part of the archive file that contains the requested messages
+    is read.
+
+    \sa IrcBufferModel::archiveDirectory, IrcMessageModel::fetchMore()
+ */
+QList<IrcMessage*> IrcBuffer::loadMessages(int count, const QDateTime& before)
+{
+    Q_D(IrcBuffer);
+    QList<IrcMessage*> messages;
+    IrcMessageArchive* archive = d->messageArchive();
+    if (!archive)
+        return messages;
+
+    const qint64 offset = before.isValid() ? archive->find(before.toMSecsSinceEpoch()) : -1;
+    foreach (const IrcMessageArchive::Record& record, archive->read(offset, count)) {
+        IrcMessage* message = IrcMessage::fromData(record.data, connection());
+        message->setTimeStamp(QDateTime::fromMSecsSinceEpoch(record.timeStamp));
+        message->setFlags(IrcMessage::Flags(record.flags));
+        messages.append(message);
+    }
+    return messages;
+}
+
 /*!
     \since 3.7
 
@@ -604,8 +710,11 @@ IrcBuffer *IrcBuffer::clone(QObject *parent)
  */
 void IrcBuffer::receiveMessage(IrcMessage* message)
 {
-    if (message)
+    Q_D(IrcBuffer);
+    if (message) {
+        d->recordMessage(message);
         emit messageReceived(message);
+    }
 }
 
 /*!
@@ -30,7 +30,9 @@
 #include "ircbuffermodel_p.h"
 #include "ircchannel_p.h"
 #include "ircbuffer_p.h"
+#include "ircmessagearchive_p.h"
 #include "ircnetwork.h"
+#include "ircnetwork_p.h"
 #include "ircchannel.h"
 #include "ircmessage.h"
 #include "irccommand.h"
@@ -44,6 +46,9 @@
 
 IRC_BEGIN_NAMESPACE
 
+// how long archived messages may wait in memory before they are written
+static const int ARCHIVE_FLUSH_INTERVAL = 1000;
+
 /*!
     \file ircbuffermodel.h
     \brief \#include &lt;IrcBufferModel&gt;
@@ -127,6 +132,13 @@ private:
     Irc::SortMethod method;
 };
 
+// automatic monitoring and rejoins must not delay commands typed by the user
+static IrcCommand* lowPriority(IrcCommand* command)
+{
+    command->setPriority(IrcCommand::LowPriority);
+    return command;
+}
+
 static QHash<int, QByteArray> irc_buffer_model_roles()
 {
     QHash<int, QByteArray> roles;
@@ -146,6 +158,12 @@ IrcBufferModelPrivate::IrcBufferModelPrivate()
 bool IrcBufferModelPrivate::messageFilter(IrcMessage* msg)
 {
     Q_Q(IrcBufferModel);
+    userStore.update(msg);
+
+    // own messages that the client has already presented locally
+    if (msg->testFlag(IrcMessage::Echo))
+        return false;
+
     if (msg->type() == IrcMessage::Join && msg->isOwn())
         createBuffer(static_cast<IrcJoinMessage*>(msg)->channel());
 
@@ -216,7 +234,7 @@ bool IrcBufferModelPrivate::messageFilter(IrcMessage* msg)
             destroyBuffer(static_cast<IrcPartMessage*>(msg)->channel());
         } else if (msg->type() == IrcMessage::Kick) {
             const IrcKickMessage* kickMsg = static_cast<IrcKickMessage*>(msg);
-            if (!kickMsg->user().compare(msg->connection()->nickName(), Qt::CaseInsensitive))
+            if (nameTable().equals(kickMsg->user(), msg->connection()->nickName()))
                 destroyBuffer(kickMsg->channel());
         }
     }
@@ -226,7 +244,7 @@ bool IrcBufferModelPrivate::messageFilter(IrcMessage* msg)
 bool IrcBufferModelPrivate::commandFilter(IrcCommand* cmd)
 {
     if (cmd->type() == IrcCommand::Join) {
-        const QString channel = cmd->parameters().value(0).toLower();
+        const QString channel = nameTable().fold(cmd->parameters().value(0));
         const QString key = cmd->parameters().value(1);
         if (!key.isEmpty())
             keys.insert(channel, key);
@@ -281,7 +299,7 @@ IrcChannel* IrcBufferModelPrivate::createChannelHelper(const QString& title)
 IrcBuffer* IrcBufferModelPrivate::createBuffer(const QString& title)
 {
     Q_Q(IrcBufferModel);
-    IrcBuffer* buffer = bufferMap.value(title.toLower());
+    IrcBuffer* buffer = bufferMap.value(nameKey(title));
     if (!buffer) {
         if (connection && connection->network()->isChannel(title))
             buffer = createChannelHelper(title);
@@ -297,7 +315,7 @@ IrcBuffer* IrcBufferModelPrivate::createBuffer(const QString& title)
 
 void IrcBufferModelPrivate::destroyBuffer(const QString& title, bool force)
 {
-    IrcBuffer* buffer = bufferMap.value(title.toLower());
+    IrcBuffer* buffer = bufferMap.value(nameKey(title));
     if (buffer && (force || (!persistent && !buffer->isPersistent()))) {
         removeBuffer(buffer);
         buffer->deleteLater();
@@ -315,8 +333,8 @@ void IrcBufferModelPrivate::insertBuffer(int index, IrcBuffer* buffer, bool noti
     if (buffer && !bufferList.contains(buffer)) {
         restoreBuffer(buffer);
         const QString title = buffer->title();
-        const QString lower = title.toLower();
-        if (bufferMap.contains(lower)) {
+        const QString key = nameKey(title);
+        if (bufferMap.contains(key)) {
             qWarning() << "IrcBufferModel: ignored duplicate buffer" << title;
             return;
         }
@@ -336,12 +354,13 @@ void IrcBufferModelPrivate::insertBuffer(int index, IrcBuffer* buffer, bool noti
             emit q->aboutToBeAdded(buffer);
         q->beginInsertRows(QModelIndex(), index, index);
         bufferList.insert(index, buffer);
-        bufferMap.insert(lower, buffer);
+        bufferMap.insert(key, buffer);
         if (isChannel) {
             channels += title;
+            channelIndex.insert(key, buffer);
             IrcChannel* channel = buffer->toChannel();
-            if (keys.contains(lower) && channel->key().isEmpty())
-                IrcChannelPrivate::get(channel)->setKey(keys.take(lower));
+            if (keys.contains(key) && channel->key().isEmpty())
+                IrcChannelPrivate::get(channel)->setKey(keys.take(key));
         }
         q->connect(buffer, SIGNAL(destroyed(IrcBuffer*)), SLOT(_irc_bufferDestroyed(IrcBuffer*)));
         q->endInsertRows();
@@ -355,7 +374,7 @@ void IrcBufferModelPrivate::insertBuffer(int index, IrcBuffer* buffer, bool noti
                 emit q->emptyChanged(false);
         }
         if (monitorEnabled && IrcBufferPrivate::get(buffer)->isMonitorable()) {
-            connection->sendCommand(IrcCommand::createMonitor("+", buffer->title()));
+            connection->sendCommand(lowPriority(IrcCommand::createMonitor("+", buffer->title())));
             if (!monitorPending) {
                 monitorPending = true;
                 QTimer::singleShot(1000, q, SLOT(_irc_monitorStatus()));
@@ -370,16 +389,18 @@ void IrcBufferModelPrivate::removeBuffer(IrcBuffer* buffer, bool notify)
     int idx = bufferList.indexOf(buffer);
     if (idx != -1) {
         const QString title = buffer->title();
-        const QString lower = title.toLower();
         const bool isChannel = buffer->isChannel();
         if (notify)
             emit q->aboutToBeRemoved(buffer);
         q->beginRemoveRows(QModelIndex(), idx, idx);
         bufferList.removeAt(idx);
-        bufferMap.remove(lower);
-        bufferStates.remove(lower);
-        if (isChannel)
+        const QString key = nameKey(title);
+        bufferMap.remove(key);
+        bufferStates.remove(key);
+        if (isChannel) {
             channels.removeOne(title);
+            channelIndex.remove(key, buffer);
+        }
         q->endRemoveRows();
         if (notify) {
             emit q->removed(buffer);
@@ -391,20 +412,24 @@ void IrcBufferModelPrivate::removeBuffer(IrcBuffer* buffer, bool notify)
                 emit q->emptyChanged(true);
         }
         if (monitorEnabled && IrcBufferPrivate::get(buffer)->isMonitorable())
-            connection->sendCommand(IrcCommand::createMonitor("-", title));
+            connection->sendCommand(lowPriority(IrcCommand::createMonitor("-", title)));
     }
 }
 
 bool IrcBufferModelPrivate::renameBuffer(const QString& from, const QString& to)
 {
     Q_Q(IrcBufferModel);
-    const QString fromLower = from.toLower();
-    const QString toLower = to.toLower();
-    if (bufferMap.contains(toLower))
-        destroyBuffer(toLower, true);
-    if (bufferMap.contains(fromLower)) {
-        IrcBuffer* buffer = bufferMap.take(fromLower);
-        bufferMap.insert(toLower, buffer);
+    const QString fromKey = nameKey(from);
+    const QString toKey = nameKey(to);
+    if (fromKey != toKey && bufferMap.contains(toKey))
+        destroyBuffer(to, true);
+    if (bufferMap.contains(fromKey)) {
+        IrcBuffer* buffer = bufferMap.take(fromKey);
+        bufferMap.insert(toKey, buffer);
+        if (buffer->isChannel()) {
+            channelIndex.remove(fromKey, buffer);
+            channelIndex.insert(toKey, buffer);
+        }
 
         const int idx = bufferList.indexOf(buffer);
         QModelIndex index = q->index(idx);
@@ -436,7 +461,7 @@ void IrcBufferModelPrivate::promoteBuffer(IrcBuffer* buffer)
 
 void IrcBufferModelPrivate::restoreBuffer(IrcBuffer* buffer)
 {
-    const QVariantMap& b = bufferStates.value(buffer->title().toLower()).toMap();
+    const QVariantMap& b = bufferStates.value(nameKey(buffer->title())).toMap();
     if (!b.isEmpty()) {
         buffer->setSticky(b.value("sticky").toBool());
         buffer->setPersistent(b.value("persistent").toBool());
@@ -446,8 +471,10 @@ void IrcBufferModelPrivate::restoreBuffer(IrcBuffer* buffer)
             IrcChannelPrivate* p = IrcChannelPrivate::get(channel);
             const QStringList modes = b.value("modes").toStringList();
             const QStringList args = b.value("args").toStringList();
-            for (int i = 0; i < modes.count(); ++i)
-                p->modes.insert(modes.at(i), args.value(i));
+            for (int i = 0; i < modes.count(); ++i) {
+                if (!modes.at(i).isEmpty())
+                    p->insertMode(modes.at(i).at(0), args.value(i));
+            }
             p->enabled = b.value("enabled", true).toBool();
         }
     }
@@ -461,8 +488,8 @@ QVariantMap IrcBufferModelPrivate::saveBuffer(IrcBuffer* buffer) const
     b.insert("prefix", buffer->prefix());
     if (IrcChannel* channel = buffer->toChannel()) {
         IrcChannelPrivate* p = IrcChannelPrivate::get(channel);
-        b.insert("modes", QStringList(p->modes.keys()));
-        b.insert("args", QStringList(p->modes.values()));
+        b.insert("modes", p->modeLetters());
+        b.insert("args", p->modeArguments());
         b.insert("topic", channel->topic());
         b.insert("enabled", p->enabled);
     }
@@ -475,7 +502,7 @@ QVariantMap IrcBufferModelPrivate::saveBuffer(IrcBuffer* buffer) const
 
 bool IrcBufferModelPrivate::processMessage(const QString& title, IrcMessage* message, bool create)
 {
-    IrcBuffer* buffer = bufferMap.value(title.toLower());
+    IrcBuffer* buffer = bufferMap.value(nameKey(title));
     if (!buffer && create && title != QLatin1String("*"))
         buffer = createBuffer(title);
     if (buffer)
@@ -483,6 +510,29 @@ bool IrcBufferModelPrivate::processMessage(const QString& title, IrcMessage* mes
     return false;
 }
 
+QString IrcBufferModelPrivate::nameKey(const QString& name) const
+{
+    // re-key the buffers and their saved states when the connection is set or CASEMAPPING changes
+    const IrcNameTable& table = nameTable();
+    if (&table != keyTable || table.generation() != keyGeneration) {
+        keyTable = &table;
+        keyGeneration = table.generation();
+        bufferMap.clear();
+        channelIndex.clear();
+        foreach (IrcBuffer* buffer, bufferList) {
+            const QString key = table.key(buffer->title());
+            bufferMap.insert(key, buffer);
+            if (buffer->isChannel())
+                channelIndex.insert(key, buffer);
+        }
+        QVariantMap states;
+        foreach (const QVariant& state, bufferStates)
+            states.insert(table.key(state.toMap().value("title").toString()), state);
+        bufferStates = states;
+    }
+    return table.key(name);
+}
+
 void IrcBufferModelPrivate::_irc_connected()
 {
     foreach (IrcBuffer* buffer, bufferList)
@@ -498,7 +548,7 @@ void IrcBufferModelPrivate::_irc_initialized()
     bool monitored = false;
     foreach (IrcBuffer* buffer, bufferList) {
         if (monitorEnabled && IrcBufferPrivate::get(buffer)->isMonitorable()) {
-            connection->sendCommand(IrcCommand::createMonitor("+", buffer->title()));
+            connection->sendCommand(lowPriority(IrcCommand::createMonitor("+", buffer->title())));
             monitored = true;
         }
     }
@@ -520,10 +570,6 @@ void IrcBufferModelPrivate::_irc_bufferDestroyed(IrcBuffer* buffer)
     removeBuffer(buffer);
 }
 
-static bool sortIrcChannels_withKeysFirst(IrcChannel *ch1, IrcChannel *ch2) {
-    return ch1->key().length() > ch2->key().length();
-}
-
 void IrcBufferModelPrivate::_irc_restoreBuffers()
 {
     Q_Q(IrcBufferModel);
@@ -555,92 +601,45 @@ void IrcBufferModelPrivate::_irc_restoreBuffers()
             }
         }
 
-        // Join multiple channels:
-        //
-        // * A single IRC command may be 512 bytes long, including the <CR><LF> at the end.
-        //   Therefore, we must collect as many channels as many channels as possible into
-        //   a single command, but without exceeding the 512 bytes.
-        //   NOTES:
-        //       - Previously, communi tried to join all channels in a single command,
-        //         which didn't work because it exceeded the 512 bytes
-        //       - Then, it joined 3 channels at a time
-        //
-        // * We should also group channels with keys separately from channels without keys,
-        //   because the JOIN command doesn't work when channels without keys preceed the
-        //   channels with keys.
-        //   Works:
-        //       JOIN #ch1,#ch2             --- neither #ch1 nor #ch2 have keys
-        //       JOIN #ch1,#ch2 key1,key2   --- both #ch1 and #ch2 have keys
-        //       JOIN #ch1,#ch2 key1        --- #ch1 has key, #ch2 doesn't
-        //   Doesn't work:
-        //       JOIN #ch1,#ch2 ,key2       --- #ch1 doesn't have a key, #ch2 does
-        //                                      (NOTE: this is what communi used to do)
-        //
-
-        // Get channels from buffers
-        QList<IrcChannel*> filteredChannels;
-
+        // the connection packs the channels into as few JOIN lines as possible
+        QStringList chans, keys;
         foreach (IrcBuffer* buf, bufferList) {
-            IrcChannel *channel = buf->toChannel();
+            IrcChannel* channel = buf->toChannel();
             if (channel && !channel->isActive() && IrcChannelPrivate::get(channel)->enabled) {
-                filteredChannels.append(channel);
-            }
-        }
-
-        // Sort channels with keys first
-        std::sort(filteredChannels.begin(), filteredChannels.end(), sortIrcChannels_withKeysFirst);
-
-        if (filteredChannels.size()) {
-
-            // Length of "JOIN  \r\n"
-            const int joinCommandMinLength = 8;
-            const int maxIrcCommandBytes = 512;
-            int joinCommandLength = joinCommandMinLength;
-
-            QStringList chans, keys;
-            foreach (IrcChannel *channel, filteredChannels) {
-                int additonalLength = channel->title().length() + channel->key().length();
-                // Command needs a comma between channels
-                if (chans.length())
-                    additonalLength++;
-                // Command needs a comma between keys
-                if (keys.length() && channel->key().length())
-                    additonalLength++;
-
-                if ((joinCommandLength + additonalLength) > maxIrcCommandBytes) {
-                    // If the command size would exceed the maximum, send a command with the channels collected so far
-                    connection->sendCommand(IrcCommand::createJoin(chans, keys));
-
-                    chans.clear();
-                    keys.clear();
-                    joinCommandLength = joinCommandMinLength;
-                }
-
-                // Add channel to list
                 chans += channel->title();
-
-                // Only add key to list if there is a key,
-                // otherwise not needed, because channels with keys are sorted before channels without keys
-                if (channel->key().length())
-                    keys += channel->key();
-
-                joinCommandLength = additonalLength;
+                keys += channel->key();
             }
-
-            if (!chans.isEmpty()) {
-                connection->sendCommand(IrcCommand::createJoin(chans, keys));
-            }
-
         }
+        if (!chans.isEmpty())
+            connection->sendCommand(lowPriority(IrcCommand::createJoin(chans, keys)));
     }
 }
 
 void IrcBufferModelPrivate::_irc_monitorStatus()
 {
     if (monitorEnabled && connection)
-        connection->sendCommand(IrcCommand::createMonitor("S"));
+        connection->sendCommand(lowPriority(IrcCommand::createMonitor("S")));
     monitorPending = false;
 }
+
+void IrcBufferModelPrivate::_irc_flushArchives()
+{
+    archiveFlushPending = false;
+    foreach (IrcBuffer* buffer, bufferList) {
+        if (IrcMessageArchive* archive = IrcBufferPrivate::get(buffer)->archive)
+            archive->flush();
+    }
+}
+
+void IrcBufferModelPrivate::scheduleArchiveFlush()
+{
+    // archived messages are written in batches, off the delivery path
+    Q_Q(IrcBufferModel);
+    if (!archiveFlushPending) {
+        archiveFlushPending = true;
+        QTimer::singleShot(ARCHIVE_FLUSH_INTERVAL, q, SLOT(_irc_flushArchives()));
+    }
+}
 #endif // IRC_DOXYGEN
 
 /*!
@@ -675,6 +674,7 @@ IrcBufferModel::~IrcBufferModel()
     }
     d->bufferList.clear();
     d->bufferMap.clear();
+    d->channelIndex.clear();
     d->channels.clear();
     emit destroyed(this);
 }
@@ -703,6 +703,7 @@ void IrcBufferModel::setConnection(IrcConnection* connection)
             return;
         }
         d->connection = connection;
+        d->userStore.setNameTable(&d->nameTable());
         d->connection->installMessageFilter(d);
         d->connection->installCommandFilter(d);
         connect(d->connection, SIGNAL(connected()), this, SLOT(_irc_connected()));
@@ -802,7 +803,7 @@ IrcBuffer* IrcBufferModel::get(int index) const
 IrcBuffer* IrcBufferModel::find(const QString& title) const
 {
     Q_D(const IrcBufferModel);
-    return d->bufferMap.value(title.toLower());
+    return d->bufferMap.value(d->nameKey(title));
 }
 
 /*!
@@ -811,7 +812,7 @@ IrcBuffer* IrcBufferModel::find(const QString& title) const
 bool IrcBufferModel::contains(const QString& title) const
 {
     Q_D(const IrcBufferModel);
-    return d->bufferMap.contains(title.toLower());
+    return d->bufferMap.contains(d->nameKey(title));
 }
 
 /*!
@@ -1023,7 +1024,9 @@ void IrcBufferModel::clear()
                 buffer->disconnect(this);
                 d->bufferList.removeOne(buffer);
                 d->channels.removeOne(buffer->title());
-                d->bufferMap.remove(buffer->title().toLower());
+                const QString key = d->nameKey(buffer->title());
+                d->bufferMap.remove(key);
+                d->channelIndex.remove(key, buffer);
                 delete buffer;
             }
         }
@@ -1147,13 +1150,13 @@ bool IrcBufferModel::lessThan(IrcBuffer* one, IrcBuffer* another, Irc::SortMetho
     }
 
     if (method == Irc::SortByTitle) {
-        const QStringList prefixes = one->network()->channelTypes();
+        const IrcNetworkPrivate* network = IrcNetworkPrivate::get(one->network());
 
         const QString p1 = one->prefix();
         const QString p2 = another->prefix();
 
-        const int i1 = !p1.isEmpty() ? prefixes.indexOf(p1.at(0)) : -1;
-        const int i2 = !p2.isEmpty() ? prefixes.indexOf(p2.at(0)) : -1;
+        const int i1 = !p1.isEmpty() ? network->channelTypeIndex(p1.at(0)) : -1;
+        const int i2 = !p2.isEmpty() ? network->channelTypeIndex(p2.at(0)) : -1;
 
         if (i1 >= 0 && i2 < 0)
             return true;
@@ -1363,6 +1366,45 @@ void IrcBufferModel::setMonitorEnabled(bool enabled)
     }
 }
 
+/*!
+    \since 3.7
+    \property QString IrcBufferModel::archiveDirectory
+
+    This property holds the directory where buffer messages are archived.
+
+    When set, every message delivered to a buffer is appended to an
+    archive file in the directory, one file per buffer. Archived messages
+    can be paged back in with IrcBuffer::loadMessages() or
+    IrcMessageModel::fetchMore().
+
+    \note Use a separate directory for each connection.
+
+    The default value is an empty string, which disables archiving.
+
+    \par Access functions:
+    \li QString <b>archiveDirectory</b>() const
+    \li void <b>setArchiveDirectory</b>(const QString& directory)
+
+    \par Notifier signal:
+    \li void <b>archiveDirectoryChanged</b>(const QString& directory)
+ */
+QString IrcBufferModel::archiveDirectory() const
+{
+    Q_D(const IrcBufferModel);
+    return d->archiveDirectory;
+}
+
+void IrcBufferModel::setArchiveDirectory(const QString& directory)
+{
+    Q_D(IrcBufferModel);
+    if (d->archiveDirectory != directory) {
+        d->archiveDirectory = directory;
+        foreach (IrcBuffer* buffer, d->bufferList)
+            IrcBufferPrivate::get(buffer)->closeArchive();
+        emit archiveDirectoryChanged(directory);
+    }
+}
+
 /*!
     \since 3.1
 
@@ -1376,9 +1418,14 @@ QByteArray IrcBufferModel::saveState(int version) const
     QVariantMap args;
     args.insert("version", version);
 
-    QVariantMap states = d->bufferStates;
+    QVariantMap states;
     foreach (IrcBuffer* buffer, d->bufferList)
-        states.insert(buffer->title(), d->saveBuffer(buffer));
+        states.insert(d->nameKey(buffer->title()), d->saveBuffer(buffer));
+    // and the saved states of the buffers that have not been restored
+    for (QVariantMap::const_iterator it = d->bufferStates.constBegin(); it != d->bufferStates.constEnd(); ++it) {
+        if (!states.contains(it.key()))
+            states.insert(it.key(), it.value());
+    }
 
     QVariantList buffers;
     foreach (const QVariant& b, states)
@@ -1412,7 +1459,7 @@ bool IrcBufferModel::restoreState(const QByteArray& state, int version)
     const QVariantList buffers = args.value("buffers").toList();
     foreach (const QVariant& v, buffers) {
         const QVariantMap b = v.toMap();
-        d->bufferStates.insert(b.value("title").toString(), b);
+        d->bufferStates.insert(d->nameKey(b.value("title").toString()), b);
     }
 
     if (d->joinDelay >= 0 && d->connection && d->connection->isConnected())
@@ -34,9 +34,11 @@
 #include "ircbuffermodel_p.h"
 #include "ircconnection.h"
 #include "ircnetwork.h"
+#include "ircnetwork_p.h"
 #include "irccommand.h"
 #include "ircuser_p.h"
 #include "irc.h"
+#include <algorithm>
 
 IRC_BEGIN_NAMESPACE
 
@@ -54,36 +56,27 @@ IRC_BEGIN_NAMESPACE
 */
 
 #ifndef IRC_DOXYGEN
-static QString getPrefix(const QString& name, const QStringList& prefixes)
+static uint userModes(const QString& title, const IrcNetworkPrivate* network, int* length)
 {
+    uint modes = 0;
     int i = 0;
-    while (i < name.length() && prefixes.contains(name.at(i)))
-        ++i;
-    return name.left(i);
-}
-
-static QString getMode(IrcNetwork *network, const QString& prefix)
-{
-    QString mode;
-    foreach (const QString& p, prefix)
-        mode += network->prefixToMode(p);
-    return mode;
-}
-
-static QString channelName(const QString& title, const QStringList& prefixes)
-{
-    int i = 0;
-    while (i < title.length() && prefixes.contains(title.at(i)))
+    while (i < title.length()) {
+        const int idx = network->prefixIndex(title.at(i));
+        if (idx == -1)
+            break;
+        modes |= 1u << idx;
         ++i;
-    return title.mid(i);
+    }
+    if (length)
+        *length = i;
+    return modes;
 }
 
-static QString userName(const QString& name, const QStringList& prefixes)
+static inline int channelModeIndex(QChar mode)
 {
-    QString copy = name;
-    while (!copy.isEmpty() && prefixes.contains(copy.at(0)))
-        copy.remove(0, 1);
-    return Irc::nickFromPrefix(copy);
+    // A-Z, a-z and the few characters in between fit in 64 bits
+    const ushort c = mode.unicode();
+    return c >= 'A' && c <= 'z' ? c - 'A' : -1;
 }
 
 IrcChannelPrivate::IrcChannelPrivate()
@@ -100,9 +93,9 @@ void IrcChannelPrivate::init(const QString& title, IrcBufferModel* m)
 {
     IrcBufferPrivate::init(title, m);
 
-    const QStringList chanTypes = m->network()->channelTypes();
-    prefix = getPrefix(title, chanTypes);
-    name = channelName(title, chanTypes);
+    const int length = IrcNetworkPrivate::get(m->network())->channelPrefixLength(title);
+    prefix = title.left(length);
+    name = title.mid(length);
 }
 
 void IrcChannelPrivate::connected()
@@ -126,62 +119,83 @@ void IrcChannelPrivate::setActive(bool value)
 }
 
 void IrcChannelPrivate::changeModes(const QString& value, const QStringList& arguments)
+{
+    applyModes(value, arguments, modeBits, modeArgs);
+}
+
+void IrcChannelPrivate::setModes(const QString& value, const QStringList& arguments)
+{
+    applyModes(value, arguments, 0, QMap<QChar, QString>());
+}
+
+void IrcChannelPrivate::applyModes(const QString& value, const QStringList& arguments, quint64 bits, QMap<QChar, QString> args)
 {
     Q_Q(IrcChannel);
     const IrcNetwork* network = q->network();
+    const IrcNetworkPrivate* priv = network ? IrcNetworkPrivate::get(network) : nullptr;
 
-    QMap<QString, QString> ms = modes;
-    QStringList args = arguments;
-
+    int a = 0;
     bool add = true;
     for (int i = 0; i < value.size(); ++i) {
-        const QString m = value.at(i);
-        if (m == QLatin1String("+")) {
+        const QChar m = value.at(i);
+        if (m == QLatin1Char('+')) {
             add = true;
-        } else if (m == QLatin1String("-")) {
+        } else if (m == QLatin1Char('-')) {
             add = false;
         } else {
+            const int idx = channelModeIndex(m);
+            if (idx == -1)
+                continue;
             if (add) {
-                QString a;
-                if (!args.isEmpty() && network && network->channelModes(IrcNetwork::TypeB | IrcNetwork::TypeC).contains(m))
-                    a = args.takeFirst();
-                ms.insert(m, a);
+                QString arg;
+                if (a < arguments.count() && priv && priv->channelModeType(m) & (IrcNetwork::TypeB | IrcNetwork::TypeC))
+                    arg = arguments.at(a++);
+                bits |= Q_UINT64_C(1) << idx;
+                if (arg.isEmpty())
+                    args.remove(m);
+                else
+                    args.insert(m, arg);
             } else {
-                ms.remove(m);
+                bits &= ~(Q_UINT64_C(1) << idx);
+                args.remove(m);
             }
         }
     }
 
-    if (modes != ms) {
-        setKey(ms.value(QLatin1String("k")));
-        modes = ms;
+    if (modeBits != bits || modeArgs != args) {
+        setKey(args.value(QLatin1Char('k')));
+        modeBits = bits;
+        modeArgs = args;
         emit q->modeChanged(q->mode());
     }
 }
 
-void IrcChannelPrivate::setModes(const QString& value, const QStringList& arguments)
+void IrcChannelPrivate::insertMode(QChar mode, const QString& argument)
 {
-    Q_Q(IrcChannel);
-    const IrcNetwork* network = q->network();
-
-    QMap<QString, QString> ms;
-    QStringList args = arguments;
-
-    for (int i = 0; i < value.size(); ++i) {
-        const QString m = value.at(i);
-        if (m != QLatin1String("+") && m != QLatin1String("-")) {
-            QString a;
-            if (!args.isEmpty() && network && network->channelModes(IrcNetwork::TypeB | IrcNetwork::TypeC).contains(m))
-                a = args.takeFirst();
-            ms.insert(m, a);
-        }
+    const int idx = channelModeIndex(mode);
+    if (idx != -1) {
+        modeBits |= Q_UINT64_C(1) << idx;
+        if (!argument.isEmpty())
+            modeArgs.insert(mode, argument);
     }
+}
 
-    if (modes != ms) {
-        setKey(ms.value(QLatin1String("k")));
-        modes = ms;
-        emit q->modeChanged(q->mode());
+QStringList IrcChannelPrivate::modeLetters() const
+{
+    QStringList letters;
+    for (int i = 0; i < 64; ++i) {
+        if (modeBits & (Q_UINT64_C(1) << i))
+            letters += QChar(QLatin1Char('A').unicode() + i);
     }
+    return letters;
+}
+
+QStringList IrcChannelPrivate::modeArguments() const
+{
+    QStringList arguments;
+    foreach (const QString& letter, modeLetters())
+        arguments += modeArgs.value(letter.at(0));
+    return arguments;
 }
 
 void IrcChannelPrivate::setTopic(const QString& value)
@@ -196,27 +210,88 @@ void IrcChannelPrivate::setTopic(const QString& value)
 void IrcChannelPrivate::setKey(const QString& value)
 {
     Q_Q(IrcChannel);
-    if (modes.value(QLatin1String("k")) != value) {
-        modes.insert(QLatin1String("k"), value);
+    const QChar k = QLatin1Char('k');
+    if (modeArgs.value(k) != value) {
+        modeBits |= Q_UINT64_C(1) << channelModeIndex(k);
+        if (value.isEmpty())
+            modeArgs.remove(k);
+        else
+            modeArgs.insert(k, value);
         emit q->keyChanged(value);
     }
 }
 
-void IrcChannelPrivate::addUser(const QString& name)
+QString IrcChannelPrivate::nameKey(const QString& name) const
+{
+    // re-key the users when the channel is added to a model or CASEMAPPING changes
+    const IrcNameTable& table = nameTable();
+    if (&table != keyTable || table.generation() != keyGeneration) {
+        keyTable = &table;
+        keyGeneration = table.generation();
+        userMap.clear();
+        QVector<IrcNameIndex<IrcUser>::Entry> entries;
+        entries.reserve(userList.count());
+        foreach (IrcUser* user, userList) {
+            const QString key = table.key(user->name());
+            userMap.insert(key, user);
+            const IrcNameIndex<IrcUser>::Entry entry = { key, user };
+            entries += entry;
+        }
+        userIndex.assign(entries);
+    }
+    return table.key(name);
+}
+
+IrcUser* IrcChannelPrivate::findUser(const QString& name) const
 {
-    Q_Q(IrcChannel);
-    const QStringList prefixes = q->network()->prefixes();
+    return userMap.value(nameKey(name));
+}
+
+void IrcChannelPrivate::indexUser(IrcUser* user)
+{
+    const QString name = user->name();
+    const QString key = nameKey(name);
+    userMap.insert(key, user);
+    userIndex.insert(key, user);
+    names.insert(std::lower_bound(names.begin(), names.end(), name), name);
+}
 
+void IrcChannelPrivate::unindexUser(IrcUser* user, const QString& name)
+{
+    const QString key = nameKey(name);
+    if (userMap.value(key) == user)
+        userMap.remove(key);
+    userIndex.remove(key, user);
+    QStringList::iterator it = std::lower_bound(names.begin(), names.end(), name);
+    if (it != names.end() && *it == name)
+        names.erase(it);
+}
+
+IrcUser* IrcChannelPrivate::createUser(const QString& name, uint modes)
+{
+    Q_Q(IrcChannel);
     IrcUser* user = new IrcUser(q);
     IrcUserPrivate* priv = IrcUserPrivate::get(user);
     priv->channel = q;
-    priv->setName(userName(name, prefixes));
-    priv->setPrefix(getPrefix(name, prefixes));
-    priv->setMode(getMode(q->network(), user->prefix()));
+    if (model)
+        priv->setIdentity(IrcBufferModelPrivate::get(model)->userStore.identity(name));
+    else
+        priv->setName(name);
+    priv->setModes(modes);
+    return user;
+}
+
+void IrcChannelPrivate::addUser(const QString& title)
+{
+    Q_Q(IrcChannel);
+    int length = 0;
+    const uint modes = userModes(title, IrcNetworkPrivate::get(q->network()), &length);
+
+    IrcUser* user = createUser(Irc::nickFromPrefix(title.mid(length)), modes);
+    IrcUserPrivate::get(user)->activity = ++mostActive;
     activeUsers.prepend(user);
     userList.append(user);
-    userMap.insert(user->name(), user);
-    names = userMap.keys();
+    indexUser(user);
 
     foreach (IrcUserModel* model, userModels)
         IrcUserModelPrivate::get(model)->addUser(user);
@@ -224,9 +299,8 @@ void IrcChannelPrivate::addUser(const QString& name)
 
 bool IrcChannelPrivate::removeUser(const QString& name)
 {
-    if (IrcUser* user = userMap.value(name)) {
-        userMap.remove(name);
-        names = userMap.keys();
+    if (IrcUser* user = findUser(name)) {
+        unindexUser(user, user->name());
         userList.removeOne(user);
         activeUsers.removeOne(user);
         foreach (IrcUserModel* model, userModels)
@@ -240,36 +314,81 @@ bool IrcChannelPrivate::removeUser(const QString& name)
 void IrcChannelPrivate::setUsers(const QStringList& users)
 {
     Q_Q(IrcChannel);
-    const QStringList prefixes = q->network()->prefixes();
-
-    qDeleteAll(userList);
-    userMap.clear();
-    userList.clear();
-    activeUsers.clear();
+    const IrcNetworkPrivate* network = IrcNetworkPrivate::get(q->network());
+
+    QHash<QString, IrcUser*> map;
+    QList<IrcUser*> list;
+    QList<IrcUser*> added;
+    QList<IrcUser*> changed;
+
+    foreach (const QString& title, users) {
+        int length = 0;
+        const uint modes = userModes(title, network, &length);
+        const QString name = Irc::nickFromPrefix(title.mid(length));
+        const QString key = nameKey(name);
+        if (map.contains(key))
+            continue;
+
+        IrcUser* user = userMap.take(key);
+        if (user) {
+            IrcUserPrivate* priv = IrcUserPrivate::get(user);
+            if (priv->modes != modes) {
+                priv->setModes(modes);
+                changed.append(user);
+            }
+        } else {
+            user = createUser(name, modes);
+            IrcUserPrivate::get(user)->activity = --leastActive;
+            added.append(user);
+        }
+        list.append(user);
+        map.insert(key, user);
+    }
 
-    foreach (const QString& name, users) {
-        IrcUser* user = new IrcUser(q);
-        IrcUserPrivate* priv = IrcUserPrivate::get(user);
-        priv->channel = q;
-        priv->setName(userName(name, prefixes));
-        priv->setPrefix(getPrefix(name, prefixes));
-        priv->setMode(getMode(q->network(), user->prefix()));
-        activeUsers.append(user);
-        userList.append(user);
-        userMap.insert(user->name(), user);
+    // whatever is left in the old map did not appear in the names reply
+    const QList<IrcUser*> removed = userMap.values();
+    if (!removed.isEmpty()) {
+        QList<IrcUser*> active;
+        active.reserve(activeUsers.count());
+        foreach (IrcUser* user, activeUsers) {
+            if (map.value(nameKey(user->name())) == user)
+                active.append(user);
+        }
+        activeUsers = active;
+    }
+    activeUsers += added;
+
+    userMap = map;
+    userList = list;
+    names.clear();
+    QVector<IrcNameIndex<IrcUser>::Entry> entries;
+    entries.reserve(userList.count());
+    foreach (IrcUser* user, userList) {
+        names += user->name();
+        const IrcNameIndex<IrcUser>::Entry entry = { nameKey(user->name()), user };
+        entries += entry;
+    }
+    std::sort(names.begin(), names.end());
+    userIndex.assign(entries);
+
+    foreach (IrcUserModel* model, userModels) {
+        IrcUserModelPrivate* priv = IrcUserModelPrivate::get(model);
+        if (priv->userList.isEmpty())
+            priv->setUsers(userList);
+        else
+            priv->syncUsers(removed, added, changed);
     }
-    names = userMap.keys();
 
-    foreach (IrcUserModel* model, userModels)
-        IrcUserModelPrivate::get(model)->setUsers(userList);
+    qDeleteAll(removed);
 }
 
 bool IrcChannelPrivate::renameUser(const QString& from, const QString& to)
 {
-    if (IrcUser* user = userMap.take(from)) {
+    if (IrcUser* user = findUser(from)) {
+        // the identity may be shared with other channels and already renamed
+        unindexUser(user, from);
         IrcUserPrivate::get(user)->setName(to);
-        userMap.insert(to, user);
-        names = userMap.keys();
+        indexUser(user);
 
         foreach (IrcUserModel* model, userModels) {
             IrcUserModelPrivate::get(model)->renameUser(user);
@@ -280,47 +399,43 @@ bool IrcChannelPrivate::renameUser(const QString& from, const QString& to)
     return false;
 }
 
-void IrcChannelPrivate::setUserMode(const QString& name, const QString& command)
+void IrcChannelPrivate::changeUserModes(const QString& value, const QStringList& arguments)
 {
-    if (IrcUser* user = userMap.value(name)) {
-        bool add = true;
-        QString mode = user->mode();
-        QString prefix = user->prefix();
-        const IrcNetwork* network = model->network();
-        for (int i = 0; i < command.size(); ++i) {
-            QChar c = command.at(i);
-            if (c == QLatin1Char('+')) {
-                add = true;
-            } else if (c == QLatin1Char('-')) {
-                add = false;
-            } else {
-                QString p = network->modeToPrefix(c);
-                if (add) {
-                    if (!mode.contains(c))
-                        mode += c;
-                    if (!prefix.contains(p))
-                        prefix += p;
-                } else {
-                    mode.remove(c);
-                    prefix.remove(p);
+    Q_Q(IrcChannel);
+    const IrcNetworkPrivate* network = IrcNetworkPrivate::get(q->network());
+
+    int a = 0;
+    bool add = true;
+    for (int i = 0; i < value.size(); ++i) {
+        const QChar c = value.at(i);
+        if (c == QLatin1Char('+')) {
+            add = true;
+        } else if (c == QLatin1Char('-')) {
+            add = false;
+        } else {
+            const int idx = network->modeIndex(c);
+            if (idx != -1) {
+                // each user mode letter is paired with its own argument (+vvv a b c)
+                const QString name = arguments.value(a++);
+                if (IrcUser* user = findUser(name)) {
+                    const uint modes = IrcUserPrivate::get(user)->modes;
+                    setUserModes(user, add ? modes | (1u << idx) : modes & ~(1u << idx));
                 }
+            } else {
+                // keep the remaining arguments aligned
+                const IrcNetwork::ModeTypes type = network->channelModeType(c);
+                if (type & (IrcNetwork::TypeA | IrcNetwork::TypeB) || (add && type & IrcNetwork::TypeC))
+                    ++a;
             }
         }
+    }
+}
 
-        QString sortedMode;
-        foreach (const QString& m, network->modes())
-            if (mode.contains(m))
-                sortedMode += m;
-
-        QString sortedPrefix;
-        foreach (const QString& p, network->prefixes())
-            if (prefix.contains(p))
-                sortedPrefix += p;
-
-        IrcUserPrivate* priv = IrcUserPrivate::get(user);
-        priv->setPrefix(sortedPrefix);
-        priv->setMode(sortedMode);
-
+void IrcChannelPrivate::setUserModes(IrcUser* user, uint modes)
+{
+    IrcUserPrivate* priv = IrcUserPrivate::get(user);
+    if (priv->modes != modes) {
+        priv->setModes(modes);
         foreach (IrcUserModel* model, userModels)
             IrcUserModelPrivate::get(model)->setUserMode(user);
     }
@@ -328,10 +443,11 @@ void IrcChannelPrivate::setUserMode(const QString& name, const QString& command)
 
 void IrcChannelPrivate::promoteUser(const QString& name)
 {
-    if (IrcUser* user = userMap.value(name)) {
+    if (IrcUser* user = findUser(name)) {
         const int idx = activeUsers.indexOf(user);
         Q_ASSERT(idx != -1);
         activeUsers.move(idx, 0);
+        IrcUserPrivate::get(user)->activity = ++mostActive;
         foreach (IrcUserModel* model, userModels)
             IrcUserModelPrivate::get(model)->promoteUser(user);
     }
@@ -339,7 +455,7 @@ void IrcChannelPrivate::promoteUser(const QString& name)
 
 bool IrcChannelPrivate::setUserAway(const QString& name, bool away)
 {
-    if (IrcUser* user = userMap.value(name)) {
+    if (IrcUser* user = findUser(name)) {
         IrcUserPrivate* priv = IrcUserPrivate::get(user);
         priv->setAway(away);
         foreach (IrcUserModel* model, userModels)
@@ -351,7 +467,7 @@ bool IrcChannelPrivate::setUserAway(const QString& name, bool away)
 
 void IrcChannelPrivate::setUserServOp(const QString& name, bool servOp)
 {
-    if (IrcUser* user = userMap.value(name)) {
+    if (IrcUser* user = findUser(name)) {
         IrcUserPrivate* priv = IrcUserPrivate::get(user);
         priv->setServOp(servOp);
         foreach (IrcUserModel* model, userModels)
@@ -381,14 +497,14 @@ bool IrcChannelPrivate::processJoinMessage(IrcJoinMessage* message)
 bool IrcChannelPrivate::processKickMessage(IrcKickMessage* message)
 {
     if (!message->testFlag(IrcMessage::Playback)) {
-        if (!message->user().compare(message->connection()->nickName(), Qt::CaseInsensitive)) {
+        if (nameTable().equals(message->user(), message->connection()->nickName())) {
             setActive(false);
             enabled = false;
             return true;
         }
         return removeUser(message->user());
     }
-    return userMap.contains(message->user());
+    return findUser(message->user());
 }
 
 bool IrcChannelPrivate::processModeMessage(IrcModeMessage* message)
@@ -400,8 +516,8 @@ bool IrcChannelPrivate::processModeMessage(IrcModeMessage* message)
             else
                 changeModes(message->mode(), message->arguments());
             return true;
-        } else if (!message->argument().isEmpty()) {
-            setUserMode(message->argument(), message->mode());
+        } else {
+            changeUserModes(message->mode(), message->arguments());
         }
     }
     return true;
@@ -450,7 +566,7 @@ bool IrcChannelPrivate::processPartMessage(IrcPartMessage* message)
 bool IrcChannelPrivate::processPrivateMessage(IrcPrivateMessage* message)
 {
     const QString content = message->content();
-    const bool prefixed = !content.isEmpty() && message->network()->prefixes().contains(content.at(0));
+    const bool prefixed = !content.isEmpty() && IrcNetworkPrivate::get(message->network())->prefixIndex(content.at(0)) != -1;
     foreach (IrcUser* user, activeUsers) {
         const QString str = prefixed ? user->title() : user->name();
         if (content.startsWith(str)) {
@@ -471,7 +587,7 @@ bool IrcChannelPrivate::processQuitMessage(IrcQuitMessage* message)
         }
         return removeUser(message->nick()) || IrcBufferPrivate::processQuitMessage(message);
     }
-    return userMap.contains(message->nick()) || IrcBufferPrivate::processQuitMessage(message);
+    return findUser(message->nick()) || IrcBufferPrivate::processQuitMessage(message);
 }
 
 bool IrcChannelPrivate::processTopicMessage(IrcTopicMessage* message)
@@ -510,6 +626,7 @@ IrcChannel::~IrcChannel()
     qDeleteAll(d->userList);
     d->userList.clear();
     d->userMap.clear();
+    d->userIndex.clear();
     d->names.clear();
     d->userModels.clear();
     emit destroyed(this);
@@ -529,7 +646,7 @@ IrcChannel::~IrcChannel()
 QString IrcChannel::key() const
 {
     Q_D(const IrcChannel);
-    return d->modes.value(QLatin1String("k"));
+    return d->modeArgs.value(QLatin1Char('k'));
 }
 
 /*!
@@ -544,9 +661,14 @@ QString IrcChannel::key() const
 QString IrcChannel::mode() const
 {
     Q_D(const IrcChannel);
-    QString m = QStringList(d->modes.keys()).join(QString());
-    QStringList a = d->modes.values();
-    a.removeAll(QString());
+    const QStringList letters = d->modeLetters();
+    QString m = letters.join(QString());
+    QStringList a;
+    foreach (const QString& letter, letters) {
+        const QString arg = d->modeArgs.value(letter.at(0));
+        if (!arg.isEmpty())
+            a += arg;
+    }
     if (!a.isEmpty())
         m += QLatin1String(" ") + a.join(QLatin1String(" "));
     if (!m.isEmpty())
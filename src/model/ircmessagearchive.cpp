@@ -0,0 +1,482 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ircmessagearchive_p.h"
+#include <qendian.h>
+#include <qdebug.h>
+
+IRC_BEGIN_NAMESPACE
+
+#ifndef IRC_DOXYGEN
+static const char irc_archive_magic[] = "COMMUNI\x01";
+
+static quint64 irc_archive_hash(const QByteArray& id)
+{
+    // 64-bit FNV-1a
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < id.size(); ++i) {
+        hash ^= uchar(id.at(i));
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+IrcMessageArchive::IrcMessageArchive(const QString& fileName) : file(fileName)
+{
+}
+
+IrcMessageArchive::~IrcMessageArchive()
+{
+    close();
+}
+
+bool IrcMessageArchive::open()
+{
+    if (file.isOpen())
+        return true;
+
+    if (!file.open(QIODevice::ReadWrite))
+        return false;
+
+    if (!file.size()) {
+        file.write(irc_archive_magic, HeaderSize);
+    } else if (file.read(HeaderSize) != QByteArray(irc_archive_magic, HeaderSize)) {
+        qWarning() << "IrcMessageArchive: unknown file format" << file.fileName();
+        file.close();
+        return false;
+    }
+
+    indexFile.setFileName(file.fileName() + QLatin1String(".idx"));
+    idFile.setFileName(file.fileName() + QLatin1String(".ids"));
+    if (!indexFile.open(QIODevice::ReadWrite) || !recover() ||
+            !idFile.open(QIODevice::ReadWrite) || !recoverIds() || !flush()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void IrcMessageArchive::close()
+{
+    if (file.isOpen())
+        flush();
+    file.close();
+    indexFile.close();
+    idFile.close();
+    pending.clear();
+    pendingIndex.clear();
+    pendingIds.clear();
+    checkpoints.clear();
+    recentOrder.clear();
+    recentIds.clear();
+    recentLoaded = false;
+    records = 0;
+    end = 0;
+}
+
+bool IrcMessageArchive::isOpen() const
+{
+    return file.isOpen();
+}
+
+qint64 IrcMessageArchive::count() const
+{
+    return records;
+}
+
+qint64 IrcMessageArchive::size() const
+{
+    return end;
+}
+
+qint64 IrcMessageArchive::append(qint64 timeStamp, int flags, const QByteArray& data)
+{
+    if (!file.isOpen())
+        return -1;
+
+    uchar header[RecordHeaderSize];
+    qToLittleEndian<qint64>(timeStamp, header);
+    qToLittleEndian<qint32>(flags, header + 8);
+    qToLittleEndian<quint32>(data.size(), header + 12);
+
+    pending.append(reinterpret_cast<const char*>(header), RecordHeaderSize);
+    pending.append(data);
+
+    const qint64 offset = end;
+    if (records % CheckpointInterval == 0)
+        addCheckpoint(offset, timeStamp);
+    addId(offset, data.constData(), data.size());
+    end += RecordHeaderSize + data.size();
+    ++records;
+
+    if (pending.size() >= WriteBufferSize && !flush())
+        return -1;
+    return offset;
+}
+
+QList<IrcMessageArchive::Record> IrcMessageArchive::read(qint64 before, int count)
+{
+    QList<Record> result;
+    if (!file.isOpen() || count <= 0)
+        return result;
+    count = int(qMin<qint64>(count, records));
+
+    if (before < 0 || before > end)
+        before = end;
+
+    int k = checkpointBefore(before);
+    if (k < 0)
+        return result;
+
+    // every segment but the last holds exactly CheckpointInterval records
+    k = qMax(0, k - (count + CheckpointInterval - 1) / CheckpointInterval);
+    const qint64 start = checkpoints.at(k).offset;
+    const qint64 length = before - start;
+
+    if (!flush())
+        return result;
+    uchar* data = file.map(start, length);
+    if (!data)
+        return result;
+
+    QVector<qint64> positions;
+    qint64 pos = 0;
+    while (pos + RecordHeaderSize <= length) {
+        const qint64 next = pos + RecordHeaderSize + qFromLittleEndian<quint32>(data + pos + 12);
+        if (next > length)
+            break;
+        positions.append(pos);
+        pos = next;
+    }
+
+    for (int i = qMax(0, positions.count() - count); i < positions.count(); ++i) {
+        const uchar* p = data + positions.at(i);
+        Record record;
+        record.offset = start + positions.at(i);
+        record.timeStamp = qFromLittleEndian<qint64>(p);
+        record.flags = qFromLittleEndian<qint32>(p + 8);
+        record.data = QByteArray(reinterpret_cast<const char*>(p + RecordHeaderSize), qFromLittleEndian<quint32>(p + 12));
+        result.append(record);
+    }
+
+    file.unmap(data);
+    return result;
+}
+
+qint64 IrcMessageArchive::find(qint64 timeStamp)
+{
+    if (!file.isOpen() || checkpoints.isEmpty())
+        return end;
+
+    // timestamps are expected to be (mostly) ascending
+    int lo = 0;
+    int hi = checkpoints.count();
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (checkpoints.at(mid).timeStamp < timeStamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const int k = qMax(0, lo - 1);
+    const qint64 start = checkpoints.at(k).offset;
+    const qint64 stop = k + 1 < checkpoints.count() ? checkpoints.at(k + 1).offset : end;
+    if (start >= stop || !flush())
+        return stop;
+
+    uchar* data = file.map(start, stop - start);
+    if (!data)
+        return stop;
+
+    qint64 pos = 0;
+    while (pos + RecordHeaderSize <= stop - start && qFromLittleEndian<qint64>(data + pos) < timeStamp)
+        pos += RecordHeaderSize + qFromLittleEndian<quint32>(data + pos + 12);
+
+    file.unmap(data);
+    return qMin(start + pos, stop);
+}
+
+qint64 IrcMessageArchive::findId(const QByteArray& id)
+{
+    if (!file.isOpen() || id.isEmpty())
+        return -1;
+
+    // the index file is read once, later records are added as they are
+    // appended, so that lookups during playback never touch the disk
+    if (!recentLoaded)
+        loadRecentIds();
+
+    // msgids are unique per network, a 64-bit hash collision is unlikely enough
+    return recentIds.value(irc_archive_hash(id), -1);
+}
+
+bool IrcMessageArchive::hasPending() const
+{
+    return !pending.isEmpty() || !pendingIndex.isEmpty() || !pendingIds.isEmpty();
+}
+
+bool IrcMessageArchive::flush()
+{
+    if (!file.isOpen())
+        return false;
+    if (!hasPending())
+        return true;
+
+    // the records go first, so that the indexes never point past them
+    if (file.write(pending) != pending.size() || !file.flush()) {
+        qWarning() << "IrcMessageArchive: write failed" << file.fileName() << file.errorString();
+        pending.clear();
+        pendingIndex.clear();
+        pendingIds.clear();
+        close();
+        return false;
+    }
+    pending.clear();
+
+    uchar through[IdHeaderSize];
+    qToLittleEndian<qint64>(end, through);
+    if (indexFile.write(pendingIndex) != pendingIndex.size() || !indexFile.flush() ||
+            idFile.write(pendingIds) != pendingIds.size() ||
+            !idFile.seek(0) || idFile.write(reinterpret_cast<const char*>(through), IdHeaderSize) != IdHeaderSize ||
+            !idFile.seek(idFile.size()) || !idFile.flush()) {
+        qWarning() << "IrcMessageArchive: index write failed" << file.fileName();
+        pendingIndex.clear();
+        pendingIds.clear();
+        close();
+        return false;
+    }
+    pendingIndex.clear();
+    pendingIds.clear();
+    return true;
+}
+
+// the raw value of the msgid tag of a line, if any
+QByteArray IrcMessageArchive::messageId(const char* data, int size)
+{
+    if (size <= 0 || data[0] != '@')
+        return QByteArray();
+
+    int end = 1;
+    while (end < size && data[end] != ' ')
+        ++end;
+    int pos = 1;
+    while (pos < end) {
+        int next = pos;
+        while (next < end && data[next] != ';')
+            ++next;
+        if (next - pos > 6 && !qstrncmp(data + pos, "msgid=", 6))
+            return QByteArray(data + pos + 6, next - pos - 6);
+        pos = next + 1;
+    }
+    return QByteArray();
+}
+
+bool IrcMessageArchive::recover()
+{
+    const qint64 fileSize = file.size();
+
+    // keep the consistent part of the index
+    const QByteArray index = indexFile.readAll();
+    const uchar* p = reinterpret_cast<const uchar*>(index.constData());
+    for (int i = 0; i + CheckpointSize <= index.size(); i += CheckpointSize) {
+        Checkpoint cp;
+        cp.offset = qFromLittleEndian<qint64>(p + i);
+        cp.timeStamp = qFromLittleEndian<qint64>(p + i + 8);
+        const qint64 min = checkpoints.isEmpty() ? HeaderSize : checkpoints.last().offset + RecordHeaderSize;
+        if (cp.offset < min || cp.offset >= fileSize || (checkpoints.isEmpty() && cp.offset != HeaderSize))
+            break;
+        checkpoints.append(cp);
+    }
+    const qint64 indexSize = qint64(checkpoints.count()) * CheckpointSize;
+    if (indexSize != index.size() && !indexFile.resize(indexSize))
+        return false;
+    if (!indexFile.seek(indexSize))
+        return false;
+
+    // re-index the records written after the last checkpoint
+    qint64 offset = checkpoints.isEmpty() ? HeaderSize : checkpoints.last().offset;
+    records = checkpoints.isEmpty() ? 0 : qint64(checkpoints.count() - 1) * CheckpointInterval;
+    const qint64 tail = fileSize - offset;
+    if (tail > 0) {
+        uchar* data = file.map(offset, tail);
+        if (!data)
+            return false;
+        qint64 pos = 0;
+        while (pos + RecordHeaderSize <= tail) {
+            const qint64 next = pos + RecordHeaderSize + qFromLittleEndian<quint32>(data + pos + 12);
+            if (next > tail)
+                break;
+            if (records % CheckpointInterval == 0 && records / CheckpointInterval >= checkpoints.count())
+                addCheckpoint(offset + pos, qFromLittleEndian<qint64>(data + pos));
+            ++records;
+            pos = next;
+        }
+        file.unmap(data);
+        offset += pos;
+    }
+    end = offset;
+
+    // drop a partially written record
+    if (end < fileSize && !file.resize(end))
+        return false;
+    return file.seek(end);
+}
+
+bool IrcMessageArchive::recoverIds()
+{
+    // the header tells up to which offset the records have been indexed
+    qint64 through = HeaderSize;
+    if (idFile.size() < IdHeaderSize) {
+        uchar header[IdHeaderSize];
+        qToLittleEndian<qint64>(through, header);
+        if (!idFile.resize(0) || idFile.write(reinterpret_cast<const char*>(header), IdHeaderSize) != IdHeaderSize)
+            return false;
+    } else {
+        const QByteArray header = idFile.read(IdHeaderSize);
+        if (header.size() != IdHeaderSize)
+            return false;
+        through = qBound<qint64>(HeaderSize, qFromLittleEndian<qint64>(reinterpret_cast<const uchar*>(header.constData())), end);
+    }
+
+    // drop the entries of records that were not completely indexed
+    qint64 count = qMax<qint64>(0, (idFile.size() - IdHeaderSize) / IdSize);
+    while (count > 0) {
+        if (!idFile.seek(IdHeaderSize + (count - 1) * IdSize))
+            return false;
+        const QByteArray entry = idFile.read(IdSize);
+        if (entry.size() != IdSize)
+            return false;
+        if (qFromLittleEndian<qint64>(reinterpret_cast<const uchar*>(entry.constData()) + 8) < through)
+            break;
+        --count;
+    }
+    const qint64 size = IdHeaderSize + count * IdSize;
+    if (idFile.size() != size && !idFile.resize(size))
+        return false;
+    if (!idFile.seek(size))
+        return false;
+
+    // re-index the records written after that, flush() updates the header
+    const qint64 tail = end - through;
+    if (tail > 0) {
+        uchar* data = file.map(through, tail);
+        if (!data)
+            return false;
+        qint64 pos = 0;
+        while (pos + RecordHeaderSize <= tail) {
+            const quint32 length = qFromLittleEndian<quint32>(data + pos + 12);
+            addId(through + pos, reinterpret_cast<const char*>(data + pos + RecordHeaderSize), length);
+            pos += RecordHeaderSize + length;
+        }
+        file.unmap(data);
+    }
+    return true;
+}
+
+int IrcMessageArchive::checkpointBefore(qint64 offset) const
+{
+    int lo = 0;
+    int hi = checkpoints.count();
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (checkpoints.at(mid).offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
+
+void IrcMessageArchive::addCheckpoint(qint64 offset, qint64 timeStamp)
+{
+    Checkpoint cp;
+    cp.offset = offset;
+    cp.timeStamp = timeStamp;
+    checkpoints.append(cp);
+
+    uchar buffer[CheckpointSize];
+    qToLittleEndian<qint64>(offset, buffer);
+    qToLittleEndian<qint64>(timeStamp, buffer + 8);
+    pendingIndex.append(reinterpret_cast<const char*>(buffer), CheckpointSize);
+}
+
+void IrcMessageArchive::addId(qint64 offset, const char* data, int size)
+{
+    const QByteArray id = messageId(data, size);
+    if (id.isEmpty())
+        return;
+
+    const quint64 hash = irc_archive_hash(id);
+    uchar buffer[IdSize];
+    qToLittleEndian<quint64>(hash, buffer);
+    qToLittleEndian<qint64>(offset, buffer + 8);
+    pendingIds.append(reinterpret_cast<const char*>(buffer), IdSize);
+    if (recentLoaded)
+        addRecentId(hash, offset);
+}
+
+void IrcMessageArchive::addRecentId(quint64 hash, qint64 offset)
+{
+    RecentId recent;
+    recent.hash = hash;
+    recent.offset = offset;
+    recentOrder.enqueue(recent);
+    recentIds.insert(hash, offset);
+
+    // forget the oldest one, unless the same id was recorded again since
+    while (recentOrder.count() > RecentIds) {
+        const RecentId oldest = recentOrder.dequeue();
+        QHash<quint64, qint64>::iterator it = recentIds.find(oldest.hash);
+        if (it != recentIds.end() && it.value() == oldest.offset)
+            recentIds.erase(it);
+    }
+}
+
+void IrcMessageArchive::loadRecentIds()
+{
+    recentLoaded = true;
+
+    // the written entries, followed by the pending ones
+    const qint64 count = qMax<qint64>(0, (idFile.size() - IdHeaderSize) / IdSize);
+    const qint64 first = qMax<qint64>(0, count - RecentIds);
+    if (count > first) {
+        uchar* ids = idFile.map(IdHeaderSize + first * IdSize, (count - first) * IdSize);
+        if (ids) {
+            for (qint64 i = 0; i < count - first; ++i)
+                addRecentId(qFromLittleEndian<quint64>(ids + i * IdSize), qFromLittleEndian<qint64>(ids + i * IdSize + 8));
+            idFile.unmap(ids);
+        }
+    }
+    const uchar* pendingData = reinterpret_cast<const uchar*>(pendingIds.constData());
+    for (int i = 0; i + IdSize <= pendingIds.size(); i += IdSize)
+        addRecentId(qFromLittleEndian<quint64>(pendingData + i), qFromLittleEndian<qint64>(pendingData + i + 8));
+}
+#endif // IRC_DOXYGEN
+
+IRC_END_NAMESPACE
@@ -0,0 +1,564 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ircmessagemodel.h"
+#include "ircmessagemodel_p.h"
+#include "ircbuffer.h"
+#include "ircbuffer_p.h"
+#include "ircmessage.h"
+#include <qdatetime.h>
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file ircmessagemodel.h
+    \brief \#include &lt;IrcMessageModel&gt;
+ */
+
+/*!
+    \since 3.7
+    \class IrcMessageModel ircmessagemodel.h <IrcMessageModel>
+    \ingroup models
+    \brief Keeps track of buffer messages.
+
+    IrcMessageModel presents the scrollback of an IrcBuffer. Messages are
+    kept by the buffer in their raw wire format together with a timestamp,
+    and are parsed and formatted only when a view asks for the data of a
+    visible row. The most recently decoded rows are cached.
+
+    All models assigned to the same buffer share the same history. The
+    buffer keeps as many messages as the most generous model allows, see
+    \ref lineLimit and \ref byteLimit.
+
+    \code
+    void ChatView::setBuffer(IrcBuffer* buffer)
+    {
+        IrcMessageModel* model = new IrcMessageModel(buffer);
+        model->setLineLimit(5000);
+        messageListView->setModel(model);
+    }
+    \endcode
+
+    \sa IrcBuffer::messageReceived()
+*/
+
+/*!
+    \fn void IrcMessageModel::countChanged(int count)
+
+    This signal is emitted when the \a count of messages changes.
+ */
+
+/*!
+    \fn void IrcMessageModel::emptyChanged(bool empty)
+
+    This signal is emitted when the model becomes \a empty or non-empty.
+ */
+
+#ifndef IRC_DOXYGEN
+static QHash<int, QByteArray> irc_message_model_roles()
+{
+    QHash<int, QByteArray> roles;
+    roles[Qt::DisplayRole] = "display";
+    roles[Irc::MessageRole] = "message";
+    roles[Irc::TimeStampRole] = "timeStamp";
+    return roles;
+}
+
+IrcMessageModelRow::~IrcMessageModelRow()
+{
+    // a view may still hold on to the message
+    if (message)
+        message->deleteLater();
+}
+
+IrcMessageModelPrivate::IrcMessageModelPrivate() : cache(256)
+{
+}
+
+IrcMessageModelRow* IrcMessageModelPrivate::row(int index) const
+{
+    Q_Q(const IrcMessageModel);
+    if (!store || index < 0 || index >= store->count())
+        return nullptr;
+
+    const IrcMessageStore::Entry& entry = store->at(index);
+    IrcMessageModelRow* row = cache.object(entry.id);
+    if (!row) {
+        IrcMessage* message = IrcMessage::fromData(entry.data, buffer ? buffer->connection() : nullptr);
+        message->setParent(const_cast<IrcMessageModel*>(q));
+        message->setTimeStamp(QDateTime::fromMSecsSinceEpoch(entry.timeStamp));
+        message->setFlags(IrcMessage::Flags(entry.flags));
+        row = new IrcMessageModelRow;
+        row->message = message;
+        cache.insert(entry.id, row);
+    }
+    return row;
+}
+
+IrcMessageArchive* IrcMessageModelPrivate::archive() const
+{
+    if (!store || !buffer)
+        return nullptr;
+    return IrcBufferPrivate::get(buffer)->messageArchive();
+}
+
+void IrcMessageModelPrivate::beginInsert(int first, int last)
+{
+    Q_Q(IrcMessageModel);
+    previousCount = q->count();
+    q->beginInsertRows(QModelIndex(), first, last);
+}
+
+void IrcMessageModelPrivate::endInsert()
+{
+    Q_Q(IrcMessageModel);
+    q->endInsertRows();
+    emit q->countChanged(q->count());
+    if (!previousCount)
+        emit q->emptyChanged(false);
+}
+
+void IrcMessageModelPrivate::beginRemove(int first, int last)
+{
+    Q_Q(IrcMessageModel);
+    previousCount = q->count();
+    q->beginRemoveRows(QModelIndex(), first, last);
+}
+
+void IrcMessageModelPrivate::endRemove()
+{
+    Q_Q(IrcMessageModel);
+    q->endRemoveRows();
+    const int count = q->count();
+    if (count != previousCount)
+        emit q->countChanged(count);
+    if (!count && previousCount)
+        emit q->emptyChanged(true);
+}
+
+void IrcMessageModelPrivate::beginReset()
+{
+    Q_Q(IrcMessageModel);
+    previousCount = q->count();
+    q->beginResetModel();
+}
+
+void IrcMessageModelPrivate::endReset()
+{
+    Q_Q(IrcMessageModel);
+    cache.clear();
+    q->endResetModel();
+    const int count = q->count();
+    if (count != previousCount)
+        emit q->countChanged(count);
+    if (!count != !previousCount)
+        emit q->emptyChanged(!count);
+}
+
+void IrcMessageModelPrivate::detach()
+{
+    Q_Q(IrcMessageModel);
+    beginReset();
+    store = nullptr;
+    buffer = nullptr;
+    endReset();
+    emit q->bufferChanged(nullptr);
+}
+
+/*!
+    Constructs a new model with \a parent.
+
+    \note If \a parent is an instance of IrcBuffer, it will be
+    automatically assigned to \ref IrcMessageModel::buffer "buffer".
+ */
+IrcMessageModel::IrcMessageModel(QObject* parent) : QAbstractListModel(parent), d_ptr(new IrcMessageModelPrivate)
+{
+    Q_D(IrcMessageModel);
+    d->q_ptr = this;
+    setBuffer(qobject_cast<IrcBuffer*>(parent));
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    setRoleNames(irc_message_model_roles());
+#endif
+
+    qRegisterMetaType<IrcMessage*>();
+}
+
+/*!
+    Destructs the model.
+ */
+IrcMessageModel::~IrcMessageModel()
+{
+    Q_D(IrcMessageModel);
+    if (d->store)
+        d->store->removeModel(this);
+}
+#endif // IRC_DOXYGEN
+
+/*!
+    This property holds the buffer.
+
+    \par Access functions:
+    \li \ref IrcBuffer* <b>buffer</b>() const
+    \li void <b>setBuffer</b>(\ref IrcBuffer* buffer)
+
+    \par Notifier signal:
+    \li void <b>bufferChanged</b>(\ref IrcBuffer* buffer)
+ */
+IrcBuffer* IrcMessageModel::buffer() const
+{
+    Q_D(const IrcMessageModel);
+    return d->buffer;
+}
+
+void IrcMessageModel::setBuffer(IrcBuffer* buffer)
+{
+    Q_D(IrcMessageModel);
+    if (d->buffer != buffer) {
+        d->beginReset();
+        if (d->store)
+            d->store->removeModel(this);
+
+        d->buffer = buffer;
+        d->store = buffer ? IrcBufferPrivate::get(buffer)->messageStore() : nullptr;
+
+        if (d->store)
+            d->store->addModel(this);
+        d->endReset();
+
+        emit bufferChanged(buffer);
+    }
+}
+
+/*!
+    This property holds the number of messages.
+
+    \par Access function:
+    \li int <b>count</b>() const
+
+    \par Notifier signal:
+    \li void <b>countChanged</b>(int count)
+ */
+int IrcMessageModel::count() const
+{
+    return rowCount();
+}
+
+/*!
+    \property bool IrcMessageModel::empty
+
+    This property holds the whether the model is empty.
+
+    \par Access function:
+    \li bool <b>isEmpty</b>() const
+
+    \par Notifier signal:
+    \li void <b>emptyChanged</b>(bool empty)
+ */
+bool IrcMessageModel::isEmpty() const
+{
+    return !rowCount();
+}
+
+/*!
+    Returns the message object at \a index.
+
+    The message is decoded on demand and owned by the model. It remains
+    valid at least until the control returns to the event loop.
+ */
+IrcMessage* IrcMessageModel::get(int index) const
+{
+    Q_D(const IrcMessageModel);
+    IrcMessageModelRow* row = d->row(index);
+    return row ? row->message : nullptr;
+}
+
+/*!
+    Returns the message for model \a index.
+ */
+IrcMessage* IrcMessageModel::message(const QModelIndex& index) const
+{
+    if (!hasIndex(index.row(), index.column(), index.parent()))
+        return nullptr;
+
+    return get(index.row());
+}
+
+/*!
+    This property holds the maximum number of messages kept.
+
+    When the limit is exceeded, the oldest messages are dropped. A negative
+    value means no limit. The default value is \c 1000.
+
+    \note The history is shared between all models of the same buffer, and
+    is limited by the largest limit among them.
+
+    \par Access functions:
+    \li int <b>lineLimit</b>() const
+    \li void <b>setLineLimit</b>(int limit)
+
+    \par Notifier signal:
+    \li void <b>lineLimitChanged</b>(int limit)
+ */
+int IrcMessageModel::lineLimit() const
+{
+    Q_D(const IrcMessageModel);
+    return d->lineLimit;
+}
+
+void IrcMessageModel::setLineLimit(int limit)
+{
+    Q_D(IrcMessageModel);
+    if (d->lineLimit != limit) {
+        d->lineLimit = limit;
+        if (d->store)
+            d->store->updateLimits();
+        emit lineLimitChanged(limit);
+    }
+}
+
+/*!
+    This property holds the maximum number of raw message bytes kept.
+
+    When the limit is exceeded, the oldest messages are dropped. A negative
+    value means no limit. The default value is \c -1.
+
+    \note The history is shared between all models of the same buffer, and
+    is limited by the largest limit among them.
+
+    \par Access functions:
+    \li int <b>byteLimit</b>() const
+    \li void <b>setByteLimit</b>(int limit)
+
+    \par Notifier signal:
+    \li void <b>byteLimitChanged</b>(int limit)
+ */
+int IrcMessageModel::byteLimit() const
+{
+    Q_D(const IrcMessageModel);
+    return d->byteLimit;
+}
+
+void IrcMessageModel::setByteLimit(int limit)
+{
+    Q_D(IrcMessageModel);
+    if (d->byteLimit != limit) {
+        d->byteLimit = limit;
+        if (d->store)
+            d->store->updateLimits();
+        emit byteLimitChanged(limit);
+    }
+}
+
+/*!
+    This property holds the number of decoded rows kept in memory.
+
+    The default value is \c 256.
+
+    \par Access functions:
+    \li int <b>cacheSize</b>() const
+    \li void <b>setCacheSize</b>(int size)
+ */
+int IrcMessageModel::cacheSize() const
+{
+    Q_D(const IrcMessageModel);
+    return d->cache.maxCost();
+}
+
+void IrcMessageModel::setCacheSize(int size)
+{
+    Q_D(IrcMessageModel);
+    d->cache.setMaxCost(qMax(1, size));
+}
+
+/*!
+    This property holds the number of archived messages loaded by fetchMore().
+
+    The default value is \c 100.
+
+    \par Access functions:
+    \li int <b>fetchSize</b>() const
+    \li void <b>setFetchSize</b>(int size)
+ */
+int IrcMessageModel::fetchSize() const
+{
+    Q_D(const IrcMessageModel);
+    return d->fetchSize;
+}
+
+void IrcMessageModel::setFetchSize(int size)
+{
+    Q_D(IrcMessageModel);
+    d->fetchSize = qMax(1, size);
+}
+
+/*!
+    The following role names are provided by default:
+
+    Role                | Name        | Type        | Example
+    --------------------|-------------|-------------|--------
+    Qt::DisplayRole     | "display"   | QString     | "&lt;jpnurmi&gt; hello"
+    Irc::MessageRole    | "message"   | IrcMessage* | &lt;object&gt;
+    Irc::TimeStampRole  | "timeStamp" | QDateTime   | 2020-01-01 12:00:00
+
+    \sa formatMessage()
+ */
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+QHash<int, QByteArray> IrcMessageModel::roleNames() const
+{
+    return irc_message_model_roles();
+}
+#endif
+
+/*!
+    Returns the number of messages.
+ */
+int IrcMessageModel::rowCount(const QModelIndex& parent) const
+{
+    Q_D(const IrcMessageModel);
+    if (parent.isValid() || !d->store)
+        return 0;
+
+    return d->store->count();
+}
+
+/*!
+    Returns the data for specified \a role referred to by the \a index.
+
+    \sa Irc::DataRole, roleNames()
+ */
+QVariant IrcMessageModel::data(const QModelIndex& index, int role) const
+{
+    Q_D(const IrcMessageModel);
+    if (!d->store || !hasIndex(index.row(), index.column(), index.parent()))
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole: {
+        IrcMessageModelRow* row = d->row(index.row());
+        if (!row->formatted) {
+            row->text = formatMessage(row->message);
+            row->formatted = true;
+        }
+        return row->text;
+    }
+    case Irc::MessageRole:
+        return QVariant::fromValue(d->row(index.row())->message);
+    case Irc::TimeStampRole:
+        // answered from the store without decoding the message
+        return QDateTime::fromMSecsSinceEpoch(d->store->at(index.row()).timeStamp);
+    }
+
+    return QVariant();
+}
+
+/*!
+    Returns \c true if older messages are available in the archive.
+
+    \sa IrcBufferModel::archiveDirectory
+ */
+bool IrcMessageModel::canFetchMore(const QModelIndex& parent) const
+{
+    Q_D(const IrcMessageModel);
+    IrcMessageArchive* archive = d->archive();
+    if (parent.isValid() || !archive)
+        return false;
+
+    if (d->store->isEmpty())
+        return archive->count() > 0;
+    return d->store->at(0).offset > IrcMessageArchive::HeaderSize;
+}
+
+/*!
+    Loads \ref fetchSize older messages from the archive to the beginning
+    of the model. The messages are parsed only once they are displayed.
+
+    \note Fetched messages are dropped again when newly received messages
+    exceed the limits.
+
+    \sa IrcBufferModel::archiveDirectory
+ */
+void IrcMessageModel::fetchMore(const QModelIndex& parent)
+{
+    Q_D(IrcMessageModel);
+    if (!canFetchMore(parent))
+        return;
+
+    const qint64 before = d->store->isEmpty() ? -1 : d->store->at(0).offset;
+    d->store->prepend(d->archive()->read(before, d->fetchSize));
+}
+
+/*!
+    Clears the message history of the buffer.
+ */
+void IrcMessageModel::clear()
+{
+    Q_D(IrcMessageModel);
+    if (d->store)
+        d->store->clear();
+}
+
+/*!
+    Returns the display text for \a message.
+
+    The default implementation returns plain text in the traditional
+    "&lt;nick&gt; message" style. Reimplement this function in order to
+    use for example IrcTextFormat. The result is cached per row.
+ */
+QString IrcMessageModel::formatMessage(IrcMessage* message) const
+{
+    switch (message->type()) {
+    case IrcMessage::Private: {
+        IrcPrivateMessage* msg = static_cast<IrcPrivateMessage*>(message);
+        if (msg->isAction())
+            return QString("* %1 %2").arg(msg->nick(), msg->content());
+        return QString("<%1> %2").arg(msg->nick(), msg->content());
+    }
+    case IrcMessage::Notice: {
+        IrcNoticeMessage* msg = static_cast<IrcNoticeMessage*>(message);
+        return QString("-%1- %2").arg(msg->nick(), msg->content());
+    }
+    case IrcMessage::Join:
+        return QString("! %1 joined").arg(message->nick());
+    case IrcMessage::Part:
+        return QString("! %1 left (%2)").arg(message->nick(), static_cast<IrcPartMessage*>(message)->reason());
+    case IrcMessage::Quit:
+        return QString("! %1 quit (%2)").arg(message->nick(), static_cast<IrcQuitMessage*>(message)->reason());
+    case IrcMessage::Nick:
+        return QString("! %1 is now known as %2").arg(message->nick(), static_cast<IrcNickMessage*>(message)->newNick());
+    case IrcMessage::Topic:
+        return QString("! %1 changed topic to %2").arg(message->nick(), static_cast<IrcTopicMessage*>(message)->topic());
+    default:
+        return message->parameters().join(QLatin1String(" "));
+    }
+}
+
+#include "moc_ircmessagemodel.cpp"
+
+IRC_END_NAMESPACE
@@ -0,0 +1,156 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ircmessagestore_p.h"
+#include "ircmessagemodel_p.h"
+
+IRC_BEGIN_NAMESPACE
+
+#ifndef IRC_DOXYGEN
+IrcMessageStore::~IrcMessageStore()
+{
+    // the models outlive the buffer that owns the store
+    foreach (IrcMessageModel* model, models)
+        IrcMessageModelPrivate::get(model)->detach();
+}
+
+void IrcMessageStore::append(qint64 timeStamp, int flags, const QByteArray& data, qint64 offset)
+{
+    Entry entry;
+    entry.id = ++nextId;
+    entry.offset = offset;
+    entry.timeStamp = timeStamp;
+    entry.flags = flags;
+    entry.data = data;
+
+    // make room for the new line before announcing it
+    const int lines = lineLimit < 0 ? -1 : qMax(0, lineLimit - 1);
+    const qint64 size = byteLimit < 0 ? -1 : qMax<qint64>(0, byteLimit - entry.data.size());
+    trim(lines, size);
+
+    const int row = entries.count();
+    foreach (IrcMessageModel* model, models)
+        IrcMessageModelPrivate::get(model)->beginInsert(row, row);
+    entries.append(entry);
+    bytes += entry.data.size();
+    foreach (IrcMessageModel* model, models)
+        IrcMessageModelPrivate::get(model)->endInsert();
+}
+
+void IrcMessageStore::prepend(const QList<IrcMessageArchive::Record>& records)
+{
+    // older history is paged in on request and not subject to trimming
+    // until the next message arrives
+    if (records.isEmpty())
+        return;
+
+    const int last = records.count() - 1;
+    foreach (IrcMessageModel* model, models)
+        IrcMessageModelPrivate::get(model)->beginInsert(0, last);
+    // the older lines are put in front of the current ones in one go
+    QVector<Entry> older(records.count());
+    for (int i = last; i >= 0; --i) {
+        const IrcMessageArchive::Record& record = records.at(i);
+        Entry& entry = older[i];
+        entry.id = ++nextId;
+        entry.offset = record.offset;
+        entry.timeStamp = record.timeStamp;
+        entry.flags = record.flags;
+        entry.data = record.data;
+        bytes += entry.data.size();
+    }
+    older += entries;
+    entries.swap(older);
+    foreach (IrcMessageModel* model, models)
+        IrcMessageModelPrivate::get(model)->endInsert();
+}
+
+void IrcMessageStore::clear()
+{
+    if (!entries.isEmpty()) {
+        foreach (IrcMessageModel* model, models)
+            IrcMessageModelPrivate::get(model)->beginReset();
+        entries.clear();
+        bytes = 0;
+        foreach (IrcMessageModel* model, models)
+            IrcMessageModelPrivate::get(model)->endReset();
+    }
+}
+
+void IrcMessageStore::addModel(IrcMessageModel* model)
+{
+    if (!models.contains(model)) {
+        models.append(model);
+        updateLimits();
+    }
+}
+
+void IrcMessageStore::removeModel(IrcMessageModel* model)
+{
+    if (models.removeOne(model))
+        updateLimits();
+}
+
+void IrcMessageStore::updateLimits()
+{
+    // the store keeps enough history for the most generous model, and
+    // as much as a model with the default limits while none is attached
+    lineLimit = models.isEmpty() ? int(DefaultLineLimit) : 0;
+    byteLimit = models.isEmpty() ? -1 : 0;
+    foreach (IrcMessageModel* model, models) {
+        const int ml = model->lineLimit();
+        const int bl = model->byteLimit();
+        if (lineLimit >= 0)
+            lineLimit = ml < 0 ? -1 : qMax(lineLimit, ml);
+        if (byteLimit >= 0)
+            byteLimit = bl < 0 ? -1 : qMax(byteLimit, bl);
+    }
+    trim(lineLimit, byteLimit);
+}
+
+void IrcMessageStore::trim(int lines, qint64 size)
+{
+    int count = 0;
+    qint64 freed = 0;
+    const int total = entries.count();
+    while (count < total && ((lines >= 0 && total - count > lines) || (size >= 0 && bytes - freed > size)))
+        freed += entries.at(count++).data.size();
+
+    if (count > 0) {
+        foreach (IrcMessageModel* model, models)
+            IrcMessageModelPrivate::get(model)->beginRemove(0, count - 1);
+        entries.erase(entries.begin(), entries.begin() + count);
+        bytes -= freed;
+        foreach (IrcMessageModel* model, models)
+            IrcMessageModelPrivate::get(model)->endRemove();
+    }
+}
+#endif // IRC_DOXYGEN
+
+IRC_END_NAMESPACE
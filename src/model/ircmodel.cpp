@@ -53,6 +53,7 @@ namespace IrcModel {
         qRegisterMetaType<IrcBuffer*>("IrcBuffer*");
         qRegisterMetaType<IrcBufferModel*>("IrcBufferModel*");
         qRegisterMetaType<IrcChannel*>("IrcChannel*");
+        qRegisterMetaType<IrcMessageModel*>("IrcMessageModel*");
         qRegisterMetaType<IrcUser*>("IrcUser*");
         qRegisterMetaType<IrcUserModel*>("IrcUserModel*");
     }
@@ -28,6 +28,7 @@
 
 #include "ircuser.h"
 #include "ircuser_p.h"
+#include "ircnetwork_p.h"
 #include <qdebug.h>
 
 IRC_BEGIN_NAMESPACE
@@ -46,50 +47,81 @@ IRC_BEGIN_NAMESPACE
 */
 
 #ifndef IRC_DOXYGEN
-void IrcUserPrivate::setName(const QString& n)
+IrcUserIdentity* IrcUserPrivate::ensureIdentity()
+{
+    if (!identity)
+        setIdentity(new IrcUserIdentity);
+    return identity;
+}
+
+void IrcUserPrivate::setIdentity(IrcUserIdentity* i)
 {
     Q_Q(IrcUser);
-    if (name != n) {
-        name = n;
-        emit q->nameChanged(name);
-        emit q->titleChanged(q->title());
+    if (identity == i)
+        return;
+
+    if (identity) {
+        identity->users.removeOne(q);
+        if (identity->users.isEmpty()) {
+            if (identity->store)
+                identity->store->remove(identity);
+            delete identity;
+        }
     }
+
+    identity = i;
+    if (identity)
+        identity->users.append(q);
 }
 
-void IrcUserPrivate::setPrefix(const QString& p)
+void IrcUserPrivate::setName(const QString& n)
 {
-    Q_Q(IrcUser);
-    if (prefix != p) {
-        prefix = p;
-        emit q->prefixChanged(prefix);
-        emit q->titleChanged(q->title());
+    IrcUserIdentity* i = ensureIdentity();
+    if (i->name != n) {
+        if (i->store)
+            i->store->rename(i, n);
+        else
+            i->name = n;
+        foreach (IrcUser* user, i->users) {
+            emit user->nameChanged(n);
+            emit user->titleChanged(user->title());
+        }
     }
 }
 
-void IrcUserPrivate::setMode(const QString& m)
+void IrcUserPrivate::setModes(uint m)
 {
     Q_Q(IrcUser);
-    if (mode != m) {
-        mode = m;
-        emit q->modeChanged(mode);
+    if (modes != m) {
+        modes = m;
+        emit q->prefixChanged(q->prefix());
+        emit q->titleChanged(q->title());
+        emit q->modeChanged(q->mode());
     }
 }
 
+const IrcNetwork* IrcUserPrivate::network() const
+{
+    return channel ? channel->network() : nullptr;
+}
+
 void IrcUserPrivate::setServOp(const bool& o)
 {
-    Q_Q(IrcUser);
-    if (servOp != o) {
-        servOp = o;
-        emit q->servOpChanged(servOp);
+    IrcUserIdentity* i = ensureIdentity();
+    if (i->servOp != o) {
+        i->servOp = o;
+        foreach (IrcUser* user, i->users)
+            emit user->servOpChanged(o);
     }
 }
 
 void IrcUserPrivate::setAway(const bool& a)
 {
-    Q_Q(IrcUser);
-    if (away != a) {
-        away = a;
-        emit q->awayChanged(away);
+    IrcUserIdentity* i = ensureIdentity();
+    if (i->away != a) {
+        i->away = a;
+        foreach (IrcUser* user, i->users)
+            emit user->awayChanged(a);
     }
 }
 #endif // IRC_DOXYGEN
@@ -103,8 +135,9 @@ IrcUser::IrcUser(QObject* parent)
     Q_D(IrcUser);
     d->q_ptr = this;
     d->channel = nullptr;
-    d->away = false;
-    d->servOp = false;
+    d->identity = nullptr;
+    d->modes = 0;
+    d->activity = 0;
 }
 
 /*!
@@ -112,6 +145,8 @@ IrcUser::IrcUser(QObject* parent)
  */
 IrcUser::~IrcUser()
 {
+    Q_D(IrcUser);
+    d->setIdentity(nullptr);
 }
 
 /*!
@@ -128,7 +163,11 @@ IrcUser::~IrcUser()
 QString IrcUser::title() const
 {
     Q_D(const IrcUser);
-    return d->prefix.left(1) + d->name;
+    const IrcNetwork* network = d->network();
+    if (!d->modes || !network)
+        return name();
+    // the lowest set bit is the highest ranked prefix
+    return IrcNetworkPrivate::get(network)->prefixesFromBits(d->modes & (~d->modes + 1)) + name();
 }
 
 /*!
@@ -143,7 +182,9 @@ QString IrcUser::title() const
 QString IrcUser::name() const
 {
     Q_D(const IrcUser);
-    return d->name;
+    if (d->identity)
+        return d->identity->name;
+    return QString();
 }
 
 /*!
@@ -165,7 +206,10 @@ QString IrcUser::name() const
 QString IrcUser::prefix() const
 {
     Q_D(const IrcUser);
-    return d->prefix;
+    const IrcNetwork* network = d->network();
+    if (!d->modes || !network)
+        return QString();
+    return IrcNetworkPrivate::get(network)->prefixesFromBits(d->modes);
 }
 
 /*!
@@ -187,7 +231,10 @@ QString IrcUser::prefix() const
 QString IrcUser::mode() const
 {
     Q_D(const IrcUser);
-    return d->mode;
+    const IrcNetwork* network = d->network();
+    if (!d->modes || !network)
+        return QString();
+    return IrcNetworkPrivate::get(network)->modesFromBits(d->modes);
 }
 
 /*!
@@ -214,7 +261,7 @@ QString IrcUser::mode() const
 bool IrcUser::isServOp() const
 {
     Q_D(const IrcUser);
-    return d->servOp;
+    return d->identity && d->identity->servOp;
 }
 
 /*!
@@ -241,7 +288,7 @@ bool IrcUser::isServOp() const
 bool IrcUser::isAway() const
 {
     Q_D(const IrcUser);
-    return d->away;
+    return d->identity && d->identity->away;
 }
 
 /*!
@@ -32,8 +32,11 @@
 #include "ircconnection.h"
 #include "ircchannel_p.h"
 #include "ircuser.h"
+#include "ircuser_p.h"
 #include <qpointer.h>
+#include <qhash.h>
 #include <algorithm>
+#include <functional>
 
 IRC_BEGIN_NAMESPACE
 
@@ -132,16 +135,7 @@ void IrcUserModelPrivate::addUser(IrcUser* user, bool notify)
 void IrcUserModelPrivate::insertUser(int index, IrcUser* user, bool notify)
 {
     Q_Q(IrcUserModel);
-    if (index == -1)
-        index = userList.count();
-    if (sortMethod != Irc::SortByHand) {
-        QList<IrcUser*>::iterator it;
-        if (sortOrder == Qt::AscendingOrder)
-            it = std::upper_bound(userList.begin(), userList.end(), user, IrcUserLessThan(q, sortMethod));
-        else
-            it = std::upper_bound(userList.begin(), userList.end(), user, IrcUserGreaterThan(q, sortMethod));
-        index = it - userList.begin();
-    }
+    index = insertIndex(index, user);
     if (notify)
         emit q->aboutToBeAdded(user);
     q->beginInsertRows(QModelIndex(), index, index);
@@ -209,6 +203,87 @@ void IrcUserModelPrivate::setUsers(const QList<IrcUser*>& users, bool reset)
         emit q->emptyChanged(userList.isEmpty());
 }
 
+void IrcUserModelPrivate::syncUsers(const QList<IrcUser*>& removed, const QList<IrcUser*>& added, const QList<IrcUser*>& changed)
+{
+    Q_Q(IrcUserModel);
+    const QList<IrcUser*> users = userList;
+
+    // the rows are looked up once per sync rather than searched per user
+    QHash<IrcUser*, int> rows;
+    rows.reserve(userList.count());
+    for (int i = 0; i < userList.count(); ++i)
+        rows.insert(userList.at(i), i);
+
+    // removed from the bottom up, so that the rows above stay valid
+    QList<int> removedRows;
+    foreach (IrcUser* user, removed) {
+        QHash<IrcUser*, int>::iterator it = rows.find(user);
+        if (it != rows.end()) {
+            removedRows += it.value();
+            rows.erase(it);
+        }
+    }
+    std::sort(removedRows.begin(), removedRows.end(), std::greater<int>());
+    foreach (int idx, removedRows) {
+        IrcUser* user = userList.at(idx);
+        emit q->aboutToBeRemoved(user);
+        q->beginRemoveRows(QModelIndex(), idx, idx);
+        userList.removeAt(idx);
+        q->endRemoveRows();
+        emit q->removed(user);
+    }
+    if (!removedRows.isEmpty() && !changed.isEmpty()) {
+        for (int i = 0; i < userList.count(); ++i)
+            rows.insert(userList.at(i), i);
+    }
+
+    foreach (IrcUser* user, changed) {
+        int row = rows.value(user, -1);
+        if (row == -1)
+            continue;
+        if (sortMethod == Irc::SortByTitle) {
+            const int from = row;
+            userList.removeAt(from);
+            const int to = insertIndex(-1, user);
+            userList.insert(from, user);
+            if (to != from) {
+                q->beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+                userList.move(from, to);
+                q->endMoveRows();
+                // the rows in between shifted by one
+                for (int i = qMin(from, to); i <= qMax(from, to); ++i)
+                    rows.insert(userList.at(i), i);
+                row = to;
+            }
+        }
+        const QModelIndex index = q->index(row, 0);
+        emit q->dataChanged(index, index);
+    }
+
+    foreach (IrcUser* user, added) {
+        const int idx = insertIndex(-1, user);
+        emit q->aboutToBeAdded(user);
+        q->beginInsertRows(QModelIndex(), idx, idx);
+        userList.insert(idx, user);
+        q->endInsertRows();
+        emit q->added(user);
+    }
+
+    const bool titlesChanged = updateTitles();
+    if (removed.isEmpty() && added.isEmpty() && !titlesChanged && users == userList)
+        return;
+
+    emit q->namesChanged(IrcChannelPrivate::get(channel)->names);
+    if (titlesChanged)
+        emit q->titlesChanged(titles);
+    if (users != userList)
+        emit q->usersChanged(userList);
+    if (users.count() != userList.count())
+        emit q->countChanged(userList.count());
+    if (users.isEmpty() != userList.isEmpty())
+        emit q->emptyChanged(userList.isEmpty());
+}
+
 void IrcUserModelPrivate::renameUser(IrcUser* user)
 {
     Q_Q(IrcUserModel);
@@ -262,6 +337,21 @@ bool IrcUserModelPrivate::updateUser(IrcUser* user)
     return false;
 }
 
+int IrcUserModelPrivate::insertIndex(int index, IrcUser* user) const
+{
+    Q_Q(const IrcUserModel);
+    if (sortMethod == Irc::SortByHand)
+        return index == -1 ? userList.count() : index;
+
+    IrcUserModel* model = const_cast<IrcUserModel*>(q);
+    QList<IrcUser*>::const_iterator it;
+    if (sortOrder == Qt::AscendingOrder)
+        it = std::upper_bound(userList.constBegin(), userList.constEnd(), user, IrcUserLessThan(model, sortMethod));
+    else
+        it = std::upper_bound(userList.constBegin(), userList.constEnd(), user, IrcUserGreaterThan(model, sortMethod));
+    return it - userList.constBegin();
+}
+
 bool IrcUserModelPrivate::updateTitles()
 {
     QStringList prev = titles;
@@ -444,7 +534,7 @@ IrcUser* IrcUserModel::find(const QString& name) const
 {
     Q_D(const IrcUserModel);
     if (d->channel && !d->userList.isEmpty())
-        return IrcChannelPrivate::get(d->channel)->userMap.value(name);
+        return IrcChannelPrivate::get(d->channel)->findUser(name);
     return nullptr;
 }
 
@@ -455,7 +545,7 @@ bool IrcUserModel::contains(const QString& name) const
 {
     Q_D(const IrcUserModel);
     if (d->channel && !d->userList.isEmpty())
-        return IrcChannelPrivate::get(d->channel)->userMap.contains(name);
+        return IrcChannelPrivate::get(d->channel)->findUser(name);
     return false;
 }
 
@@ -733,26 +823,22 @@ void IrcUserModel::sort(Irc::SortMethod method, Qt::SortOrder order)
 bool IrcUserModel::lessThan(IrcUser* one, IrcUser* another, Irc::SortMethod method) const
 {
     if (method == Irc::SortByActivity) {
-        QList<IrcUser*> activeUsers = IrcChannelPrivate::get(one->channel())->activeUsers;
-        const int i1 = activeUsers.indexOf(one);
-        const int i2 = activeUsers.indexOf(another);
-        return i1 < i2;
+        // the most recently active user has the highest activity stamp
+        return IrcUserPrivate::get(one)->activity > IrcUserPrivate::get(another)->activity;
     } else if (method == Irc::SortByTitle) {
-        const IrcNetwork* network = one->channel()->network();
-        const QStringList prefixes = network->prefixes();
-
-        const QString p1 = one->prefix();
-        const QString p2 = another->prefix();
+        // the lowest set mode bit is the highest ranked prefix
+        const uint m1 = IrcUserPrivate::get(one)->modes;
+        const uint m2 = IrcUserPrivate::get(another)->modes;
 
-        const int i1 = !p1.isEmpty() ? prefixes.indexOf(p1.at(0)) : -1;
-        const int i2 = !p2.isEmpty() ? prefixes.indexOf(p2.at(0)) : -1;
+        const uint b1 = m1 & (~m1 + 1);
+        const uint b2 = m2 & (~m2 + 1);
 
-        if (i1 >= 0 && i2 < 0)
+        if (b1 && !b2)
             return true;
-        if (i1 < 0 && i2 >= 0)
+        if (!b1 && b2)
             return false;
-        if (i1 >= 0 && i2 >= 0 && i1 != i2)
-            return i1 < i2;
+        if (b1 && b2 && b1 != b2)
+            return b1 < b2;
     }
 
     // Irc::SortByName
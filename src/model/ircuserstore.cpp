@@ -0,0 +1,137 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ircuserstore_p.h"
+#include "ircmessage.h"
+
+IRC_BEGIN_NAMESPACE
+
+#ifndef IRC_DOXYGEN
+IrcUserStore::~IrcUserStore()
+{
+    // identities are owned by their users and may outlive the store
+    foreach (IrcUserIdentity* identity, identities)
+        identity->store = nullptr;
+}
+
+void IrcUserStore::setNameTable(const IrcNameTable* table)
+{
+    if (nameTable != table) {
+        nameTable = table;
+        keyGeneration = -1;
+    }
+}
+
+QString IrcUserStore::key(const QString& name) const
+{
+    // re-key the identities when the name table or CASEMAPPING changes
+    const IrcNameTable& table = nameTable ? *nameTable : localNames;
+    if (table.generation() != keyGeneration) {
+        keyGeneration = table.generation();
+        QHash<QString, IrcUserIdentity*> keyed;
+        foreach (IrcUserIdentity* identity, identities)
+            keyed.insert(table.key(identity->name), identity);
+        identities = keyed;
+    }
+    return table.key(name);
+}
+
+IrcUserIdentity* IrcUserStore::find(const QString& name) const
+{
+    return identities.value(key(name));
+}
+
+IrcUserIdentity* IrcUserStore::identity(const QString& name)
+{
+    const QString k = key(name);
+    IrcUserIdentity* identity = identities.value(k);
+    if (!identity) {
+        identity = new IrcUserIdentity;
+        identity->store = this;
+        identity->name = name;
+        identities.insert(k, identity);
+    }
+    return identity;
+}
+
+void IrcUserStore::rename(IrcUserIdentity* identity, const QString& name)
+{
+    const QString from = key(identity->name);
+    if (identities.value(from) == identity)
+        identities.remove(from);
+    identity->name = name;
+
+    // a stale identity may still be around under the new name
+    const QString to = key(name);
+    if (IrcUserIdentity* other = identities.value(to)) {
+        if (other != identity)
+            other->store = nullptr;
+    }
+    identities.insert(to, identity);
+}
+
+void IrcUserStore::remove(IrcUserIdentity* identity)
+{
+    const QString k = key(identity->name);
+    if (identities.value(k) == identity)
+        identities.remove(k);
+    identity->store = nullptr;
+}
+
+void IrcUserStore::update(IrcMessage* message)
+{
+    IrcUserIdentity* identity = find(message->nick());
+    if (!identity)
+        return;
+
+    if (message->type() == IrcMessage::HostChange) {
+        IrcHostChangeMessage* hostChange = static_cast<IrcHostChangeMessage*>(message);
+        identity->ident = hostChange->user();
+        identity->host = hostChange->host();
+        return;
+    }
+
+    if (message->type() == IrcMessage::Account) {
+        identity->account = static_cast<IrcAccountMessage*>(message)->account();
+        return;
+    }
+
+    const QString ident = message->ident();
+    if (!ident.isEmpty())
+        identity->ident = ident;
+    const QString host = message->host();
+    if (!host.isEmpty())
+        identity->host = host;
+    const QString account = message->account();
+    if (!account.isEmpty())
+        identity->account = account;
+}
+#endif // IRC_DOXYGEN
+
+IRC_END_NAMESPACE
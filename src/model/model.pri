@@ -12,6 +12,7 @@ INCLUDEPATH += $$PWD $$INCDIR
 CONV_HEADERS  = $$INCDIR/IrcBuffer
 CONV_HEADERS += $$INCDIR/IrcBufferModel
 CONV_HEADERS += $$INCDIR/IrcChannel
+CONV_HEADERS += $$INCDIR/IrcMessageModel
 CONV_HEADERS += $$INCDIR/IrcModel
 CONV_HEADERS += $$INCDIR/IrcUser
 CONV_HEADERS += $$INCDIR/IrcUserModel
@@ -19,6 +20,7 @@ CONV_HEADERS += $$INCDIR/IrcUserModel
 PUB_HEADERS  = $$INCDIR/ircbuffer.h
 PUB_HEADERS += $$INCDIR/ircbuffermodel.h
 PUB_HEADERS += $$INCDIR/ircchannel.h
+PUB_HEADERS += $$INCDIR/ircmessagemodel.h
 PUB_HEADERS += $$INCDIR/ircmodel.h
 PUB_HEADERS += $$INCDIR/ircuser.h
 PUB_HEADERS += $$INCDIR/ircusermodel.h
@@ -26,8 +28,13 @@ PUB_HEADERS += $$INCDIR/ircusermodel.h
 PRIV_HEADERS  = $$INCDIR/ircbuffer_p.h
 PRIV_HEADERS += $$INCDIR/ircbuffermodel_p.h
 PRIV_HEADERS += $$INCDIR/ircchannel_p.h
+PRIV_HEADERS += $$INCDIR/ircmessagearchive_p.h
+PRIV_HEADERS += $$INCDIR/ircmessagemodel_p.h
+PRIV_HEADERS += $$INCDIR/ircmessagestore_p.h
+PRIV_HEADERS += $$INCDIR/ircnameindex_p.h
 PRIV_HEADERS += $$INCDIR/ircuser_p.h
 PRIV_HEADERS += $$INCDIR/ircusermodel_p.h
+PRIV_HEADERS += $$INCDIR/ircuserstore_p.h
 
 HEADERS += $$PUB_HEADERS
 HEADERS += $$PRIV_HEADERS
@@ -35,6 +42,10 @@ HEADERS += $$PRIV_HEADERS
 SOURCES += $$PWD/ircbuffer.cpp
 SOURCES += $$PWD/ircbuffermodel.cpp
 SOURCES += $$PWD/ircchannel.cpp
+SOURCES += $$PWD/ircmessagearchive.cpp
+SOURCES += $$PWD/ircmessagemodel.cpp
+SOURCES += $$PWD/ircmessagestore.cpp
 SOURCES += $$PWD/ircmodel.cpp
 SOURCES += $$PWD/ircuser.cpp
 SOURCES += $$PWD/ircusermodel.cpp
+SOURCES += $$PWD/ircuserstore.cpp
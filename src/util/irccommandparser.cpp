@@ -568,13 +568,16 @@ void IrcCommandParser::setTolerant(bool tolerant)
 
 /*!
     Parses and returns the command for \a input, or \c 0 if the input is not valid.
+
+    Since 3.7, the returned command has \ref IrcCommand::NormalPriority.
  */
 IrcCommand* IrcCommandParser::parse(const QString& input) const
 {
     Q_D(const IrcCommandParser);
+    IrcCommand* cmd = nullptr;
     QString message = input;
     if (d->processMessage(&message)) {
-        return IrcCommand::createMessage(d->target, message.trimmed());
+        cmd = IrcCommand::createMessage(d->target, message.trimmed());
     } else if (!message.isEmpty()) {
         IrcTokenizer tokenizer(message);
         const QString command = tokenizer.at(0).text().toUpper();
@@ -582,17 +585,20 @@ IrcCommand* IrcCommandParser::parse(const QString& input) const
         const QList<IrcCommandInfo> commands = d->find(command);
         if (!commands.isEmpty()) {
             foreach (const IrcCommandInfo& c, commands) {
-                IrcCommand* cmd = d->parseCommand(c, params);
+                cmd = d->parseCommand(c, params);
                 if (cmd)
-                    return cmd;
+                    break;
             }
         } else if (d->tolerant) {
             IrcCommandInfo custom = d->parseSyntax(IrcCommand::Quote, QString(QLatin1String("%1 (<parameters...>)")).arg(command));
             params.prepend(custom.command + QLatin1Char(' '));
-            return d->parseCommand(custom, params);
+            cmd = d->parseCommand(custom, params);
         }
     }
-    return nullptr;
+    // commands typed by the user take precedence over automated ones
+    if (cmd)
+        cmd->setPriority(IrcCommand::NormalPriority);
+    return cmd;
 }
 
 /*!
@@ -29,13 +29,35 @@
 #include "irccommandqueue.h"
 #include "irccommandqueue_p.h"
 #include "ircconnection.h"
+#include "irclagtimer.h"
 #include "irccommand.h"
+#include "irccommand_p.h"
+#include "ircnetwork.h"
+#include "ircnetwork_p.h"
+#include "ircmessage.h"
+#include <QtCore/qmath.h>
 
 IRC_BEGIN_NAMESPACE
 
 static const int DEFAULT_BATCH = 3;
 static const int DEFAULT_INTERVAL = 2;
 
+// the cost of a short line; longer lines and expensive verbs cost more
+static const int LINE_COST = 1000;
+// ircu charges an extra 2 second penalty for every 120 bytes on top of the
+// 2 seconds per line; relative to a line that is one line per 240 bytes,
+// charged for the bytes beyond the first 240 of a line so that a short
+// line costs no more than LINE_COST
+static const int LINE_BYTES = 240;
+// multiplicative decrease / additive increase of the refill rate on lag
+static const qreal MIN_FACTOR = 0.25;
+static const qreal FACTOR_STEP = 0.1;
+static const qint64 LAG_TOLERANCE = 500;
+// interactive commands sent for every bulk command when both are queued
+static const int INTERACTIVE_WEIGHT = 4;
+// the deficit round-robin quantum granted to a target per round
+static const int TARGET_QUANTUM = LINE_COST;
+
 /*!
     \file irccommandqueue.h
     \brief \#include &lt;IrcCommandQueue&gt;
@@ -46,6 +68,40 @@ static const int DEFAULT_INTERVAL = 2;
     \class IrcCommandQueue irccommandqueue.h <IrcCommandQueue>
     \ingroup util
     \brief Provides a flood protection queue for commands.
+
+    IrcCommandQueue implements a token bucket. Every queued command is charged
+    the cost of a short line, plus a cost that grows with its length in bytes
+    beyond that of a short line, and a penalty for verbs that servers treat
+    as expensive (for example WHO, LIST and INVITE), modelled after the flood
+    control of ircu and hybrid. The bucket holds up to
+    \ref batch short lines and is refilled at the rate of \ref batch short
+    lines per \ref interval. Commands are sent as soon as the bucket allows.
+
+    Commands are queued in lanes by their \ref IrcCommand::priority "priority".
+    High priority control commands, such as PONG, CAP and AUTHENTICATE, are
+    never queued. Interactive commands are sent before bulk commands, but
+    every fifth command is taken from the bulk lane so that automated
+    commands such as rejoins and WHO synchronization are not starved. When
+    a command has \ref IrcCommand::DefaultPriority, WHO, NAMES, LIST, WHOWAS
+    and MONITOR are considered bulk commands, and all others interactive.
+
+    Within a lane, messages, notices, CTCPs, modes and kicks are scheduled
+    per target using deficit round-robin, so that flooding one channel does
+    not hold back commands to other channels and users. The amount of
+    queued commands and the waiting time per target are available via
+    \ref targets, depth() and waitTime().
+
+    While commands are waiting in the queue, redundant commands are
+    \ref coalescing "coalesced": repeated WHO, NAMES and JOIN commands are
+    dropped, a MONITOR change supersedes a queued opposite change of the
+    same nick,
+    a PART cancels a queued JOIN of the same channel, and consecutive MODE
+    changes on a channel are merged into one line as long as the MODES
+    limit of the \ref IrcNetwork "network" allows.
+
+    When a \ref lagTimer is assigned, the refill rate adapts to the observed
+    lag: it is halved whenever the lag grows well beyond the lowest lag seen,
+    and recovers step by step while the lag stays low.
  */
 
 /*!
@@ -55,19 +111,69 @@ static const int DEFAULT_INTERVAL = 2;
  */
 
 #ifndef IRC_DOXYGEN
-IrcCommandQueuePrivate::IrcCommandQueuePrivate() :  batch(DEFAULT_BATCH), interval(DEFAULT_INTERVAL)
+IrcCommandQueuePrivate::IrcCommandQueuePrivate() :  batch(DEFAULT_BATCH), interval(DEFAULT_INTERVAL), credit(INTERACTIVE_WEIGHT)
 {
+    tokens = capacity();
+    clock.start();
+    uptime.start();
+    timer.setSingleShot(true);
+}
+
+bool IrcCommandQueuePrivate::messageFilter(IrcMessage* msg)
+{
+    rekey();
+
+    // the channels that are joined decide whether a part cancels a join
+    switch (msg->type()) {
+    case IrcMessage::Join:
+        if (msg->isOwn()) {
+            const QString channel = static_cast<IrcJoinMessage*>(msg)->channel();
+            joined.insert(key(channel), channel);
+        }
+        break;
+    case IrcMessage::Part:
+        if (msg->isOwn())
+            joined.remove(key(static_cast<IrcPartMessage*>(msg)->channel()));
+        break;
+    case IrcMessage::Kick: {
+        IrcKickMessage* kickMsg = static_cast<IrcKickMessage*>(msg);
+        if (equals(kickMsg->user(), connection->nickName()))
+            joined.remove(key(kickMsg->channel()));
+        break;
+    }
+    case IrcMessage::Numeric:
+        if (static_cast<IrcNumericMessage*>(msg)->code() == Irc::RPL_WELCOME)
+            joined.clear();
+        break;
+    default:
+        break;
+    }
+    return false;
 }
 
 bool IrcCommandQueuePrivate::commandFilter(IrcCommand* cmd)
 {
     Q_Q(IrcCommandQueue);
+    rekey();
     if (cmd->type() == IrcCommand::Quit) {
         _irc_sendBatch(true);
-    } else if (interval > 0 && !cmd->parent() && connection->isConnected()) {
-        cmd->setParent(q);
-        commands.enqueue(cmd);
-        emit q->sizeChanged(commands.size());
+    } else if (isQueueing() && !cmd->parent() && connection->isConnected()) {
+        const int l = lane(cmd);
+        if (l == IrcControlLane) {
+            // sent right away, but accounted for
+            refill();
+            tokens -= cost(cmd);
+            return false;
+        }
+        if (!coalescing || !coalesce(cmd, l)) {
+            cmd->setParent(q);
+            IrcCommandQueueItem item;
+            item.command = cmd;
+            item.cost = cost(cmd);
+            item.time = uptime.elapsed();
+            lanes[l].enqueue(target(cmd), item);
+        }
+        emit q->sizeChanged(count());
         _irc_updateTimer();
         return true;
     }
@@ -76,10 +182,14 @@ bool IrcCommandQueuePrivate::commandFilter(IrcCommand* cmd)
 
 void IrcCommandQueuePrivate::_irc_updateTimer()
 {
-    if (connection && interval > 0 && !commands.isEmpty() && connection->isConnected()) {
-        timer.setInterval(interval * 1000);
-        if (!timer.isActive())
-            timer.start();
+    const int next = nextLane();
+    if (connection && isQueueing() && next != -1 && connection->isConnected()) {
+        // wait until the bucket holds enough tokens for the next command
+        refill();
+        const qreal missing = qMin<qreal>(lanes[next].head().cost, capacity()) - tokens;
+        const qreal r = rate();
+        const int wait = missing > 0 && r > 0 ? qCeil(missing * 1000 / r) : 0;
+        timer.start(wait);
     } else {
         if (timer.isActive())
             timer.stop();
@@ -89,19 +199,513 @@ void IrcCommandQueuePrivate::_irc_updateTimer()
 void IrcCommandQueuePrivate::_irc_sendBatch(bool force)
 {
     Q_Q(IrcCommandQueue);
-    if (!commands.isEmpty()) {
-        int i = batch;
-        while ((force || --i >= 0) && !commands.isEmpty()) {
-            IrcCommand* cmd = commands.dequeue();
+    const int size = count();
+    if (size > 0) {
+        refill();
+        int next;
+        while ((next = nextLane()) != -1) {
+            // a command that costs more than a full bucket may overdraw it
+            const int cost = lanes[next].head().cost;
+            if (!force && tokens < cost && tokens < capacity())
+                break;
+            IrcCommand* cmd = take().command;
+            tokens -= cost;
             if (cmd) {
                 connection->sendCommand(cmd);
                 cmd->deleteLater();
             }
         }
-        emit q->sizeChanged(commands.size());
+        if (count() != size)
+            emit q->sizeChanged(count());
+    }
+    _irc_updateTimer();
+}
+
+int IrcCommandQueuePrivate::count() const
+{
+    int size = 0;
+    for (int i = 0; i < IrcLaneCount; ++i)
+        size += lanes[i].size;
+    return size;
+}
+
+int IrcCommandQueuePrivate::nextLane() const
+{
+    const bool interactive = !lanes[IrcInteractiveLane].isEmpty();
+    const bool bulk = !lanes[IrcBulkLane].isEmpty();
+    if (interactive && (!bulk || credit > 0))
+        return IrcInteractiveLane;
+    if (bulk)
+        return IrcBulkLane;
+    return -1;
+}
+
+IrcCommandQueueItem IrcCommandQueuePrivate::take()
+{
+    const int next = nextLane();
+    if (next == IrcInteractiveLane)
+        credit = qMax(0, credit - 1);
+    else
+        credit = INTERACTIVE_WEIGHT;
+    return lanes[next].dequeue();
+}
+
+QString IrcCommandQueuePrivate::target(IrcCommand* cmd) const
+{
+    switch (cmd->type()) {
+    case IrcCommand::CtcpAction:
+    case IrcCommand::CtcpReply:
+    case IrcCommand::CtcpRequest:
+    case IrcCommand::Kick:
+    case IrcCommand::Message:
+    case IrcCommand::Mode:
+    case IrcCommand::Notice:
+        return key(cmd->parameters().value(0));
+    default:
+        // such as the raw lines of a multiline batch
+        return key(IrcCommandPrivate::get(cmd)->target);
+    }
+}
+
+const IrcNameTable* IrcCommandQueuePrivate::nameTable() const
+{
+    if (!connection || !connection->network())
+        return nullptr;
+    return &IrcNetworkPrivate::get(connection->network())->nameTable;
+}
+
+QString IrcCommandQueuePrivate::key(const QString& name) const
+{
+    // fold names as per the server's CASEMAPPING
+    if (const IrcNameTable* names = nameTable())
+        return names->key(name);
+    return name.toLower();
+}
+
+bool IrcCommandQueuePrivate::equals(const QString& one, const QString& another) const
+{
+    if (const IrcNameTable* names = nameTable())
+        return names->equals(one, another);
+    return !one.compare(another, Qt::CaseInsensitive);
+}
+
+int IrcCommandQueuePrivate::indexOf(const QStringList& names, const QString& name) const
+{
+    for (int i = 0; i < names.count(); ++i) {
+        if (equals(names.at(i), name))
+            return i;
+    }
+    return -1;
+}
+
+void IrcCommandQueuePrivate::rekey(bool force)
+{
+    const IrcNameTable* names = nameTable();
+    const int current = names ? names->generation() : -1;
+    if (!force && generation == current)
+        return;
+    generation = current;
+
+    // the case mapping changed, so the flows and joined channels are keyed
+    // again by the commands and spellings they were keyed by originally
+    QHash<QString, QString> channels;
+    foreach (const QString& channel, joined)
+        channels.insert(key(channel), channel);
+    joined = channels;
+
+    for (int i = 0; i < IrcLaneCount; ++i) {
+        IrcCommandQueueLane& queue = lanes[i];
+        QHash<QString, QString> keys;
+        QHash<QString, IrcCommandQueueFlow> flows;
+        for (QHash<QString, IrcCommandQueueFlow>::const_iterator it = queue.flows.constBegin(); it != queue.flows.constEnd(); ++it) {
+            QString k = it.key();
+            foreach (const IrcCommandQueueItem& item, it.value().items) {
+                if (item.command) {
+                    k = target(item.command);
+                    break;
+                }
+            }
+            keys.insert(it.key(), k);
+            IrcCommandQueueFlow& flow = flows[k];
+            flow.items += it.value().items;
+            flow.deficit = qMax(flow.deficit, it.value().deficit);
+        }
+        QQueue<QString> active;
+        foreach (const QString& k, queue.active) {
+            const QString folded = keys.value(k);
+            if (!active.contains(folded))
+                active.enqueue(folded);
+        }
+        queue.flows = flows;
+        queue.active = active;
+    }
+}
+
+int IrcCommandQueuePrivate::lane(IrcCommand* cmd)
+{
+    switch (cmd->priority()) {
+    case IrcCommand::HighPriority:
+        return IrcControlLane;
+    case IrcCommand::NormalPriority:
+        return IrcInteractiveLane;
+    case IrcCommand::LowPriority:
+        return IrcBulkLane;
+    default:
+        break;
+    }
+
+    switch (cmd->type()) {
+    case IrcCommand::Capability:
+    case IrcCommand::Ping:
+    case IrcCommand::Pong:
+        return IrcControlLane;
+    case IrcCommand::Quote:
+        if (cmd->parameters().value(0).startsWith(QLatin1String("AUTHENTICATE"), Qt::CaseInsensitive))
+            return IrcControlLane;
+        return IrcInteractiveLane;
+    case IrcCommand::List:
+    case IrcCommand::Monitor:
+    case IrcCommand::Names:
+    case IrcCommand::Who:
+    case IrcCommand::Whowas:
+        return IrcBulkLane;
+    default:
+        return IrcInteractiveLane;
+    }
+}
+
+void IrcCommandQueueLane::enqueue(const QString& target, const IrcCommandQueueItem& item)
+{
+    IrcCommandQueueFlow& flow = flows[target];
+    if (flow.items.isEmpty())
+        active.enqueue(target);
+    flow.items.enqueue(item);
+    ++size;
+}
+
+const IrcCommandQueueItem& IrcCommandQueueLane::head()
+{
+    // deficit round-robin: a target keeps its turn while its deficit
+    // covers the next command, otherwise it is granted another quantum
+    // and has to wait for the next round
+    forever {
+        IrcCommandQueueFlow& flow = flows[active.head()];
+        if (flow.deficit >= flow.items.head().cost)
+            return flow.items.head();
+        flow.deficit += TARGET_QUANTUM;
+        active.enqueue(active.dequeue());
+    }
+}
+
+IrcCommandQueueItem IrcCommandQueueLane::dequeue()
+{
+    head();
+    const QString target = active.head();
+    IrcCommandQueueFlow& flow = flows[target];
+    IrcCommandQueueItem item = flow.items.dequeue();
+    flow.deficit -= item.cost;
+    if (flow.items.isEmpty()) {
+        active.dequeue();
+        flows.remove(target);
+    }
+    --size;
+    return item;
+}
+
+IrcCommandQueueItem IrcCommandQueueLane::remove(const QString& target, int index)
+{
+    IrcCommandQueueFlow& flow = flows[target];
+    IrcCommandQueueItem item = flow.items.takeAt(index);
+    if (flow.items.isEmpty()) {
+        active.removeOne(target);
+        flows.remove(target);
+    }
+    --size;
+    return item;
+}
+
+IrcCommandQueueFlow* IrcCommandQueueLane::flow(const QString& target)
+{
+    QHash<QString, IrcCommandQueueFlow>::iterator it = flows.find(target);
+    if (it == flows.end())
+        return nullptr;
+    return &it.value();
+}
+
+void IrcCommandQueueLane::clear()
+{
+    foreach (const IrcCommandQueueFlow& flow, flows) {
+        foreach (const IrcCommandQueueItem& item, flow.items)
+            delete item.command;
+    }
+    flows.clear();
+    active.clear();
+    size = 0;
+}
+
+bool IrcCommandQueuePrivate::coalesce(IrcCommand* cmd, int lane)
+{
+    switch (cmd->type()) {
+    case IrcCommand::Join:
+    case IrcCommand::Names:
+    case IrcCommand::Who:
+        return findDuplicate(cmd, lane);
+    case IrcCommand::Mode:
+        return mergeMode(cmd, lane);
+    case IrcCommand::Monitor:
+        return mergeMonitor(cmd, lane);
+    case IrcCommand::Part:
+        return cancelJoin(cmd);
+    default:
+        return false;
+    }
+}
+
+bool IrcCommandQueuePrivate::findDuplicate(IrcCommand* cmd, int lane)
+{
+    const IrcCommandQueueFlow* flow = lanes[lane].flow(target(cmd));
+    if (!flow)
+        return false;
+    const QString str = cmd->toString();
+    foreach (const IrcCommandQueueItem& item, flow->items) {
+        if (item.command && item.command->type() == cmd->type() && !item.command->toString().compare(str, Qt::CaseInsensitive))
+            return true;
+    }
+    return false;
+}
+
+bool IrcCommandQueuePrivate::mergeMode(IrcCommand* cmd, int lane)
+{
+    IrcNetwork* network = connection->network();
+    const QString channel = cmd->parameters().value(0);
+    if (!network->isChannel(channel) || network->channelModes(IrcNetwork::AllTypes).isEmpty())
+        return false;
+
+    // only the last queued command for the channel may be merged to keep the order
+    IrcCommandQueueFlow* flow = lanes[lane].flow(target(cmd));
+    if (!flow)
+        return false;
+    IrcCommandQueueItem& last = flow->items.last();
+    IrcCommand* queued = last.command;
+    if (!queued || queued->type() != IrcCommand::Mode || !equals(queued->parameters().value(0), channel))
+        return false;
+
+    QList<IrcModeChange> changes;
+    if (!IrcCommandPrivate::parseModes(network, queued->parameters(), &changes) || !IrcCommandPrivate::parseModes(network, cmd->parameters(), &changes))
+        return false;
+
+    int args = 0;
+    foreach (const IrcModeChange& change, changes) {
+        if (!change.arg.isEmpty())
+            ++args;
+    }
+    if (args > IrcCommandPrivate::modeLimit(network))
+        return false;
+
+    const QStringList params = IrcCommandPrivate::modeParameters(queued->parameters().value(0), changes);
+    if (!fits(QLatin1String("MODE ") + params.join(QLatin1String(" "))))
+        return false;
+
+    queued->setParameters(params);
+    last.cost = cost(queued);
+    return true;
+}
+
+bool IrcCommandQueuePrivate::mergeMonitor(IrcCommand* cmd, int lane)
+{
+    const QString sign = cmd->parameters().value(0);
+    if (sign != QLatin1String("+") && sign != QLatin1String("-"))
+        return findDuplicate(cmd, lane);
+
+    const QString key = target(cmd);
+    QStringList nicks = cmd->parameters().value(1).split(QLatin1Char(','), Qt::SkipEmptyParts);
+
+    // walk back until a MONITOR C, L or S that depends on the preceding changes
+    IrcCommandQueueFlow* flow = lanes[lane].flow(key);
+    for (int i = flow ? flow->items.count() - 1 : -1; i >= 0 && !nicks.isEmpty(); --i) {
+        IrcCommandQueueItem& item = lanes[lane].flow(key)->items[i];
+        IrcCommand* queued = item.command;
+        if (!queued || queued->type() != IrcCommand::Monitor)
+            continue;
+        const QString other = queued->parameters().value(0);
+        if (other != QLatin1String("+") && other != QLatin1String("-"))
+            break;
+
+        QStringList targets = queued->parameters().value(1).split(QLatin1Char(','), Qt::SkipEmptyParts);
+        const int count = targets.count();
+        foreach (const QString& nick, nicks) {
+            const int index = indexOf(targets, nick);
+            if (index != -1) {
+                // the same change is already queued, or the new one supersedes
+                if (other == sign)
+                    nicks.removeOne(nick);
+                else
+                    targets.removeAt(index);
+            }
+        }
+        if (targets.isEmpty())
+            delete lanes[lane].remove(key, i).command;
+        else if (targets.count() != count) {
+            queued->setParameters(QStringList() << other << targets.join(QLatin1String(",")));
+            item.cost = cost(queued);
+        }
+    }
+    if (nicks.isEmpty())
+        return true;
+
+    // append the remaining nicks to the last queued change of the same kind
+    flow = lanes[lane].flow(key);
+    if (flow) {
+        IrcCommandQueueItem& last = flow->items.last();
+        IrcCommand* queued = last.command;
+        if (queued && queued->type() == IrcCommand::Monitor && queued->parameters().value(0) == sign) {
+            const QStringList targets = queued->parameters().value(1).split(QLatin1Char(','), Qt::SkipEmptyParts) + nicks;
+            const int limit = connection->network()->targetLimit(QLatin1String("MONITOR"));
+            const QString param = targets.join(QLatin1String(","));
+            if ((limit <= 0 || targets.count() <= limit) && fits(QLatin1String("MONITOR ") + sign + QLatin1Char(' ') + param)) {
+                queued->setParameters(QStringList() << sign << param);
+                last.cost = cost(queued);
+                return true;
+            }
+        }
     }
+    cmd->setParameters(QStringList() << sign << nicks.join(QLatin1String(",")));
+    return false;
+}
+
+bool IrcCommandQueuePrivate::cancelJoin(IrcCommand* part)
+{
+    QStringList params = part->parameters();
+    QStringList channels = params.value(0).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    const int count = channels.count();
+
+    foreach (const QString& channel, channels) {
+        // queued commands for the channel still need the channel to be joined
+        bool busy = false;
+        for (int i = 0; !busy && i < IrcLaneCount; ++i)
+            busy = lanes[i].flow(key(channel)) != nullptr;
+        if (busy)
+            continue;
+
+        bool cancelled = false;
+        for (int i = 0; !cancelled && i < IrcLaneCount; ++i) {
+            IrcCommandQueueFlow* flow = lanes[i].flow(QString());
+            for (int j = flow ? flow->items.count() - 1 : -1; !cancelled && j >= 0; --j) {
+                IrcCommandQueueItem& item = flow->items[j];
+                IrcCommand* queued = item.command;
+                if (!queued || queued->type() != IrcCommand::Join)
+                    continue;
+                QStringList joins = queued->parameters().value(0).split(QLatin1Char(','), Qt::SkipEmptyParts);
+                const int index = indexOf(joins, channel);
+                if (index == -1)
+                    continue;
+
+                // a joined channel is still parted, only the join is redundant
+                cancelled = true;
+                if (!joined.contains(key(channel)))
+                    channels.removeOne(channel);
+                joins.removeAt(index);
+                if (joins.isEmpty()) {
+                    delete lanes[i].remove(QString(), j).command;
+                } else {
+                    QStringList keys = queued->parameters().value(1).split(QLatin1Char(','));
+                    if (index < keys.count())
+                        keys.removeAt(index);
+                    while (!keys.isEmpty() && keys.last().isEmpty())
+                        keys.removeLast();
+                    QStringList args = QStringList() << joins.join(QLatin1String(","));
+                    if (!keys.isEmpty())
+                        args += keys.join(QLatin1String(","));
+                    queued->setParameters(args);
+                    item.cost = cost(queued);
+                }
+            }
+        }
+    }
+    if (channels.isEmpty())
+        return true;
+    if (channels.count() != count) {
+        params[0] = channels.join(QLatin1String(","));
+        part->setParameters(params);
+    }
+    return false;
+}
+
+bool IrcCommandQueuePrivate::fits(const QString& command) const
+{
+    return command.toUtf8().size() + 2 <= connection->network()->numericLimit(IrcNetwork::MessageLength);
+}
+
+void IrcCommandQueuePrivate::_irc_updateLag(qint64 lag)
+{
+    if (lag < 0)
+        return;
+    if (baseLag < 0 || lag < baseLag)
+        baseLag = lag;
+    refill();
+    if (lag > 2 * baseLag + LAG_TOLERANCE)
+        factor = qMax(MIN_FACTOR, factor / 2);
+    else
+        factor = qMin<qreal>(1.0, factor + FACTOR_STEP);
     _irc_updateTimer();
 }
+
+int IrcCommandQueuePrivate::cost(IrcCommand* cmd)
+{
+    int penalty = 0;
+    switch (cmd->type()) {
+    case IrcCommand::List:
+        penalty = 3;
+        break;
+    case IrcCommand::Who:
+    case IrcCommand::Invite:
+    case IrcCommand::Knock:
+        penalty = 2;
+        break;
+    case IrcCommand::Join:
+    case IrcCommand::Kick:
+    case IrcCommand::Mode:
+    case IrcCommand::Names:
+    case IrcCommand::Nick:
+    case IrcCommand::Topic:
+    case IrcCommand::Whois:
+    case IrcCommand::Whowas:
+        penalty = 1;
+        break;
+    default:
+        break;
+    }
+    // a multiline batch is a single raw command of several lines
+    const QByteArray data = cmd->toString().toUtf8();
+    const int lines = data.count('\n') + 1;
+    const int bytes = data.size() + 2; // CRLF
+    return LINE_COST * (lines + penalty) + qMax(0, bytes - lines * LINE_BYTES) * LINE_COST / LINE_BYTES;
+}
+
+bool IrcCommandQueuePrivate::isQueueing() const
+{
+    // an empty bucket would never refill
+    return batch > 0 && interval > 0;
+}
+
+qreal IrcCommandQueuePrivate::capacity() const
+{
+    return qMax(batch, 0) * LINE_COST;
+}
+
+qreal IrcCommandQueuePrivate::rate() const
+{
+    // tokens per second
+    if (!isQueueing())
+        return 0;
+    return capacity() * factor / interval;
+}
+
+void IrcCommandQueuePrivate::refill()
+{
+    const qint64 elapsed = clock.restart();
+    tokens = qMin(capacity(), tokens + elapsed * rate() / 1000);
+}
 #endif // IRC_DOXYGEN
 
 /*!
@@ -129,8 +733,11 @@ IrcCommandQueue::~IrcCommandQueue()
 /*!
     This property holds the batch size.
 
-    This is the amount of commands sent at once.
-    The default value is \c 3.
+    This is the amount of short commands that can be sent at once, and
+    that are allowed per \ref interval. Long commands and commands with
+    a penalty count as several short commands.
+    The default value is \c 3. A value equal to or less than \c 0
+    disables command queueing.
 
     \par Access functions:
     \li int <b>batch</b>() const
@@ -145,13 +752,19 @@ int IrcCommandQueue::batch() const
 void IrcCommandQueue::setBatch(int batch)
 {
     Q_D(IrcCommandQueue);
-    d->batch = batch;
+    if (d->batch != batch) {
+        d->refill();
+        d->batch = batch;
+        d->tokens = qMin(d->tokens, d->capacity());
+        d->_irc_updateTimer();
+    }
 }
 
 /*!
     This property holds the queue processing interval in seconds.
 
-    The default value is \c 2 seconds. A value equal to or
+    The queue is refilled at the rate of \ref batch short commands
+    per interval. The default value is \c 2 seconds. A value equal to or
     less than \c 0 seconds disables command queueing.
 
     \par Access functions:
@@ -168,11 +781,36 @@ void IrcCommandQueue::setInterval(int seconds)
 {
     Q_D(IrcCommandQueue);
     if (d->interval != seconds) {
+        d->refill();
         d->interval = seconds;
         d->_irc_updateTimer();
     }
 }
 
+/*!
+    \since 3.7
+
+    This property holds whether redundant queued commands are coalesced.
+
+    When enabled, commands that are made redundant by other queued commands
+    are dropped or merged before they are sent. The default value is \c true.
+
+    \par Access functions:
+    \li bool <b>isCoalescing</b>() const
+    \li void <b>setCoalescing</b>(bool coalescing)
+ */
+bool IrcCommandQueue::isCoalescing() const
+{
+    Q_D(const IrcCommandQueue);
+    return d->coalescing;
+}
+
+void IrcCommandQueue::setCoalescing(bool coalescing)
+{
+    Q_D(IrcCommandQueue);
+    d->coalescing = coalescing;
+}
+
 /*!
     This property holds the current size of the queue.
 
@@ -185,7 +823,83 @@ void IrcCommandQueue::setInterval(int seconds)
 int IrcCommandQueue::size() const
 {
     Q_D(const IrcCommandQueue);
-    return d->commands.size();
+    return d->count();
+}
+
+/*!
+    \since 3.7
+
+    This property holds the targets that have queued commands.
+
+    The targets are channels and users that queued messages, notices,
+    CTCPs, modes and kicks are addressed to, case folded as per the
+    server's CASEMAPPING.
+
+    \par Access function:
+    \li QStringList <b>targets</b>() const
+
+    \par Notifier signal:
+    \li void <b>sizeChanged</b>(int size)
+
+    \sa depth(), waitTime()
+ */
+QStringList IrcCommandQueue::targets() const
+{
+    Q_D(const IrcCommandQueue);
+    const_cast<IrcCommandQueuePrivate*>(d)->rekey();
+    QStringList targets;
+    for (int i = 0; i < IrcLaneCount; ++i) {
+        foreach (const QString& target, d->lanes[i].flows.keys()) {
+            if (!target.isEmpty() && !targets.contains(target))
+                targets += target;
+        }
+    }
+    targets.sort();
+    return targets;
+}
+
+/*!
+    \since 3.7
+
+    Returns the amount of queued commands for \a target.
+
+    Commands that are not addressed to a specific target are counted
+    for an empty \a target.
+
+    \sa targets, size
+ */
+int IrcCommandQueue::depth(const QString& target) const
+{
+    Q_D(const IrcCommandQueue);
+    const_cast<IrcCommandQueuePrivate*>(d)->rekey();
+    const QString key = d->key(target);
+    int depth = 0;
+    for (int i = 0; i < IrcLaneCount; ++i)
+        depth += d->lanes[i].flows.value(key).items.size();
+    return depth;
+}
+
+/*!
+    \since 3.7
+
+    Returns the time in milliseconds that the oldest queued command
+    for \a target has been waiting, or \c -1 if there are no queued
+    commands for \a target.
+
+    \sa targets, depth()
+ */
+qint64 IrcCommandQueue::waitTime(const QString& target) const
+{
+    Q_D(const IrcCommandQueue);
+    const_cast<IrcCommandQueuePrivate*>(d)->rekey();
+    const QString key = d->key(target);
+    qint64 wait = -1;
+    for (int i = 0; i < IrcLaneCount; ++i) {
+        const IrcCommandQueueFlow flow = d->lanes[i].flows.value(key);
+        if (!flow.items.isEmpty())
+            wait = qMax(wait, d->uptime.elapsed() - flow.items.head().time);
+    }
+    return wait;
 }
 
 /*!
@@ -206,12 +920,16 @@ void IrcCommandQueue::setConnection(IrcConnection* connection)
     Q_D(IrcCommandQueue);
     if (d->connection != connection) {
         if (d->connection) {
+            d->connection->removeMessageFilter(d);
             d->connection->removeCommandFilter(d);
             disconnect(d->connection, SIGNAL(connected()), this, SLOT(_irc_sendBatch()));
             disconnect(d->connection, SIGNAL(disconnected()), this, SLOT(_irc_updateTimer()));
         }
         d->connection = connection;
+        d->joined.clear();
+        d->rekey(true);
         if (connection) {
+            connection->installMessageFilter(d);
             connection->installCommandFilter(d);
             connect(connection, SIGNAL(connected()), this, SLOT(_irc_sendBatch()));
             connect(connection, SIGNAL(disconnected()), this, SLOT(_irc_updateTimer()));
@@ -220,6 +938,40 @@ void IrcCommandQueue::setConnection(IrcConnection* connection)
     }
 }
 
+/*!
+    \since 3.7
+
+    This property holds the lag timer used for adapting the queue rate.
+
+    When the lag reported by the timer grows, the queue slows down to avoid
+    being throttled or disconnected for excess flood by the server.
+    The default value is \c nullptr.
+
+    \par Access functions:
+    \li IrcLagTimer* <b>lagTimer</b>() const
+    \li void <b>setLagTimer</b>(IrcLagTimer* timer)
+ */
+IrcLagTimer* IrcCommandQueue::lagTimer() const
+{
+    Q_D(const IrcCommandQueue);
+    return d->lagTimer;
+}
+
+void IrcCommandQueue::setLagTimer(IrcLagTimer* timer)
+{
+    Q_D(IrcCommandQueue);
+    if (d->lagTimer != timer) {
+        if (d->lagTimer)
+            disconnect(d->lagTimer, SIGNAL(lagChanged(qint64)), this, SLOT(_irc_updateLag(qint64)));
+        d->lagTimer = timer;
+        d->baseLag = -1;
+        d->factor = 1.0;
+        if (timer)
+            connect(timer, SIGNAL(lagChanged(qint64)), this, SLOT(_irc_updateLag(qint64)));
+        d->_irc_updateTimer();
+    }
+}
+
 /*!
     This methods clears the command queue.
 
@@ -230,8 +982,8 @@ void IrcCommandQueue::setConnection(IrcConnection* connection)
 void IrcCommandQueue::clear()
 {
     Q_D(IrcCommandQueue);
-    qDeleteAll(d->commands);
-    d->commands.clear();
+    for (int i = 0; i < IrcLaneCount; ++i)
+        d->lanes[i].clear();
     d->_irc_updateTimer();
 }
 
@@ -30,8 +30,11 @@
 #include "irccommandparser.h"
 #include "irccommandparser_p.h"
 #include "ircbuffermodel.h"
-#include "ircusermodel.h"
+#include "ircbuffermodel_p.h"
+#include "ircchannel_p.h"
+#include "ircuser_p.h"
 #include "ircnetwork.h"
+#include "ircnetwork_p.h"
 #include "ircchannel.h"
 #include "irctoken_p.h"
 #include "irccore_p.h"
@@ -39,8 +42,11 @@
 
 #include <QTextBoundaryFinder>
 #include <QPointer>
+#include <QHash>
 #include <QList>
 #include <QPair>
+#include <QSet>
+#include <algorithm>
 
 IRC_BEGIN_NAMESPACE
 
@@ -96,19 +102,16 @@ IRC_BEGIN_NAMESPACE
 
 #ifndef IRC_DOXYGEN
 
-static bool isPrefixed(const QString& text, int pos, const QStringList& prefixes, int* len)
+static bool isPrefixed(const QString& text, int pos, const IrcNetworkPrivate* network, int* len)
 {
-    foreach (const QString& prefix, prefixes) {
-        const int ll = prefix.length();
-        if (text.mid(pos, ll) == prefix) {
-            if (len)
-                *len = 0;
-            return true;
-        } else if (text.mid(pos - ll, ll) == prefix) {
-            if (len)
-                *len = ll;
-            return true;
-        }
+    if (pos >= 0 && pos < text.length() && network->channelTypeIndex(text.at(pos)) != -1) {
+        if (len)
+            *len = 0;
+        return true;
+    } else if (pos > 0 && pos <= text.length() && network->channelTypeIndex(text.at(pos - 1)) != -1) {
+        if (len)
+            *len = 1;
+        return true;
     }
     return false;
 }
@@ -131,6 +134,9 @@ class IrcCompleterPrivate
 public:
     IrcCompleterPrivate();
 
+    // tab completion cycles through at most this many candidates per kind
+    enum { MaxCompletions = 256 };
+
     void completeNext(IrcCompleter::Direction direction);
     QList<IrcCompletion> completeCommands(const QString& text, int pos) const;
     QList<IrcCompletion> completeWords(const QString& text, int pos) const;
@@ -215,6 +221,43 @@ static IrcCompletion completeWord(const QString& text, int from, int len, const
     return IrcCompletion(completion, ++next);
 }
 
+static bool addUnique(QSet<QPair<QString, int> >* seen, const IrcCompletion& completion)
+{
+    const QPair<QString, int> key = qMakePair(completion.text, completion.cursor);
+    if (seen->contains(key))
+        return false;
+    seen->insert(key);
+    return true;
+}
+
+struct IrcUserActivityGreaterThan
+{
+    bool operator()(IrcUser* one, IrcUser* another) const
+    {
+        return IrcUserPrivate::get(one)->activity > IrcUserPrivate::get(another)->activity;
+    }
+};
+
+// the current buffer first, then in the order of the buffer model
+struct IrcBufferOrder
+{
+    IrcBufferOrder(const IrcBufferModelPrivate* model, IrcBuffer* current) : current(current)
+    {
+        // rank the buffers once instead of looking them up per comparison
+        ranks.reserve(model->bufferList.count());
+        for (int i = 0; i < model->bufferList.count(); ++i)
+            ranks.insert(model->bufferList.at(i), i);
+    }
+    bool operator()(IrcBuffer* one, IrcBuffer* another) const
+    {
+        if ((one == current) != (another == current))
+            return one == current;
+        return ranks.value(one) < ranks.value(another);
+    }
+    QHash<IrcBuffer*, int> ranks;
+    IrcBuffer* current;
+};
+
 QList<IrcCompletion> IrcCompleterPrivate::completeWords(const QString& text, int pos) const
 {
     if (!buffer || !buffer->network())
@@ -229,44 +272,61 @@ QList<IrcCompletion> IrcCompleterPrivate::completeWords(const QString& text, int
 
         int pfx = 0;
         QString prefix;
-        bool isChannel = isPrefixed(text, bounds.first, buffer->network()->channelTypes(), &pfx);
+        bool isChannel = isPrefixed(text, bounds.first, IrcNetworkPrivate::get(buffer->network()), &pfx);
         if (isChannel && pfx > 0)
             prefix = text.mid(bounds.first - pfx, pfx);
 
+        // compare case folded names as per the server's CASEMAPPING
+        const IrcNameTable& names = IrcNetworkPrivate::get(buffer->network())->nameTable;
+        const QString folded = names.fold(word);
+
+        QSet<QPair<QString, int> > seen;
+
         if (!isChannel) {
-            IrcUserModel userModel;
-            userModel.setSortMethod(Irc::SortByActivity);
-            userModel.setChannel(qobject_cast<IrcChannel*>(buffer));
-            foreach (IrcUser* user, userModel.users()) {
-                if (user->name().startsWith(word, Qt::CaseInsensitive)) {
+            if (IrcChannel* channel = buffer->toChannel()) {
+                const IrcNameIndex<IrcUser>& index = IrcChannelPrivate::get(channel)->userIndex;
+                foreach (IrcUser* user, index.find(folded, MaxCompletions, IrcUserActivityGreaterThan())) {
                     QString name = user->name();
                     if (token.index() == 0)
                         name += suffix;
-                    IrcCompletion completion = completeWord(text, bounds.first, bounds.second, name);
-                    if (completion.isValid() && !completions.contains(completion))
+                    const IrcCompletion completion = completeWord(text, bounds.first, bounds.second, name);
+                    if (completion.isValid() && addUnique(&seen, completion))
                         completions += completion;
                 }
             }
         }
 
-        QList<IrcBuffer*> buffers = buffer->model()->buffers();
-        buffers.move(buffers.indexOf(buffer), 0); // promote the current buffer
-        foreach (IrcBuffer* buffer, buffers) {
-            if (!buffer->isChannel()) {
-                // it would be very confusing to auto-complete the titles of other
-                // open query (or server) buffers, because it makes it look like such
-                // user would be on the channel
-                continue;
+        // it would be very confusing to auto-complete the titles of other
+        // open query (or server) buffers, because it makes it look like such
+        // user would be on the channel, so only channels are indexed
+        IrcBufferModelPrivate* model = IrcBufferModelPrivate::get(buffer->model());
+        const IrcBufferOrder order(model, buffer);
+        QList<IrcBuffer*> channels = model->channelIndex.find(folded, MaxCompletions, order);
+        QSet<IrcBuffer*> prefixed;
+        if (isChannel && !prefix.isEmpty()) {
+            QSet<IrcBuffer*> unprefixed;
+            foreach (IrcBuffer* channel, channels)
+                unprefixed.insert(channel);
+            foreach (IrcBuffer* channel, model->channelIndex.find(prefix + folded, MaxCompletions, order)) {
+                if (!unprefixed.contains(channel)) {
+                    prefixed.insert(channel);
+                    channels += channel;
+                }
             }
-            QString title = buffer->title();
+            const int count = qMin<int>(channels.count(), MaxCompletions);
+            std::partial_sort(channels.begin(), channels.begin() + count, channels.end(), order);
+            channels.erase(channels.begin() + count, channels.end());
+        }
+        foreach (IrcBuffer* channel, channels) {
+            QString title = channel->title();
             if (!isChannel && token.index() == 0)
                 title += suffix;
             IrcCompletion completion;
-            if (title.startsWith(word, Qt::CaseInsensitive))
+            if (!prefixed.contains(channel))
                 completion = completeWord(text, bounds.first, bounds.second, title);
-            else if (isChannel && !prefix.isEmpty() && title.startsWith(prefix + word, Qt::CaseInsensitive))
+            else
                 completion = completeWord(text, bounds.first - prefix.length(), bounds.second + prefix.length(), title);
-            if (completion.isValid() && !completions.contains(completion))
+            if (completion.isValid() && addUnique(&seen, completion))
                 completions += completion;
         }
     }
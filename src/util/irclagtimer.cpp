@@ -29,13 +29,20 @@
 #include "irclagtimer.h"
 #include "irclagtimer_p.h"
 #include "ircconnection.h"
+#include "ircnetwork.h"
 #include "ircmessage.h"
+#include "ircmessage_p.h"
 #include "irccommand.h"
-#include <QDateTime>
+#include <QElapsedTimer>
+#include <QtCore/qmath.h>
+#include <algorithm>
 
 IRC_BEGIN_NAMESPACE
 
 static const int DEFAULT_INTERVAL = 60;
+static const int DEFAULT_WINDOW = 20;
+// the amount of sent messages remembered while waiting for their echo
+static const int MAX_ECHOES = 64;
 
 /*!
     \file irclagtimer.h
@@ -47,6 +54,17 @@ static const int DEFAULT_INTERVAL = 60;
     \ingroup util
     \brief Provides a timer for measuring lag.
 
+    IrcLagTimer measures the round trip time of PING commands on a
+    monotonic clock, and keeps the last \ref windowSize measurements
+    for statistics such as \ref medianLag and percentile().
+
+    When the \c echo-message capability is active, the round trip of
+    sent messages is measured as well, and so is the round trip of
+    IrcConnection::sendRequest() when the \c labeled-response capability
+    is active. Active PINGs are skipped while
+    such passive measurements arrive at least once per \ref interval,
+    which saves a line per interval on busy connections.
+
     \note IrcLagTimer relies on functionality introduced in Qt 4.7.0, and is
           therefore not functional when built against earlier versions of Qt.
  */
@@ -57,15 +75,75 @@ static const int DEFAULT_INTERVAL = 60;
     This signal is emitted when the \a lag has changed.
  */
 
+/*!
+    \since 3.7
+    \fn void IrcLagTimer::statisticsChanged()
+
+    This signal is emitted when a lag measurement has been added to,
+    or the measurements have been removed from the statistics.
+ */
+
 #ifndef IRC_DOXYGEN
-IrcLagTimerPrivate::IrcLagTimerPrivate() :  interval(DEFAULT_INTERVAL)
+IrcLagTimerPrivate::IrcLagTimerPrivate() :  interval(DEFAULT_INTERVAL), windowSize(DEFAULT_WINDOW)
 {
 }
 
 bool IrcLagTimerPrivate::messageFilter(IrcMessage* msg)
 {
-    if (msg->type() == IrcMessage::Pong)
+    // the response to a labeled request measures the lag like an echo
+    const qint64 roundTrip = IrcMessagePrivate::get(msg)->roundTrip;
+    if (roundTrip >= 0) {
+        lastPassive = now();
+        addSample(roundTrip);
+    }
+
+    switch (msg->type()) {
+    case IrcMessage::Pong:
         return processPongReply(static_cast<IrcPongMessage*>(msg));
+    case IrcMessage::Private:
+        if (!echoes.isEmpty() && msg->isOwn()) {
+            IrcPrivateMessage* privMsg = static_cast<IrcPrivateMessage*>(msg);
+            processEcho(privMsg->target(), privMsg->content());
+        }
+        return false;
+    case IrcMessage::Notice:
+        if (!echoes.isEmpty() && msg->isOwn()) {
+            IrcNoticeMessage* notice = static_cast<IrcNoticeMessage*>(msg);
+            processEcho(notice->target(), notice->content());
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+bool IrcLagTimerPrivate::commandFilter(IrcCommand* cmd)
+{
+#if QT_VERSION >= 0x040700
+    if ((cmd->type() == IrcCommand::Message || cmd->type() == IrcCommand::Notice)
+            && connection->network()->isCapable(QLatin1String("echo-message"))) {
+        IrcLagTimerEcho echo;
+        echo.key = cmd->parameters().value(0).toLower() + QLatin1Char(' ') + QStringList(cmd->parameters().mid(1)).join(QLatin1String(" "));
+        echo.time = now();
+        // a queued command passes again when it is actually sent
+        bool resent = false;
+        if (cmd->parent()) {
+            for (int i = 0; !resent && i < echoes.count(); ++i) {
+                if (echoes.at(i).key == echo.key) {
+                    echoes[i].time = echo.time;
+                    resent = true;
+                }
+            }
+        }
+        if (!resent) {
+            echoes.enqueue(echo);
+            if (echoes.count() > MAX_ECHOES)
+                echoes.dequeue();
+        }
+    }
+#else
+    Q_UNUSED(cmd);
+#endif // QT_VERSION
     return false;
 }
 
@@ -78,7 +156,7 @@ bool IrcLagTimerPrivate::processPongReply(IrcPongMessage* msg)
         qint64 timestamp = msg->argument().mid(8).toLongLong(&ok);
         if (ok) {
             --pendingPings;
-            updateLag(QDateTime::currentMSecsSinceEpoch() - timestamp);
+            addSample(now() - timestamp);
             return true;
         }
     }
@@ -86,6 +164,19 @@ bool IrcLagTimerPrivate::processPongReply(IrcPongMessage* msg)
     return false;
 }
 
+void IrcLagTimerPrivate::processEcho(const QString& target, const QString& content)
+{
+    const QString key = target.toLower() + QLatin1Char(' ') + content;
+    for (int i = 0; i < echoes.count(); ++i) {
+        if (echoes.at(i).key == key) {
+            const qint64 time = echoes.takeAt(i).time;
+            lastPassive = now();
+            addSample(lastPassive - time);
+            break;
+        }
+    }
+}
+
 void IrcLagTimerPrivate::_irc_connected()
 {
 #if QT_VERSION >= 0x040700
@@ -98,8 +189,12 @@ void IrcLagTimerPrivate::_irc_connected()
 void IrcLagTimerPrivate::_irc_pingServer()
 {
 #if QT_VERSION >= 0x040700
+    // passive measurements within the interval make an active ping unnecessary
+    if (lastPassive != -1 && now() - lastPassive < interval * 1000000ll)
+        return;
+
     // TODO: configurable format?
-    QString cmd = QString("PING communi/%1").arg(QDateTime::currentMSecsSinceEpoch());
+    QString cmd = QString("PING communi/%1").arg(now());
     connection->sendData(cmd.toUtf8());
     qint64 pingLag = pendingPings * interval * 1000ll;
     if (lag > -1 && pingLag > lag)
@@ -112,6 +207,7 @@ void IrcLagTimerPrivate::_irc_disconnected()
 {
 #if QT_VERSION >= 0x040700
     updateLag(-1);
+    clearSamples();
     pendingPings = 0;
     if (timer.isActive())
         timer.stop();
@@ -129,6 +225,7 @@ void IrcLagTimerPrivate::updateTimer()
         if (timer.isActive())
             timer.stop();
         updateLag(-1);
+        clearSamples();
     }
 #endif // QT_VERSION
 }
@@ -142,6 +239,35 @@ void IrcLagTimerPrivate::updateLag(qint64 value)
         emit q->lagChanged(lag);
     }
 }
+
+void IrcLagTimerPrivate::addSample(qint64 usecs)
+{
+    Q_Q(IrcLagTimer);
+    const qint64 msecs = qMax(0ll, (usecs + 500) / 1000);
+    samples += msecs;
+    while (samples.count() > qMax(1, windowSize))
+        samples.removeFirst();
+    updateLag(msecs);
+    emit q->statisticsChanged();
+}
+
+void IrcLagTimerPrivate::clearSamples()
+{
+    Q_Q(IrcLagTimer);
+    echoes.clear();
+    lastPassive = -1;
+    if (!samples.isEmpty()) {
+        samples.clear();
+        emit q->statisticsChanged();
+    }
+}
+
+qint64 IrcLagTimerPrivate::now()
+{
+    // microseconds on a monotonic clock shared by all lag timers
+    static const QElapsedTimer clock = []() { QElapsedTimer timer; timer.start(); return timer; }();
+    return clock.nsecsElapsed() / 1000;
+}
 #endif // IRC_DOXYGEN
 
 /*!
@@ -184,16 +310,19 @@ void IrcLagTimer::setConnection(IrcConnection* connection)
     if (d->connection != connection) {
         if (d->connection) {
             d->connection->removeMessageFilter(d);
+            d->connection->removeCommandFilter(d);
             disconnect(d->connection, SIGNAL(connected()), this, SLOT(_irc_connected()));
             disconnect(d->connection, SIGNAL(disconnected()), this, SLOT(_irc_disconnected()));
         }
         d->connection = connection;
         if (connection) {
             connection->installMessageFilter(d);
+            connection->installCommandFilter(d);
             connect(connection, SIGNAL(connected()), this, SLOT(_irc_connected()));
             connect(connection, SIGNAL(disconnected()), this, SLOT(_irc_disconnected()));
         }
         d->updateLag(-1);
+        d->clearSamples();
         d->updateTimer();
     }
 }
@@ -219,6 +348,115 @@ qint64 IrcLagTimer::lag() const
     return d->lag;
 }
 
+/*!
+    \since 3.7
+
+    This property holds the lowest lag in milliseconds within the
+    measurement window, or \c -1 if the lag has not been measured.
+
+    \par Access function:
+    \li qint64 <b>minimumLag</b>() const
+
+    \par Notifier signal:
+    \li void <b>statisticsChanged</b>()
+
+    \sa windowSize, percentile()
+ */
+qint64 IrcLagTimer::minimumLag() const
+{
+    return percentile(0);
+}
+
+/*!
+    \since 3.7
+
+    This property holds the median lag in milliseconds within the
+    measurement window, or \c -1 if the lag has not been measured.
+
+    \par Access function:
+    \li qint64 <b>medianLag</b>() const
+
+    \par Notifier signal:
+    \li void <b>statisticsChanged</b>()
+
+    \sa windowSize, percentile()
+ */
+qint64 IrcLagTimer::medianLag() const
+{
+    return percentile(50);
+}
+
+/*!
+    \since 3.7
+
+    This property holds the highest lag in milliseconds within the
+    measurement window, or \c -1 if the lag has not been measured.
+
+    \par Access function:
+    \li qint64 <b>maximumLag</b>() const
+
+    \par Notifier signal:
+    \li void <b>statisticsChanged</b>()
+
+    \sa windowSize, percentile()
+ */
+qint64 IrcLagTimer::maximumLag() const
+{
+    return percentile(100);
+}
+
+/*!
+    \since 3.7
+
+    Returns the lag in milliseconds at the given \a percent (0-100) of the
+    measurements within the window, or \c -1 if the lag has not been measured.
+
+    For example, \c percentile(95) returns the lag that 95% of the
+    measurements did not exceed.
+
+    \sa minimumLag, medianLag, maximumLag
+ */
+qint64 IrcLagTimer::percentile(int percent) const
+{
+    Q_D(const IrcLagTimer);
+    if (d->samples.isEmpty())
+        return -1;
+    QList<qint64> sorted = d->samples;
+    std::sort(sorted.begin(), sorted.end());
+    // nearest rank
+    const int rank = qCeil(qBound(0, percent, 100) * sorted.count() / 100.0);
+    return sorted.at(qMax(rank - 1, 0));
+}
+
+/*!
+    \since 3.7
+
+    This property holds the amount of lag measurements kept for statistics.
+
+    The default value is \c 20.
+
+    \par Access functions:
+    \li int <b>windowSize</b>() const
+    \li void <b>setWindowSize</b>(int size)
+ */
+int IrcLagTimer::windowSize() const
+{
+    Q_D(const IrcLagTimer);
+    return d->windowSize;
+}
+
+void IrcLagTimer::setWindowSize(int size)
+{
+    Q_D(IrcLagTimer);
+    if (d->windowSize != size) {
+        d->windowSize = size;
+        if (d->samples.count() > qMax(1, size)) {
+            d->samples = d->samples.mid(d->samples.count() - qMax(1, size));
+            emit statisticsChanged();
+        }
+    }
+}
+
 /*!
     This property holds the lag measurement interval in seconds.
 
@@ -0,0 +1,480 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "irclogwriter.h"
+#include "irclogwriter_p.h"
+#include "ircconnection.h"
+#include "ircnetwork.h"
+#include "ircnetwork_p.h"
+#include "ircmessage.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QFileInfo>
+#include <QDir>
+#include <QUrl>
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file irclogwriter.h
+    \brief \#include &lt;IrcLogWriter&gt;
+ */
+
+/*!
+    \since 3.7
+    \class IrcLogWriter irclogwriter.h <IrcLogWriter>
+    \ingroup util
+    \brief Writes connection messages to log files in the background.
+
+    IrcLogWriter installs a message filter on the \ref connection, and
+    appends every message to a log file per target (channel or query) in
+    the given \ref directory. Messages without a target are logged to a
+    file named after the server host.
+
+    Each line consists of an ISO 8601 timestamp and the raw message line.
+
+    The filter only copies the raw line into a bounded queue, which a
+    background thread writes to disk in batches every \ref flushInterval
+    milliseconds. A slow disk therefore never stalls message processing.
+    When the queue is full, messages are dropped and counted in \ref dropped.
+
+    \code
+    IrcLogWriter* writer = new IrcLogWriter(connection);
+    writer->setDirectory(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/logs");
+    writer->setRotationSize(10 * 1024 * 1024);
+    \endcode
+ */
+
+#ifndef IRC_DOXYGEN
+void IrcLogWriterThread::run()
+{
+    forever {
+        writer->drain();
+        QMutexLocker locker(&writer->mutex);
+        if (writer->stopped)
+            break;
+        writer->condition.wait(&writer->mutex, writer->flushInterval);
+    }
+    writer->drain();
+    writer->closeFiles();
+}
+
+IrcLogWriterPrivate::IrcLogWriterPrivate() : thread(this)
+{
+}
+
+IrcLogWriterPrivate::~IrcLogWriterPrivate()
+{
+    stop();
+}
+
+bool IrcLogWriterPrivate::messageFilter(IrcMessage* message)
+{
+    if (!ring)
+        return false;
+
+    QString target;
+    switch (message->type()) {
+    case IrcMessage::Private: {
+        IrcPrivateMessage* msg = static_cast<IrcPrivateMessage*>(message);
+        target = msg->isPrivate() ? msg->nick() : msg->target();
+        break;
+    }
+    case IrcMessage::Notice: {
+        IrcNoticeMessage* msg = static_cast<IrcNoticeMessage*>(message);
+        target = msg->isPrivate() ? msg->nick() : msg->target();
+        break;
+    }
+    case IrcMessage::Join:
+        target = static_cast<IrcJoinMessage*>(message)->channel();
+        break;
+    case IrcMessage::Part:
+        target = static_cast<IrcPartMessage*>(message)->channel();
+        break;
+    case IrcMessage::Kick:
+        target = static_cast<IrcKickMessage*>(message)->channel();
+        break;
+    case IrcMessage::Topic:
+        target = static_cast<IrcTopicMessage*>(message)->channel();
+        break;
+    case IrcMessage::Mode:
+        target = static_cast<IrcModeMessage*>(message)->target();
+        break;
+    default:
+        break;
+    }
+
+    IrcLogRecord record;
+    record.timeStamp = message->timeStamp().toMSecsSinceEpoch();
+    if (target.isEmpty() || !connection)
+        record.target = connection ? connection->host() : QString();
+    else
+        record.target = IrcNetworkPrivate::get(connection->network())->nameTable.fold(target);
+    record.data = message->toData();
+    enqueue(record);
+    return false;
+}
+
+bool IrcLogWriterPrivate::enqueue(const IrcLogRecord& record)
+{
+    const quint32 t = tail.loadAcquire();
+    const quint32 h = head.loadAcquire();
+    const quint32 used = t - h;
+    if (used >= quint32(queueSize)) {
+        dropped.ref();
+        return false;
+    }
+    ring[t & (capacity - 1)] = record;
+    tail.storeRelease(t + 1);
+
+    // wake up the writer early when the queue fills up
+    if (used + 1 == quint32(queueSize / 2))
+        condition.wakeOne();
+    return true;
+}
+
+void IrcLogWriterPrivate::start()
+{
+    if (ring || directory.isEmpty() || !connection)
+        return;
+
+    // a power of two keeps the slots stable when the counters wrap around
+    queueSize = qMax(1, queueSize);
+    capacity = 1;
+    while (capacity < queueSize)
+        capacity <<= 1;
+    ring = new IrcLogRecord[capacity];
+    head.storeRelease(0);
+    tail.storeRelease(0);
+    stopped = false;
+    thread.start(QThread::LowPriority);
+}
+
+void IrcLogWriterPrivate::stop()
+{
+    if (!ring)
+        return;
+
+    {
+        QMutexLocker locker(&mutex);
+        stopped = true;
+        condition.wakeAll();
+    }
+    thread.wait();
+    delete [] ring;
+    ring = nullptr;
+    capacity = 0;
+}
+
+void IrcLogWriterPrivate::drain()
+{
+    const quint32 h = head.loadAcquire();
+    const quint32 t = tail.loadAcquire();
+    if (h == t)
+        return;
+
+    // group the batch by target, keeping the order of the lines
+    QStringList targets;
+    QHash<QString, QByteArray> batches;
+    for (quint32 i = h; i != t; ++i) {
+        IrcLogRecord& record = ring[i & (capacity - 1)];
+        if (!batches.contains(record.target))
+            targets += record.target;
+        QByteArray& lines = batches[record.target];
+        lines += QDateTime::fromMSecsSinceEpoch(record.timeStamp).toString(QLatin1String("yyyy-MM-ddThh:mm:ss.zzz")).toLatin1();
+        lines += ' ';
+        lines += record.data;
+        lines += '\n';
+        record = IrcLogRecord();
+    }
+    head.storeRelease(t);
+
+    foreach (const QString& target, targets)
+        write(target, batches.value(target));
+}
+
+void IrcLogWriterPrivate::write(const QString& target, const QByteArray& lines)
+{
+    QFile* file = files.value(target);
+    if (file && rotationSize > 0 && file->size() > 0 && file->size() + lines.size() > rotationSize) {
+        // rotate to a timestamped file and start over
+        const QFileInfo info(file->fileName());
+        const QString suffix = QDateTime::currentDateTime().toString(QLatin1String("yyyyMMdd-hhmmsszzz"));
+        file->close();
+        QFile::rename(info.filePath(), info.dir().filePath(info.completeBaseName() + QLatin1Char('-') + suffix + QLatin1String(".log")));
+        delete files.take(target);
+        file = nullptr;
+    }
+
+    if (!file) {
+        const QString name = QString::fromLatin1(QUrl::toPercentEncoding(target)) + QLatin1String(".log");
+        file = new QFile(QDir(directory).filePath(name));
+        if (!file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "IrcLogWriter: cannot open" << file->fileName() << file->errorString();
+            delete file;
+            return;
+        }
+        files.insert(target, file);
+    }
+
+    file->write(lines);
+    file->flush();
+    if (syncEnabled) {
+#if defined(Q_OS_UNIX)
+        ::fsync(file->handle());
+#elif defined(Q_OS_WIN)
+        ::_commit(file->handle());
+#endif
+    }
+}
+
+void IrcLogWriterPrivate::closeFiles()
+{
+    qDeleteAll(files);
+    files.clear();
+}
+#endif // IRC_DOXYGEN
+
+/*!
+    Constructs a new log writer with \a parent.
+
+    \note If \a parent is an instance of IrcConnection, it will be
+    automatically assigned to \ref IrcLogWriter::connection "connection".
+ */
+IrcLogWriter::IrcLogWriter(QObject* parent) : QObject(parent), d_ptr(new IrcLogWriterPrivate)
+{
+    Q_D(IrcLogWriter);
+    d->q_ptr = this;
+    setConnection(qobject_cast<IrcConnection*>(parent));
+}
+
+/*!
+    Destructs the log writer. Queued messages are written before returning.
+ */
+IrcLogWriter::~IrcLogWriter()
+{
+    Q_D(IrcLogWriter);
+    if (d->connection)
+        d->connection->removeMessageFilter(d);
+    d->stop();
+}
+
+/*!
+    This property holds the associated connection.
+
+    \par Access functions:
+    \li IrcConnection* <b>connection</b>() const
+    \li void <b>setConnection</b>(IrcConnection* connection)
+ */
+IrcConnection* IrcLogWriter::connection() const
+{
+    Q_D(const IrcLogWriter);
+    return d->connection;
+}
+
+void IrcLogWriter::setConnection(IrcConnection* connection)
+{
+    Q_D(IrcLogWriter);
+    if (d->connection != connection) {
+        d->stop();
+        if (d->connection)
+            d->connection->removeMessageFilter(d);
+        d->connection = connection;
+        if (connection)
+            connection->installMessageFilter(d);
+        d->start();
+    }
+}
+
+/*!
+    This property holds the directory where the log files are written.
+
+    Logging is disabled while the directory is empty, which is the default.
+
+    \par Access functions:
+    \li QString <b>directory</b>() const
+    \li void <b>setDirectory</b>(const QString& directory)
+ */
+QString IrcLogWriter::directory() const
+{
+    Q_D(const IrcLogWriter);
+    return d->directory;
+}
+
+void IrcLogWriter::setDirectory(const QString& directory)
+{
+    Q_D(IrcLogWriter);
+    if (d->directory != directory) {
+        d->stop();
+        d->directory = directory;
+        d->start();
+    }
+}
+
+/*!
+    This property holds the maximum number of queued messages.
+
+    Messages that arrive while the queue is full are dropped.
+    The default value is \c 4096.
+
+    \par Access functions:
+    \li int <b>queueSize</b>() const
+    \li void <b>setQueueSize</b>(int size)
+
+    \sa dropped
+ */
+int IrcLogWriter::queueSize() const
+{
+    Q_D(const IrcLogWriter);
+    return d->queueSize;
+}
+
+void IrcLogWriter::setQueueSize(int size)
+{
+    Q_D(IrcLogWriter);
+    if (d->queueSize != size) {
+        d->stop();
+        d->queueSize = size;
+        d->start();
+    }
+}
+
+/*!
+    This property holds the interval in milliseconds between batched writes.
+
+    The writer wakes up earlier when the queue is half full.
+    The default value is \c 1000.
+
+    \par Access functions:
+    \li int <b>flushInterval</b>() const
+    \li void <b>setFlushInterval</b>(int msecs)
+ */
+int IrcLogWriter::flushInterval() const
+{
+    Q_D(const IrcLogWriter);
+    return d->flushInterval;
+}
+
+void IrcLogWriter::setFlushInterval(int msecs)
+{
+    Q_D(IrcLogWriter);
+    if (d->flushInterval != msecs) {
+        d->stop();
+        d->flushInterval = msecs;
+        d->start();
+    }
+}
+
+/*!
+    This property holds whether written batches are synced to disk.
+
+    When enabled, every batch is followed by \c fsync() so that the
+    logs survive a system crash, at the cost of disk throughput.
+    The default value is \c false.
+
+    \par Access functions:
+    \li bool <b>isSyncEnabled</b>() const
+    \li void <b>setSyncEnabled</b>(bool enabled)
+ */
+bool IrcLogWriter::isSyncEnabled() const
+{
+    Q_D(const IrcLogWriter);
+    return d->syncEnabled;
+}
+
+void IrcLogWriter::setSyncEnabled(bool enabled)
+{
+    Q_D(IrcLogWriter);
+    if (d->syncEnabled != enabled) {
+        d->stop();
+        d->syncEnabled = enabled;
+        d->start();
+    }
+}
+
+/*!
+    This property holds the size in bytes at which log files are rotated.
+
+    A full log file is renamed with a timestamp suffix, and a new file is
+    started. The default value is \c 0, which disables rotation.
+
+    \par Access functions:
+    \li qint64 <b>rotationSize</b>() const
+    \li void <b>setRotationSize</b>(qint64 size)
+ */
+qint64 IrcLogWriter::rotationSize() const
+{
+    Q_D(const IrcLogWriter);
+    return d->rotationSize;
+}
+
+void IrcLogWriter::setRotationSize(qint64 size)
+{
+    Q_D(IrcLogWriter);
+    if (d->rotationSize != size) {
+        d->stop();
+        d->rotationSize = size;
+        d->start();
+    }
+}
+
+/*!
+    This property holds the number of messages dropped because the queue was full.
+
+    \par Access function:
+    \li int <b>dropped</b>() const
+
+    \sa queueSize
+ */
+int IrcLogWriter::dropped() const
+{
+    Q_D(const IrcLogWriter);
+    return d->dropped.loadAcquire();
+}
+
+/*!
+    Wakes up the writer thread to write the queued messages without
+    waiting for the \ref flushInterval to elapse.
+ */
+void IrcLogWriter::flush()
+{
+    Q_D(IrcLogWriter);
+    d->condition.wakeOne();
+}
+
+#include "moc_irclogwriter.cpp"
+#include "moc_irclogwriter_p.cpp"
+
+IRC_END_NAMESPACE
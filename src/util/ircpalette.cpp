@@ -27,6 +27,7 @@
 */
 
 #include "ircpalette.h"
+#include "ircpalette_p.h"
 #include "irc.h"
 
 IRC_BEGIN_NAMESPACE
@@ -58,12 +59,6 @@ IRC_BEGIN_NAMESPACE
     \sa Irc::Color, <a href="http://www.mirc.com/colors.html">mIRC colors</a>, <a href="http://www.w3.org/TR/SVG/types.html#ColorKeywords">SVG color keyword names</a>
  */
 
-class IrcPalettePrivate
-{
-public:
-    QMap<int, QString> colors;
-};
-
 static QMap<int, QString>& irc_default_colors()
 {
     static QMap<int, QString> x;
@@ -126,7 +121,7 @@ QString IrcPalette::white() const
 void IrcPalette::setWhite(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::White, color);
+    d->setColor(Irc::White, color);
 }
 
 /*!
@@ -149,7 +144,7 @@ QString IrcPalette::black() const
 void IrcPalette::setBlack(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Black, color);
+    d->setColor(Irc::Black, color);
 }
 
 /*!
@@ -172,7 +167,7 @@ QString IrcPalette::blue() const
 void IrcPalette::setBlue(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Blue, color);
+    d->setColor(Irc::Blue, color);
 }
 
 /*!
@@ -195,7 +190,7 @@ QString IrcPalette::green() const
 void IrcPalette::setGreen(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Green, color);
+    d->setColor(Irc::Green, color);
 }
 
 /*!
@@ -218,7 +213,7 @@ QString IrcPalette::red() const
 void IrcPalette::setRed(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Red, color);
+    d->setColor(Irc::Red, color);
 }
 
 /*!
@@ -241,7 +236,7 @@ QString IrcPalette::brown() const
 void IrcPalette::setBrown(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Brown, color);
+    d->setColor(Irc::Brown, color);
 }
 
 /*!
@@ -264,7 +259,7 @@ QString IrcPalette::purple() const
 void IrcPalette::setPurple(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Purple, color);
+    d->setColor(Irc::Purple, color);
 }
 
 /*!
@@ -287,7 +282,7 @@ QString IrcPalette::orange() const
 void IrcPalette::setOrange(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Orange, color);
+    d->setColor(Irc::Orange, color);
 }
 
 /*!
@@ -310,7 +305,7 @@ QString IrcPalette::yellow() const
 void IrcPalette::setYellow(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Yellow, color);
+    d->setColor(Irc::Yellow, color);
 }
 
 /*!
@@ -333,7 +328,7 @@ QString IrcPalette::lightGreen() const
 void IrcPalette::setLightGreen(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::LightGreen, color);
+    d->setColor(Irc::LightGreen, color);
 }
 
 /*!
@@ -356,7 +351,7 @@ QString IrcPalette::cyan() const
 void IrcPalette::setCyan(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Cyan, color);
+    d->setColor(Irc::Cyan, color);
 }
 
 /*!
@@ -379,7 +374,7 @@ QString IrcPalette::lightCyan() const
 void IrcPalette::setLightCyan(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::LightCyan, color);
+    d->setColor(Irc::LightCyan, color);
 }
 
 /*!
@@ -402,7 +397,7 @@ QString IrcPalette::lightBlue() const
 void IrcPalette::setLightBlue(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::LightBlue, color);
+    d->setColor(Irc::LightBlue, color);
 }
 
 /*!
@@ -425,7 +420,7 @@ QString IrcPalette::pink() const
 void IrcPalette::setPink(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Pink, color);
+    d->setColor(Irc::Pink, color);
 }
 
 /*!
@@ -448,7 +443,7 @@ QString IrcPalette::gray() const
 void IrcPalette::setGray(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::Gray, color);
+    d->setColor(Irc::Gray, color);
 }
 
 /*!
@@ -471,7 +466,7 @@ QString IrcPalette::lightGray() const
 void IrcPalette::setLightGray(const QString& color)
 {
     Q_D(IrcPalette);
-    d->colors.insert(Irc::LightGray, color);
+    d->setColor(Irc::LightGray, color);
 }
 
 /*!
@@ -490,6 +485,7 @@ void IrcPalette::setColorNames(const QMap<int, QString>& names)
 {
     Q_D(IrcPalette);
     d->colors = names;
+    ++d->generation;
 }
 
 /*!
@@ -519,7 +515,7 @@ QString IrcPalette::colorName(int color, const QString& fallback) const
 void IrcPalette::setColorName(int color, const QString& name)
 {
     Q_D(IrcPalette);
-    d->colors.insert(color, name);
+    d->setColor(color, name);
 }
 
 #include "moc_ircpalette.cpp"
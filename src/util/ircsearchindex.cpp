@@ -0,0 +1,687 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ircsearchindex.h"
+#include "ircsearchindex_p.h"
+#include "irctextformat.h"
+#include "ircbuffermodel.h"
+#include "ircbuffermodel_p.h"
+#include "ircbuffer.h"
+#include "ircbuffer_p.h"
+#include "ircmessage.h"
+#include "ircmessagearchive_p.h"
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QMutexLocker>
+#include <QMetaObject>
+#include <QFileInfo>
+#include <QtEndian>
+#include <algorithm>
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file ircsearchindex.h
+    \brief \#include &lt;IrcSearchIndex&gt;
+ */
+
+/*!
+    \since 3.7
+    \class IrcSearchIndex ircsearchindex.h <IrcSearchIndex>
+    \ingroup util
+    \brief Provides full-text search over buffer messages.
+
+    IrcSearchIndex keeps an inverted index of the messages delivered to the
+    buffers of a \ref model. Message content is stripped from formatting
+    with IrcTextFormat::toPlainText(), split into case folded words, and
+    merged into the index on a background thread, so that indexing never
+    blocks message delivery. Archived messages are referred to by their
+    position in the archive, and read again for the search results only.
+
+    Queries may be restricted to a buffer, a nick and a time range. All
+    words of the query must be present in a matching message.
+
+    \code
+    IrcSearchIndex* index = new IrcSearchIndex(this);
+    index->setModel(bufferModel);
+
+    // ...
+
+    QList<IrcMessage*> messages = index->search("release date", "#communi");
+    foreach (IrcMessage* message, messages)
+        ...;
+    qDeleteAll(messages);
+    \endcode
+
+    \sa IrcBufferModel::archiveDirectory
+ */
+
+/*!
+    \fn void IrcSearchIndex::modelChanged(IrcBufferModel* model)
+
+    This signal is emitted when the \a model changes.
+ */
+
+#ifndef IRC_DOXYGEN
+IrcSearchWorker::IrcSearchWorker()
+{
+}
+
+IrcSearchWorker::~IrcSearchWorker()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopped = true;
+        condition.wakeAll();
+    }
+    wait();
+}
+
+void IrcSearchWorker::enqueue(const QList<IrcSearchEntry>& entries)
+{
+    QMutexLocker locker(&mutex);
+    pending += entries;
+    condition.wakeAll();
+    if (!isRunning())
+        start(QThread::LowPriority);
+}
+
+void IrcSearchWorker::enqueue(const QList<IrcSearchArchive>& queued, int count)
+{
+    QMutexLocker locker(&mutex);
+    archives += queued;
+    archiveCount = count;
+    condition.wakeAll();
+    if (!isRunning())
+        start(QThread::LowPriority);
+}
+
+void IrcSearchWorker::clear()
+{
+    QMutexLocker locker(&mutex);
+    QWriteLocker writer(&lock);
+    // a batch or an archive that is being indexed is discarded by the generation check
+    ++generation;
+    pending.clear();
+    archives.clear();
+    documents.clear();
+    postings.clear();
+    sources.clear();
+    sourceIds.clear();
+    unflushed.clear();
+}
+
+int IrcSearchWorker::count() const
+{
+    QReadLocker locker(&lock);
+    return documents.count();
+}
+
+QList<IrcSearchHit> IrcSearchWorker::search(const QStringList& keys, qint64 from, qint64 to, int limit) const
+{
+    QList<IrcSearchHit> hits;
+    if (limit <= 0)
+        return hits;
+
+    {
+        QReadLocker locker(&lock);
+        QList<const QVector<int>*> lists;
+        foreach (const QString& key, keys) {
+            QHash<QString, QVector<int> >::const_iterator it = postings.constFind(key);
+            if (it == postings.constEnd())
+                return hits;
+            lists.append(&it.value());
+        }
+
+        // walk the shortest posting list from the newest document backwards
+        const QVector<int>* shortest = nullptr;
+        foreach (const QVector<int>* list, lists) {
+            if (!shortest || list->count() < shortest->count())
+                shortest = list;
+        }
+
+        int i = shortest ? shortest->count() : documents.count();
+        while (--i >= 0 && hits.count() < limit) {
+            const int id = shortest ? shortest->at(i) : i;
+            bool match = true;
+            foreach (const QVector<int>* list, lists) {
+                if (list != shortest && !std::binary_search(list->constBegin(), list->constEnd(), id)) {
+                    match = false;
+                    break;
+                }
+            }
+            const Document& doc = documents.at(id);
+            if (match && (from < 0 || doc.timeStamp >= from) && (to < 0 || doc.timeStamp <= to)) {
+                IrcSearchHit hit;
+                hit.timeStamp = doc.timeStamp;
+                hit.flags = doc.flags;
+                hit.source = doc.source != -1 ? sources.at(doc.source) : QString();
+                hit.offset = doc.offset;
+                hit.data = doc.data;
+                hits.prepend(hit);
+            }
+        }
+    }
+
+    // read the archived lines of the hits outside of the index lock
+    QHash<QString, QFile*> files;
+    QList<IrcSearchHit>::iterator it = hits.begin();
+    while (it != hits.end()) {
+        if (it->data.isEmpty()) {
+            QFile*& file = files[it->source];
+            if (!file) {
+                file = new QFile(it->source);
+                file->open(QIODevice::ReadOnly);
+            }
+            // an archive that was removed or replaced since
+            if (!readRecord(file, it->offset, it->timeStamp, &it->data)) {
+                it = hits.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+    qDeleteAll(files);
+    return hits;
+}
+
+QStringList IrcSearchWorker::terms(const QString& text)
+{
+    QStringList words;
+    QString word;
+    const int len = text.length();
+    for (int i = 0; i <= len; ++i) {
+        const QChar c = i < len ? text.at(i) : QChar();
+        if (c.isLetterOrNumber()) {
+            word += c;
+        } else if (!word.isEmpty()) {
+            words += word.toCaseFolded();
+            word.clear();
+        }
+    }
+    return words;
+}
+
+QString IrcSearchWorker::bufferKey(const QString& buffer)
+{
+    return QLatin1Char('\1') + buffer.toCaseFolded();
+}
+
+QString IrcSearchWorker::nickKey(const QString& nick)
+{
+    return QLatin1Char('\2') + nick.toCaseFolded();
+}
+
+// the nick and the text of a raw PRIVMSG, NOTICE or TOPIC line, parsed
+// without creating an IrcMessage, so that it is safe on the worker thread
+bool IrcSearchWorker::parse(const QByteArray& data, QString* nick, QString* text)
+{
+    int pos = 0;
+    if (data.startsWith('@')) {
+        pos = data.indexOf(' ') + 1;
+        if (!pos)
+            return false;
+    }
+    QByteArray prefix;
+    if (pos < data.size() && data.at(pos) == ':') {
+        const int space = data.indexOf(' ', pos);
+        if (space == -1)
+            return false;
+        prefix = data.mid(pos + 1, space - pos - 1);
+        pos = space + 1;
+    }
+    const int space = data.indexOf(' ', pos);
+    if (space == -1)
+        return false;
+
+    const QByteArray command = data.mid(pos, space - pos).toUpper();
+    const bool topic = command == "TOPIC" || command == "332";
+    if (!topic && command != "PRIVMSG" && command != "NOTICE")
+        return false;
+
+    // the text is the trailing parameter
+    const int colon = data.indexOf(" :", space);
+    QByteArray trailing = colon != -1 ? data.mid(colon + 2) : data.mid(data.lastIndexOf(' ') + 1);
+
+    // CTCP requests and replies, such as actions
+    if (!topic && trailing.startsWith('\1')) {
+        trailing.remove(0, 1);
+        if (trailing.endsWith('\1'))
+            trailing.chop(1);
+        if (trailing.startsWith("ACTION "))
+            trailing.remove(0, 7);
+    }
+
+    const int bang = prefix.indexOf('!');
+    *nick = QString::fromUtf8(bang != -1 ? prefix.left(bang) : prefix);
+    *text = QString::fromUtf8(trailing);
+    return true;
+}
+
+bool IrcSearchWorker::readRecord(QFile* file, qint64 offset, qint64 timeStamp, QByteArray* data)
+{
+    if (!file->isOpen() || !file->seek(offset))
+        return false;
+    const QByteArray header = file->read(IrcMessageArchive::RecordHeaderSize);
+    if (header.size() != IrcMessageArchive::RecordHeaderSize)
+        return false;
+    const uchar* p = reinterpret_cast<const uchar*>(header.constData());
+    if (qFromLittleEndian<qint64>(p) != timeStamp)
+        return false;
+    const quint32 size = qFromLittleEndian<quint32>(p + 12);
+    *data = file->read(size);
+    return data->size() == int(size);
+}
+
+void IrcSearchWorker::run()
+{
+    forever {
+        QList<IrcSearchEntry> batch;
+        IrcSearchArchive archive;
+        bool paging = false;
+        int count = -1;
+        int batchGeneration;
+        {
+            QMutexLocker locker(&mutex);
+            while (pending.isEmpty() && archives.isEmpty() && !stopped)
+                condition.wait(&mutex);
+            if (stopped)
+                return;
+            // the archives go first, so that the documents stay in chronological order
+            if (!archives.isEmpty()) {
+                archive = archives.takeFirst();
+                count = archiveCount;
+                paging = true;
+            } else {
+                batch.swap(pending);
+            }
+            batchGeneration = generation;
+        }
+
+        if (paging)
+            index(archive, count, batchGeneration);
+        else
+            index(batch, batchGeneration);
+    }
+}
+
+bool IrcSearchWorker::isCurrent(int batchGeneration)
+{
+    QMutexLocker locker(&mutex);
+    return !stopped && batchGeneration == generation;
+}
+
+void IrcSearchWorker::index(const QList<IrcSearchEntry>& batch, int batchGeneration)
+{
+    // tokenize outside of the index lock
+    IrcTextFormat format;
+    QList<QStringList> keys;
+    QList<IrcSearchEntry> entries;
+    foreach (const IrcSearchEntry& entry, batch) {
+        QString nick;
+        QString text;
+        if (!parse(entry.data, &nick, &text))
+            continue;
+        QStringList words = terms(format.toPlainText(text));
+        words += bufferKey(entry.buffer);
+        words += nickKey(nick);
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+        keys += words;
+        entries += entry;
+    }
+
+    QWriteLocker locker(&lock);
+    if (batchGeneration != generation)
+        return;
+    for (int i = 0; i < entries.count(); ++i) {
+        const IrcSearchEntry& entry = entries.at(i);
+        const int id = documents.count();
+        Document doc;
+        doc.timeStamp = entry.timeStamp;
+        doc.flags = entry.flags;
+        doc.source = -1;
+        doc.offset = entry.offset;
+        doc.data = entry.data;
+        if (!entry.source.isEmpty()) {
+            QHash<QString, int>::const_iterator it = sourceIds.constFind(entry.source);
+            if (it == sourceIds.constEnd()) {
+                it = sourceIds.insert(entry.source, sources.count());
+                sources += entry.source;
+            }
+            doc.source = it.value();
+            // the line is kept until the archive has been written out
+            unflushed += id;
+        }
+        documents.append(doc);
+        foreach (const QString& key, keys.at(i))
+            postings[key].append(id);
+    }
+    release();
+}
+
+void IrcSearchWorker::index(const IrcSearchArchive& archive, int count, int batchGeneration)
+{
+    QFile file(archive.fileName);
+    if (!file.open(QIODevice::ReadOnly) ||
+            file.read(IrcMessageArchive::HeaderSize).size() != IrcMessageArchive::HeaderSize)
+        return;
+
+    // with a count, skip the records before the last count ones
+    qint64 offset = IrcMessageArchive::HeaderSize;
+    if (count >= 0) {
+        QVector<qint64> offsets;
+        while (offset + IrcMessageArchive::RecordHeaderSize <= archive.end && file.seek(offset)) {
+            const QByteArray header = file.read(IrcMessageArchive::RecordHeaderSize);
+            if (header.size() != IrcMessageArchive::RecordHeaderSize)
+                break;
+            offsets += offset;
+            offset += IrcMessageArchive::RecordHeaderSize + qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(header.constData()) + 12);
+        }
+        offset = offsets.count() > count ? offsets.at(offsets.count() - count) : IrcMessageArchive::HeaderSize;
+        if (!count || !file.seek(offset))
+            return;
+    }
+
+    // every page is merged as soon as it has been read
+    IrcTextFormat format;
+    bool ok = true;
+    while (ok && offset + IrcMessageArchive::RecordHeaderSize <= archive.end && isCurrent(batchGeneration)) {
+        QList<Document> docs;
+        QList<QStringList> keys;
+        for (int i = 0; i < PageSize && offset + IrcMessageArchive::RecordHeaderSize <= archive.end; ++i) {
+            const QByteArray header = file.read(IrcMessageArchive::RecordHeaderSize);
+            const uchar* p = reinterpret_cast<const uchar*>(header.constData());
+            const quint32 size = header.size() == IrcMessageArchive::RecordHeaderSize ? qFromLittleEndian<quint32>(p + 12) : 0;
+            const QByteArray data = file.read(size);
+            if (header.size() != IrcMessageArchive::RecordHeaderSize || data.size() != int(size)) {
+                ok = false;
+                break;
+            }
+
+            QString nick;
+            QString text;
+            if (parse(data, &nick, &text)) {
+                QStringList words = terms(format.toPlainText(text));
+                words += bufferKey(archive.buffer);
+                words += nickKey(nick);
+                std::sort(words.begin(), words.end());
+                words.erase(std::unique(words.begin(), words.end()), words.end());
+                keys += words;
+
+                Document doc;
+                doc.timeStamp = qFromLittleEndian<qint64>(p);
+                doc.flags = qFromLittleEndian<qint32>(p + 8);
+                doc.source = -1;
+                doc.offset = offset;
+                docs += doc;
+            }
+            offset += IrcMessageArchive::RecordHeaderSize + size;
+        }
+        if (docs.isEmpty())
+            continue;
+
+        QWriteLocker locker(&lock);
+        if (batchGeneration != generation)
+            return;
+        int source = sourceIds.value(archive.fileName, -1);
+        if (source == -1) {
+            source = sources.count();
+            sourceIds.insert(archive.fileName, source);
+            sources += archive.fileName;
+        }
+        for (int i = 0; i < docs.count(); ++i) {
+            const int id = documents.count();
+            Document doc = docs.at(i);
+            doc.source = source;
+            documents.append(doc);
+            foreach (const QString& key, keys.at(i))
+                postings[key].append(id);
+        }
+    }
+}
+
+// drops the lines of delivered messages that have been archived since
+void IrcSearchWorker::release()
+{
+    QHash<int, qint64> sizes;
+    QVector<int> remaining;
+    foreach (int id, unflushed) {
+        Document& doc = documents[id];
+        QHash<int, qint64>::iterator it = sizes.find(doc.source);
+        if (it == sizes.end())
+            it = sizes.insert(doc.source, QFileInfo(sources.at(doc.source)).size());
+        if (doc.offset + IrcMessageArchive::RecordHeaderSize + doc.data.size() <= it.value())
+            doc.data.clear();
+        else
+            remaining += id;
+    }
+    unflushed = remaining;
+}
+
+void IrcSearchIndexPrivate::_irc_bufferAdded(IrcBuffer* buffer)
+{
+    Q_Q(IrcSearchIndex);
+    QObject::connect(buffer, SIGNAL(messageReceived(IrcMessage*)), q, SLOT(_irc_messageReceived(IrcMessage*)));
+}
+
+void IrcSearchIndexPrivate::_irc_bufferRemoved(IrcBuffer* buffer)
+{
+    Q_Q(IrcSearchIndex);
+    QObject::disconnect(buffer, SIGNAL(messageReceived(IrcMessage*)), q, SLOT(_irc_messageReceived(IrcMessage*)));
+}
+
+void IrcSearchIndexPrivate::_irc_messageReceived(IrcMessage* message)
+{
+    Q_Q(IrcSearchIndex);
+    IrcBuffer* buffer = qobject_cast<IrcBuffer*>(q->sender());
+    if (!buffer)
+        return;
+
+    switch (message->type()) {
+    case IrcMessage::Private:
+    case IrcMessage::Notice:
+    case IrcMessage::Topic:
+        break;
+    default:
+        return;
+    }
+
+    IrcSearchEntry e;
+    e.timeStamp = message->timeStamp().toMSecsSinceEpoch();
+    e.flags = message->flags();
+    e.buffer = buffer->title();
+    e.offset = -1;
+    e.data = message->toData();
+
+    // the message was archived right before it was delivered
+    IrcBufferPrivate* priv = IrcBufferPrivate::get(buffer);
+    if (priv->archive && priv->archiveOffset != -1) {
+        e.source = priv->archive->fileName();
+        e.offset = priv->archiveOffset;
+    }
+    worker.enqueue(QList<IrcSearchEntry>() << e);
+}
+#endif // IRC_DOXYGEN
+
+/*!
+    Constructs a new search index with \a parent.
+
+    \note If \a parent is an instance of IrcBufferModel, it will be
+    automatically assigned to \ref IrcSearchIndex::model "model".
+ */
+IrcSearchIndex::IrcSearchIndex(QObject* parent) : QObject(parent), d_ptr(new IrcSearchIndexPrivate)
+{
+    Q_D(IrcSearchIndex);
+    d->q_ptr = this;
+    setModel(qobject_cast<IrcBufferModel*>(parent));
+}
+
+/*!
+    Destructs the search index.
+ */
+IrcSearchIndex::~IrcSearchIndex()
+{
+}
+
+/*!
+    This property holds the buffer model whose messages are indexed.
+
+    \par Access functions:
+    \li \ref IrcBufferModel* <b>model</b>() const
+    \li void <b>setModel</b>(\ref IrcBufferModel* model)
+
+    \par Notifier signal:
+    \li void <b>modelChanged</b>(\ref IrcBufferModel* model)
+ */
+IrcBufferModel* IrcSearchIndex::model() const
+{
+    Q_D(const IrcSearchIndex);
+    return d->model;
+}
+
+void IrcSearchIndex::setModel(IrcBufferModel* model)
+{
+    Q_D(IrcSearchIndex);
+    if (d->model != model) {
+        if (d->model) {
+            disconnect(d->model, SIGNAL(added(IrcBuffer*)), this, SLOT(_irc_bufferAdded(IrcBuffer*)));
+            disconnect(d->model, SIGNAL(removed(IrcBuffer*)), this, SLOT(_irc_bufferRemoved(IrcBuffer*)));
+            foreach (IrcBuffer* buffer, d->model->buffers())
+                d->_irc_bufferRemoved(buffer);
+        }
+        d->model = model;
+        if (model) {
+            connect(model, SIGNAL(added(IrcBuffer*)), this, SLOT(_irc_bufferAdded(IrcBuffer*)));
+            connect(model, SIGNAL(removed(IrcBuffer*)), this, SLOT(_irc_bufferRemoved(IrcBuffer*)));
+            foreach (IrcBuffer* buffer, model->buffers())
+                d->_irc_bufferAdded(buffer);
+        }
+        emit modelChanged(model);
+    }
+}
+
+/*!
+    This property holds the number of indexed messages.
+
+    Messages are indexed asynchronously, so the count lags slightly
+    behind the delivered messages.
+
+    \par Access function:
+    \li int <b>count</b>() const
+ */
+int IrcSearchIndex::count() const
+{
+    Q_D(const IrcSearchIndex);
+    return d->worker.count();
+}
+
+/*!
+    Returns up to \a limit most recent messages that contain all words of
+    \a text, in chronological order. The caller takes ownership of the
+    returned messages.
+
+    The search is restricted to messages delivered to the \a buffer with
+    the given title and sent by \a nick, and to the time range between
+    \a from and \a to, unless they are empty or invalid, respectively.
+    Words, buffer titles and nicks are matched case insensitively.
+ */
+QList<IrcMessage*> IrcSearchIndex::search(const QString& text, const QString& buffer, const QString& nick,
+                                          const QDateTime& from, const QDateTime& to, int limit) const
+{
+    Q_D(const IrcSearchIndex);
+    QStringList keys = IrcSearchWorker::terms(text);
+    if (!buffer.isEmpty())
+        keys += IrcSearchWorker::bufferKey(buffer);
+    if (!nick.isEmpty())
+        keys += IrcSearchWorker::nickKey(nick);
+
+    const qint64 begin = from.isValid() ? from.toMSecsSinceEpoch() : -1;
+    const qint64 end = to.isValid() ? to.toMSecsSinceEpoch() : -1;
+
+    QList<IrcMessage*> messages;
+    IrcConnection* connection = d->model ? d->model->connection() : nullptr;
+    foreach (const IrcSearchHit& hit, d->worker.search(keys, begin, end, limit)) {
+        IrcMessage* message = IrcMessage::fromData(hit.data, connection);
+        message->setTimeStamp(QDateTime::fromMSecsSinceEpoch(hit.timeStamp));
+        message->setFlags(IrcMessage::Flags(hit.flags));
+        messages += message;
+    }
+    return messages;
+}
+
+/*!
+    Clears the index.
+ */
+void IrcSearchIndex::clear()
+{
+    Q_D(IrcSearchIndex);
+    d->worker.clear();
+}
+
+/*!
+    Clears the index, and re-indexes up to \a count archived messages of
+    each buffer in the model. A negative \a count re-indexes all archived
+    messages.
+
+    The archives are read and indexed page by page on the background
+    thread, so the count grows gradually.
+
+    \sa IrcBufferModel::archiveDirectory, IrcBuffer::loadMessages()
+ */
+void IrcSearchIndex::rebuild(int count)
+{
+    Q_D(IrcSearchIndex);
+    d->worker.clear();
+    if (!d->model || d->model->archiveDirectory().isEmpty())
+        return;
+
+    // write out the buffered records, and read the archives up to their
+    // current end, so that the messages delivered after are not indexed twice
+    QMetaObject::invokeMethod(d->model, "_irc_flushArchives", Qt::DirectConnection);
+
+    const QString dir = d->model->archiveDirectory();
+    const IrcNameTable& names = IrcBufferModelPrivate::get(d->model)->nameTable();
+    QList<IrcSearchArchive> archives;
+    foreach (IrcBuffer* buffer, d->model->buffers()) {
+        if (buffer->title().isEmpty())
+            continue;
+        IrcSearchArchive archive;
+        archive.buffer = buffer->title();
+        archive.fileName = IrcMessageArchive::filePath(dir, names.fold(buffer->title()));
+        archive.end = QFileInfo(archive.fileName).size();
+        if (archive.end > IrcMessageArchive::HeaderSize)
+            archives += archive;
+    }
+    d->worker.enqueue(archives, count);
+}
+
+#include "moc_ircsearchindex.cpp"
+
+IRC_END_NAMESPACE
@@ -36,16 +36,18 @@
 
 #include "irctextformat.h"
 #include "ircpalette.h"
+#include "ircpalette_p.h"
 #include "irccore_p.h"
-#include <QStringList>
+#include <QCache>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
 #include <QUrl>
+#include <QPair>
 #include "irc.h"
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
     #include <QRegExp>
-#elif QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    #include <QRegularExpression>
-    #include <QRegExp>
 #else
     #include <QRegularExpression>
 #endif
@@ -67,7 +69,8 @@ IRC_BEGIN_NAMESPACE
     plain text or HTML. When converting to plain text, the IRC-style formatting
     (colors, bold, underline etc.) are simply stripped away. When converting
     to HTML, the IRC-style formatting is converted to the corresponding HTML
-    formatting.
+    formatting. For clients that lay out text themselves, toRuns() describes
+    the formatting as a list of styled ranges over the plain text.
 
     \code
     IrcTextFormat format;
@@ -98,19 +101,171 @@ IRC_BEGIN_NAMESPACE
     \brief HTML span-elements with class-attributes.
  */
 
-class IrcTextFormatPrivate
+/*!
+    \since 3.7
+    \enum IrcTextFormat::Style
+    This enum describes the character styles of a formatted text run.
+ */
+
+/*!
+    \var IrcTextFormat::NoStyle
+    \brief No styling.
+ */
+
+/*!
+    \var IrcTextFormat::Bold
+    \brief Bold ("\02").
+ */
+
+/*!
+    \var IrcTextFormat::Italic
+    \brief Italic ("\1D").
+ */
+
+/*!
+    \var IrcTextFormat::Underline
+    \brief Underline ("\15" or "\1F").
+ */
+
+/*!
+    \var IrcTextFormat::StrikeOut
+    \brief Line-through ("\13").
+ */
+
+/*!
+    \var IrcTextFormat::Inverse
+    \brief Inverse ("\16"); swap the foreground and background colors.
+ */
+
+/*!
+    \since 3.7
+    \struct IrcTextFormat::Run irctextformat.h <IrcTextFormat>
+    \brief Describes a formatted range of plain text.
+
+    A run covers \ref length characters of plain text starting at \ref start,
+    so it maps directly to QTextLayout::FormatRange:
+
+    \code
+    QString text;
+    QList<QUrl> urls;
+    QVector<QTextLayout::FormatRange> ranges;
+    foreach (const IrcTextFormat::Run& run, format.toRuns(message, &text, &urls)) {
+        QTextLayout::FormatRange range;
+        range.start = run.start;
+        range.length = run.length;
+        range.format.setFontWeight(run.styles & IrcTextFormat::Bold ? QFont::Bold : QFont::Normal);
+        range.format.setFontItalic(run.styles & IrcTextFormat::Italic);
+        range.format.setFontUnderline(run.styles & IrcTextFormat::Underline);
+        range.format.setFontStrikeOut(run.styles & IrcTextFormat::StrikeOut);
+        if (run.foreground != -1)
+            range.format.setForeground(QColor(format.palette()->colorName(run.foreground)));
+        if (run.background != -1)
+            range.format.setBackground(QColor(format.palette()->colorName(run.background)));
+        if (run.url != -1)
+            range.format.setAnchorHref(urls.at(run.url).toString());
+        ranges += range;
+    }
+    layout.setText(text);
+    layout.setFormats(ranges);
+    \endcode
+
+    \sa toRuns()
+ */
+
+/*!
+    \var IrcTextFormat::Run::start
+    \brief The position of the first character in the plain text.
+ */
+
+/*!
+    \var IrcTextFormat::Run::length
+    \brief The number of characters.
+ */
+
+/*!
+    \var IrcTextFormat::Run::styles
+    \brief The character styles.
+ */
+
+/*!
+    \var IrcTextFormat::Run::foreground
+    \brief The foreground palette index, or \c -1 for the default color.
+ */
+
+/*!
+    \var IrcTextFormat::Run::background
+    \brief The background palette index, or \c -1 for the default color.
+ */
+
+/*!
+    \var IrcTextFormat::Run::url
+    \brief The index of the URL in the list of detected URLs, or \c -1.
+ */
+
+class IrcTextFormatCacheEntry
+{
+public:
+    bool hasText = false;
+    bool hasHtml = false;
+    QString plainText;
+    QString html;
+    QList<QUrl> urls;
+};
+
+class IrcTextFormatConfig : public QSharedData
 {
 public:
     void parse(const QString& str, QString* text, QString* html, QList<QUrl>* urls) const;
+    void appendColors(QString* html, int fg, int bg) const;
+    QVector<IrcTextFormat::Run> parseRuns(const QString& str, QString* text, QList<QUrl>* urls) const;
+    void compileUrlPattern();
+
+    int generation = -1;
+    QMap<int, QString> colors;
+    QString urlPattern;
+#if QT_VERSION >= 0x050000
+    QRegularExpression urlRegExp;
+#else
+    QRegExp urlRegExp;
+#endif
+    IrcTextFormat::SpanFormat spanFormat = IrcTextFormat::SpanStyle;
+};
+
+class IrcTextFormatPrivate
+{
+public:
+    const IrcTextFormatConfig* currentConfig() const;
+    const IrcTextFormatCacheEntry* lookup(const QString& str, bool text, bool html) const;
 
     QString plainText;
     QString html;
     QList<QUrl> urls;
-    QString urlPattern;
     IrcPalette* palette;
-    IrcTextFormat::SpanFormat spanFormat;
+    // shared with snapshots; detached when modified
+    mutable QSharedDataPointer<IrcTextFormatConfig> config;
+    mutable QCache<QString, IrcTextFormatCacheEntry> cache;
+    mutable int cacheGeneration = 0;
+    mutable int cacheHits = 0;
+    mutable int cacheMisses = 0;
 };
 
+static inline bool isDigit(const QChar* data, int pos, int size)
+{
+    return pos < size && data[pos].unicode() >= '0' && data[pos].unicode() <= '9';
+}
+
+static int parseNumber(const QChar* data, int pos, int size, int* len)
+{
+    // \d{1,2}
+    int value = data[pos].unicode() - '0';
+    *len = 1;
+    if (isDigit(data, pos + 1, size)) {
+        value = value * 10 + data[pos + 1].unicode() - '0';
+        *len = 2;
+    }
+    return value;
+}
+
 static bool parseColors(const QString& message, int pos, int* len, int* fg = nullptr, int* bg = nullptr)
 {
     // fg(,bg)
@@ -120,87 +275,88 @@ static bool parseColors(const QString& message, int pos, int* len, int* fg = nul
     if (bg)
         *bg = -1;
 
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-
-    QRegExp rx(QLatin1String("(\\d{1,2})(?:,(\\d{1,2}))?"));
-    int idx = rx.indexIn(message, pos);
-    if (idx == pos) {
-        *len = rx.matchedLength();
-        if (fg)
-            *fg = rx.cap(1).toInt();
-        if (bg) {
-            bool ok = false;
-            int tmp = rx.cap(2).toInt(&ok);
-            if (ok)
-                *bg = tmp;
-        }
-    }
-
-#else
+    const QChar* data = message.constData();
+    const int size = message.size();
+    if (!isDigit(data, pos, size))
+        return false;
 
-    QRegularExpression rx(QLatin1String("(\\d{1,2})(?:,(\\d{1,2}))?"));
-    auto match = rx.match(message, pos);
-    if (match.hasMatch()) {
-        *len = match.captured(1).size();
-        if (fg)
-            *fg = match.captured(1).toInt();
-        if (bg) {
-            bool ok = false;
-            int tmp = match.captured(2).toInt(&ok);
-            if (ok)
-                *bg = tmp;
-        }
+    int n = 0;
+    const int f = parseNumber(data, pos, size, &n);
+    if (fg)
+        *fg = f;
+    *len = n;
+
+    // the comma belongs to the color code only when followed by a background
+    if (pos + n < size && data[pos + n] == QLatin1Char(',') && isDigit(data, pos + n + 1, size)) {
+        const int b = parseNumber(data, pos + n + 1, size, &n);
+        if (bg)
+            *bg = b;
+        *len += n + 1;
     }
-
-#endif
-
-    return *len > 0;
+    return true;
 }
 
-static QString generateLink(const QString& protocol, const QString &raw, const QString &href)
+static void appendLink(QString* html, const QString& protocol, const QString& raw, const QString& href)
 {
     const char* exclude = ":/?@%#=+&,;";
-    const QByteArray url = QUrl::toPercentEncoding(raw, exclude);
-    return QString(QLatin1String("<a href='%1%2'>%3</a>")).arg(protocol, url, href);
+    html->append(QLatin1String("<a href='"));
+    html->append(protocol);
+    html->append(QLatin1String(QUrl::toPercentEncoding(raw, exclude)));
+    html->append(QLatin1String("'>"));
+    html->append(href);
+    html->append(QLatin1String("</a>"));
+}
+
+#if QT_VERSION >= 0x050000
+static QString guessProtocol(const QString& link)
+{
+    if (link.startsWith(QStringLiteral("ftp."), Qt::CaseInsensitive))
+        return QStringLiteral("ftp://");
+    if (link.contains(QStringLiteral("@")))
+        return QStringLiteral("mailto:");
+    return QStringLiteral("http://");
 }
+#endif
 
-static QString parseUrls(const QString& message, const QString& pattern, QList<QUrl>* urls)
+#if QT_VERSION >= 0x050000
+static void parseUrls(const QString& message, const QRegularExpression& rx, QString* html, QList<QUrl>* urls)
+#else
+static void parseUrls(const QString& message, QRegExp rx, QString* html, QList<QUrl>* urls)
+#endif
 {
-    QString processed = message;
+    // links are streamed to the output between the untouched segments of the
+    // message, so the message is neither copied nor shifted for each link
+    int last = 0;
+    bool linked = false;
 #if QT_VERSION >= 0x050000
-    int offset = 0;
-    QRegularExpression rx(pattern);
     QRegularExpressionMatchIterator it = rx.globalMatch(message);
     while (it.hasNext()) {
         QRegularExpressionMatch match = it.next();
         QString protocol;
-        if (match.captured(2).isEmpty()) {
-            QString link = match.captured(1);
-            if (link.startsWith(QStringLiteral("ftp."), Qt::CaseInsensitive))
-                protocol = QStringLiteral("ftp://");
-            else if (link.contains(QStringLiteral("@")))
-                protocol = QStringLiteral("mailto:");
-            else
-                protocol = QStringLiteral("http://");
-        }
+        if (match.captured(2).isEmpty())
+            protocol = guessProtocol(match.captured(1));
 
         const int start = match.capturedStart();
-        const int len = match.capturedEnd() - start;
-        QString href = match.captured();
+        const QString href = match.captured();
         QString raw = href;
-        raw.replace("&amp;", "&");
-        const QString link = generateLink(protocol, raw, href);
-        processed.replace(start + offset, len, link);
-        offset += link.length() - len;
+        if (raw.contains(QLatin1Char('&')))
+            raw.replace(QLatin1String("&amp;"), QLatin1String("&"));
+        if (html) {
+            if (!linked)
+                html->reserve(message.size() + 128);
+            html->append(message.constData() + last, start - last);
+            appendLink(html, protocol, raw, href);
+        }
+        last = match.capturedEnd();
+        linked = true;
         if (urls)
             urls->append(QUrl(protocol + raw));
     }
 #else
     int pos = 0;
-    QRegExp rx(pattern);
-    while ((pos = rx.indexIn(processed, pos)) >= 0) {
+    while ((pos = rx.indexIn(message, pos)) >= 0) {
         int len = rx.matchedLength();
-        QString href = processed.mid(pos, len);
+        QString href = message.mid(pos, len);
         QString raw = href;
         raw.replace("&amp;", "&");
 
@@ -214,28 +370,273 @@ static QString parseUrls(const QString& message, const QString& pattern, QList<Q
                 protocol = QLatin1String("http://");
         }
 
-        QString link = generateLink(protocol, raw, href);
-        processed.replace(pos, len, link);
-        pos += link.length();
+        if (html) {
+            if (!linked)
+                html->reserve(message.size() + 128);
+            html->append(message.midRef(last, pos - last));
+            appendLink(html, protocol, raw, href);
+        }
+        pos += len;
+        last = pos;
+        linked = true;
         if (urls)
             urls->append(QUrl(protocol + raw));
     }
 #endif
-    return processed;
+    if (html) {
+        if (linked)
+            html->append(message.constData() + last, message.size() - last);
+        else
+            *html = message;
+    }
 }
 
-void IrcTextFormatPrivate::parse(const QString& str, QString* text, QString* html, QList<QUrl>* urls) const
+#if QT_VERSION >= 0x050000
+static void findUrls(const QString& text, const QRegularExpression& rx, QVector<QPair<int, int> >* ranges, QList<QUrl>* urls)
 {
-    QString processed = str;
+    QRegularExpressionMatchIterator it = rx.globalMatch(text);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        if (match.capturedLength() <= 0)
+            continue;
+        QString protocol;
+        if (match.captured(2).isEmpty())
+            protocol = guessProtocol(match.captured(1));
+        ranges->append(qMakePair(match.capturedStart(), match.capturedEnd()));
+        if (urls)
+            urls->append(QUrl(protocol + match.captured()));
+    }
+}
+#else
+static void findUrls(const QString& text, QRegExp rx, QVector<QPair<int, int> >* ranges, QList<QUrl>* urls)
+{
+    int pos = 0;
+    while ((pos = rx.indexIn(text, pos)) >= 0) {
+        int len = rx.matchedLength();
+        if (len <= 0)
+            break;
+        QString protocol;
+        if (rx.cap(2).isEmpty()) {
+            if (rx.cap(1).contains(QLatin1Char('@')))
+                protocol = QLatin1String("mailto:");
+            else if (rx.cap(1).startsWith(QLatin1String("ftp."), Qt::CaseInsensitive))
+                protocol = QLatin1String("ftp://");
+            else
+                protocol = QLatin1String("http://");
+        }
+        ranges->append(qMakePair(pos, pos + len));
+        if (urls)
+            urls->append(QUrl(protocol + text.mid(pos, len)));
+        pos += len;
+    }
+}
+#endif
+
+static void appendRun(QVector<IrcTextFormat::Run>* runs, const IrcTextFormat::Run& run)
+{
+    if (run.length <= 0)
+        return;
+    if (!runs->isEmpty()) {
+        IrcTextFormat::Run& last = runs->last();
+        if (last.start + last.length == run.start && last.styles == run.styles && last.url == run.url
+                && last.foreground == run.foreground && last.background == run.background) {
+            last.length += run.length;
+            return;
+        }
+    }
+    runs->append(run);
+}
+
+QVector<IrcTextFormat::Run> IrcTextFormatConfig::parseRuns(const QString& str, QString* text, QList<QUrl>* urls) const
+{
+    const int size = str.size();
+    const QChar* data = str.constData();
+
+    QString plain;
+    plain.reserve(size);
+
+    // contiguous runs covering the whole plain text, including unformatted ones
+    QVector<IrcTextFormat::Run> runs;
+    IrcTextFormat::Run run = { 0, 0, IrcTextFormat::NoStyle, -1, -1, -1 };
+    bool potentialUrl = false;
+    int literal = 0;
+
+    for (int pos = 0; pos < size; ++pos) {
+        const ushort c = data[pos].unicode();
+        if (c > ':')
+            continue;
+
+        if (c == '.' || c == '/' || c == ':') {
+            // a dot, slash or colon NOT surrounded by a space indicates a potential URL
+            if (!potentialUrl && pos < size - 1 && !data[pos + 1].isSpace()) {
+                if (pos > literal)
+                    potentialUrl = !data[pos - 1].isSpace();
+                else
+                    potentialUrl = !plain.isEmpty() && !plain.at(plain.size() - 1).isSpace();
+            }
+            continue;
+        }
 
-    // TODO:
-    processed.replace(QLatin1Char('&'), QLatin1String("&amp;"));
-    processed.replace(QLatin1Char('<'), QLatin1String("&lt;"));
-    //processed.replace(QLatin1Char('>'), QLatin1String("&gt;"));
-    //processed.replace(QLatin1Char('"'), QLatin1String("&quot;"));
-    //processed.replace(QLatin1Char('\''), QLatin1String("&apos;"));
-    //processed.replace(QLatin1Char('\t'), QLatin1String("&nbsp;"));
+        IrcTextFormat::Styles styles = run.styles;
+        int fg = run.foreground;
+        int bg = run.background;
+        int len = 0;
+        switch (c) {
+            case '\x02': styles ^= IrcTextFormat::Bold; break;
+            case '\x1d': styles ^= IrcTextFormat::Italic; break;
+            case '\x13': styles ^= IrcTextFormat::StrikeOut; break;
+            case '\x15':
+            case '\x1f': styles ^= IrcTextFormat::Underline; break;
+            case '\x16': styles ^= IrcTextFormat::Inverse; break;
+            case '\x03': {
+                int f = -1;
+                int b = -1;
+                if (parseColors(str, pos + 1, &len, &f, &b)) {
+                    fg = f;
+                    if (b != -1)
+                        bg = b;
+                } else {
+                    fg = -1;
+                    bg = -1;
+                }
+                break;
+            }
+            case '\x0f':
+                styles = IrcTextFormat::NoStyle;
+                fg = -1;
+                bg = -1;
+                break;
+            default:
+                continue;
+        }
 
+        if (pos > literal)
+            plain.append(data + literal, pos - literal);
+        literal = pos + len + 1;
+        pos += len;
+
+        run.length = plain.size() - run.start;
+        appendRun(&runs, run);
+        run.start = plain.size();
+        run.styles = styles;
+        run.foreground = fg;
+        run.background = bg;
+    }
+    if (size > literal)
+        plain.append(data + literal, size - literal);
+    run.length = plain.size() - run.start;
+    appendRun(&runs, run);
+
+    // split the runs at URL boundaries
+    QVector<QPair<int, int> > ranges;
+    const int base = urls ? urls->size() : 0;
+    if (potentialUrl && !urlPattern.isEmpty())
+        findUrls(plain, urlRegExp, &ranges, urls);
+
+    QVector<IrcTextFormat::Run> result;
+    result.reserve(runs.size() + 2 * ranges.size());
+    int u = 0;
+    foreach (const IrcTextFormat::Run& r, runs) {
+        int pos = r.start;
+        const int end = r.start + r.length;
+        while (pos < end) {
+            while (u < ranges.size() && ranges.at(u).second <= pos)
+                ++u;
+            IrcTextFormat::Run piece = r;
+            piece.start = pos;
+            if (u < ranges.size() && ranges.at(u).first <= pos) {
+                piece.url = base + u;
+                piece.length = qMin(end, ranges.at(u).second) - pos;
+            } else {
+                piece.length = (u < ranges.size() ? qMin(end, ranges.at(u).first) : end) - pos;
+            }
+            pos += piece.length;
+            if (piece.styles != IrcTextFormat::NoStyle || piece.foreground != -1 || piece.background != -1 || piece.url != -1)
+                result += piece;
+        }
+    }
+
+    if (text)
+        *text = plain;
+    return result;
+}
+
+const IrcTextFormatConfig* IrcTextFormatPrivate::currentConfig() const
+{
+    const IrcPalettePrivate* p = IrcPalettePrivate::get(palette);
+    if (config.constData()->generation != p->generation) {
+        config->colors = p->colors;
+        config->generation = p->generation;
+    }
+    return config.constData();
+}
+
+const IrcTextFormatCacheEntry* IrcTextFormatPrivate::lookup(const QString& str, bool text, bool html) const
+{
+    if (cache.maxCost() <= 0)
+        return nullptr;
+
+    // palette changes invalidate everything formatted with the old colors
+    const int generation = IrcPalettePrivate::get(palette)->generation;
+    if (generation != cacheGeneration) {
+        cache.clear();
+        cacheGeneration = generation;
+    }
+
+    IrcTextFormatCacheEntry* entry = cache.object(str);
+    if (entry && (!text || entry->hasText) && (!html || entry->hasHtml)) {
+        ++cacheHits;
+        return entry;
+    }
+
+    ++cacheMisses;
+    if (!entry) {
+        entry = new IrcTextFormatCacheEntry;
+        cache.insert(str, entry);
+    }
+    text &= !entry->hasText;
+    html &= !entry->hasHtml;
+    currentConfig()->parse(str, text ? &entry->plainText : nullptr, html ? &entry->html : nullptr, html ? &entry->urls : nullptr);
+    entry->hasText |= text;
+    entry->hasHtml |= html;
+    return entry;
+}
+
+void IrcTextFormatConfig::compileUrlPattern()
+{
+    // compiled once per pattern instead of once per parsed message
+#if QT_VERSION >= 0x050000
+    urlRegExp = QRegularExpression(urlPattern);
+    if (!urlPattern.isEmpty())
+        urlRegExp.optimize();
+#else
+    urlRegExp = QRegExp(urlPattern);
+#endif
+}
+
+void IrcTextFormatConfig::appendColors(QString* html, int fg, int bg) const
+{
+    if (spanFormat == IrcTextFormat::SpanStyle) {
+        html->append(QLatin1String("<span style='color: "));
+        html->append(colors.value(fg, QLatin1String("black")));
+        if (bg != -1) {
+            html->append(QLatin1String("; background-color: "));
+            html->append(colors.value(bg, QLatin1String("transparent")));
+        }
+    } else {
+        html->append(QLatin1String("<span class='"));
+        html->append(colors.value(fg, QLatin1String("black")));
+        if (bg != -1) {
+            html->append(QLatin1Char(' '));
+            html->append(colors.value(bg, QLatin1String("transparent")));
+            html->append(QLatin1String("-background"));
+        }
+    }
+    html->append(QLatin1String("'>"));
+}
+
+void IrcTextFormatConfig::parse(const QString& str, QString* text, QString* html, QList<QUrl>* urls) const
+{
     enum {
         None            = 0x0,
         Bold            = 0x1,
@@ -245,149 +646,160 @@ void IrcTextFormatPrivate::parse(const QString& str, QString* text, QString* htm
         Inverse         = 0x20
     };
     int state = None;
-
-    int pos = 0;
-    int len = 0;
-    int fg = -1;
-    int bg = -1;
     int depth = 0;
     bool potentialUrl = false;
-    while (pos < processed.size()) {
-        QString replacement;
-        switch (processed.at(pos).unicode()) {
+
+    const int size = str.size();
+    const QChar* data = str.constData();
+    const bool markup = html || urls;
+    const bool style = spanFormat == IrcTextFormat::SpanStyle;
+
+    // the input is scanned once and literal runs are appended in chunks.
+    // the HTML output is not materialized until the first character that
+    // needs escaping or formatting; until then it is the input itself.
+    QString processed;
+    bool copied = false;
+    int run = 0;
+
+    if (text)
+        text->reserve(text->size() + size);
+
+    auto flush = [&](int pos) {
+        if (pos > run) {
+            if (text)
+                text->append(data + run, pos - run);
+            if (copied)
+                processed.append(data + run, pos - run);
+        }
+    };
+    auto detach = [&](int pos) {
+        if (!copied) {
+            processed.reserve(size + 128);
+            processed.append(data, pos);
+            copied = true;
+        }
+    };
+    auto toggle = [&](int pos, int flag, const QLatin1String& styled, const QLatin1String& classed) {
+        if (markup) {
+            detach(pos);
+            if (state & flag)
+                processed.append(QLatin1String("</span>"));
+            else
+                processed.append(style ? styled : classed);
+        }
+        depth += (state & flag) ? -1 : 1;
+        state ^= flag;
+    };
+
+    for (int pos = 0; pos < size; ++pos) {
+        const ushort c = data[pos].unicode();
+        if (c > '<')
+            continue;
+
+        switch (c) {
             case '\x02': // bold
-                if (state & Bold) {
-                    depth--;
-                    replacement = QLatin1String("</span>");
-                } else {
-                    depth++;
-                    if (spanFormat == IrcTextFormat::SpanStyle)
-                        replacement = QLatin1String("<span style='font-weight: bold'>");
-                    else
-                        replacement = QLatin1String("<span class='bold'>");
-                }
-                state ^= Bold;
+                flush(pos);
+                toggle(pos, Bold, QLatin1String("<span style='font-weight: bold'>"), QLatin1String("<span class='bold'>"));
                 break;
 
-            case '\x03': // color
-                if (parseColors(processed, pos + 1, &len, &fg, &bg)) {
+            case '\x03': { // color
+                flush(pos);
+                int len = 0;
+                int fg = -1;
+                int bg = -1;
+                if (parseColors(str, pos + 1, &len, &fg, &bg)) {
                     depth++;
-                    if (spanFormat == IrcTextFormat::SpanStyle) {
-                        QStringList styles;
-                        styles += QString(QLatin1String("color: %1")).arg(palette->colorName(fg, QLatin1String("black")));
-                        if (bg != -1)
-                            styles += QString(QLatin1String("background-color: %1")).arg(palette->colorName(bg, QLatin1String("transparent")));
-                        replacement = QString(QLatin1String("<span style='%1'>")).arg(styles.join(QLatin1String("; ")));
-                    } else {
-                        QStringList classes;
-                        classes += palette->colorName(fg, QLatin1String("black"));
-                        if (bg != -1)
-                            classes += palette->colorName(bg, QLatin1String("transparent")) + QLatin1String("-background");
-                        replacement = QString(QLatin1String("<span class='%1'>")).arg(classes.join(QLatin1String(" ")));
+                    if (markup) {
+                        detach(pos);
+                        appendColors(&processed, fg, bg);
                     }
                     // \x03FF(,BB)
-                    processed.replace(pos, len + 1, replacement);
-                    pos += replacement.length();
-                    continue;
+                    pos += len;
                 } else {
                     depth--;
-                    replacement = QLatin1String("</span>");
+                    if (markup) {
+                        detach(pos);
+                        processed.append(QLatin1String("</span>"));
+                    }
                 }
                 break;
+            }
 
                 //case '\x09': // italic
             case '\x1d': // italic
-                if (state & Italic) {
-                    depth--;
-                    replacement = QLatin1String("</span>");
-                } else {
-                    depth++;
-                    if (spanFormat == IrcTextFormat::SpanStyle)
-                        replacement = QLatin1String("<span style='font-style: italic'>");
-                    else
-                        replacement = QLatin1String("<span class='italic'>");
-                }
-                state ^= Italic;
+                flush(pos);
+                toggle(pos, Italic, QLatin1String("<span style='font-style: italic'>"), QLatin1String("<span class='italic'>"));
                 break;
 
             case '\x13': // line-through
-                if (state & LineThrough) {
-                    depth--;
-                    replacement = QLatin1String("</span>");
-                } else {
-                    depth++;
-                    if (spanFormat == IrcTextFormat::SpanStyle)
-                        replacement = QLatin1String("<span style='text-decoration: line-through'>");
-                    else
-                        replacement = QLatin1String("<span class='line-through'>");
-                }
-                state ^= LineThrough;
+                flush(pos);
+                toggle(pos, LineThrough, QLatin1String("<span style='text-decoration: line-through'>"), QLatin1String("<span class='line-through'>"));
                 break;
 
             case '\x15': // underline
             case '\x1f': // underline
-                if (state & Underline) {
-                    depth--;
-                    replacement = QLatin1String("</span>");
-                } else {
-                    depth++;
-                    if (spanFormat == IrcTextFormat::SpanStyle)
-                        replacement = QLatin1String("<span style='text-decoration: underline'>");
-                    else
-                        replacement = QLatin1String("<span class='underline'>");
-                }
-                state ^= Underline;
+                flush(pos);
+                toggle(pos, Underline, QLatin1String("<span style='text-decoration: underline'>"), QLatin1String("<span class='underline'>"));
                 break;
 
             case '\x16': // inverse
-                if (state & Inverse) {
-                    depth--;
-                    replacement = QLatin1String("</span>");
-                } else {
-                    depth++;
-                    if (spanFormat == IrcTextFormat::SpanStyle)
-                        replacement = QLatin1String("<span style='text-decoration: inverse'>");
-                    else
-                        replacement = QLatin1String("<span class='inverse'>");
-                }
-                state ^= Inverse;
+                flush(pos);
+                toggle(pos, Inverse, QLatin1String("<span style='text-decoration: inverse'>"), QLatin1String("<span class='inverse'>"));
                 break;
 
             case '\x0f': // none
-                if (depth > 0)
-                    replacement = QString(QLatin1String("</span>")).repeated(depth);
-                else
-                    processed.remove(pos--, 1); // must rewind back for ++pos below...
+                flush(pos);
+                if (markup) {
+                    detach(pos);
+                    for (int i = 0; i < depth; ++i)
+                        processed.append(QLatin1String("</span>"));
+                }
                 state = None;
                 depth = 0;
                 break;
 
+            case '&':
+            case '<': {
+                // TODO: '>', '"', '\'' and '\t'
+                const QLatin1String entity = c == '&' ? QLatin1String("&amp;") : QLatin1String("&lt;");
+                flush(pos);
+                if (text)
+                    text->append(entity);
+                if (markup) {
+                    detach(pos);
+                    processed.append(entity);
+                }
+                break;
+            }
+
             case '.':
             case '/':
             case ':':
                 // a dot, slash or colon NOT surrounded by a space indicates a potential URL
-                if (!potentialUrl && pos > 0 && !processed.at(pos - 1).isSpace()
-                        && pos < processed.length() - 1 && !processed.at(pos + 1).isSpace())
-                    potentialUrl = true;
-                Q_FALLTHROUGH();
+                if (markup && !potentialUrl && pos < size - 1 && !data[pos + 1].isSpace()) {
+                    if (!copied || pos > run)
+                        potentialUrl = pos > 0 && !data[pos - 1].isSpace();
+                    else
+                        potentialUrl = !processed.isEmpty() && !processed.at(processed.size() - 1).isSpace();
+                }
+                continue;
+
             default:
-                if (text)
-                    *text += processed.at(pos);
-                break;
+                continue;
         }
 
-        if (!replacement.isEmpty()) {
-            processed.replace(pos, 1, replacement);
-            pos += replacement.length();
-        } else {
-            ++pos;
-        }
+        run = pos + 1;
     }
+    flush(size);
+
+    if (!markup)
+        return;
 
-    if ((html || urls) && potentialUrl && !urlPattern.isEmpty())
-        processed = parseUrls(processed, urlPattern, urls);
-    if (html)
-        *html = processed;
+    const QString result = copied ? processed : str;
+    if (potentialUrl && !urlPattern.isEmpty())
+        parseUrls(result, urlRegExp, html, urls);
+    else if (html)
+        *html = result;
 }
 
 /*!
@@ -397,8 +809,10 @@ IrcTextFormat::IrcTextFormat(QObject* parent) : QObject(parent), d_ptr(new IrcTe
 {
     Q_D(IrcTextFormat);
     d->palette = new IrcPalette(this);
-    d->urlPattern = QString("\\b((?:(?:([a-z][\\w\\.-]+:/{1,3})|www|ftp\\d{0,3}[.]|[a-z0-9.\\-]+[.][a-z]{2,4}/)(?:[^\\s()<>]+|\\(([^\\s()<>]+|(\\([^\\s()<>]+\\)))*\\))+(?:\\(([^\\s()<>]+|(\\([^\\s()<>]+\\)))*\\)|\\}\\]|[^\\s`!()\\[\\]{};:'\".,<>?%1%2%3%4%5%6])|[a-z0-9.\\-+_]+@[a-z0-9.\\-]+[.][a-z]{1,5}[^\\s/`!()\\[\\]{};:'\".,<>?%1%2%3%4%5%6]))").arg(QChar(0x00AB)).arg(QChar(0x00BB)).arg(QChar(0x201C)).arg(QChar(0x201D)).arg(QChar(0x2018)).arg(QChar(0x2019));
-    d->spanFormat = SpanStyle;
+    d->config = new IrcTextFormatConfig;
+    d->config->urlPattern = QString("\\b((?:(?:([a-z][\\w\\.-]+:/{1,3})|www|ftp\\d{0,3}[.]|[a-z0-9.\\-]+[.][a-z]{2,4}/)(?:[^\\s()<>]+|\\(([^\\s()<>]+|(\\([^\\s()<>]+\\)))*\\))+(?:\\(([^\\s()<>]+|(\\([^\\s()<>]+\\)))*\\)|\\}\\]|[^\\s`!()\\[\\]{};:'\".,<>?%1%2%3%4%5%6])|[a-z0-9.\\-+_]+@[a-z0-9.\\-]+[.][a-z]{1,5}[^\\s/`!()\\[\\]{};:'\".,<>?%1%2%3%4%5%6]))").arg(QChar(0x00AB)).arg(QChar(0x00BB)).arg(QChar(0x201C)).arg(QChar(0x201D)).arg(QChar(0x2018)).arg(QChar(0x2019));
+    d->config->compileUrlPattern();
+    d->cache.setMaxCost(0);
 }
 
 /*!
@@ -430,13 +844,17 @@ IrcPalette* IrcTextFormat::palette() const
 QString IrcTextFormat::urlPattern() const
 {
     Q_D(const IrcTextFormat);
-    return d->urlPattern;
+    return d->config.constData()->urlPattern;
 }
 
 void IrcTextFormat::setUrlPattern(const QString& pattern)
 {
     Q_D(IrcTextFormat);
-    d->urlPattern = pattern;
+    if (d->config.constData()->urlPattern != pattern) {
+        d->config->urlPattern = pattern;
+        d->config->compileUrlPattern();
+        d->cache.clear();
+    }
 }
 
 /*!
@@ -471,13 +889,16 @@ void IrcTextFormat::setUrlPattern(const QString& pattern)
 IrcTextFormat::SpanFormat IrcTextFormat::spanFormat() const
 {
     Q_D(const IrcTextFormat);
-    return d->spanFormat;
+    return d->config.constData()->spanFormat;
 }
 
 void IrcTextFormat::setSpanFormat(IrcTextFormat::SpanFormat format)
 {
     Q_D(IrcTextFormat);
-    d->spanFormat = format;
+    if (d->config.constData()->spanFormat != format) {
+        d->config->spanFormat = format;
+        d->cache.clear();
+    }
 }
 
 
@@ -495,8 +916,10 @@ void IrcTextFormat::setSpanFormat(IrcTextFormat::SpanFormat format)
 QString IrcTextFormat::toHtml(const QString& text) const
 {
     Q_D(const IrcTextFormat);
+    if (const IrcTextFormatCacheEntry* entry = d->lookup(text, false, true))
+        return entry->html;
     QString html;
-    d->parse(text, nullptr, &html, nullptr);
+    d->currentConfig()->parse(text, nullptr, &html, nullptr);
     return html;
 }
 
@@ -509,11 +932,32 @@ QString IrcTextFormat::toHtml(const QString& text) const
 QString IrcTextFormat::toPlainText(const QString& text) const
 {
     Q_D(const IrcTextFormat);
+    if (const IrcTextFormatCacheEntry* entry = d->lookup(text, true, false))
+        return entry->plainText;
     QString plain;
-    d->parse(text, &plain, nullptr, nullptr);
+    d->currentConfig()->parse(text, &plain, nullptr, nullptr);
     return plain;
 }
 
+/*!
+    \since 3.7
+
+    Converts \a text to a list of formatted runs over its plain text. The plain
+    text is stored to \a plainText, and the detected URLs are appended to
+    \a urls. Unformatted ranges outside of URLs are not included.
+
+    Unlike toHtml(), this function does not generate any markup that would have
+    to be parsed again by a rich text engine, and unlike toPlainText(), the
+    resulting plain text is not HTML-escaped.
+
+    \sa Run, toPlainText(), toHtml()
+*/
+QVector<IrcTextFormat::Run> IrcTextFormat::toRuns(const QString& text, QString* plainText, QList<QUrl>* urls) const
+{
+    Q_D(const IrcTextFormat);
+    return d->currentConfig()->parseRuns(text, plainText, urls);
+}
+
 /*!
     \since 3.2
 
@@ -572,10 +1016,330 @@ QList<QUrl> IrcTextFormat::urls() const
 void IrcTextFormat::parse(const QString& text)
 {
     Q_D(IrcTextFormat);
+    if (const IrcTextFormatCacheEntry* entry = d->lookup(text, true, true)) {
+        d->plainText = entry->plainText;
+        d->html = entry->html;
+        d->urls = entry->urls;
+        return;
+    }
     d->plainText.clear();
     d->html.clear();
     d->urls.clear();
-    d->parse(text, &d->plainText, &d->html, &d->urls);
+    d->currentConfig()->parse(text, &d->plainText, &d->html, &d->urls);
+}
+
+/*!
+    \since 3.7
+
+    This property holds the maximum number of cached messages.
+
+    When enabled, toHtml(), toPlainText() and parse() keep the results for the
+    most recently formatted messages, and return them without parsing again
+    when the same message is formatted repeatedly, for example while scrolling
+    a view. The cache is invalidated when the \ref palette colors, the
+    \ref urlPattern or the \ref spanFormat change.
+
+    The default value is \c 0, which disables caching.
+
+    \par Access functions:
+    \li int <b>cacheSize</b>() const
+    \li void <b>setCacheSize</b>(int size)
+
+    \sa cacheHits, cacheMisses, clearCache()
+ */
+int IrcTextFormat::cacheSize() const
+{
+    Q_D(const IrcTextFormat);
+    return d->cache.maxCost();
+}
+
+void IrcTextFormat::setCacheSize(int size)
+{
+    Q_D(IrcTextFormat);
+    d->cache.setMaxCost(qMax(0, size));
+}
+
+/*!
+    \since 3.7
+
+    This property holds the number of formatting requests served from the cache.
+
+    \par Access function:
+    \li int <b>cacheHits</b>() const
+
+    \sa cacheSize, cacheMisses
+ */
+int IrcTextFormat::cacheHits() const
+{
+    Q_D(const IrcTextFormat);
+    return d->cacheHits;
+}
+
+/*!
+    \since 3.7
+
+    This property holds the number of formatting requests that missed the cache.
+
+    \par Access function:
+    \li int <b>cacheMisses</b>() const
+
+    \sa cacheSize, cacheHits
+ */
+int IrcTextFormat::cacheMisses() const
+{
+    Q_D(const IrcTextFormat);
+    return d->cacheMisses;
+}
+
+/*!
+    \since 3.7
+
+    Clears the cache and resets the hit and miss counters.
+
+    \sa cacheSize
+ */
+void IrcTextFormat::clearCache()
+{
+    Q_D(IrcTextFormat);
+    d->cache.clear();
+    d->cacheHits = 0;
+    d->cacheMisses = 0;
+}
+
+/*!
+    \since 3.7
+
+    Returns an immutable snapshot of the current formatting configuration.
+
+    The snapshot captures the \ref palette colors, the \ref urlPattern and the
+    \ref spanFormat. It is not affected by later changes to the text format,
+    and it can be copied and used from any thread.
+
+    \sa Snapshot
+ */
+IrcTextFormat::Snapshot IrcTextFormat::snapshot() const
+{
+    Q_D(const IrcTextFormat);
+    d->currentConfig();
+    Snapshot snapshot;
+    snapshot.d = d->config;
+    return snapshot;
+}
+
+/*!
+    \since 3.7
+    \class IrcTextFormat::Snapshot irctextformat.h <IrcTextFormat>
+    \brief An immutable, thread-safe copy of a text format configuration.
+
+    IrcTextFormat is a QObject and its palette cannot be shared across threads.
+    A snapshot taken with IrcTextFormat::snapshot() carries the palette colors,
+    the URL pattern and the span format by value. All its functions are const
+    and reentrant, and the same snapshot may be used from several threads at
+    the same time.
+
+    The batch functions format a list of messages in parallel on a QThreadPool.
+    The calling thread takes part in the work, and the call returns when all
+    messages have been formatted:
+
+    \code
+    IrcTextFormat::Snapshot snapshot = format->snapshot();
+    QStringList html = snapshot.toHtml(lines);
+    \endcode
+
+    \sa IrcTextFormat::snapshot()
+ */
+
+/*!
+    Constructs a null snapshot.
+
+    \sa IrcTextFormat::snapshot()
+ */
+IrcTextFormat::Snapshot::Snapshot()
+{
+}
+
+/*!
+    Constructs a copy of \a other.
+ */
+IrcTextFormat::Snapshot::Snapshot(const Snapshot& other) : d(other.d)
+{
+}
+
+/*!
+    Assigns \a other to this snapshot.
+ */
+IrcTextFormat::Snapshot& IrcTextFormat::Snapshot::operator=(const Snapshot& other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Destructs the snapshot.
+ */
+IrcTextFormat::Snapshot::~Snapshot()
+{
+}
+
+/*!
+    Returns \c true if the snapshot was not taken from a text format.
+ */
+bool IrcTextFormat::Snapshot::isNull() const
+{
+    return !d.constData();
+}
+
+/*!
+    Converts \a text to HTML.
+
+    \sa IrcTextFormat::toHtml()
+ */
+QString IrcTextFormat::Snapshot::toHtml(const QString& text) const
+{
+    QString html;
+    if (const IrcTextFormatConfig* config = d.constData())
+        config->parse(text, nullptr, &html, nullptr);
+    return html;
+}
+
+/*!
+    Converts \a text to plain text.
+
+    \sa IrcTextFormat::toPlainText()
+ */
+QString IrcTextFormat::Snapshot::toPlainText(const QString& text) const
+{
+    QString plain;
+    if (const IrcTextFormatConfig* config = d.constData())
+        config->parse(text, &plain, nullptr, nullptr);
+    return plain;
+}
+
+/*!
+    Converts \a text to a list of formatted runs over \a plainText.
+
+    \sa IrcTextFormat::toRuns()
+ */
+QVector<IrcTextFormat::Run> IrcTextFormat::Snapshot::toRuns(const QString& text, QString* plainText, QList<QUrl>* urls) const
+{
+    if (const IrcTextFormatConfig* config = d.constData())
+        return config->parseRuns(text, plainText, urls);
+    return QVector<Run>();
+}
+
+/*!
+    Parses \a text to \a plainText and \a html, and appends the detected URLs
+    to \a urls. Any of the output arguments may be \c nullptr.
+
+    \sa IrcTextFormat::parse()
+ */
+void IrcTextFormat::Snapshot::parse(const QString& text, QString* plainText, QString* html, QList<QUrl>* urls) const
+{
+    if (const IrcTextFormatConfig* config = d.constData())
+        config->parse(text, plainText, html, urls);
+}
+
+#ifndef IRC_DOXYGEN
+class IrcTextFormatBatch
+{
+public:
+    enum { ChunkSize = 32 };
+
+    IrcTextFormatBatch(const IrcTextFormatConfig* config, const QStringList& input, QString* output, bool html)
+        : config(config), input(input), output(output), html(html)
+    {
+    }
+
+    void work()
+    {
+        const int count = input.size();
+        forever {
+            const int from = next.fetchAndAddOrdered(ChunkSize);
+            if (from >= count)
+                break;
+            const int to = qMin(from + int(ChunkSize), count);
+            for (int i = from; i < to; ++i)
+                config->parse(input.at(i), html ? nullptr : &output[i], html ? &output[i] : nullptr, nullptr);
+        }
+    }
+
+    const IrcTextFormatConfig* config;
+    const QStringList& input;
+    QString* output;
+    bool html;
+    QAtomicInt next;
+    QSemaphore done;
+};
+
+class IrcTextFormatRunnable : public QRunnable
+{
+public:
+    IrcTextFormatRunnable(IrcTextFormatBatch* batch) : batch(batch) { }
+
+    void run() override
+    {
+        batch->work();
+        batch->done.release();
+    }
+
+private:
+    IrcTextFormatBatch* batch;
+};
+
+static QStringList formatBatch(const IrcTextFormatConfig* config, const QStringList& texts, bool html, QThreadPool* pool)
+{
+    if (!config)
+        return QStringList();
+
+    QVector<QString> results(texts.size());
+    IrcTextFormatBatch batch(config, texts, results.data(), html);
+
+    // helpers are only started on idle pool threads, and the calling thread
+    // works through the chunks too, so a busy pool cannot stall the batch
+    if (!pool)
+        pool = QThreadPool::globalInstance();
+    const int chunks = (texts.size() + IrcTextFormatBatch::ChunkSize - 1) / IrcTextFormatBatch::ChunkSize;
+    const int helpers = qMin(pool->maxThreadCount(), chunks) - 1;
+    int started = 0;
+    while (started < helpers) {
+        IrcTextFormatRunnable* runnable = new IrcTextFormatRunnable(&batch);
+        if (!pool->tryStart(runnable)) {
+            delete runnable;
+            break;
+        }
+        ++started;
+    }
+    batch.work();
+    batch.done.acquire(started);
+
+    QStringList formatted;
+    formatted.reserve(results.size());
+    foreach (const QString& result, results)
+        formatted += result;
+    return formatted;
+}
+#endif // IRC_DOXYGEN
+
+/*!
+    Converts \a texts to HTML in parallel on \a pool, or on
+    QThreadPool::globalInstance() if \a pool is \c nullptr.
+
+    The results are in the same order as \a texts.
+ */
+QStringList IrcTextFormat::Snapshot::toHtml(const QStringList& texts, QThreadPool* pool) const
+{
+    return formatBatch(d.constData(), texts, true, pool);
+}
+
+/*!
+    Converts \a texts to plain text in parallel on \a pool, or on
+    QThreadPool::globalInstance() if \a pool is \c nullptr.
+
+    The results are in the same order as \a texts.
+ */
+QStringList IrcTextFormat::Snapshot::toPlainText(const QStringList& texts, QThreadPool* pool) const
+{
+    return formatBatch(d.constData(), texts, false, pool);
 }
 
 #include "moc_irctextformat.cpp"
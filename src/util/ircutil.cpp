@@ -53,7 +53,9 @@ namespace IrcUtil {
         qRegisterMetaType<IrcCommandParser*>("IrcCommandParser*");
         qRegisterMetaType<IrcCompleter*>("IrcCompleter*");
         qRegisterMetaType<IrcLagTimer*>("IrcLagTimer*");
+        qRegisterMetaType<IrcLogWriter*>("IrcLogWriter*");
         qRegisterMetaType<IrcPalette*>("IrcPalette*");
+        qRegisterMetaType<IrcSearchIndex*>("IrcSearchIndex*");
         qRegisterMetaType<IrcTextFormat*>("IrcTextFormat*");
     }
 }
@@ -13,7 +13,9 @@ CONV_HEADERS  = $$INCDIR/IrcCommandParser
 CONV_HEADERS += $$INCDIR/IrcCommandQueue
 CONV_HEADERS += $$INCDIR/IrcCompleter
 CONV_HEADERS += $$INCDIR/IrcLagTimer
+CONV_HEADERS += $$INCDIR/IrcLogWriter
 CONV_HEADERS += $$INCDIR/IrcPalette
+CONV_HEADERS += $$INCDIR/IrcSearchIndex
 CONV_HEADERS += $$INCDIR/IrcTextFormat
 CONV_HEADERS += $$INCDIR/IrcUtil
 
@@ -21,13 +23,18 @@ PUB_HEADERS  = $$INCDIR/irccommandparser.h
 PUB_HEADERS += $$INCDIR/irccommandqueue.h
 PUB_HEADERS += $$INCDIR/irccompleter.h
 PUB_HEADERS += $$INCDIR/irclagtimer.h
+PUB_HEADERS += $$INCDIR/irclogwriter.h
 PUB_HEADERS += $$INCDIR/ircpalette.h
+PUB_HEADERS += $$INCDIR/ircsearchindex.h
 PUB_HEADERS += $$INCDIR/irctextformat.h
 PUB_HEADERS += $$INCDIR/ircutil.h
 
 PRIV_HEADERS  = $$INCDIR/irccommandparser_p.h
 PRIV_HEADERS += $$INCDIR/irccommandqueue_p.h
 PRIV_HEADERS += $$INCDIR/irclagtimer_p.h
+PRIV_HEADERS += $$INCDIR/irclogwriter_p.h
+PRIV_HEADERS += $$INCDIR/ircpalette_p.h
+PRIV_HEADERS += $$INCDIR/ircsearchindex_p.h
 PRIV_HEADERS += $$INCDIR/irctoken_p.h
 
 HEADERS += $$PUB_HEADERS
@@ -37,7 +44,9 @@ SOURCES += $$PWD/irccommandparser.cpp
 SOURCES += $$PWD/irccommandqueue.cpp
 SOURCES += $$PWD/irccompleter.cpp
 SOURCES += $$PWD/irclagtimer.cpp
+SOURCES += $$PWD/irclogwriter.cpp
 SOURCES += $$PWD/ircpalette.cpp
+SOURCES += $$PWD/ircsearchindex.cpp
 SOURCES += $$PWD/irctextformat.cpp
 SOURCES += $$PWD/irctoken.cpp
 SOURCES += $$PWD/ircutil.cpp
@@ -15,6 +15,7 @@ SUBDIRS += ircnetwork
 SUBDIRS += ircbuffer
 SUBDIRS += ircbuffermodel
 SUBDIRS += ircchannel
+SUBDIRS += ircmessagemodel
 SUBDIRS += ircuser
 SUBDIRS += ircusermodel
 
@@ -23,5 +24,7 @@ SUBDIRS += irccommandparser
 SUBDIRS += irccommandqueue
 SUBDIRS += irccompleter
 SUBDIRS += irclagtimer
+SUBDIRS += irclogwriter
 SUBDIRS += ircpalette
+SUBDIRS += ircsearchindex
 SUBDIRS += irctextformat
@@ -107,12 +107,15 @@ void tst_Irc::testMetaTypes()
     QVERIFY(qMetaTypeId<IrcBuffer*>());
     QVERIFY(qMetaTypeId<IrcBufferModel*>());
     QVERIFY(qMetaTypeId<IrcChannel*>());
+    QVERIFY(qMetaTypeId<IrcMessageModel*>());
     QVERIFY(qMetaTypeId<IrcUser*>());
     QVERIFY(qMetaTypeId<IrcUserModel*>());
 
     IrcUtil::registerMetaTypes();
     QVERIFY(qMetaTypeId<IrcCommandParser*>());
     QVERIFY(qMetaTypeId<IrcCommandQueue*>());
+    QVERIFY(qMetaTypeId<IrcSearchIndex*>());
+    QVERIFY(qMetaTypeId<IrcLogWriter*>());
     QVERIFY(qMetaTypeId<IrcCompleter*>());
     QVERIFY(qMetaTypeId<IrcLagTimer*>());
     QVERIFY(qMetaTypeId<IrcPalette*>());
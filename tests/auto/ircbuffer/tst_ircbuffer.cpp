@@ -14,6 +14,7 @@
 #include "ircmessage.h"
 #include "ircfilter.h"
 #include <QtTest/QtTest>
+#include <QtCore/QTemporaryDir>
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     #include <QtCore/QRegExp>
 #else
@@ -34,6 +35,7 @@ private slots:
     void testUserData();
     void testClose();
     void testSendCommand();
+    void testArchive();
 };
 
 void tst_IrcBuffer::testDefaults()
@@ -227,6 +229,120 @@ void tst_IrcBuffer::testSendCommand()
     QCOMPARE(filter.lastCommand, cmd);
 }
 
+void tst_IrcBuffer::testArchive()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    IrcConnection connection;
+    IrcBufferModel model(&connection);
+    model.setArchiveDirectory(dir.path());
+    QCOMPARE(model.archiveDirectory(), dir.path());
+
+    IrcBuffer* buffer = model.add("#Foo");
+    QVERIFY(buffer->loadMessages(10).isEmpty());
+
+    const int count = 100000;
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(Q_INT64_C(1500000000000));
+    for (int i = 0; i < count; ++i) {
+        IrcMessage* msg = IrcMessage::fromData(":nick!user@host PRIVMSG #foo :" + QByteArray::number(i), &connection);
+        msg->setTimeStamp(base.addSecs(i));
+        buffer->receiveMessage(msg);
+        delete msg;
+    }
+
+    // one file per case folded title
+    QVERIFY(QFile::exists(dir.filePath("%23foo.log")));
+    QVERIFY(QFile::exists(dir.filePath("%23foo.log.idx")));
+
+    QList<IrcMessage*> messages = buffer->loadMessages(3);
+    QCOMPARE(messages.count(), 3);
+    QCOMPARE(messages.at(0)->type(), IrcMessage::Private);
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(0))->content(), QString::number(count - 3));
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(2))->content(), QString::number(count - 1));
+    QCOMPARE(messages.at(2)->timeStamp(), base.addSecs(count - 1));
+    QCOMPARE(messages.at(2)->connection(), &connection);
+    qDeleteAll(messages);
+
+    messages = buffer->loadMessages(2, base.addSecs(50000));
+    QCOMPARE(messages.count(), 2);
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(0))->content(), QString("49998"));
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(1))->content(), QString("49999"));
+    QCOMPARE(messages.at(1)->timeStamp(), base.addSecs(49999));
+    qDeleteAll(messages);
+
+    messages = buffer->loadMessages(1000, base.addSecs(5));
+    QCOMPARE(messages.count(), 5);
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(0))->content(), QString("0"));
+    qDeleteAll(messages);
+
+    QVERIFY(buffer->loadMessages(10, base.addSecs(-1)).isEmpty());
+
+    // a damaged index and a partially written record are recovered on reopen
+    model.setArchiveDirectory(QString());
+    QVERIFY(buffer->loadMessages(10).isEmpty());
+
+    QVERIFY(QFile::resize(dir.filePath("%23foo.log.idx"), 10 * 16 + 5));
+    QFile file(dir.filePath("%23foo.log"));
+    QVERIFY(file.open(QIODevice::Append));
+    QVERIFY(file.write(QByteArray(10, 'x')) == 10);
+    file.close();
+
+    model.setArchiveDirectory(dir.path());
+    messages = buffer->loadMessages(1, base.addSecs(count - 1));
+    QCOMPARE(messages.count(), 1);
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(0))->content(), QString::number(count - 2));
+    qDeleteAll(messages);
+
+    IrcMessage* msg = IrcMessage::fromData(":nick!user@host PRIVMSG #foo :last", &connection);
+    buffer->receiveMessage(msg);
+    delete msg;
+
+    messages = buffer->loadMessages(2);
+    QCOMPARE(messages.count(), 2);
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(0))->content(), QString::number(count - 1));
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(1))->content(), QString("last"));
+    qDeleteAll(messages);
+
+    // messages are indexed by msgid, and played back history is not archived twice
+    const QDateTime later = QDateTime::currentDateTime().addSecs(60);
+    for (int i = 0; i < 3; ++i) {
+        msg = IrcMessage::fromData("@msgid=id" + QByteArray::number(i) + " :nick!user@host PRIVMSG #foo :tagged " + QByteArray::number(i), &connection);
+        msg->setTimeStamp(later.addSecs(i));
+        buffer->receiveMessage(msg);
+        delete msg;
+    }
+    msg = IrcMessage::fromData("@msgid=id1 :nick!user@host PRIVMSG #foo :tagged 1", &connection);
+    msg->setTimeStamp(later.addSecs(1));
+    msg->setFlag(IrcMessage::Playback);
+    buffer->receiveMessage(msg);
+    delete msg;
+
+    // and the msgid index is written along with the archive
+    model.setArchiveDirectory(QString());
+    QVERIFY(QFile::exists(dir.filePath("%23foo.log.ids")));
+    model.setArchiveDirectory(dir.path());
+
+    messages = buffer->loadMessages(4);
+    QCOMPARE(messages.count(), 4);
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(0))->content(), QString("last"));
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(1))->content(), QString("tagged 0"));
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(2))->content(), QString("tagged 1"));
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(3))->content(), QString("tagged 2"));
+    qDeleteAll(messages);
+
+    msg = IrcMessage::fromData("@msgid=id2 :nick!user@host PRIVMSG #foo :tagged 2", &connection);
+    msg->setTimeStamp(later.addSecs(2));
+    msg->setFlag(IrcMessage::Playback);
+    buffer->receiveMessage(msg);
+    delete msg;
+    messages = buffer->loadMessages(2);
+    QCOMPARE(messages.count(), 2);
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(0))->content(), QString("tagged 1"));
+    QCOMPARE(static_cast<IrcPrivateMessage*>(messages.at(1))->content(), QString("tagged 2"));
+    qDeleteAll(messages);
+}
+
 QTEST_MAIN(tst_IrcBuffer)
 
 #include "tst_ircbuffer.moc"
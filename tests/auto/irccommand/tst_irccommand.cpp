@@ -31,6 +31,8 @@ private slots:
     void testEncoding();
 
     void testConversion();
+    void testToMessage_data();
+    void testToMessage();
 
     void testConnection();
 
@@ -79,12 +81,16 @@ void tst_IrcCommand::testDefaults()
     IrcCommand cmd;
     QVERIFY(cmd.parameters().isEmpty());
     QCOMPARE(cmd.type(), IrcCommand::Custom);
+    QCOMPARE(cmd.priority(), IrcCommand::DefaultPriority);
     QCOMPARE(cmd.encoding(), QByteArray("UTF-8"));
     QVERIFY(!cmd.connection());
     QVERIFY(!cmd.network());
 
     QTest::ignoreMessage(QtWarningMsg, "Reimplement IrcCommand::toString() for IrcCommand::Custom");
     QVERIFY(cmd.toString().isEmpty());
+
+    cmd.setPriority(IrcCommand::LowPriority);
+    QCOMPARE(cmd.priority(), IrcCommand::LowPriority);
 }
 
 void tst_IrcCommand::testEncoding_data()
@@ -135,6 +141,46 @@ void tst_IrcCommand::testConversion()
     QCOMPARE(msg->property("content").toString(), QString("foo bar"));
 }
 
+void tst_IrcCommand::testToMessage_data()
+{
+    QTest::addColumn<IrcCommand*>("command");
+
+    QTest::newRow("action") << IrcCommand::createCtcpAction("#chan", "waves");
+    QTest::newRow("request") << IrcCommand::createCtcpRequest("nick", "VERSION");
+    QTest::newRow("reply") << IrcCommand::createCtcpReply("nick", "VERSION Communi");
+    QTest::newRow("join") << IrcCommand::createJoin("#chan");
+    QTest::newRow("join key") << IrcCommand::createJoin("#chan", "key");
+    QTest::newRow("kick") << IrcCommand::createKick("#chan", "nick");
+    QTest::newRow("kick reason") << IrcCommand::createKick("#chan", "nick", "go away");
+    QTest::newRow("message") << IrcCommand::createMessage("#chan", "foo bar");
+    QTest::newRow("message colon") << IrcCommand::createMessage("#chan", ":)");
+    QTest::newRow("nick") << IrcCommand::createNick("nick");
+    QTest::newRow("notice") << IrcCommand::createNotice("nick", "foo bar");
+    QTest::newRow("part") << IrcCommand::createPart("#chan");
+    QTest::newRow("part reason") << IrcCommand::createPart("#chan", "bye bye");
+    QTest::newRow("quit") << IrcCommand::createQuit("bye bye");
+    QTest::newRow("topic") << IrcCommand::createTopic("#chan", "foo bar");
+    QTest::newRow("whois") << IrcCommand::createWhois("nick");
+}
+
+void tst_IrcCommand::testToMessage()
+{
+    QFETCH(IrcCommand*, command);
+    QScopedPointer<IrcCommand> cmd(command);
+
+    // built directly, but equal to a parsed message
+    IrcConnection conn;
+    QScopedPointer<IrcMessage> msg(cmd->toMessage("nick!user@host", &conn));
+    QScopedPointer<IrcMessage> parsed(IrcMessage::fromData(":nick!user@host " + cmd->toString().toUtf8(), &conn));
+    QVERIFY(msg.data());
+    QVERIFY(parsed.data());
+    QCOMPARE(msg->type(), parsed->type());
+    QCOMPARE(msg->prefix(), parsed->prefix());
+    QCOMPARE(msg->nick(), parsed->nick());
+    QCOMPARE(msg->command(), parsed->command());
+    QCOMPARE(msg->parameters(), parsed->parameters());
+}
+
 void tst_IrcCommand::testConnection()
 {
     IrcConnection* connection = new IrcConnection(this);
@@ -94,6 +94,8 @@ void tst_IrcCommandParser::testParse()
 
     IrcCommand* cmd = parser.parse(input);
     QCOMPARE(cmd ? cmd->toString() : QString(), output);
+    if (cmd)
+        QCOMPARE(cmd->priority(), IrcCommand::NormalPriority);
 }
 
 void tst_IrcCommandParser::testTriggers()
@@ -8,6 +8,7 @@
  */
 
 #include "irccommandqueue.h"
+#include "irclagtimer.h"
 #include "ircconnection.h"
 #include "irccommand.h"
 #include "ircfilter.h"
@@ -28,6 +29,11 @@ private slots:
     void testClear();
     void testFlush();
     void testQuit();
+    void testLagTimer();
+    void testCost();
+    void testLanes();
+    void testTargets();
+    void testCoalescing();
 };
 
 void tst_IrcCommandQueue::testBatch()
@@ -36,6 +42,17 @@ void tst_IrcCommandQueue::testBatch()
     QCOMPARE(queue.batch(), 3);
     queue.setBatch(5);
     QCOMPARE(queue.batch(), 5);
+
+    // an empty batch disables queueing
+    queue.setBatch(0);
+    queue.setConnection(connection);
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    for (int i = 0; i < 5; ++i)
+        connection->sendCommand(IrcCommand::createAway());
+    QCOMPARE(queue.size(), 0);
 }
 
 void tst_IrcCommandQueue::testInterval()
@@ -144,6 +161,243 @@ void tst_IrcCommandQueue::testQuit()
     QCOMPARE(queue.size(), 0);
 }
 
+void tst_IrcCommandQueue::testLagTimer()
+{
+    IrcCommandQueue queue;
+    QVERIFY(!queue.lagTimer());
+
+    IrcLagTimer* timer = new IrcLagTimer(&queue);
+    queue.setLagTimer(timer);
+    QCOMPARE(queue.lagTimer(), timer);
+
+    delete timer;
+    QVERIFY(!queue.lagTimer());
+}
+
+void tst_IrcCommandQueue::testCost()
+{
+    TestCommandFilter filter(connection);
+    IrcCommandQueue queue(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    filter.commands.clear();
+
+    // a full bucket sends a batch of short commands right away
+    for (int i = 0; i < 4; ++i)
+        connection->sendCommand(IrcCommand::createAway());
+    QCOMPARE(queue.size(), 4);
+    QTRY_COMPARE(filter.commands.size(), queue.batch());
+    QCOMPARE(queue.size(), 1);
+    QTRY_COMPARE(filter.commands.size(), 4);
+    QCOMPARE(queue.size(), 0);
+
+    QTest::qWait(queue.interval() * 1000);
+    filter.commands.clear();
+
+    // a long line costs about two short ones
+    const QString message(450, QLatin1Char('x'));
+    connection->sendCommand(IrcCommand::createMessage("#communi", message));
+    connection->sendCommand(IrcCommand::createMessage("#communi", message));
+    QTRY_COMPARE(filter.commands.size(), 1);
+    QTest::qWait(250);
+    QCOMPARE(filter.commands.size(), 1);
+    QCOMPARE(queue.size(), 1);
+    QTRY_COMPARE(filter.commands.size(), 2);
+    QCOMPARE(queue.size(), 0);
+}
+
+void tst_IrcCommandQueue::testLanes()
+{
+    TestCommandFilter filter(connection);
+    IrcCommandQueue queue(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    filter.commands.clear();
+
+    connection->sendCommand(IrcCommand::createWho("#communi"));
+    connection->sendCommand(IrcCommand::createWho("#freenode"));
+    for (int i = 0; i < 6; ++i)
+        connection->sendCommand(IrcCommand::createMessage("#communi", "hi"));
+    QCOMPARE(queue.size(), 8);
+
+    // control commands are not queued
+    connection->sendCommand(IrcCommand::createPong("communi"));
+    QCOMPARE(queue.size(), 8);
+    QCOMPARE(filter.commands.size(), 1);
+    QCOMPARE(filter.commands.at(0)->type(), IrcCommand::Pong);
+
+    // an explicit priority overrides the type
+    IrcCommand* bulk = IrcCommand::createAway("bulk");
+    bulk->setPriority(IrcCommand::LowPriority);
+    connection->sendCommand(bulk);
+    QCOMPARE(queue.size(), 9);
+
+    queue.flush();
+    QCOMPARE(queue.size(), 0);
+
+    QList<IrcCommand::Type> types;
+    for (int i = 1; i < filter.commands.size(); ++i)
+        types += filter.commands.at(i)->type();
+    QCOMPARE(types, QList<IrcCommand::Type>() << IrcCommand::Message << IrcCommand::Message
+                                              << IrcCommand::Message << IrcCommand::Message
+                                              << IrcCommand::Who
+                                              << IrcCommand::Message << IrcCommand::Message
+                                              << IrcCommand::Who << IrcCommand::Away);
+}
+
+void tst_IrcCommandQueue::testTargets()
+{
+    TestCommandFilter filter(connection);
+    IrcCommandQueue queue(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    filter.commands.clear();
+
+    for (int i = 0; i < 6; ++i)
+        connection->sendCommand(IrcCommand::createMessage("#flood", "hi"));
+    for (int i = 0; i < 2; ++i)
+        connection->sendCommand(IrcCommand::createMessage("#Quiet", "hi"));
+    connection->sendCommand(IrcCommand::createMessage("jpnurmi", "hi"));
+    connection->sendCommand(IrcCommand::createAway("away"));
+
+    QCOMPARE(queue.size(), 10);
+    QCOMPARE(queue.targets(), QStringList() << "#flood" << "#quiet" << "jpnurmi");
+    QCOMPARE(queue.depth("#flood"), 6);
+    QCOMPARE(queue.depth("#QUIET"), 2);
+    QCOMPARE(queue.depth("jpnurmi"), 1);
+    QCOMPARE(queue.depth(QString()), 1);
+    QCOMPARE(queue.depth("#none"), 0);
+    QVERIFY(queue.waitTime("#flood") >= 0);
+    QCOMPARE(queue.waitTime("#none"), qint64(-1));
+
+    queue.flush();
+    QCOMPARE(queue.size(), 0);
+    QVERIFY(queue.targets().isEmpty());
+    QCOMPARE(queue.waitTime("#flood"), qint64(-1));
+
+    QStringList targets;
+    foreach (IrcCommand* cmd, filter.commands) {
+        if (cmd->type() == IrcCommand::Message)
+            targets += cmd->parameters().value(0);
+    }
+    QCOMPARE(targets, QStringList() << "#flood" << "#Quiet" << "jpnurmi"
+                                    << "#flood" << "#Quiet"
+                                    << "#flood" << "#flood" << "#flood" << "#flood");
+
+    // a multiline batch is queued as one command for its target
+    QVERIFY(waitForWritten(":irc.ser.ver CAP communi NEW :draft/multiline=max-bytes=4096,max-lines=2"));
+    QVERIFY(waitForWritten(":irc.ser.ver CAP communi ACK :draft/multiline"));
+    QVERIFY(connection->network()->isCapable("draft/multiline"));
+    queue.flush();
+    filter.commands.clear();
+
+    for (int i = 0; i < 6; ++i)
+        connection->sendCommand(IrcCommand::createMessage("#flood", "hi"));
+    connection->sendCommand(IrcCommand::createMessage("#Multi", "a\nb"));
+    QCOMPARE(queue.depth(QString()), 0);
+    QCOMPARE(queue.depth("#multi"), 1);
+
+    queue.flush();
+    QStringList lines;
+    foreach (IrcCommand* cmd, filter.commands) {
+        if (cmd->type() == IrcCommand::Quote)
+            lines += cmd->toString();
+    }
+    QCOMPARE(lines, QStringList() << "BATCH +1 draft/multiline #Multi\r\n"
+                                     "@batch=1 PRIVMSG #Multi :a\r\n"
+                                     "@batch=1 PRIVMSG #Multi :b\r\n"
+                                     "BATCH -1");
+
+    // targets are folded as per the server's CASEMAPPING
+    connection->sendCommand(IrcCommand::createMessage("Nick[away]", "hi"));
+    QCOMPARE(queue.targets(), QStringList() << "nick{away}");
+    QCOMPARE(queue.depth("NICK{AWAY}"), 1);
+
+    QVERIFY(waitForWritten(":irc.ser.ver 005 communi CASEMAPPING=ascii :are supported by this server"));
+    QCOMPARE(queue.targets(), QStringList() << "nick[away]");
+    QCOMPARE(queue.depth("NICK{AWAY}"), 0);
+    QCOMPARE(queue.depth("NICK[AWAY]"), 1);
+}
+
+void tst_IrcCommandQueue::testCoalescing()
+{
+    TestCommandFilter filter(connection);
+    IrcCommandQueue queue(connection);
+    QVERIFY(queue.isCoalescing());
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome("freenode")));
+
+    filter.commands.clear();
+
+    // duplicates
+    connection->sendCommand(IrcCommand::createWho("#communi"));
+    connection->sendCommand(IrcCommand::createWho("#Communi"));
+    connection->sendCommand(IrcCommand::createNames("#communi"));
+    connection->sendCommand(IrcCommand::createNames("#communi"));
+    QCOMPARE(queue.size(), 2);
+
+    // a part cancels a queued join
+    connection->sendCommand(IrcCommand::createJoin("#foo"));
+    connection->sendCommand(IrcCommand::createPart("#foo"));
+    connection->sendCommand(IrcCommand::createJoin(QStringList() << "#a" << "#b"));
+    connection->sendCommand(IrcCommand::createPart("#b"));
+    QCOMPARE(queue.size(), 3);
+
+    // but a channel that is already joined is still parted
+    QVERIFY(waitForWritten(":communi!communi@hidd.en JOIN :#joined"));
+    connection->sendCommand(IrcCommand::createJoin("#joined"));
+    connection->sendCommand(IrcCommand::createPart("#joined"));
+    QCOMPARE(queue.size(), 4);
+
+    // monitor changes are merged and superseded
+    connection->sendCommand(IrcCommand::createMonitor("+", "alice"));
+    connection->sendCommand(IrcCommand::createMonitor("+", "bob"));
+    connection->sendCommand(IrcCommand::createMonitor("-", "alice"));
+    QCOMPARE(queue.size(), 6);
+
+    // modes are merged up to MODES=4
+    connection->sendCommand(IrcCommand::createMode("#communi", "+o", "jpnurmi"));
+    connection->sendCommand(IrcCommand::createMode("#communi", "+v", "alice"));
+    connection->sendCommand(IrcCommand::createMode("#communi", "-b", "mask"));
+    connection->sendCommand(IrcCommand::createMode("#communi", "+o", "bob"));
+    connection->sendCommand(IrcCommand::createMode("#communi", "+v", "carol"));
+    connection->sendCommand(IrcCommand::createMode("#communi", "+m"));
+    QCOMPARE(queue.size(), 8);
+
+    queue.flush();
+    QCOMPARE(queue.size(), 0);
+
+    QStringList lines;
+    foreach (IrcCommand* cmd, filter.commands)
+        lines += cmd->toString();
+    lines.sort();
+    QCOMPARE(lines, QStringList() << "JOIN #a"
+                                  << "MODE #communi +ov-b+o jpnurmi alice mask bob"
+                                  << "MODE #communi +vm carol"
+                                  << "MONITOR + bob"
+                                  << "MONITOR - alice"
+                                  << "NAMES #communi"
+                                  << "PART #joined"
+                                  << "WHO #communi");
+
+    queue.setCoalescing(false);
+    QVERIFY(!queue.isCoalescing());
+    connection->sendCommand(IrcCommand::createWho("#communi"));
+    connection->sendCommand(IrcCommand::createWho("#communi"));
+    QCOMPARE(queue.size(), 2);
+}
+
 QTEST_MAIN(tst_IrcCommandQueue)
 
 #include "tst_irccommandqueue.moc"
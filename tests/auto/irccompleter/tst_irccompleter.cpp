@@ -29,6 +29,7 @@ private slots:
     void testCompletion();
 
     void testReset();
+    void testMembership();
 };
 
 void tst_IrcCompleter::testSuffix()
@@ -232,6 +233,54 @@ void tst_IrcCompleter::testReset()
     QCOMPARE(guest3, guest1);
 }
 
+void tst_IrcCompleter::testMembership()
+{
+    IrcBufferModel model(connection);
+    connection->open();
+    waitForOpened();
+    waitForWritten(tst_IrcData::welcome());
+    waitForWritten(tst_IrcData::join());
+    IrcChannel* channel = model.get(0)->toChannel();
+    QVERIFY(channel);
+
+    IrcCompleter completer;
+    completer.setBuffer(channel);
+
+    QSignalSpy spy(&completer, SIGNAL(completed(QString,int)));
+    QVERIFY(spy.isValid());
+
+    completer.complete("zzz", 3);
+    QCOMPARE(spy.count(), 0);
+
+    waitForWritten(":zzz_newbie!user@host JOIN #freenode");
+    completer.reset();
+    completer.complete("ZZZ", 3);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.last().at(0).toString(), QString("zzz_newbie: "));
+
+    waitForWritten(":zzz_newbie!user@host NICK zzz_renamed");
+    completer.reset();
+    completer.complete("zzz", 3);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.last().at(0).toString(), QString("zzz_renamed: "));
+
+    // the most recently active user comes first
+    waitForWritten(":zzz_other!user@host JOIN #freenode");
+    completer.reset();
+    completer.complete("zzz", 3);
+    QCOMPARE(spy.count(), 3);
+    QCOMPARE(spy.last().at(0).toString(), QString("zzz_other: "));
+    completer.complete("zzz", 3);
+    QCOMPARE(spy.count(), 4);
+    QCOMPARE(spy.last().at(0).toString(), QString("zzz_renamed: "));
+
+    waitForWritten(":zzz_renamed!user@host PART #freenode");
+    waitForWritten(":zzz_other!user@host QUIT :bye");
+    completer.reset();
+    completer.complete("zzz", 3);
+    QCOMPARE(spy.count(), 4);
+}
+
 QTEST_MAIN(tst_IrcCompleter)
 
 #include "tst_irccompleter.moc"
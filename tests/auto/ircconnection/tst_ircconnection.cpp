@@ -13,6 +13,7 @@
 #include "ircconnection.h"
 #include "ircmessage.h"
 #include "ircfilter.h"
+#include "ircreply.h"
 #include <QtTest/QtTest>
 #include <QtCore/QScopedPointer>
 #ifndef QT_NO_SSL
@@ -105,6 +106,12 @@ private slots:
 
     void testSendCommand();
     void testSendData();
+    void testSplitCommand();
+    void testSplitMessage();
+    void testSendRequest();
+    void testLabeledResponse();
+    void testLocalEcho();
+    void testPingFastPath();
 
     void testMessageFilter();
     void testCommandFilter();
@@ -1498,6 +1505,464 @@ void tst_IrcConnection::testSendData()
     QVERIFY(protocol->written.contains("QUIT"));
 }
 
+class TestLineFilter : public QObject, public IrcCommandFilter
+{
+    Q_OBJECT
+    Q_INTERFACES(IrcCommandFilter)
+
+public:
+    bool commandFilter(IrcCommand* command) override
+    {
+        lines += command->toString();
+        return true;
+    }
+
+    QStringList lines;
+};
+
+void tst_IrcConnection::testSplitCommand()
+{
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome("freenode")));
+
+    TestLineFilter filter;
+    connection->installCommandFilter(&filter);
+
+    // TARGMAX=NAMES:1,PRIVMSG:4
+    connection->sendCommand(IrcCommand::createNames(QStringList() << "#a" << "#b" << "#c"));
+    QCOMPARE(filter.lines, QStringList() << "NAMES #a" << "NAMES #b" << "NAMES #c");
+    filter.lines.clear();
+
+    connection->sendCommand(IrcCommand::createMessage("a,b,c,d,e,f", "hi"));
+    QCOMPARE(filter.lines, QStringList() << "PRIVMSG a,b,c,d :hi" << "PRIVMSG e,f :hi");
+    filter.lines.clear();
+
+    connection->sendCommand(IrcCommand::createMessage("#communi", "hi"));
+    QCOMPARE(filter.lines, QStringList() << "PRIVMSG #communi :hi");
+    filter.lines.clear();
+
+    // channels with keys first
+    connection->sendCommand(IrcCommand::createJoin(QStringList() << "#a" << "#b" << "#c", QStringList() << "" << "kb" << ""));
+    QCOMPARE(filter.lines, QStringList() << "JOIN #b,#a,#c kb");
+    filter.lines.clear();
+
+    // 24 channels of 20 bytes fit in 512 bytes
+    QStringList channels;
+    for (int i = 0; i < 100; ++i)
+        channels += QString("#channel-%1").arg(i, 11, 10, QLatin1Char('0'));
+    connection->sendCommand(IrcCommand::createJoin(channels));
+    QCOMPARE(filter.lines.count(), 5);
+    QStringList joined;
+    foreach (const QString& line, filter.lines) {
+        QVERIFY(line.length() + 2 <= 512);
+        joined += line.mid(5).split(",");
+    }
+    QCOMPARE(joined, channels);
+    filter.lines.clear();
+
+    // MODES=4
+    connection->sendCommand(IrcCommand::createMode("#communi", "+oooooo", "a b c d e f"));
+    QCOMPARE(filter.lines, QStringList() << "MODE #communi +oooo a b c d" << "MODE #communi +oo e f");
+    filter.lines.clear();
+
+    connection->removeCommandFilter(&filter);
+}
+
+void tst_IrcConnection::testSplitMessage()
+{
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome("freenode")));
+    QVERIFY(waitForWritten(":communi!~communi@hidd.en JOIN :#communi"));
+
+    TestLineFilter filter;
+    connection->installCommandFilter(&filter);
+
+    // ":communi!~communi@hidd.en PRIVMSG #communi :" + text + "\r\n" <= 512
+    const int budget = 512 - 46;
+
+    const QString x(1000, QLatin1Char('x'));
+    connection->sendCommand(IrcCommand::createMessage("#communi", x));
+    QCOMPARE(filter.lines, QStringList() << "PRIVMSG #communi :" + x.left(budget)
+                                         << "PRIVMSG #communi :" + x.mid(budget, budget)
+                                         << "PRIVMSG #communi :" + x.mid(2 * budget));
+    filter.lines.clear();
+
+    // split after whitespace
+    const QString words = QString("word ").repeated(200);
+    connection->sendCommand(IrcCommand::createMessage("#communi", words));
+    QCOMPARE(filter.lines.count(), 3);
+    QString joined;
+    foreach (const QString& line, filter.lines) {
+        QVERIFY(line.endsWith(" "));
+        QVERIFY(line.toUtf8().length() - 18 <= budget);
+        joined += line.mid(18);
+    }
+    QCOMPARE(joined, words);
+    filter.lines.clear();
+
+    // never within a UTF-8 sequence
+    const QString umlauts(400, QChar(0xe4));
+    connection->sendCommand(IrcCommand::createMessage("#communi", umlauts));
+    QCOMPARE(filter.lines, QStringList() << "PRIVMSG #communi :" + umlauts.left(budget / 2)
+                                         << "PRIVMSG #communi :" + umlauts.mid(budget / 2));
+    filter.lines.clear();
+
+    // line breaks
+    connection->sendCommand(IrcCommand::createNotice("#communi", "a\nb\r\n\nc"));
+    QCOMPARE(filter.lines, QStringList() << "NOTICE #communi :a" << "NOTICE #communi :b" << "NOTICE #communi :c");
+    filter.lines.clear();
+
+    // multiline batches
+    QVERIFY(waitForWritten(":moorcock.freenode.net CAP communi NEW :draft/multiline=max-bytes=4096,max-lines=2"));
+    QVERIFY(waitForWritten(":moorcock.freenode.net CAP communi ACK :draft/multiline"));
+    QVERIFY(connection->network()->isCapable("draft/multiline"));
+    connection->sendCommand(IrcCommand::createMessage("#communi", "a\nb\nc"));
+    // ...that are sent as one command
+    QCOMPARE(filter.lines, QStringList() << "BATCH +1 draft/multiline #communi\r\n"
+                                            "@batch=1 PRIVMSG #communi :a\r\n"
+                                            "@batch=1 PRIVMSG #communi :b\r\n"
+                                            "BATCH -1"
+                                         << "PRIVMSG #communi :c");
+    filter.lines.clear();
+
+    connection->removeCommandFilter(&filter);
+}
+
+void tst_IrcConnection::testSendRequest()
+{
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome("freenode")));
+    clientSocket->waitForBytesWritten(100);
+    if (serverSocket->waitForReadyRead(100))
+        serverSocket->readAll();
+
+    QVERIFY(!connection->sendRequest(nullptr));
+
+    QScopedPointer<IrcReply> first(connection->sendRequest(IrcCommand::createWhois("jpnurmi")));
+    QScopedPointer<IrcReply> second(connection->sendRequest(IrcCommand::createWhois("Guest1234")));
+    QScopedPointer<IrcReply> other(connection->sendRequest(IrcCommand::createMessage("#communi", "hi")));
+    QVERIFY(first && second && other);
+    QCOMPARE(first->connection(), connection.data());
+    QVERIFY(!first->isFinished());
+    QVERIFY(!second->isFinished());
+
+    // requests that cannot be matched finish once sent
+    QSignalSpy otherSpy(other.data(), SIGNAL(finished()));
+    QVERIFY(other->isFinished());
+    QVERIFY(!other->isAborted());
+    QVERIFY(other->messages().isEmpty());
+    QCoreApplication::sendPostedEvents(other.data(), QEvent::MetaCall);
+    QCOMPARE(otherSpy.count(), 1);
+
+    QVERIFY(clientSocket->waitForBytesWritten(1000));
+    QVERIFY(serverSocket->waitForReadyRead(1000));
+    QByteArray written = serverSocket->readAll();
+    QVERIFY(written.contains("WHOIS jpnurmi"));
+    QVERIFY(written.contains("WHOIS Guest1234"));
+    QVERIFY(!written.contains("@label="));
+
+    // numeric replies are matched in order
+    QSignalSpy firstSpy(first.data(), SIGNAL(finished()));
+    QSignalSpy secondSpy(second.data(), SIGNAL(finished()));
+    QVERIFY(waitForWritten(":moorcock.freenode.net 311 communi jpnurmi ~jpnurmi qt/jpnurmi * :J-P Nurmi\r\n"
+                           ":moorcock.freenode.net 312 communi jpnurmi moorcock.freenode.net :Texas, USA\r\n"
+                           ":moorcock.freenode.net 318 communi jpnurmi :End of /WHOIS list.\r\n"
+                           ":moorcock.freenode.net 401 communi Guest1234 :No such nick/channel"));
+    QCOMPARE(firstSpy.count(), 1);
+    QVERIFY(first->isFinished());
+    QVERIFY(!first->isAborted());
+    QCOMPARE(first->messages().count(), 3);
+    QCOMPARE(static_cast<IrcNumericMessage*>(first->messages().first())->code(), 311);
+    QCOMPARE(first->messages().first()->parent(), first.data());
+    QCOMPARE(secondSpy.count(), 0);
+    QCOMPARE(second->messages().count(), 1);
+
+    QVERIFY(waitForWritten(":moorcock.freenode.net 318 communi Guest1234 :End of /WHOIS list."));
+    QCOMPARE(secondSpy.count(), 1);
+    QCOMPARE(second->messages().count(), 2);
+
+    // different kinds of queries in flight
+    QScopedPointer<IrcReply> names(connection->sendRequest(IrcCommand::createNames("#communi")));
+    QScopedPointer<IrcReply> bans(connection->sendRequest(IrcCommand::createMode("#communi", "b")));
+    QScopedPointer<IrcReply> modes(connection->sendRequest(IrcCommand::createMode("#freenode")));
+    QVERIFY(waitForWritten(":moorcock.freenode.net 353 communi = #communi :communi @jpnurmi\r\n"
+                           ":moorcock.freenode.net 366 communi #communi :End of /NAMES list.\r\n"
+                           ":moorcock.freenode.net 367 communi #communi *!*@foo jpnurmi 1234567890\r\n"
+                           ":moorcock.freenode.net 367 communi #communi *!*@bar jpnurmi 1234567890\r\n"
+                           ":moorcock.freenode.net 368 communi #communi :End of Channel Ban List"));
+    QVERIFY(names->isFinished());
+    QCOMPARE(names->messages().count(), 2);
+    QVERIFY(bans->isFinished());
+    QCOMPARE(bans->messages().count(), 3);
+    QVERIFY(!modes->isFinished());
+
+    QVERIFY(waitForWritten(":moorcock.freenode.net 482 communi #freenode :You're not a channel operator"));
+    QVERIFY(modes->isFinished());
+    QCOMPARE(modes->messages().count(), 1);
+
+    // names are compared as per the server's CASEMAPPING
+    QScopedPointer<IrcReply> mapped(connection->sendRequest(IrcCommand::createWhois("Nick[away]")));
+    QVERIFY(waitForWritten(":moorcock.freenode.net 311 communi nick{away} ~nick hidd.en * :Nick\r\n"
+                           ":moorcock.freenode.net 318 communi nick{away} :End of /WHOIS list."));
+    QVERIFY(mapped->isFinished());
+    QCOMPARE(mapped->messages().count(), 2);
+
+    // a lost connection aborts pending requests
+    QScopedPointer<IrcReply> lost(connection->sendRequest(IrcCommand::createWho("#communi")));
+    QVERIFY(!lost->isFinished());
+    connection->close();
+    QVERIFY(lost->isFinished());
+    QVERIFY(lost->isAborted());
+}
+
+void tst_IrcConnection::testLabeledResponse()
+{
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome("freenode")));
+    QVERIFY(waitForWritten(":moorcock.freenode.net CAP communi ACK :batch labeled-response"));
+    QVERIFY(connection->network()->isCapable("labeled-response"));
+    clientSocket->waitForBytesWritten(100);
+    if (serverSocket->waitForReadyRead(100))
+        serverSocket->readAll();
+
+    QScopedPointer<IrcReply> who(connection->sendRequest(IrcCommand::createWho("#communi")));
+    QScopedPointer<IrcReply> whois(connection->sendRequest(IrcCommand::createWhois("jpnurmi")));
+    QScopedPointer<IrcReply> message(connection->sendRequest(IrcCommand::createMessage("#communi", "hi")));
+    QScopedPointer<IrcReply> mode(connection->sendRequest(IrcCommand::createMode("#communi", "+v", "jpnurmi")));
+    QVERIFY(!who->isFinished());
+    QVERIFY(!whois->isFinished());
+    QVERIFY(!message->isFinished());
+    QVERIFY(!mode->isFinished());
+
+    QVERIFY(clientSocket->waitForBytesWritten(1000));
+    QVERIFY(serverSocket->waitForReadyRead(1000));
+    QByteArray written = serverSocket->readAll();
+    QVERIFY(written.contains("@label=1 WHO #communi"));
+    QVERIFY(written.contains("@label=2 WHOIS jpnurmi"));
+    QVERIFY(written.contains("@label=3 PRIVMSG #communi :hi"));
+    QVERIFY(written.contains("@label=4 MODE #communi +v jpnurmi"));
+
+    // responses in any order
+    QVERIFY(waitForWritten("@label=2 :moorcock.freenode.net BATCH +b1 labeled-response\r\n"
+                           "@batch=b1 :moorcock.freenode.net 311 communi jpnurmi ~jpnurmi qt/jpnurmi * :J-P Nurmi\r\n"
+                           "@batch=b1 :moorcock.freenode.net 318 communi jpnurmi :End of /WHOIS list.\r\n"
+                           ":moorcock.freenode.net BATCH -b1\r\n"
+                           "@label=4 :moorcock.freenode.net ACK\r\n"
+                           "@label=3 :communi!~communi@hidd.en PRIVMSG #communi :hi"));
+    QVERIFY(!who->isFinished());
+    QVERIFY(whois->isFinished());
+    QCOMPARE(whois->messages().count(), 2);
+    QVERIFY(mode->isFinished());
+    QVERIFY(mode->messages().isEmpty());
+    QVERIFY(message->isFinished());
+    QCOMPARE(message->messages().count(), 1);
+    QCOMPARE(message->messages().first()->type(), IrcMessage::Private);
+
+    QVERIFY(waitForWritten("@label=1 :moorcock.freenode.net 315 communi #communi :End of /WHO list."));
+    QVERIFY(who->isFinished());
+    QVERIFY(!who->isAborted());
+    QCOMPARE(who->messages().count(), 1);
+
+    // labels are merged with the existing tags of a multiline batch
+    QVERIFY(waitForWritten(":moorcock.freenode.net CAP communi NEW :draft/multiline=max-bytes=4096,max-lines=2"));
+    QVERIFY(waitForWritten(":moorcock.freenode.net CAP communi ACK :draft/multiline"));
+    clientSocket->waitForBytesWritten(100);
+    if (serverSocket->waitForReadyRead(100))
+        serverSocket->readAll();
+    QScopedPointer<IrcReply> multiline(connection->sendRequest(IrcCommand::createMessage("#communi", "a\nb")));
+    QVERIFY(clientSocket->waitForBytesWritten(1000));
+    QVERIFY(serverSocket->waitForReadyRead(1000));
+    written = serverSocket->readAll();
+    QVERIFY(written.contains("@label=5 BATCH +"));
+    QCOMPARE(written.count("label="), 1);
+    QVERIFY(!multiline->isFinished());
+}
+
+class TestEchoFilter : public QObject, public IrcMessageFilter
+{
+    Q_OBJECT
+    Q_INTERFACES(IrcMessageFilter)
+
+public:
+    bool messageFilter(IrcMessage* message) override
+    {
+        if (message->type() == IrcMessage::Private || message->type() == IrcMessage::Notice)
+            echoes += message->testFlag(IrcMessage::Echo);
+        return false;
+    }
+
+    QList<bool> echoes;
+};
+
+void tst_IrcConnection::testLocalEcho()
+{
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome("freenode")));
+    QVERIFY(waitForWritten(":communi!~communi@hidd.en JOIN :#communi"));
+
+    TestEchoFilter filter;
+    connection->installMessageFilter(&filter);
+
+    // nothing to reconcile without echo-message
+    IrcCommand* command = IrcCommand::createMessage("#communi", "hello");
+    QScopedPointer<IrcMessage> local(command->toMessage(connection->nickName(), connection));
+    QVERIFY(connection->sendCommand(command));
+    QVERIFY(waitForWritten(":jpnurmi!~jpnurmi@qt/jpnurmi PRIVMSG #communi :hello"));
+    QCOMPARE(filter.echoes, QList<bool>() << false);
+    filter.echoes.clear();
+
+    QVERIFY(waitForWritten(":moorcock.freenode.net CAP communi ACK :echo-message"));
+    QVERIFY(connection->network()->isCapable("echo-message"));
+
+    command = IrcCommand::createMessage("#communi", "hello");
+    local.reset(command->toMessage(connection->nickName(), connection));
+    QVERIFY(connection->sendCommand(command));
+    QCOMPARE(local->type(), IrcMessage::Private);
+    QVERIFY(local->isOwn());
+    QVERIFY(!local->testFlag(IrcMessage::Echo));
+
+    // the echo is reconciled with the local message
+    QVERIFY(waitForWritten("@msgid=abc;time=2020-01-01T12:00:00.000Z :communi!~communi@hidd.en PRIVMSG #communi :hello"));
+    QCOMPARE(filter.echoes, QList<bool>() << true);
+    QCOMPARE(local->tags().value("msgid").toString(), QString("abc"));
+    QCOMPARE(local->timeStamp(), QDateTime(QDate(2020, 1, 1), QTime(12, 0), Qt::UTC));
+
+    // ...only once
+    QVERIFY(waitForWritten(":communi!~communi@hidd.en PRIVMSG #communi :hello"));
+    QCOMPARE(filter.echoes, QList<bool>() << true << false);
+    filter.echoes.clear();
+
+    // long messages are echoed line by line
+    const int budget = 512 - 46;
+    const QString x(1000, QLatin1Char('x'));
+    command = IrcCommand::createMessage("#communi", x);
+    local.reset(command->toMessage(connection->nickName(), connection));
+    QVERIFY(connection->sendCommand(command));
+    QVERIFY(waitForWritten((":communi!~communi@hidd.en PRIVMSG #communi :" + x.left(budget) + "\r\n"
+                            ":communi!~communi@hidd.en PRIVMSG #communi :" + x.mid(budget, budget) + "\r\n"
+                            ":communi!~communi@hidd.en PRIVMSG #communi :" + x.mid(2 * budget)).toUtf8()));
+    QCOMPARE(filter.echoes, QList<bool>() << true << true << true);
+    filter.echoes.clear();
+
+    // the local message may be gone by the time of the echo
+    command = IrcCommand::createCtcpAction("#communi", "waves");
+    local.reset(command->toMessage(connection->nickName(), connection));
+    QVERIFY(connection->sendCommand(command));
+    local.reset();
+    QVERIFY(waitForWritten(":communi!~communi@hidd.en PRIVMSG #communi :\1ACTION waves\1"));
+    QCOMPARE(filter.echoes, QList<bool>() << true);
+    filter.echoes.clear();
+
+    // a refused message is not expected to echo back
+    command = IrcCommand::createMessage("#nowhere", "hello");
+    local.reset(command->toMessage(connection->nickName(), connection));
+    QVERIFY(connection->sendCommand(command));
+    QVERIFY(waitForWritten(":moorcock.freenode.net 403 communi #nowhere :No such channel"));
+    QVERIFY(waitForWritten(":communi!~communi@hidd.en PRIVMSG #nowhere :hello"));
+    QCOMPARE(filter.echoes, QList<bool>() << false);
+    filter.echoes.clear();
+
+    // targets are compared with the case mapping of the network
+    command = IrcCommand::createMessage("#Chan[1]", "hello");
+    local.reset(command->toMessage(connection->nickName(), connection));
+    QVERIFY(connection->sendCommand(command));
+    QVERIFY(waitForWritten(":communi!~communi@hidd.en PRIVMSG #chan{1} :hello"));
+    QCOMPARE(filter.echoes, QList<bool>() << true);
+    filter.echoes.clear();
+
+    // with labeled-response, own messages are labeled and their echoes matched by the label
+    QVERIFY(waitForWritten(":moorcock.freenode.net CAP communi ACK :labeled-response"));
+    QVERIFY(connection->network()->isCapable("labeled-response"));
+    clientSocket->waitForBytesWritten(100);
+    if (serverSocket->waitForReadyRead(100))
+        serverSocket->readAll();
+    command = IrcCommand::createMessage("#communi", "hello");
+    local.reset(command->toMessage(connection->nickName(), connection));
+    QVERIFY(connection->sendCommand(command));
+    QVERIFY(clientSocket->waitForBytesWritten(1000));
+    QVERIFY(serverSocket->waitForReadyRead(1000));
+    const QByteArray written = serverSocket->readAll();
+    QVERIFY(written.startsWith("@label="));
+    const QByteArray label = written.mid(7, written.indexOf(' ') - 7);
+    QVERIFY(written.endsWith(" PRIVMSG #communi :hello\r\n"));
+
+    // the same text sent by another client of the account is not an echo
+    QVERIFY(waitForWritten(":communi!~communi@hidd.en PRIVMSG #communi :hello"));
+    QVERIFY(waitForWritten("@label=" + label + " :communi!~communi@hidd.en PRIVMSG #communi :hello"));
+    QCOMPARE(filter.echoes, QList<bool>() << false << true);
+
+    connection->removeMessageFilter(&filter);
+}
+
+class TestPingFilter : public QObject, public IrcMessageFilter
+{
+    Q_OBJECT
+    Q_INTERFACES(IrcMessageFilter)
+
+public:
+    TestPingFilter(TestProtocol* protocol) : protocol(protocol)
+    {
+    }
+
+    bool messageFilter(IrcMessage* message) override
+    {
+        commands += message->command();
+        written += protocol->written;
+        return false;
+    }
+
+    TestProtocol* protocol;
+    QStringList commands;
+    QList<QByteArray> written;
+};
+
+void tst_IrcConnection::testPingFastPath()
+{
+    TestProtocol* protocol = new TestProtocol(connection);
+    FriendlyConnection* friendly = static_cast<FriendlyConnection*>(connection.data());
+    friendly->setProtocol(protocol);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome("freenode")));
+
+    TestPingFilter filter(protocol);
+    connection->installMessageFilter(&filter);
+
+    // a backlog received at once
+    serverSocket->write(":jpnurmi!~jpnurmi@qt/jpnurmi PRIVMSG #communi :one\r\n"
+                        ":jpnurmi!~jpnurmi@qt/jpnurmi PRIVMSG #communi :two\r\n"
+                        "PING :moorcock.freenode.net\r\n"
+                        ":jpnurmi!~jpnurmi@qt/jpnurmi PRIVMSG #communi :three\r\n");
+    QVERIFY(serverSocket->waitForBytesWritten(1000));
+    QVERIFY(clientSocket->waitForReadyRead(1000));
+
+    // the ping is answered before the preceding lines are processed...
+    QCOMPARE(filter.commands, QStringList() << "PRIVMSG" << "PRIVMSG" << "PING" << "PRIVMSG");
+    QCOMPARE(filter.written.first(), QByteArray("PONG moorcock.freenode.net"));
+
+    // ...and only once
+    QVERIFY(clientSocket->waitForBytesWritten(1000));
+    QVERIFY(serverSocket->waitForReadyRead(1000));
+    QCOMPARE(serverSocket->readAll().count("PONG"), 1);
+
+    // tags and prefix
+    QVERIFY(waitForWritten("@time=2020-01-01T12:00:00.000Z :moorcock.freenode.net PING 1234567890"));
+    QCOMPARE(protocol->written, QByteArray("PONG 1234567890"));
+    QCOMPARE(filter.commands.last(), QString("PING"));
+
+    // not a ping
+    QVERIFY(waitForWritten(":moorcock.freenode.net PINGS communi"));
+    QCOMPARE(protocol->written, QByteArray("PONG 1234567890"));
+
+    connection->removeMessageFilter(&filter);
+}
+
 class TestFilter : public QObject, public IrcMessageFilter, public IrcCommandFilter
 {
     Q_OBJECT
@@ -9,6 +9,8 @@
 
 #include "irclagtimer.h"
 #include "ircconnection.h"
+#include "irccommand.h"
+#include "ircreply.h"
 #include "tst_ircclientserver.h"
 #include "tst_ircdata.h"
 #include <QtTest/QtTest>
@@ -22,6 +24,12 @@ private slots:
     void testInterval();
     void testConnection();
     void testLag();
+    void testStatistics();
+    void testEcho();
+    void testLabeledResponse();
+
+private:
+    qint64 ping(IrcLagTimer* timer);
 };
 
 void tst_IrcLagTimer::testDefaults()
@@ -30,6 +38,11 @@ void tst_IrcLagTimer::testDefaults()
     QCOMPARE(timer.lag(), qint64(-1));
     QVERIFY(!timer.connection());
     QCOMPARE(timer.interval(), 60);
+    QCOMPARE(timer.windowSize(), 20);
+    QCOMPARE(timer.minimumLag(), qint64(-1));
+    QCOMPARE(timer.medianLag(), qint64(-1));
+    QCOMPARE(timer.maximumLag(), qint64(-1));
+    QCOMPARE(timer.percentile(95), qint64(-1));
 }
 
 void tst_IrcLagTimer::testInterval()
@@ -78,12 +91,16 @@ void tst_IrcLagTimer::testLag()
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     QRegExp rx("PING communi/(\\d+)");
     QVERIFY(rx.indexIn(written) != -1);
+    const qint64 sent = rx.cap(1).toLongLong();
 #else
     QRegularExpression rx("PING communi/(\\d+)");
-    QVERIFY(rx.match(written).hasMatch());
+    QRegularExpressionMatch match = rx.match(written);
+    QVERIFY(match.hasMatch());
+    const qint64 sent = match.captured(1).toLongLong();
 #endif
 
-    waitForWritten(QString(":irc.ser.ver PONG communi communi/%1").arg(QDateTime::currentMSecsSinceEpoch() - 1234ll).toUtf8());
+    // microseconds on a monotonic clock
+    waitForWritten(QString(":irc.ser.ver PONG communi communi/%1").arg(sent - 1234000ll).toUtf8());
     QVERIFY(timer.lag() >= 1234ll);
     QCOMPARE(lagSpy.count(), ++lagCount);
     QVERIFY(lagSpy.last().at(0).toLongLong() >= 1234ll);
@@ -97,7 +114,7 @@ void tst_IrcLagTimer::testLag()
     QCOMPARE(timer.lag(), -1ll);
     QCOMPARE(lagSpy.count(), lagCount);
 
-    waitForWritten(QString(":irc.ser.ver PONG communi communi/%1").arg(QDateTime::currentMSecsSinceEpoch() - 4321ll).toUtf8());
+    waitForWritten(QString(":irc.ser.ver PONG communi communi/%1").arg(sent - 4321000ll).toUtf8());
     QVERIFY(timer.lag() >= 4321ll);
     QCOMPARE(lagSpy.count(), ++lagCount);
     QVERIFY(lagSpy.last().at(0).toLongLong() >= 4321ll);
@@ -109,6 +126,109 @@ void tst_IrcLagTimer::testLag()
 #endif // QT_VERSION >= 0x040700
 }
 
+qint64 tst_IrcLagTimer::ping(IrcLagTimer* timer)
+{
+    QMetaObject::invokeMethod(timer, "_irc_pingServer");
+    if (!clientSocket->waitForBytesWritten(1000) || !serverSocket->waitForReadyRead(1000))
+        return -1;
+    const QString written = QString::fromUtf8(serverSocket->readAll());
+    const int index = written.indexOf("PING communi/");
+    if (index == -1)
+        return -1;
+    return written.mid(index + 13).trimmed().toLongLong();
+}
+
+void tst_IrcLagTimer::testStatistics()
+{
+#if QT_VERSION >= 0x040700
+    IrcLagTimer timer(connection);
+    timer.setWindowSize(5);
+    QCOMPARE(timer.windowSize(), 5);
+
+    QSignalSpy statisticsSpy(&timer, SIGNAL(statisticsChanged()));
+    QVERIFY(statisticsSpy.isValid());
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    const qint64 sent = ping(&timer);
+    QVERIFY(sent >= 0);
+
+    // 100ms, 200ms, ..., 1000ms of which the last 5 are kept
+    for (int i = 1; i <= 10; ++i)
+        QVERIFY(waitForWritten(QString(":irc.ser.ver PONG communi communi/%1").arg(sent - i * 100000ll).toUtf8()));
+    QCOMPARE(statisticsSpy.count(), 10);
+
+    QVERIFY(timer.minimumLag() >= 600);
+    QVERIFY(timer.minimumLag() < timer.medianLag());
+    QVERIFY(timer.medianLag() >= 800);
+    QVERIFY(timer.medianLag() < timer.maximumLag());
+    QVERIFY(timer.maximumLag() >= 1000);
+    QCOMPARE(timer.percentile(95), timer.maximumLag());
+    QCOMPARE(timer.percentile(0), timer.minimumLag());
+    QCOMPARE(timer.lag(), timer.maximumLag());
+
+    connection->close();
+    QCOMPARE(timer.minimumLag(), qint64(-1));
+    QCOMPARE(timer.maximumLag(), qint64(-1));
+    QCOMPARE(statisticsSpy.count(), 11);
+#endif // QT_VERSION >= 0x040700
+}
+
+void tst_IrcLagTimer::testEcho()
+{
+#if QT_VERSION >= 0x040700
+    IrcLagTimer timer(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+    QVERIFY(waitForWritten(":irc.ser.ver CAP communi ACK :echo-message"));
+
+    QVERIFY(connection->sendCommand(IrcCommand::createMessage("#communi", "hello")));
+    QVERIFY(clientSocket->waitForBytesWritten(1000));
+    QVERIFY(serverSocket->waitForReadyRead(1000));
+    serverSocket->readAll();
+
+    QTest::qWait(50);
+    QVERIFY(waitForWritten(":communi!communi@hidd.en PRIVMSG #communi :hello"));
+    QVERIFY(timer.lag() >= 50);
+    QCOMPARE(timer.maximumLag(), timer.lag());
+
+    // the passive measurement makes the active ping unnecessary
+    QMetaObject::invokeMethod(&timer, "_irc_pingServer");
+    QVERIFY(!clientSocket->waitForBytesWritten(100));
+#endif // QT_VERSION >= 0x040700
+}
+
+void tst_IrcLagTimer::testLabeledResponse()
+{
+#if QT_VERSION >= 0x040700
+    IrcLagTimer timer(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+    QVERIFY(waitForWritten(":irc.ser.ver CAP communi ACK :labeled-response"));
+
+    QScopedPointer<IrcReply> reply(connection->sendRequest(IrcCommand::createTopic("#communi")));
+    QVERIFY(clientSocket->waitForBytesWritten(1000));
+    QVERIFY(serverSocket->waitForReadyRead(1000));
+    QVERIFY(serverSocket->readAll().startsWith("@label=1 TOPIC #communi"));
+
+    QTest::qWait(50);
+    QVERIFY(waitForWritten("@label=1 :irc.ser.ver 331 communi #communi :No topic is set."));
+    QVERIFY(reply->isFinished());
+    QVERIFY(timer.lag() >= 50);
+    QCOMPARE(timer.maximumLag(), timer.lag());
+
+    // the passive measurement makes the active ping unnecessary
+    QMetaObject::invokeMethod(&timer, "_irc_pingServer");
+    QVERIFY(!clientSocket->waitForBytesWritten(100));
+#endif // QT_VERSION >= 0x040700
+}
+
 QTEST_MAIN(tst_IrcLagTimer)
 
 #include "tst_irclagtimer.moc"
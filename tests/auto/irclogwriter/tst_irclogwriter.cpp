@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "irclogwriter.h"
+#include "ircconnection.h"
+#include "tst_ircdata.h"
+#include "tst_ircclientserver.h"
+#include <QtTest/QtTest>
+#include <QtCore/QTemporaryDir>
+
+class tst_IrcLogWriter : public tst_IrcClientServer
+{
+    Q_OBJECT
+
+private slots:
+    void testDefaults();
+    void testTargets();
+    void testDropped();
+    void testRotation();
+
+private:
+    static QByteArray readAll(const QString& fileName);
+};
+
+QByteArray tst_IrcLogWriter::readAll(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+void tst_IrcLogWriter::testDefaults()
+{
+    IrcLogWriter writer;
+    QVERIFY(!writer.connection());
+    QVERIFY(writer.directory().isEmpty());
+    QCOMPARE(writer.queueSize(), 4096);
+    QCOMPARE(writer.flushInterval(), 1000);
+    QVERIFY(!writer.isSyncEnabled());
+    QCOMPARE(writer.rotationSize(), Q_INT64_C(0));
+    QCOMPARE(writer.dropped(), 0);
+
+    IrcLogWriter child(connection);
+    QCOMPARE(child.connection(), connection.data());
+}
+
+void tst_IrcLogWriter::testTargets()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    IrcLogWriter writer(connection);
+    writer.setDirectory(dir.path());
+    writer.setFlushInterval(10);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    waitForWritten(":communi!communi@hidd.en JOIN :#Foo");
+    waitForWritten(":a!a@hidd.en PRIVMSG #foo :channel message");
+    waitForWritten(":Bob!b@hidd.en PRIVMSG communi :private message");
+
+    QTRY_VERIFY(readAll(dir.filePath("%23foo.log")).contains("PRIVMSG #foo :channel message"));
+    QByteArray channel = readAll(dir.filePath("%23foo.log"));
+    QVERIFY(channel.contains("JOIN :#Foo"));
+    QVERIFY(channel.indexOf("JOIN") < channel.indexOf("PRIVMSG"));
+    QVERIFY(channel.endsWith('\n'));
+
+    QTRY_VERIFY(readAll(dir.filePath("bob.log")).contains("PRIVMSG communi :private message"));
+
+    // server messages go to a file named after the host
+    QTRY_VERIFY(readAll(dir.filePath("127.0.0.1.log")).contains(" 001 "));
+    QCOMPARE(writer.dropped(), 0);
+}
+
+void tst_IrcLogWriter::testDropped()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    IrcLogWriter writer(connection);
+    writer.setDirectory(dir.path());
+    writer.setFlushInterval(60000);
+    writer.setQueueSize(1);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+
+    waitForWritten(":a!a@hidd.en PRIVMSG nick :one");
+    waitForWritten(":a!a@hidd.en PRIVMSG nick :two");
+    waitForWritten(":a!a@hidd.en PRIVMSG nick :three");
+    QVERIFY(writer.dropped() > 0);
+
+    writer.flush();
+    QTRY_VERIFY(readAll(dir.filePath("a.log")).contains(":one"));
+}
+
+void tst_IrcLogWriter::testRotation()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    IrcLogWriter writer(connection);
+    writer.setDirectory(dir.path());
+    writer.setFlushInterval(10);
+    writer.setRotationSize(1);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+
+    waitForWritten(":a!a@hidd.en PRIVMSG nick :one");
+    QTRY_VERIFY(readAll(dir.filePath("a.log")).contains(":one"));
+
+    waitForWritten(":a!a@hidd.en PRIVMSG nick :two");
+    QTRY_VERIFY(readAll(dir.filePath("a.log")).contains(":two"));
+    QVERIFY(!readAll(dir.filePath("a.log")).contains(":one"));
+
+    const QStringList rotated = QDir(dir.path()).entryList(QStringList() << "a-*.log");
+    QCOMPARE(rotated.count(), 1);
+    QVERIFY(readAll(QDir(dir.path()).filePath(rotated.first())).contains(":one"));
+}
+
+QTEST_MAIN(tst_IrcLogWriter)
+
+#include "tst_irclogwriter.moc"
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "ircmessagemodel.h"
+#include "ircconnection.h"
+#include "ircbuffermodel.h"
+#include "ircbuffer.h"
+#include "ircmessage.h"
+#include "irc.h"
+#include "tst_ircdata.h"
+#include "tst_ircclientserver.h"
+#include <QtTest/QtTest>
+#include <QtCore/QTemporaryDir>
+
+class tst_IrcMessageModel : public tst_IrcClientServer
+{
+    Q_OBJECT
+
+public:
+    tst_IrcMessageModel();
+
+private slots:
+    void testDefaults();
+    void testMessages();
+    void testLimits();
+    void testSharedHistory();
+    void testClear();
+    void testBufferDestroyed();
+    void testFetchMore();
+
+private:
+    IrcBuffer* joinChannel(IrcBufferModel* bufferModel);
+};
+
+Q_DECLARE_METATYPE(QModelIndex)
+tst_IrcMessageModel::tst_IrcMessageModel()
+{
+    Irc::registerMetaTypes();
+    qRegisterMetaType<QModelIndex>();
+    qRegisterMetaType<IrcBuffer*>("IrcBuffer*");
+}
+
+IrcBuffer* tst_IrcMessageModel::joinChannel(IrcBufferModel* bufferModel)
+{
+    bufferModel->setConnection(connection);
+
+    connection->open();
+    if (!waitForOpened())
+        return nullptr;
+
+    if (!waitForWritten(tst_IrcData::welcome()))
+        return nullptr;
+    waitForWritten(":communi!communi@hidd.en JOIN :#channel");
+    return bufferModel->find("#channel");
+}
+
+void tst_IrcMessageModel::testDefaults()
+{
+    IrcMessageModel model;
+    QCOMPARE(model.count(), 0);
+    QVERIFY(model.isEmpty());
+    QVERIFY(!model.buffer());
+    QVERIFY(!model.get(0));
+    QCOMPARE(model.lineLimit(), 1000);
+    QCOMPARE(model.byteLimit(), -1);
+    QCOMPARE(model.cacheSize(), 256);
+}
+
+void tst_IrcMessageModel::testMessages()
+{
+    IrcBufferModel bufferModel;
+    IrcBuffer* channel = joinChannel(&bufferModel);
+    QVERIFY(channel);
+
+    // no history is kept before a model is attached
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :ignored");
+
+    IrcMessageModel model(channel);
+    QCOMPARE(model.buffer(), channel);
+    QCOMPARE(model.count(), 0);
+
+    QSignalSpy countSpy(&model, SIGNAL(countChanged(int)));
+    QSignalSpy emptySpy(&model, SIGNAL(emptyChanged(bool)));
+    QSignalSpy insertedSpy(&model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    QVERIFY(countSpy.isValid());
+    QVERIFY(emptySpy.isValid());
+    QVERIFY(insertedSpy.isValid());
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :hello");
+    waitForWritten(":b!b@hidd.en NOTICE #channel :world");
+    waitForWritten(":c!c@hidd.en PRIVMSG #channel :\1ACTION waves\1");
+
+    QCOMPARE(model.count(), 3);
+    QVERIFY(!model.isEmpty());
+    QCOMPARE(countSpy.count(), 3);
+    QCOMPARE(countSpy.last().at(0).toInt(), 3);
+    QCOMPARE(emptySpy.count(), 1);
+    QCOMPARE(emptySpy.last().at(0).toBool(), false);
+    QCOMPARE(insertedSpy.count(), 3);
+    QCOMPARE(insertedSpy.last().at(1).toInt(), 2);
+
+    QCOMPARE(model.data(model.index(0)).toString(), QString("<a> hello"));
+    QCOMPARE(model.data(model.index(1)).toString(), QString("-b- world"));
+    QCOMPARE(model.data(model.index(2)).toString(), QString("* c waves"));
+    QVERIFY(model.data(model.index(0), Irc::TimeStampRole).toDateTime().isValid());
+
+    IrcMessage* message = model.data(model.index(0), Irc::MessageRole).value<IrcMessage*>();
+    QVERIFY(message);
+    QCOMPARE(message->type(), IrcMessage::Private);
+    QCOMPARE(message->nick(), QString("a"));
+    QCOMPARE(message->connection(), connection.data());
+    QCOMPARE(model.get(0), message);
+    QCOMPARE(model.message(model.index(0)), message);
+
+    QVERIFY(!model.get(3));
+    QVERIFY(!model.data(model.index(3)).isValid());
+
+    // forwarded messages are part of the history too
+    IrcMessage* msg = IrcMessage::fromData(":d!d@hidd.en PRIVMSG communi :forwarded", connection);
+    channel->receiveMessage(msg);
+    QCOMPARE(model.count(), 4);
+    QCOMPARE(model.data(model.index(3)).toString(), QString("<d> forwarded"));
+    delete msg;
+}
+
+void tst_IrcMessageModel::testLimits()
+{
+    IrcBufferModel bufferModel;
+    IrcBuffer* channel = joinChannel(&bufferModel);
+    QVERIFY(channel);
+
+    IrcMessageModel model(channel);
+    model.setLineLimit(2);
+
+    QSignalSpy removedSpy(&model, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+    QVERIFY(removedSpy.isValid());
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :1");
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :2");
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :3");
+
+    QCOMPARE(model.count(), 2);
+    QCOMPARE(removedSpy.count(), 1);
+    QCOMPARE(model.data(model.index(0)).toString(), QString("<a> 2"));
+    QCOMPARE(model.data(model.index(1)).toString(), QString("<a> 3"));
+
+    // lowering the limit trims the oldest lines right away
+    model.setLineLimit(1);
+    QCOMPARE(model.count(), 1);
+    QCOMPARE(model.data(model.index(0)).toString(), QString("<a> 3"));
+
+    model.setLineLimit(-1);
+    // room for two lines, but not for three
+    const int size = QByteArray(":a!a@hidd.en PRIVMSG #channel :4").size();
+    model.setByteLimit(size * 5 / 2);
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :4");
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :5");
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :6");
+    QCOMPARE(model.count(), 2);
+    QCOMPARE(model.data(model.index(0)).toString(), QString("<a> 5"));
+    QCOMPARE(model.data(model.index(1)).toString(), QString("<a> 6"));
+}
+
+void tst_IrcMessageModel::testSharedHistory()
+{
+    IrcBufferModel bufferModel;
+    IrcBuffer* channel = joinChannel(&bufferModel);
+    QVERIFY(channel);
+
+    IrcMessageModel small(channel);
+    small.setLineLimit(1);
+
+    IrcMessageModel* large = new IrcMessageModel(channel);
+    large->setLineLimit(3);
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :1");
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :2");
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :3");
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :4");
+
+    // the most generous model wins
+    QCOMPARE(small.count(), 3);
+    QCOMPARE(large->count(), 3);
+
+    delete large;
+    QCOMPARE(small.count(), 1);
+    QCOMPARE(small.data(small.index(0)).toString(), QString("<a> 4"));
+
+    // a new model sees the existing history
+    IrcMessageModel other;
+    other.setLineLimit(1);
+    other.setBuffer(channel);
+    QCOMPARE(other.count(), 1);
+
+    // without models the history falls back to the default limits
+    small.setBuffer(nullptr);
+    other.setBuffer(nullptr);
+    for (int i = 0; i < 1500; ++i) {
+        IrcMessage* msg = IrcMessage::fromData(":a!a@hidd.en PRIVMSG #channel :" + QByteArray::number(i), connection);
+        channel->receiveMessage(msg);
+        delete msg;
+    }
+
+    IrcMessageModel unlimited;
+    unlimited.setLineLimit(-1);
+    unlimited.setBuffer(channel);
+    QCOMPARE(unlimited.count(), 1000);
+    QCOMPARE(unlimited.data(unlimited.index(999)).toString(), QString("<a> 1499"));
+}
+
+void tst_IrcMessageModel::testClear()
+{
+    IrcBufferModel bufferModel;
+    IrcBuffer* channel = joinChannel(&bufferModel);
+    QVERIFY(channel);
+
+    IrcMessageModel model(channel);
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :1");
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :2");
+    QCOMPARE(model.count(), 2);
+
+    QSignalSpy countSpy(&model, SIGNAL(countChanged(int)));
+    QSignalSpy emptySpy(&model, SIGNAL(emptyChanged(bool)));
+    QSignalSpy resetSpy(&model, SIGNAL(modelReset()));
+    QVERIFY(countSpy.isValid());
+    QVERIFY(emptySpy.isValid());
+    QVERIFY(resetSpy.isValid());
+
+    model.clear();
+    QCOMPARE(model.count(), 0);
+    QVERIFY(model.isEmpty());
+    QCOMPARE(countSpy.count(), 1);
+    QCOMPARE(emptySpy.count(), 1);
+    QCOMPARE(resetSpy.count(), 1);
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :3");
+    QCOMPARE(model.count(), 1);
+    QCOMPARE(model.data(model.index(0)).toString(), QString("<a> 3"));
+}
+
+void tst_IrcMessageModel::testBufferDestroyed()
+{
+    IrcBuffer* buffer = new IrcBuffer;
+    IrcMessageModel model;
+    model.setBuffer(buffer);
+    QCOMPARE(model.buffer(), buffer);
+
+    IrcMessage* msg = IrcMessage::fromData(":a!a@hidd.en PRIVMSG #channel :hello", nullptr);
+    buffer->receiveMessage(msg);
+    delete msg;
+    QCOMPARE(model.count(), 1);
+
+    QSignalSpy bufferSpy(&model, SIGNAL(bufferChanged(IrcBuffer*)));
+    QVERIFY(bufferSpy.isValid());
+
+    delete buffer;
+    QVERIFY(!model.buffer());
+    QCOMPARE(model.count(), 0);
+    QCOMPARE(bufferSpy.count(), 1);
+}
+
+void tst_IrcMessageModel::testFetchMore()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    IrcBufferModel bufferModel;
+    bufferModel.setArchiveDirectory(dir.path());
+    IrcBuffer* channel = joinChannel(&bufferModel);
+    QVERIFY(channel);
+
+    for (int i = 1; i <= 5; ++i)
+        waitForWritten(":a!a@hidd.en PRIVMSG #channel :" + QByteArray::number(i));
+
+    IrcMessageModel model(channel);
+    model.setFetchSize(2);
+    QCOMPARE(model.count(), 0);
+    QVERIFY(model.canFetchMore(QModelIndex()));
+
+    QSignalSpy insertedSpy(&model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    QVERIFY(insertedSpy.isValid());
+
+    model.fetchMore(QModelIndex());
+    QCOMPARE(model.count(), 2);
+    QCOMPARE(insertedSpy.count(), 1);
+    QCOMPARE(insertedSpy.last().at(1).toInt(), 0);
+    QCOMPARE(insertedSpy.last().at(2).toInt(), 1);
+    QCOMPARE(model.data(model.index(0)).toString(), QString("<a> 4"));
+    QCOMPARE(model.data(model.index(1)).toString(), QString("<a> 5"));
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #channel :6");
+    QCOMPARE(model.count(), 3);
+
+    model.fetchMore(QModelIndex());
+    QCOMPARE(model.count(), 5);
+    QCOMPARE(model.data(model.index(0)).toString(), QString("<a> 2"));
+    QCOMPARE(model.data(model.index(4)).toString(), QString("<a> 6"));
+
+    // the join is the oldest archived message
+    model.fetchMore(QModelIndex());
+    QCOMPARE(model.count(), 7);
+    QCOMPARE(model.get(0)->type(), IrcMessage::Join);
+    QCOMPARE(model.data(model.index(1)).toString(), QString("<a> 1"));
+    QVERIFY(!model.canFetchMore(QModelIndex()));
+}
+
+QTEST_MAIN(tst_IrcMessageModel)
+
+#include "tst_ircmessagemodel.moc"
@@ -44,6 +44,8 @@ private slots:
 
     void testCapNotify();
 
+    void testSharedInfo();
+
     void testDebug();
 };
 
@@ -434,6 +436,45 @@ void tst_IrcNetwork::testCapNotify()
     QVERIFY(network->hasCapability("foo-bar"));
 }
 
+void tst_IrcNetwork::testSharedInfo()
+{
+#ifdef Q_OS_LINUX
+    // others have problems with symbols (win) or private headers (osx frameworks)
+    QHash<QString, QString> info;
+    info.insert("NETWORK", "shared");
+    info.insert("PREFIX", "(qaohv)~&@%+");
+    info.insert("CHANTYPES", "#&");
+    info.insert("STATUSMSG", "@+");
+    info.insert("NICKLEN", "30");
+
+    IrcConnection one;
+    IrcConnection another;
+    IrcNetworkPrivate* p1 = IrcNetworkPrivate::get(one.network());
+    IrcNetworkPrivate* p2 = IrcNetworkPrivate::get(another.network());
+    p1->setInfo(info);
+    p2->setInfo(info);
+
+    QVERIFY(p1->info == p2->info);
+    QCOMPARE(p1->prefixIndex('%'), 3);
+    QCOMPARE(p1->modeIndex('q'), 0);
+    QCOMPARE(p1->channelTypeIndex('&'), 1);
+    QCOMPARE(p1->statusPrefixLength("@+#chan"), 2);
+    QCOMPARE(one.network()->numericLimit(IrcNetwork::NickLength), 30);
+    QCOMPARE(one.network()->numericLimit(IrcNetwork::TopicLength), -1);
+    QVERIFY(one.network()->isChannel("@&chan"));
+    QVERIFY(!one.network()->isChannel("@jpnurmi"));
+
+    // a later ISUPPORT update forks a new snapshot without touching the shared one
+    QHash<QString, QString> update;
+    update.insert("TOPICLEN", "390");
+    p2->setInfo(update);
+    QVERIFY(p1->info != p2->info);
+    QCOMPARE(one.network()->numericLimit(IrcNetwork::TopicLength), -1);
+    QCOMPARE(another.network()->numericLimit(IrcNetwork::TopicLength), 390);
+    QCOMPARE(another.network()->numericLimit(IrcNetwork::NickLength), 30);
+#endif // Q_OS_LINUX
+}
+
 void tst_IrcNetwork::testDebug()
 {
     QString str;
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "ircsearchindex.h"
+#include "ircconnection.h"
+#include "ircbuffermodel.h"
+#include "ircbuffer.h"
+#include "ircmessage.h"
+#include "tst_ircdata.h"
+#include "tst_ircclientserver.h"
+#include <QtTest/QtTest>
+#include <QtCore/QTemporaryDir>
+
+class tst_IrcSearchIndex : public tst_IrcClientServer
+{
+    Q_OBJECT
+
+private slots:
+    void testDefaults();
+    void testSearch();
+    void testFilters();
+    void testClear();
+    void testRebuild();
+
+private:
+    bool joinChannels(IrcBufferModel* model);
+    static QStringList contents(const QList<IrcMessage*>& messages);
+};
+
+bool tst_IrcSearchIndex::joinChannels(IrcBufferModel* model)
+{
+    model->setConnection(connection);
+
+    connection->open();
+    if (!waitForOpened())
+        return false;
+
+    if (!waitForWritten(tst_IrcData::welcome()))
+        return false;
+    waitForWritten(":communi!communi@hidd.en JOIN :#foo");
+    waitForWritten(":communi!communi@hidd.en JOIN :#bar");
+    return model->count() == 2;
+}
+
+QStringList tst_IrcSearchIndex::contents(const QList<IrcMessage*>& messages)
+{
+    QStringList result;
+    foreach (IrcMessage* message, messages)
+        result += message->property("content").toString();
+    qDeleteAll(messages);
+    return result;
+}
+
+void tst_IrcSearchIndex::testDefaults()
+{
+    IrcSearchIndex index;
+    QVERIFY(!index.model());
+    QCOMPARE(index.count(), 0);
+    QVERIFY(index.search("foo").isEmpty());
+
+    IrcBufferModel model;
+    IrcSearchIndex child(&model);
+    QCOMPARE(child.model(), &model);
+}
+
+void tst_IrcSearchIndex::testSearch()
+{
+    IrcBufferModel model;
+    IrcSearchIndex index(&model);
+    QVERIFY(joinChannels(&model));
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #foo :Hello World");
+    waitForWritten(":b!b@hidd.en PRIVMSG #bar :hello, \x02world\x02!");
+    waitForWritten(":c!c@hidd.en NOTICE #foo :goodbye world");
+    waitForWritten(":d!d@hidd.en PRIVMSG #foo :unrelated");
+    QTRY_COMPARE(index.count(), 4);
+
+    QCOMPARE(contents(index.search("hello")), QStringList() << "Hello World" << "hello, \x02world\x02!");
+    QCOMPARE(contents(index.search("WORLD hello")), QStringList() << "Hello World" << "hello, \x02world\x02!");
+    QCOMPARE(contents(index.search("world")).count(), 3);
+    QCOMPARE(contents(index.search("world", QString(), QString(), QDateTime(), QDateTime(), 1)), QStringList() << "goodbye world");
+    QVERIFY(index.search("missing").isEmpty());
+    QVERIFY(index.search("hello missing").isEmpty());
+
+    QList<IrcMessage*> messages = index.search("unrelated");
+    QCOMPARE(messages.count(), 1);
+    QCOMPARE(messages.first()->type(), IrcMessage::Private);
+    QCOMPARE(messages.first()->nick(), QString("d"));
+    QCOMPARE(messages.first()->connection(), connection.data());
+    qDeleteAll(messages);
+}
+
+void tst_IrcSearchIndex::testFilters()
+{
+    IrcBufferModel model;
+    IrcSearchIndex index(&model);
+    QVERIFY(joinChannels(&model));
+
+    IrcBuffer* foo = model.find("#foo");
+    QVERIFY(foo);
+
+    const QDateTime base = QDateTime::fromMSecsSinceEpoch(Q_INT64_C(1500000000000));
+    for (int i = 0; i < 10; ++i) {
+        IrcMessage* msg = IrcMessage::fromData(":nick" + QByteArray::number(i % 2) + "!u@h PRIVMSG #foo :msg " + QByteArray::number(i), connection);
+        msg->setTimeStamp(base.addSecs(i));
+        foo->receiveMessage(msg);
+        delete msg;
+    }
+    waitForWritten(":nick0!u@h PRIVMSG #bar :msg bar");
+    QTRY_COMPARE(index.count(), 11);
+
+    QCOMPARE(contents(index.search("msg")).count(), 11);
+    QCOMPARE(contents(index.search("msg", "#FOO")).count(), 10);
+    QCOMPARE(contents(index.search("msg", "#bar")), QStringList() << "msg bar");
+    QCOMPARE(contents(index.search("msg", "#foo", "NICK1")), QStringList() << "msg 1" << "msg 3" << "msg 5" << "msg 7" << "msg 9");
+    QCOMPARE(contents(index.search(QString(), QString(), "nick0")).count(), 6);
+    QCOMPARE(contents(index.search("msg", "#foo", QString(), base.addSecs(3), base.addSecs(5))), QStringList() << "msg 3" << "msg 4" << "msg 5");
+    QCOMPARE(contents(index.search("msg", "#foo", "nick0", base.addSecs(3))), QStringList() << "msg 4" << "msg 6" << "msg 8");
+    QVERIFY(index.search("msg", "#baz").isEmpty());
+}
+
+void tst_IrcSearchIndex::testClear()
+{
+    IrcBufferModel model;
+    IrcSearchIndex index(&model);
+    QVERIFY(joinChannels(&model));
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #foo :first");
+    QTRY_COMPARE(index.count(), 1);
+
+    index.clear();
+    QCOMPARE(index.count(), 0);
+    QVERIFY(index.search("first").isEmpty());
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #foo :second");
+    QTRY_COMPARE(index.count(), 1);
+    QCOMPARE(contents(index.search("second")), QStringList() << "second");
+
+    // detached from the model
+    index.setModel(nullptr);
+    waitForWritten(":a!a@hidd.en PRIVMSG #foo :third");
+    QTest::qWait(50);
+    QCOMPARE(index.count(), 1);
+}
+
+void tst_IrcSearchIndex::testRebuild()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    IrcBufferModel model;
+    model.setArchiveDirectory(dir.path());
+    QVERIFY(joinChannels(&model));
+
+    waitForWritten(":a!a@hidd.en PRIVMSG #foo :archived one");
+    waitForWritten(":b!b@hidd.en PRIVMSG #bar :archived two");
+    waitForWritten(":c!c@hidd.en PRIVMSG #foo :archived three");
+
+    IrcSearchIndex index;
+    index.setModel(&model);
+    QCOMPARE(index.count(), 0);
+
+    index.rebuild();
+    QTRY_COMPARE(index.count(), 3);
+    QCOMPARE(contents(index.search("archived", "#foo")), QStringList() << "archived one" << "archived three");
+
+    index.rebuild(1);
+    QTRY_COMPARE(index.count(), 2);
+    QCOMPARE(contents(index.search("archived")).count(), 2);
+
+    // more than a page, mostly sharing the same timestamps
+    for (int i = 0; i < 300; ++i)
+        waitForWritten(":a!a@hidd.en PRIVMSG #foo :paged " + QByteArray::number(i));
+
+    index.rebuild();
+    QTRY_COMPARE(index.count(), 303);
+    const QStringList paged = contents(index.search("paged"));
+    QCOMPARE(paged.count(), 100);
+    QCOMPARE(paged.first(), QString("paged 200"));
+    QCOMPARE(paged.last(), QString("paged 299"));
+}
+
+QTEST_MAIN(tst_IrcSearchIndex)
+
+#include "tst_ircsearchindex.moc"
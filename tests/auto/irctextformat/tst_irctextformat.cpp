@@ -24,6 +24,9 @@ private slots:
     void testHtml();
     void testUrls_data();
     void testUrls();
+    void testRuns();
+    void testCache();
+    void testSnapshot();
 };
 
 void tst_IrcTextFormat::testDefaults()
@@ -57,6 +60,9 @@ void tst_IrcTextFormat::testPlainText_data()
     QTest::newRow("dummy \\x03") << "foo\x03 \02bold\x0f bar\x03" << "foo bold bar";
     QTest::newRow("extra \\x0f") << "foo\x0f \02bold\x0f bar\x0f" << "foo bold bar";
     QTest::newRow("background") << QString("foo \x03%1,%1red\x0f on \x03%1,%1red\x03 bar").arg(Irc::Red) << "foo red on red bar";
+    QTest::newRow("comma") << "foo \x03" "4,bar" << "foo ,bar";
+    QTest::newRow("three digits") << "\x03" "123" << "3";
+    QTest::newRow("three digit background") << "\x03" "1,234" << "4";
 }
 
 void tst_IrcTextFormat::testPlainText()
@@ -188,6 +194,148 @@ void tst_IrcTextFormat::testUrls()
     QCOMPARE(format.urls(), urls);
 }
 
+static bool compareRun(const IrcTextFormat::Run& run, int start, int length, IrcTextFormat::Styles styles, int fg = -1, int bg = -1, int url = -1)
+{
+    return run.start == start && run.length == length && run.styles == styles
+            && run.foreground == fg && run.background == bg && run.url == url;
+}
+
+void tst_IrcTextFormat::testRuns()
+{
+    IrcTextFormat format;
+    QString text;
+    QList<QUrl> urls;
+    QVector<IrcTextFormat::Run> runs;
+
+    runs = format.toRuns("foo \02bold\x0f bar", &text, &urls);
+    QCOMPARE(text, QString("foo bold bar"));
+    QCOMPARE(runs.count(), 1);
+    QVERIFY(compareRun(runs.at(0), 4, 4, IrcTextFormat::Bold));
+    QVERIFY(urls.isEmpty());
+
+    runs = format.toRuns("\x1d\x1f" "a\x1f" "b\x1d\x13\x16" "c", &text);
+    QCOMPARE(text, QString("abc"));
+    QCOMPARE(runs.count(), 3);
+    QVERIFY(compareRun(runs.at(0), 0, 1, IrcTextFormat::Italic | IrcTextFormat::Underline));
+    QVERIFY(compareRun(runs.at(1), 1, 1, IrcTextFormat::Italic));
+    QVERIFY(compareRun(runs.at(2), 2, 1, IrcTextFormat::StrikeOut | IrcTextFormat::Inverse));
+
+    runs = format.toRuns(QString("\x03%1,%2red\x03%3blue\x03 none").arg(Irc::Red).arg(Irc::Black).arg(Irc::Blue), &text);
+    QCOMPARE(text, QString("redblue none"));
+    QCOMPARE(runs.count(), 2);
+    QVERIFY(compareRun(runs.at(0), 0, 3, IrcTextFormat::NoStyle, Irc::Red, Irc::Black));
+    QVERIFY(compareRun(runs.at(1), 3, 4, IrcTextFormat::NoStyle, Irc::Blue, Irc::Black));
+
+    runs = format.toRuns("a & <b>", &text);
+    QCOMPARE(text, QString("a & <b>"));
+    QVERIFY(runs.isEmpty());
+
+    runs = format.toRuns("go \02to http://www.fi\02 or www.fi", &text, &urls);
+    QCOMPARE(text, QString("go to http://www.fi or www.fi"));
+    QCOMPARE(urls, QList<QUrl>() << QUrl("http://www.fi") << QUrl("http://www.fi"));
+    QCOMPARE(runs.count(), 3);
+    QVERIFY(compareRun(runs.at(0), 3, 3, IrcTextFormat::Bold));
+    QVERIFY(compareRun(runs.at(1), 6, 13, IrcTextFormat::Bold, -1, -1, 0));
+    QVERIFY(compareRun(runs.at(2), 23, 6, IrcTextFormat::NoStyle, -1, -1, 1));
+
+    format.setUrlPattern(QString());
+    runs = format.toRuns("www.fi", &text, &urls);
+    QVERIFY(runs.isEmpty());
+}
+
+void tst_IrcTextFormat::testCache()
+{
+    IrcTextFormat format;
+    QCOMPARE(format.cacheSize(), 0);
+
+    const QString text = QString("\x03%1red\x0f www.fi").arg(Irc::Red);
+    format.toHtml(text);
+    format.toHtml(text);
+    QCOMPARE(format.cacheHits(), 0);
+    QCOMPARE(format.cacheMisses(), 0);
+
+    format.setCacheSize(10);
+    QCOMPARE(format.cacheSize(), 10);
+
+    const QString html = format.toHtml(text);
+    QCOMPARE(format.cacheMisses(), 1);
+    QCOMPARE(format.toHtml(text), html);
+    QCOMPARE(format.cacheHits(), 1);
+
+    QCOMPARE(format.toPlainText(text), QString("red www.fi"));
+    QCOMPARE(format.cacheMisses(), 2);
+    QCOMPARE(format.toPlainText(text), QString("red www.fi"));
+    QCOMPARE(format.cacheHits(), 2);
+
+    format.parse(text);
+    QCOMPARE(format.cacheHits(), 3);
+    QCOMPARE(format.plainText(), QString("red www.fi"));
+    QCOMPARE(format.html(), html);
+    QCOMPARE(format.urls(), QList<QUrl>() << QUrl("http://www.fi"));
+
+    format.palette()->setColorName(Irc::Red, "#ff0000");
+    QVERIFY(format.toHtml(text).contains("#ff0000"));
+    QCOMPARE(format.cacheMisses(), 3);
+
+    format.setSpanFormat(IrcTextFormat::SpanClass);
+    QVERIFY(format.toHtml(text).contains("class='#ff0000'"));
+    QCOMPARE(format.cacheMisses(), 4);
+
+    format.setUrlPattern(QString());
+    QVERIFY(!format.toHtml(text).contains("<a href"));
+    QCOMPARE(format.cacheMisses(), 5);
+
+    format.clearCache();
+    QCOMPARE(format.cacheHits(), 0);
+    QCOMPARE(format.cacheMisses(), 0);
+    QCOMPARE(format.cacheSize(), 10);
+}
+
+void tst_IrcTextFormat::testSnapshot()
+{
+    IrcTextFormat::Snapshot null;
+    QVERIFY(null.isNull());
+    QVERIFY(null.toHtml("foo").isEmpty());
+
+    IrcTextFormat format;
+    format.palette()->setColorName(Irc::Red, "#ff0000");
+
+    const QString text = QString("\x03%1red\x0f \02bold\02 www.fi").arg(Irc::Red);
+    const QString html = format.toHtml(text);
+    const QString plain = format.toPlainText(text);
+
+    IrcTextFormat::Snapshot snapshot = format.snapshot();
+    QVERIFY(!snapshot.isNull());
+    QCOMPARE(snapshot.toHtml(text), html);
+    QCOMPARE(snapshot.toPlainText(text), plain);
+
+    format.palette()->setColorName(Irc::Red, "#cc0000");
+    format.setSpanFormat(IrcTextFormat::SpanClass);
+    format.setUrlPattern(QString());
+    QVERIFY(format.toHtml(text) != html);
+    QCOMPARE(snapshot.toHtml(text), html);
+
+    IrcTextFormat::Snapshot copy = snapshot;
+    QCOMPARE(copy.toHtml(text), html);
+
+    QStringList texts;
+    for (int i = 0; i < 1000; ++i)
+        texts += QString("%1 \x03%2color\x03 https://communi.github.io/%1").arg(i).arg(i % 16);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(4);
+    const QStringList htmls = snapshot.toHtml(texts, &pool);
+    const QStringList plains = snapshot.toPlainText(texts, &pool);
+    QCOMPARE(htmls.count(), texts.count());
+    QCOMPARE(plains.count(), texts.count());
+    for (int i = 0; i < texts.count(); ++i) {
+        QCOMPARE(htmls.at(i), snapshot.toHtml(texts.at(i)));
+        QCOMPARE(plains.at(i), snapshot.toPlainText(texts.at(i)));
+    }
+
+    QVERIFY(snapshot.toHtml(QStringList()).isEmpty());
+}
+
 QTEST_MAIN(tst_IrcTextFormat)
 
 #include "tst_irctextformat.moc"
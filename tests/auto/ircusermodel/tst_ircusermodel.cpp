@@ -49,6 +49,10 @@ private slots:
     void testRoles();
     void testAIM();
     void testUser();
+    void testNamesRefresh();
+    void testSharedIdentity();
+    void testMassModes();
+    void testCaseMapping();
 };
 
 Q_DECLARE_METATYPE(QModelIndex)
@@ -1684,6 +1688,218 @@ void tst_IrcUserModel::testUser()
     QCOMPARE(qoutServOpSpy.count(), 0);
 }
 
+void tst_IrcUserModel::testNamesRefresh()
+{
+    IrcBufferModel bufferModel;
+    bufferModel.setConnection(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+    QVERIFY(waitForWritten(":communi!communi@hidd.en JOIN :#channel"));
+    QCOMPARE(bufferModel.count(), 1);
+
+    IrcUserModel userModel(bufferModel.get(0));
+    QVERIFY(waitForWritten(":irc.ser.ver 353 communi = #channel :a @b +c"));
+    QVERIFY(waitForWritten(":irc.ser.ver 366 communi #channel :End of /NAMES list."));
+    QCOMPARE(userModel.count(), 3);
+
+    QPointer<IrcUser> a = userModel.find("a");
+    QPointer<IrcUser> b = userModel.find("b");
+    QPointer<IrcUser> c = userModel.find("c");
+    QVERIFY(a);
+    QVERIFY(b);
+    QVERIFY(c);
+
+    QSignalSpy addedSpy(&userModel, SIGNAL(added(IrcUser*)));
+    QSignalSpy removedSpy(&userModel, SIGNAL(removed(IrcUser*)));
+    QSignalSpy dataChangedSpy(&userModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+    QSignalSpy modelResetSpy(&userModel, SIGNAL(modelReset()));
+    QVERIFY(addedSpy.isValid());
+    QVERIFY(removedSpy.isValid());
+    QVERIFY(dataChangedSpy.isValid());
+    QVERIFY(modelResetSpy.isValid());
+
+    // identical names -> no changes
+    QVERIFY(waitForWritten(":irc.ser.ver 353 communi = #channel :a @b +c"));
+    QVERIFY(waitForWritten(":irc.ser.ver 366 communi #channel :End of /NAMES list."));
+    QCOMPARE(userModel.count(), 3);
+    QCOMPARE(userModel.find("a"), a.data());
+    QCOMPARE(userModel.find("b"), b.data());
+    QCOMPARE(userModel.find("c"), c.data());
+    QCOMPARE(addedSpy.count(), 0);
+    QCOMPARE(removedSpy.count(), 0);
+    QCOMPARE(dataChangedSpy.count(), 0);
+    QCOMPARE(modelResetSpy.count(), 0);
+
+    // a opped, b deopped, c gone, d new
+    QVERIFY(waitForWritten(":irc.ser.ver 353 communi = #channel :@a b d"));
+    QVERIFY(waitForWritten(":irc.ser.ver 366 communi #channel :End of /NAMES list."));
+    QCOMPARE(userModel.count(), 3);
+    QCOMPARE(userModel.find("a"), a.data());
+    QCOMPARE(userModel.find("b"), b.data());
+    QVERIFY(!userModel.find("c"));
+    QVERIFY(userModel.find("d"));
+    QVERIFY(!c);
+
+    QCOMPARE(a->prefix(), QString("@"));
+    QCOMPARE(a->mode(), QString("o"));
+    QCOMPARE(b->prefix(), QString());
+    QCOMPARE(b->mode(), QString());
+
+    QCOMPARE(addedSpy.count(), 1);
+    QCOMPARE(addedSpy.last().at(0).value<IrcUser*>(), userModel.find("d"));
+    QCOMPARE(removedSpy.count(), 1);
+    QCOMPARE(dataChangedSpy.count(), 2);
+    QCOMPARE(modelResetSpy.count(), 0);
+    QCOMPARE(userModel.names(), QStringList() << "a" << "b" << "d");
+}
+
+void tst_IrcUserModel::testSharedIdentity()
+{
+    IrcBufferModel bufferModel;
+    bufferModel.setConnection(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+    QVERIFY(waitForWritten(":communi!communi@hidd.en JOIN :#one"));
+    QVERIFY(waitForWritten(":irc.ser.ver 353 communi = #one :communi @x y"));
+    QVERIFY(waitForWritten(":irc.ser.ver 366 communi #one :End of /NAMES list."));
+    QVERIFY(waitForWritten(":communi!communi@hidd.en JOIN :#two"));
+    QVERIFY(waitForWritten(":irc.ser.ver 353 communi = #two :communi +x"));
+    QVERIFY(waitForWritten(":irc.ser.ver 366 communi #two :End of /NAMES list."));
+    QCOMPARE(bufferModel.count(), 2);
+
+    IrcUserModel one(bufferModel.get(0));
+    IrcUserModel two(bufferModel.get(1));
+
+    IrcUser* x1 = one.find("x");
+    IrcUser* x2 = two.find("x");
+    QVERIFY(x1);
+    QVERIFY(x2);
+    QVERIFY(x1 != x2);
+    QCOMPARE(x1->prefix(), QString("@"));
+    QCOMPARE(x2->prefix(), QString("+"));
+
+    QSignalSpy awaySpy1(x1, SIGNAL(awayChanged(bool)));
+    QSignalSpy awaySpy2(x2, SIGNAL(awayChanged(bool)));
+    QSignalSpy nameSpy1(x1, SIGNAL(nameChanged(QString)));
+    QSignalSpy nameSpy2(x2, SIGNAL(nameChanged(QString)));
+    QVERIFY(awaySpy1.isValid());
+    QVERIFY(awaySpy2.isValid());
+    QVERIFY(nameSpy1.isValid());
+    QVERIFY(nameSpy2.isValid());
+
+    // the who reply is delivered to #one, but the state is shared
+    QVERIFY(waitForWritten(":irc.ser.ver 352 communi #one ~x hidd.en irc.ser.ver x G@ :0 X"));
+    QVERIFY(x1->isAway());
+    QVERIFY(x2->isAway());
+    QCOMPARE(awaySpy1.count(), 1);
+    QCOMPARE(awaySpy2.count(), 1);
+
+    QVERIFY(waitForWritten(":x!~x@hidd.en NICK :z"));
+    QCOMPARE(x1->name(), QString("z"));
+    QCOMPARE(x2->name(), QString("z"));
+    QCOMPARE(nameSpy1.count(), 1);
+    QCOMPARE(nameSpy2.count(), 1);
+    QCOMPARE(one.find("z"), x1);
+    QCOMPARE(two.find("z"), x2);
+    QVERIFY(!one.find("x"));
+    QVERIFY(!two.find("x"));
+
+    // membership state stays per channel
+    QVERIFY(waitForWritten(":ChanServ!ChanServ@services. MODE #two -v z"));
+    QCOMPARE(x1->prefix(), QString("@"));
+    QCOMPARE(x2->prefix(), QString());
+}
+
+void tst_IrcUserModel::testMassModes()
+{
+    IrcBufferModel bufferModel;
+    bufferModel.setConnection(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+    QVERIFY(waitForWritten(":communi!communi@hidd.en JOIN :#channel"));
+    QVERIFY(waitForWritten(":irc.ser.ver 353 communi = #channel :communi a b c d"));
+    QVERIFY(waitForWritten(":irc.ser.ver 366 communi #channel :End of /NAMES list."));
+    QCOMPARE(bufferModel.count(), 1);
+
+    IrcChannel* channel = bufferModel.get(0)->toChannel();
+    QVERIFY(channel);
+
+    IrcUserModel userModel(channel);
+    userModel.setSortMethod(Irc::SortByTitle);
+
+    QVERIFY(waitForWritten(":ChanServ!ChanServ@services. MODE #channel +vvvv a b c d"));
+    foreach (const QString& name, QStringList() << "a" << "b" << "c" << "d") {
+        QCOMPARE(userModel.find(name)->mode(), QString("v"));
+        QCOMPARE(userModel.find(name)->prefix(), QString("+"));
+    }
+
+    // channel mode arguments must not be mistaken for users
+    QVERIFY(waitForWritten(":ChanServ!ChanServ@services. MODE #channel +ob-v c *!*@mask d"));
+    QCOMPARE(userModel.find("c")->mode(), QString("ov"));
+    QCOMPARE(userModel.find("c")->prefix(), QString("@+"));
+    QCOMPARE(userModel.find("c")->title(), QString("@c"));
+    QCOMPARE(userModel.find("d")->mode(), QString());
+    QCOMPARE(userModel.find("d")->title(), QString("d"));
+
+    QStringList titles = QStringList() << "@c" << "+a" << "+b" << "communi" << "d";
+    QCOMPARE(userModel.titles(), titles);
+
+    QVERIFY(waitForWritten(":ChanServ!ChanServ@services. MODE #channel +nt-n+k secret"));
+    QCOMPARE(channel->mode(), QString("+kt secret"));
+    QCOMPARE(channel->key(), QString("secret"));
+}
+
+void tst_IrcUserModel::testCaseMapping()
+{
+    IrcBufferModel bufferModel;
+    bufferModel.setConnection(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+
+    // CASEMAPPING=rfc1459: {}|~ are the lower case forms of []\^
+    QVERIFY(waitForWritten(tst_IrcData::welcome("freenode")));
+    QVERIFY(waitForWritten(":communi!communi@hidd.en JOIN :#Chan[nel]"));
+    QCOMPARE(bufferModel.count(), 1);
+    IrcBuffer* buffer = bufferModel.get(0);
+    QCOMPARE(bufferModel.find("#chan{NEL}"), buffer);
+    QVERIFY(bufferModel.contains("#CHAN{nel}"));
+
+    IrcUserModel userModel(buffer);
+    QVERIFY(waitForWritten(":irc.ser.ver 353 communi = #chan{nel} :Nick[a] @b^ c"));
+    QVERIFY(waitForWritten(":irc.ser.ver 366 communi #chan{nel} :End of /NAMES list."));
+    QCOMPARE(userModel.count(), 3);
+    QCOMPARE(userModel.names(), QStringList() << "Nick[a]" << "b^" << "c");
+
+    IrcUser* nick = userModel.find("Nick[a]");
+    QVERIFY(nick);
+    QCOMPARE(userModel.find("nick{A}"), nick);
+    QCOMPARE(userModel.find("B~"), userModel.find("b^"));
+    QVERIFY(!userModel.find("nick[b]"));
+
+    QVERIFY(waitForWritten(":NICK{A}!user@host NICK :Other"));
+    QCOMPARE(userModel.find("other"), nick);
+    QCOMPARE(nick->name(), QString("Other"));
+    QCOMPARE(userModel.names(), QStringList() << "Other" << "b^" << "c");
+
+    QVERIFY(waitForWritten(":B~!user@host PART #CHAN{NEL}"));
+    QCOMPARE(userModel.count(), 2);
+    QVERIFY(!userModel.contains("b^"));
+
+    // own messages are recognized regardless of the case
+    QVERIFY(waitForWritten(":COMMUNI!communi@hidd.en PART #chan[nel]"));
+    QCOMPARE(bufferModel.count(), 0);
+}
+
 QTEST_MAIN(tst_IrcUserModel)
 
 #include "tst_ircusermodel.moc"
@@ -17,6 +17,8 @@ class tst_IrcTextFormat : public QObject
 private slots:
     void testToHtml_data();
     void testToHtml();
+    void testToPlainText_data();
+    void testToPlainText();
 };
 
 void tst_IrcTextFormat::testToHtml_data()
@@ -27,6 +29,7 @@ void tst_IrcTextFormat::testToHtml_data()
     QTest::newRow("topic") << QString("Communi 1.2.2 - IRC framework || Home: https://communi.github.io || Docs: https://communi.github.io/doc || MeeGo: http://store.ovi.com/content/219150");
     QTest::newRow("commit") << QString("[communi-desktop] jpnurmi pushed 2 new commits to master: https://github.com/communi/communi-desktop/compare/257ca915a490...8832bfe8d0b8");
     QTest::newRow("welcome") << QString("Welcome to the Communi development lounge. Communi for MeeGo/Symbian users are kindly asked to submit a review in Nokia Store.");
+    QTest::newRow("formatted") << QString("\x02\x03" "04,01Communi\x0f is a \x1d" "cross-platform\x1d \x1fIRC framework\x1f & <library> written with \x03" "12Qt\x03 - see https://communi.github.io?a=1&b=2");
 }
 
 void tst_IrcTextFormat::testToHtml()
@@ -39,6 +42,21 @@ void tst_IrcTextFormat::testToHtml()
     }
 }
 
+void tst_IrcTextFormat::testToPlainText_data()
+{
+    testToHtml_data();
+}
+
+void tst_IrcTextFormat::testToPlainText()
+{
+    QFETCH(QString, text);
+
+    IrcTextFormat format;
+    QBENCHMARK {
+        format.toPlainText(text);
+    }
+}
+
 QTEST_MAIN(tst_IrcTextFormat)
 
 #include "tst_irctextformat.moc"